@@ -78,6 +78,14 @@ WLIBC_INLINE int readdir_r(DIR *restrict dirstream, struct dirent *restrict entr
 	return wlibc_readdir_r(dirstream, entry, result);
 }
 
+// Read up to 'count' entries into 'entries' at once. Returns the number of entries read, 0 at the end of the directory
+// and -1 on error.
+WLIBC_API ssize_t wlibc_readdir_batch(DIR *restrict dirstream, struct dirent *restrict entries, size_t count);
+WLIBC_INLINE ssize_t readdir_batch(DIR *restrict dirstream, struct dirent *restrict entries, size_t count)
+{
+	return wlibc_readdir_batch(dirstream, entries, count);
+}
+
 WLIBC_API void wlibc_rewinddir(DIR *dirstream);
 WLIBC_INLINE void rewinddir(DIR *dirstream)
 {
@@ -102,25 +110,26 @@ WLIBC_INLINE int dirfd(DIR *dirstream)
 	return wlibc_dirfd(dirstream);
 }
 
+WLIBC_API int wlibc_alphasort(const struct dirent **e1, const struct dirent **e2);
+WLIBC_INLINE int alphasort(const struct dirent **e1, const struct dirent **e2)
+{
+	return wlibc_alphasort(e1, e2);
+}
+
 WLIBC_API int wlibc_common_scandir(int dfd, const char *path, struct dirent ***entries, int (*selector)(const struct dirent *),
 								   int (*cmp)(const struct dirent **, const struct dirent **));
 
 WLIBC_INLINE int scandir(const char *path, struct dirent ***entries, int (*selector)(const struct dirent *),
 						 int (*cmp)(const struct dirent **, const struct dirent **))
 {
-	return wlibc_common_scandir(AT_FDCWD, path, entries, selector, cmp);
+	// Let scandir know that the entries are to be sorted by alphasort, it can sort them faster.
+	return wlibc_common_scandir(AT_FDCWD, path, entries, selector, cmp == alphasort ? wlibc_alphasort : cmp);
 }
 
 WLIBC_INLINE int scandirat(int dfd, const char *path, struct dirent ***entries, int (*selector)(const struct dirent *),
 						int (*cmp)(const struct dirent **, const struct dirent **))
 {
-	return wlibc_common_scandir(dfd, path, entries, selector, cmp);
-}
-
-WLIBC_API int wlibc_alphasort(const struct dirent **e1, const struct dirent **e2);
-WLIBC_INLINE int alphasort(const struct dirent **e1, const struct dirent **e2)
-{
-	return wlibc_alphasort(e1, e2);
+	return wlibc_common_scandir(dfd, path, entries, selector, cmp == alphasort ? wlibc_alphasort : cmp);
 }
 
 _WLIBC_END_DECLS
@@ -0,0 +1,121 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_FTS_H
+#define WLIBC_FTS_H
+
+#include <wlibc.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Options of fts_open.
+#define FTS_COMFOLLOW 0x001 // Follow symbolic links given as arguments.
+#define FTS_LOGICAL   0x002 // Follow symbolic links.
+#define FTS_NOCHDIR   0x004 // Do not change directories, this is always the case.
+#define FTS_NOSTAT    0x008 // Stat information is not needed, it is given anyway.
+#define FTS_PHYSICAL  0x010 // Do not follow symbolic links.
+#define FTS_SEEDOT    0x020 // Return "." and "..".
+#define FTS_XDEV      0x040 // Stay within the same file system.
+
+// Option of fts_children.
+#define FTS_NAMEONLY 0x100 // Only the names are needed.
+
+// Values of fts_info.
+#define FTS_D       1  // Directory, before its contents.
+#define FTS_DC      2  // Directory that causes a cycle.
+#define FTS_DEFAULT 3  // None of the below.
+#define FTS_DNR     4  // Directory that can't be read.
+#define FTS_DOT     5  // "." or "..".
+#define FTS_DP      6  // Directory, after its contents.
+#define FTS_ERR     7  // Error, fts_errno is set.
+#define FTS_F       8  // File.
+#define FTS_INIT    9  // Initialized only.
+#define FTS_NS      10 // stat failed, fts_errno is set.
+#define FTS_NSOK    11 // stat not requested.
+#define FTS_SL      12 // Symbolic link.
+#define FTS_SLNONE  13 // Symbolic link to a nonexistent file.
+
+// Instructions of fts_set.
+#define FTS_AGAIN   1 // Return the entry again.
+#define FTS_FOLLOW  2 // Follow the symbolic link.
+#define FTS_NOINSTR 3 // No instruction.
+#define FTS_SKIP    4 // Do not walk the directory.
+
+typedef struct _FTSENT
+{
+	struct _FTSENT *fts_cycle;  // Directory that this one is a cycle of (FTS_DC).
+	struct _FTSENT *fts_parent; // Parent directory.
+	struct _FTSENT *fts_link;   // Next entry of the same directory.
+	long long fts_number;       // For the caller.
+	void *fts_pointer;          // For the caller.
+	char *fts_accpath;          // Path to access the entry, same as fts_path.
+	char *fts_path;             // Path of the entry from the root.
+	char *fts_name;             // Name of the entry.
+	size_t fts_pathlen;
+	size_t fts_namelen;
+	int fts_errno;
+	short fts_level;            // Depth, the roots are at 0.
+	unsigned short fts_info;    // FTS_* values above.
+	unsigned short fts_instr;   // Instruction given by fts_set.
+	ino_t fts_ino;
+	dev_t fts_dev;
+	nlink_t fts_nlink;
+	struct stat *fts_statp;
+} FTSENT;
+
+typedef struct _FTS
+{
+	FTSENT *fts_cur;   // Last entry returned.
+	FTSENT *fts_child; // Children of the current entry given by fts_children.
+	int (*fts_compar)(const FTSENT **, const FTSENT **);
+	dev_t fts_dev; // Of the current root, for FTS_XDEV.
+	int fts_options;
+	int fts_stop;
+} FTS;
+
+/*
+ The entries are stat'ed from the listings of their directories, same as nftw (see ftw.h). The stat buffers are always
+ filled, FTS_NOSTAT makes no difference. The walk never changes the working directory, fts_accpath is fts_path.
+ Each entry owns its path, fts_path stays valid till the entry is freed.
+*/
+
+WLIBC_API FTS *wlibc_fts_open(char *const *paths, int options, int (*compar)(const FTSENT **, const FTSENT **));
+WLIBC_API FTSENT *wlibc_fts_read(FTS *ftsp);
+WLIBC_API FTSENT *wlibc_fts_children(FTS *ftsp, int options);
+WLIBC_API int wlibc_fts_set(FTS *ftsp, FTSENT *entry, int instr);
+WLIBC_API int wlibc_fts_close(FTS *ftsp);
+
+WLIBC_INLINE FTS *fts_open(char *const *paths, int options, int (*compar)(const FTSENT **, const FTSENT **))
+{
+	return wlibc_fts_open(paths, options, compar);
+}
+
+WLIBC_INLINE FTSENT *fts_read(FTS *ftsp)
+{
+	return wlibc_fts_read(ftsp);
+}
+
+WLIBC_INLINE FTSENT *fts_children(FTS *ftsp, int options)
+{
+	return wlibc_fts_children(ftsp, options);
+}
+
+WLIBC_INLINE int fts_set(FTS *ftsp, FTSENT *entry, int instr)
+{
+	return wlibc_fts_set(ftsp, entry, instr);
+}
+
+WLIBC_INLINE int fts_close(FTS *ftsp)
+{
+	return wlibc_fts_close(ftsp);
+}
+
+_WLIBC_END_DECLS
+
+#endif
@@ -0,0 +1,74 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_FTW_H
+#define WLIBC_FTW_H
+
+#include <wlibc.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Values of 'typeflag' given to the callback.
+#define FTW_F   0 // File
+#define FTW_D   1 // Directory
+#define FTW_DNR 2 // Directory that can't be read
+#define FTW_NS  3 // stat failed
+#define FTW_SL  4 // Symbolic link (FTW_PHYS)
+#define FTW_DP  5 // Directory, all its subdirectories have been visited (FTW_DEPTH)
+#define FTW_SLN 6 // Symbolic link to a nonexistent file
+
+// Flags of nftw.
+#define FTW_PHYS         0x01  // Do not follow symbolic links.
+#define FTW_MOUNT        0x02  // Stay within the same file system.
+#define FTW_CHDIR        0x04  // Change to each directory before reading it.
+#define FTW_DEPTH        0x08  // Visit the contents of a directory before the directory itself.
+#define FTW_ACTIONRETVAL 0x10  // Interpret the return value of the callback, see below.
+#define FTW_PARALLEL     0x100 // Walk the subdirectories in parallel, see below.
+
+// Return values of the callback for FTW_ACTIONRETVAL.
+#define FTW_CONTINUE      0
+#define FTW_STOP          1
+#define FTW_SKIP_SUBTREE  2
+#define FTW_SKIP_SIBLINGS 3
+
+struct FTW
+{
+	int base;  // Offset of the file name in the path.
+	int level; // Depth relative to the starting directory.
+};
+
+/*
+ The entries are stat'ed from the listings of their directories, files are never opened. Only the starting path and the
+ targets of symbolic links that are followed are stat'ed by path. The permission bits of the stat buffers given to the
+ callback are derived from the file attributes and st_uid, st_gid, st_nlink, st_blksize are 0. 'nopenfd' is ignored,
+ a directory is closed once it has been read.
+
+ FTW_PARALLEL is an extension. The subdirectories are walked by a pool of threads and the callback is called from
+ all of them concurrently, in no particular order except that a directory is visited before its contents (or after them
+ with FTW_DEPTH). FTW_SKIP_SIBLINGS is treated as FTW_CONTINUE and FTW_CHDIR is not allowed with it.
+*/
+
+WLIBC_API int wlibc_ftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag), int nopenfd);
+WLIBC_API int wlibc_nftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf),
+						 int nopenfd, int flags);
+
+WLIBC_INLINE int ftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag), int nopenfd)
+{
+	return wlibc_ftw(path, callback, nopenfd);
+}
+
+WLIBC_INLINE int nftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf),
+					  int nopenfd, int flags)
+{
+	return wlibc_nftw(path, callback, nopenfd, flags);
+}
+
+_WLIBC_END_DECLS
+
+#endif
@@ -9,6 +9,7 @@
 #define WLIBC_DIRENT_INTERNAL_H
 
 #include <internal/nt.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 typedef struct _WLIBC_DIR
@@ -35,4 +36,30 @@ typedef struct _WLIBC_DIR
 
 #define DIRENT_DIR_BUFFER_SIZE 131072 // 128 KB. This allows a minimum of 250 entries.
 
+// The entries of a directory (except "." and "..") read in one go by the tree walkers, see walk.c.
+// The records are packed one after the other in a single buffer.
+typedef struct _dirent_record
+{
+	struct stat st; // From the directory listing, see convert_stat in readdir.c.
+	uint16_t size;  // Size of the record, the next one follows it.
+	uint8_t type;   // d_type
+	uint8_t namlen;
+	char name[1];
+} dirent_record;
+
+typedef struct _dirent_records
+{
+	char *buffer;
+	size_t used;
+	size_t capacity;
+	size_t count;
+} dirent_records;
+
+#define FIRST_DIRENT_RECORD(records) ((dirent_record *)((records)->buffer))
+#define NEXT_DIRENT_RECORD(record)   ((dirent_record *)((char *)(record) + (record)->size))
+
+// Returns 0 on success, -1 on failure (errno is set). st_dev of the records is set to 'dev'.
+int read_dirent_records(const char *path, dev_t dev, dirent_records *records);
+void free_dirent_records(dirent_records *records);
+
 #endif
@@ -19,7 +19,12 @@ typedef enum _handle_t
 	CONSOLE_HANDLE,
 	FILE_HANDLE,
 	DIRECTORY_HANDLE,
-	PIPE_HANDLE
+	PIPE_HANDLE,
+	EPOLL_HANDLE,
+	EVENTFD_HANDLE,
+	TIMERFD_HANDLE,
+	SIGNALFD_HANDLE,
+	MAX_HANDLE_TYPE // Not a type, keep this last.
 } handle_t;
 
 typedef struct _fdinfo
@@ -28,10 +33,17 @@ typedef struct _fdinfo
 	handle_t type;
 	int flags;
 	unsigned int sequence;
+	unsigned int version; // Odd while the entry is being modified.
+	HANDLE pio_handle;    // Positional io handle, see get_fd_pio_handle.
 } fdinfo;
 
-extern fdinfo *_wlibc_fd_table;
-extern size_t _wlibc_fd_table_size;
+// The fd table is made up of fixed size pages. Once published a page is never moved or freed,
+// only the directory of page pointers is replaced when the table grows.
+#define FD_TABLE_PAGE_SHIFT 8
+#define FD_TABLE_PAGE_SIZE  (1 << FD_TABLE_PAGE_SHIFT)
+
+extern fdinfo **volatile _wlibc_fd_directory;
+extern volatile size_t _wlibc_fd_table_size;
 extern unsigned int _wlibc_fd_sequence;
 extern RTL_SRWLOCK _wlibc_fd_table_srwlock;
 
@@ -56,13 +68,52 @@ void unregister_from_fd_table(HANDLE _h);
 // Remove the file descriptor from the table and close it's handle
 int close_fd(int _fd);
 
+// Modules keeping their own state for fds of a type can register a hook, called (with the table locked) before the handle is closed.
+typedef void (*fd_close_hook)(int _fd, HANDLE _h);
+void register_fd_close_hook(handle_t _type, fd_close_hook _hook);
+
 // Return the file descriptor corresponding to the given handle
 int get_fd(HANDLE _h);
 
+// Fds that are not backed by a file (eventfd, timerfd, signalfd) keep their state in an object shared by the fd and its duplicates.
+// The handle of such an fd is a waitable object (event or timer) which is signaled while the fd is readable, so poll can wait on it.
+#define IS_OBJECT_HANDLE(type) ((type) == EVENTFD_HANDLE || (type) == TIMERFD_HANDLE || (type) == SIGNALFD_HANDLE)
+
+typedef struct _fd_object
+{
+	HANDLE handle; // Our own handle to the waitable object of the fd, valid till the object is freed.
+	RTL_SRWLOCK lock;
+	volatile LONG references;
+	ssize_t (*read)(struct _fd_object *object, void *buffer, size_t count, int flags);
+	ssize_t (*write)(struct _fd_object *object, const void *buffer, size_t count, int flags); // Optional.
+	void (*destroy)(struct _fd_object *object);                                               // Optional, called before it is freed.
+} fd_object;
+
+// Create an fd of 'type' for the object, whose methods should be set. The object should be allocated from the process heap and
+// is owned by the fd table from here on, even on failure. 'handle' is the waitable object of the fd, which is closed along with the fd.
+int register_fd_object(fd_object *object, HANDLE handle, handle_t type, int flags);
+
+// Return the object of the fd with a reference held, or NULL with errno set (EBADF, EINVAL if it is not of 'type').
+fd_object *acquire_fd_object(int fd, handle_t type);
+void release_fd_object(fd_object *object);
+
+// Bookkeeping for duplicates and closes of object fds, called by dup and close_fd.
+int dup_fd_object(HANDLE source, HANDLE target);
+void remove_fd_object(HANDLE handle);
+
+// Read and write of object fds.
+ssize_t common_object_read(const fdinfo *info, void *buffer, size_t count);
+ssize_t common_object_write(const fdinfo *info, const void *buffer, size_t count);
+
 // Return information on the fd.
 // If fd given is invalid, type is set to INVALID_HANDLE, and handle is set to NULL.
 void get_fdinfo(int fd, fdinfo *info);
 
+// Return a second handle to the file of 'info' (a snapshot of 'fd') for positional io. Io with an explicit offset on a
+// synchronous handle moves its file position, doing it through this handle leaves the position of the fd untouched.
+// It is opened on first use and closed along with the fd. Returns NULL if the file can't be reopened.
+HANDLE get_fd_pio_handle(int fd, const fdinfo *info);
+
 // Getters
 HANDLE get_fd_handle(int _fd);
 int get_fd_flags(int _fd);
@@ -97,11 +148,13 @@ HANDLE open_mountmgr(void);
 #define EXCLUSIVE_LOCK_FD_TABLE()   RtlAcquireSRWLockExclusive(&_wlibc_fd_table_srwlock)
 #define EXCLUSIVE_UNLOCK_FD_TABLE() RtlReleaseSRWLockExclusive(&_wlibc_fd_table_srwlock)
 
+// Entries can be read without the lock. Check FD_IN_TABLE first, the size is always published after the directory.
+#define FD_ENTRY(fd)        (&_wlibc_fd_directory[(fd) >> FD_TABLE_PAGE_SHIFT][(fd) & (FD_TABLE_PAGE_SIZE - 1)])
 #define FD_IN_TABLE(fd)     (fd < _wlibc_fd_table_size)
-#define FD_GET_HANDLE(fd)   (_wlibc_fd_table[fd].handle)
-#define FD_GET_TYPE(fd)     (_wlibc_fd_table[fd].type)
-#define FD_GET_FLAGS(fd)    (_wlibc_fd_table[fd].flags)
-#define FD_GET_SEQUENCE(fd) (_wlibc_fd_table[fd].sequence)
+#define FD_GET_HANDLE(fd)   (FD_ENTRY(fd)->handle)
+#define FD_GET_TYPE(fd)     (FD_ENTRY(fd)->type)
+#define FD_GET_FLAGS(fd)    (FD_ENTRY(fd)->flags)
+#define FD_GET_SEQUENCE(fd) (FD_ENTRY(fd)->sequence)
 
 #define VALIDATE_PATH(path, error, ret)  \
 	if (path == NULL || path[0] == '\0') \
@@ -0,0 +1,45 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_FORMAT_INTERNAL_H
+#define WLIBC_FORMAT_INTERNAL_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * The printf formatting engine.
+ * This is plain C and does not depend on anything Windows specific, so it can be built and checked on any host.
+ */
+
+// Maximum number of arguments that can be referred to by position (%n$).
+#define FORMAT_MAX_POSITIONAL_ARGS 128
+
+// Output destination of the formatter. Formatting writes into 'buffer' starting at 'used'.
+// When the buffer is full 'spill' is called, it should consume the 'used' characters and provide a new buffer
+// (resetting 'used'). It returns 0 on success and -1 (errno is set) on failure, which ends the formatting.
+// If 'spill' is NULL the characters that do not fit are dropped, they are still counted.
+typedef struct _format_sink
+{
+	char *buffer;
+	size_t size;
+	size_t used;
+	int (*spill)(struct _format_sink *sink);
+	void *context;
+} format_sink;
+
+// Format the arguments according to 'format' into 'sink'. No NULL terminator is written.
+// On return 'used' is the number of characters in the last buffer provided, these have not been spilled.
+// Returns the length of the complete output, or -1 (errno is set) on failure.
+int format_to_sink(format_sink *sink, const char *format, va_list args);
+
+// Format the arguments according to 'format' into 'buffer' with the semantics of vsnprintf.
+// At most 'size - 1' characters are written followed by a NULL terminator, 'buffer' can be NULL if 'size' is 0.
+// Returns the length of the complete output, or -1 (errno is set) if the format string is invalid.
+int format_string(char *buffer, size_t size, const char *format, va_list args);
+
+#endif
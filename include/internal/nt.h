@@ -465,6 +465,25 @@ NtWriteFile(_In_ HANDLE FileHandle, _In_opt_ HANDLE Event, _In_opt_ PIO_APC_ROUT
 			_Out_ PIO_STATUS_BLOCK IoStatusBlock, _In_reads_bytes_(Length) PVOID Buffer, _In_ ULONG Length,
 			_In_opt_ PLARGE_INTEGER ByteOffset, _In_opt_ PULONG Key);
 
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtReadFileScatter(_In_ HANDLE FileHandle, _In_opt_ HANDLE Event, _In_opt_ PIO_APC_ROUTINE ApcRoutine, _In_opt_ PVOID ApcContext,
+				  _Out_ PIO_STATUS_BLOCK IoStatusBlock, _In_ PFILE_SEGMENT_ELEMENT SegmentArray, _In_ ULONG Length,
+				  _In_opt_ PLARGE_INTEGER ByteOffset, _In_opt_ PULONG Key);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtWriteFileGather(_In_ HANDLE FileHandle, _In_opt_ HANDLE Event, _In_opt_ PIO_APC_ROUTINE ApcRoutine, _In_opt_ PVOID ApcContext,
+				  _Out_ PIO_STATUS_BLOCK IoStatusBlock, _In_ PFILE_SEGMENT_ELEMENT SegmentArray, _In_ ULONG Length,
+				  _In_opt_ PLARGE_INTEGER ByteOffset, _In_opt_ PULONG Key);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtCancelSynchronousIoFile(_In_ HANDLE ThreadHandle, _In_opt_ PIO_STATUS_BLOCK IoRequestToCancel, _Out_ PIO_STATUS_BLOCK IoStatusBlock);
+
 NTSYSCALLAPI
 NTSTATUS
 NTAPI
@@ -613,6 +632,12 @@ NTAPI
 NtDuplicateObject(_In_ HANDLE SourceProcessHandle, _In_ HANDLE SourceHandle, _In_opt_ HANDLE TargetProcessHandle,
 				  _Out_opt_ PHANDLE TargetHandle, _In_ ACCESS_MASK DesiredAccess, _In_ ULONG HandleAttributes, _In_ ULONG Options);
 
+// Returns STATUS_SUCCESS if both handles refer to the same object, STATUS_NOT_SAME_OBJECT otherwise.
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtCompareObjects(_In_ HANDLE FirstObjectHandle, _In_ HANDLE SecondObjectHandle);
+
 NTSYSCALLAPI
 NTSTATUS
 NTAPI
@@ -1556,6 +1581,15 @@ typedef struct _TEB
 #define FSCTL_GET_REPARSE_POINT    CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 42, METHOD_BUFFERED, FILE_ANY_ACCESS)     // REPARSE_DATA_BUFFER
 #define FSCTL_DELETE_REPARSE_POINT CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 43, METHOD_BUFFERED, FILE_SPECIAL_ACCESS) // REPARSE_DATA_BUFFER,
 
+#define FSCTL_PIPE_ASSIGN_EVENT CTL_CODE(FILE_DEVICE_NAMED_PIPE, 0, METHOD_BUFFERED, FILE_ANY_ACCESS) // FILE_PIPE_ASSIGN_EVENT_BUFFER
+
+// The event is signaled by the file system whenever the state of the pipe end changes (data written, read, end closed).
+typedef struct _FILE_PIPE_ASSIGN_EVENT_BUFFER
+{
+	HANDLE EventHandle; // NULL removes the event.
+	ULONG KeyValue;
+} FILE_PIPE_ASSIGN_EVENT_BUFFER, *PFILE_PIPE_ASSIGN_EVENT_BUFFER;
+
 #define SYMLINK_FLAG_RELATIVE 0x00000001 // If set then this is a relative symlink.
 #define SYMLINK_DIRECTORY \
 	0x80000000 // If set then this is a directory symlink. This is not persisted on disk and is programmatically set by file system.
@@ -1967,6 +2001,28 @@ NTAPI
 NtWaitForMultipleObjects(_In_ ULONG Count, _In_reads_(Count) HANDLE Handles[], _In_ WAIT_TYPE WaitType, _In_ BOOLEAN Alertable,
 						 _In_opt_ PLARGE_INTEGER Timeout);
 
+typedef enum _EVENT_TYPE
+{
+	NotificationEvent,
+	SynchronizationEvent
+} EVENT_TYPE;
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtCreateEvent(_Out_ PHANDLE EventHandle, _In_ ACCESS_MASK DesiredAccess, _In_opt_ POBJECT_ATTRIBUTES ObjectAttributes,
+			  _In_ EVENT_TYPE EventType, _In_ BOOLEAN InitialState);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtSetEvent(_In_ HANDLE EventHandle, _Out_opt_ PLONG PreviousState);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtResetEvent(_In_ HANDLE EventHandle, _Out_opt_ PLONG PreviousState);
+
 typedef enum _PROCESSINFOCLASS
 {
 	ProcessBasicInformation = 0,
@@ -2187,6 +2243,31 @@ NTSTATUS
 NTAPI
 NtWaitForAlertByThreadId(_In_ PVOID Address, _In_opt_ PLARGE_INTEGER Timeout);
 
+typedef enum _TIMER_TYPE
+{
+	NotificationTimer,
+	SynchronizationTimer
+} TIMER_TYPE;
+
+typedef VOID(NTAPI *PTIMER_APC_ROUTINE)(_In_ PVOID TimerContext, _In_ ULONG TimerLowValue, _In_ LONG TimerHighValue);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtCreateTimer(_Out_ PHANDLE TimerHandle, _In_ ACCESS_MASK DesiredAccess, _In_opt_ POBJECT_ATTRIBUTES ObjectAttributes,
+			  _In_ TIMER_TYPE TimerType);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtSetTimer(_In_ HANDLE TimerHandle, _In_ PLARGE_INTEGER DueTime, _In_opt_ PTIMER_APC_ROUTINE TimerApcRoutine, _In_opt_ PVOID TimerContext,
+		   _In_ BOOLEAN ResumeTimer, _In_opt_ LONG Period, _Out_opt_ PBOOLEAN PreviousState);
+
+NTSYSCALLAPI
+NTSTATUS
+NTAPI
+NtCancelTimer(_In_ HANDLE TimerHandle, _Out_opt_ PBOOLEAN CurrentState);
+
 typedef struct _T2_SET_PARAMETERS_V0
 {
 	ULONG Version;
@@ -2330,6 +2411,18 @@ VOID NTAPI RtlWakeConditionVariable(_Inout_ PRTL_CONDITION_VARIABLE ConditionVar
 NTSYSAPI
 VOID NTAPI RtlWakeAllConditionVariable(_Inout_ PRTL_CONDITION_VARIABLE ConditionVariable);
 
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(_In_reads_bytes_(AddressSize) volatile VOID *Address, _In_reads_bytes_(AddressSize) PVOID CompareAddress,
+				 _In_ SIZE_T AddressSize, _In_opt_ PLARGE_INTEGER Timeout);
+
+NTSYSAPI
+VOID NTAPI RtlWakeAddressSingle(_In_ PVOID Address);
+
+NTSYSAPI
+VOID NTAPI RtlWakeAddressAll(_In_ PVOID Address);
+
 #define RTL_BARRIER_FLAGS_SPIN_ONLY  0x00000001
 #define RTL_BARRIER_FLAGS_BLOCK_ONLY 0x00000002
 #define RTL_BARRIER_FLAGS_NO_DELETE  0x00000004
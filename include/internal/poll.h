@@ -0,0 +1,43 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_POLL_INTERNAL_H
+#define WLIBC_POLL_INTERNAL_H
+
+#include <internal/fcntl.h>
+#include <poll.h>
+
+// Readiness of pipes for writing can't be waited on, check them at this interval (in 100ns units, 10ms).
+#define POLL_RECHECK_INTERVAL 100000
+
+// Check the current state of the fd, without waiting. Returns 1 if there is an event to report.
+int common_poll_check(const fdinfo *pinfo, struct pollfd *pfd);
+
+/*
+ Pipes are opened for synchronous io, a read on them (even of zero bytes) holds the lock of the file object till it completes
+ and returns immediately on non blocking pipes. Instead an event is assigned to the pipe end, which the file system signals
+ whenever its state changes. There can only be one such event for each end, so a watch is shared by all the watchers of a pipe
+ end, whichever handle they come through. The event is waited on by the thread pool, 'notify' is called for each watcher from
+ there. It should not block, nor start or stop watchers.
+
+ Changes that happen before the watcher is started are not notified, check the state of the pipe after starting it.
+*/
+typedef struct _pipe_watcher
+{
+	struct _pipe_watcher *next;
+	struct _pipe_watch *watch;
+	void (*notify)(void *context);
+	void *context;
+} pipe_watcher;
+
+// Start watching the pipe, 'notify' and 'context' should be set. Returns 0 on success, -1 if the pipe can't be watched.
+int start_pipe_watcher(pipe_watcher *watcher, HANDLE pipe);
+
+// Stop watching, 'notify' is not called after this returns.
+void stop_pipe_watcher(pipe_watcher *watcher);
+
+#endif
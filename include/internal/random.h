@@ -0,0 +1,34 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_RANDOM_INTERNAL_H
+#define WLIBC_RANDOM_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ChaCha20 as in RFC 8439, 256 bit key, 32 bit block counter and 96 bit nonce.
+#define CHACHA20_KEY_WORDS   8
+#define CHACHA20_NONCE_WORDS 3
+#define CHACHA20_BLOCK_SIZE  64
+
+// Write the keystream of 'blocks' consecutive blocks, starting at 'counter'. Uses the widest implementation the processor supports.
+void chacha20_blocks(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+					 uint8_t *output, size_t blocks);
+
+// The implementations, of 1, 4 and 8 blocks at a time.
+void chacha20_block_generic(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+							uint8_t output[CHACHA20_BLOCK_SIZE]);
+void chacha20_blocks_sse2(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+						  uint8_t output[4 * CHACHA20_BLOCK_SIZE]);
+void chacha20_blocks_avx2(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+						  uint8_t output[8 * CHACHA20_BLOCK_SIZE]);
+
+// Whether the processor (and the OS) support AVX2.
+int chacha20_avx2_supported(void);
+
+#endif
@@ -19,17 +19,31 @@ typedef struct _siginfo
 	int mask;
 } siginfo;
 
-extern RTL_SRWLOCK _wlibc_signal_srw;
-extern siginfo _wlibc_signal_table[NSIG];
+// The sequence is odd while the entry is being written. Readers retry until they see the same even sequence on both sides.
+typedef struct _sigentry
+{
+	volatile LONG sequence;
+	siginfo info;
+} sigentry;
+
+extern RTL_SRWLOCK _wlibc_signal_srw; // Serializes the writers.
+extern sigentry _wlibc_signal_table[NSIG];
+
+// Blocked signals are offered to this hook (set by signalfd) before they are marked pending. Returns 1 if it took the signal.
+// Signals directed at the process are offered to it before their disposition is considered.
+typedef int (*signal_queue_hook)(int sig);
+extern signal_queue_hook _wlibc_signal_queue_hook;
 
 void signal_init(void);
 void signal_cleanup(void);
 
 void get_siginfo(int sig, siginfo *sinfo);
 void set_siginfo(int sig, const siginfo *sinfo);
+void reset_siginfo(int sig); // SA_RESETHAND
+
+// Raise a signal directed at the process (console control events, timer expirations) from an internal thread.
+void raise_process_signal(int sig);
 
-#define SHARED_LOCK_SIGNAL_TABLE()      RtlAcquireSRWLockShared(&_wlibc_signal_srw)
-#define SHARED_UNLOCK_SIGNAL_TABLE()    RtlReleaseSRWLockShared(&_wlibc_signal_srw)
 #define EXCLUSIVE_LOCK_SIGNAL_TABLE()   RtlAcquireSRWLockExclusive(&_wlibc_signal_srw)
 #define EXCLUSIVE_UNLOCK_SIGNAL_TABLE() RtlReleaseSRWLockExclusive(&_wlibc_signal_srw)
 
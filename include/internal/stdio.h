@@ -23,10 +23,13 @@ typedef struct _WLIBC_FILE
 	size_t end;
 	size_t pos; // ftell
 	int prev_op;
+	int flags; // _IOSTREAM_*
 	HANDLE phandle;
+	struct _WLIBC_MEMSTREAM *memstream; // Only for memory streams.
 	RTL_CRITICAL_SECTION critical;
+	unsigned int shard; // Index into _wlibc_stdio_shards.
 	struct _WLIBC_FILE *prev;
-	struct _WLIBC_FILE *next;
+	struct _WLIBC_FILE *next; // Also links the cached streams of a shard.
 } FILE;
 
 /* Buffer options */
@@ -62,20 +65,67 @@ typedef struct _WLIBC_FILE
 #define OP_READ  0x1
 #define OP_WRITE 0x2
 
+#define _IOSTREAM_APPEND 0x1 // The fd was opened with O_APPEND, every write goes to the end of the file.
+#define _IOSTREAM_RELPOS 0x2 // 'pos' is only relative to 'start' and 'end', the file position is found when asked for.
+
 #define FD_MEMSTREAM -1
 
-extern FILE *_wlibc_stdio_head;
-extern RTL_CRITICAL_SECTION _wlibc_stdio_critical;
+// Buffer sizes of streams, see get_buf_type.
+#define STDIO_DEFAULT_BUFFER_SIZE 4096
+#define STDIO_FILE_BUFFER_SIZE    65536  // Preferred size for files, rounded up to a multiple of the cluster size.
+#define STDIO_MAX_BUFFER_SIZE     262144
+
+// The open streams are kept in shards picked by the creating thread, so that threads opening and closing streams
+// do not contend on one lock. Each shard also caches a few closed streams (with their buffers) for reuse.
+#define STDIO_SHARDS     16
+#define STDIO_CACHE_SIZE 4
+
+typedef struct __declspec(align(64)) _WLIBC_STDIO_SHARD
+{
+	RTL_CRITICAL_SECTION critical;
+	FILE *head;
+	FILE *cache;
+	int cache_count;
+} stdio_shard;
+
+extern stdio_shard _wlibc_stdio_shards[STDIO_SHARDS];
+
+// Thread ids are multiples of 4.
+#define STDIO_CURRENT_SHARD() ((unsigned int)((NtCurrentThreadId() >> 2) % STDIO_SHARDS))
 
-#define LOCK_STDIO()   RtlEnterCriticalSection(&_wlibc_stdio_critical)
-#define UNLOCK_STDIO() RtlLeaveCriticalSection(&_wlibc_stdio_critical)
+#define LOCK_STDIO_SHARD(shard)   RtlEnterCriticalSection(&(_wlibc_stdio_shards[shard].critical))
+#define UNLOCK_STDIO_SHARD(shard) RtlLeaveCriticalSection(&(_wlibc_stdio_shards[shard].critical))
 
 void initialize_stdio(void);
 void cleanup_stdio(void);
+
+// create_stream is allocate_stream followed by insert_stream. Streams that need more setup are allocated first and
+// inserted once complete, fflush(NULL) can visit them after that.
 FILE *create_stream(int fd, int buf_mode, int buf_size);
+FILE *allocate_stream(int fd, int buf_mode, int buf_size);
+void insert_stream(FILE *stream);
+
+// Unlink the stream, its internal buffer is released here as well.
 void delete_stream(FILE *stream);
 
 int parse_mode(const char *mode);
 int get_buf_mode(int flags);
 
+// Memory streams (fd is FD_MEMSTREAM). The stream buffer is the memory itself and 'start' is always 0, so the
+// buffered fast paths work on them unchanged. These handle the rest, see memstream.c.
+int memstream_write_begin(FILE *stream);
+int memstream_spill(FILE *stream);
+size_t memstream_write(FILE *restrict stream, const void *restrict buffer, size_t size);
+size_t memstream_read(FILE *restrict stream, void *restrict buffer, size_t size);
+int memstream_peek(FILE *stream, const char **buffer, size_t *size);
+int memstream_seek(FILE *stream, ssize_t offset, int whence);
+int memstream_flush(FILE *stream);
+void memstream_close(FILE *stream);
+
+// Bring 'pos' of a stream with _IOSTREAM_RELPOS up to date with the file position. Returns 0 on success, -1 otherwise.
+int common_fposition(FILE *stream);
+
+// Pick the buffering of a new stream from the handle of the fd. Returns _IOFBF or _IOLBF (consoles), 'size' is set to the buffer size.
+int get_buf_type(int fd, size_t *size);
+
 #endif
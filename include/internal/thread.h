@@ -10,20 +10,42 @@
 
 #include <internal/nt.h>
 #include <signal.h>
+#include <thread.h>
 
 typedef void *(*thread_start_t)(void *);
 typedef void (*dtor_t)(void *);
 typedef void (*cleanup_t)(void *);
 
-extern DWORD _wlibc_threadinfo_index;
-extern ULONGLONG _wlibc_tls_bitmap;
-extern dtor_t _wlibc_tls_destructors[64];
+/*
+ Keys are an index and a generation. The first 64 indexes are stored inline in the threadinfo, the rest in pages of 64
+ allocated on first use. Deleting a key bumps the generation of its index, values are tagged with the key they were set
+ with so that a value set with a deleted key is never seen through a new key of the same index.
+*/
+#define TLS_INLINE_KEYS 64
+#define TLS_PAGE_KEYS   64
+#define TLS_MAX_KEYS    4096
+#define TLS_PAGES       ((TLS_MAX_KEYS - TLS_INLINE_KEYS) / TLS_PAGE_KEYS)
+
+#define TLS_KEY_INDEX_BITS 12
+#define TLS_KEY_INDEX(key) ((key) & (TLS_MAX_KEYS - 1))
+#define TLS_KEY_FREE       0x80000000 // Set in the key of an index that is not allocated.
 
 typedef struct _tls_entry
 {
 	void *value;
+	key_t key;
 } tls_entry;
 
+typedef struct _tls_key
+{
+	volatile key_t key;
+	dtor_t destructor;
+} tls_key;
+
+extern DWORD _wlibc_threadinfo_index;
+extern tls_key _wlibc_tls_keys[TLS_MAX_KEYS];
+extern RTL_SRWLOCK _wlibc_tls_lock;
+
 typedef struct _cleanup_entry
 {
 	cleanup_t routine;
@@ -44,9 +66,29 @@ typedef struct _threadinfo
 	DWORD cleanup_slots_allocated;
 	DWORD cleanup_slots_used;
 	cleanup_entry *cleanup_entries;
-	tls_entry slots[64];
+	tls_entry slots[TLS_INLINE_KEYS];
+	tls_entry *pages[TLS_PAGES];
 } threadinfo;
 
+// The threadinfo index is almost always one of the 64 TLS slots of the TEB, read it from there instead of calling TlsGetValue.
+WLIBC_INLINE threadinfo *get_threadinfo(void)
+{
+	if (_wlibc_threadinfo_index < TLS_MINIMUM_AVAILABLE)
+	{
+		return (threadinfo *)NtCurrentTeb()->TlsSlots[_wlibc_threadinfo_index];
+	}
+
+	return (threadinfo *)TlsGetValue(_wlibc_threadinfo_index);
+}
+
+#define MUTEX_MAGIC 0x1
+#define VALIDATE_MUTEX(mutex)                         \
+	if (mutex == NULL || mutex->magic != MUTEX_MAGIC) \
+	{                                                 \
+		errno = EINVAL;                               \
+		return -1;                                    \
+	}
+
 void threads_init(void);
 void threads_cleanup(void);
 void cleanup_tls(threadinfo *tinfo);
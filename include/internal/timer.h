@@ -10,17 +10,39 @@
 
 #include <internal/nt.h>
 #include <signal.h>
+#include <sys/time.h>
 #include <thread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct _timerinfo
 {
 	HANDLE handle;
 	LONGLONG period;
-	thread_t thread;
-	struct sigevent event;
 } timerinfo;
 
+// POSIX timers, serviced by the timer wheel in wheel.c. All times are in 100ns units.
+typedef struct _timer_entry
+{
+	struct _timer_entry *next;    // In a slot of the wheel.
+	struct _timer_entry *prev;
+	struct _timer_entry *expired; // In the list of expired timers of the dispatcher.
+	struct _timer_entry *queue;   // In the queue of the callback threads.
+	ULONGLONG due;             // Monotonic time of the next expiration.
+	ULONGLONG tick;            // Wheel tick of the next expiration.
+	LONGLONG period;
+	clockid_t clock;
+	volatile LONG references;
+	volatile LONG missed;  // Expirations missed since the last one delivered.
+	volatile LONG overrun; // Expirations missed before the last one delivered.
+	uint8_t armed;
+	uint8_t deleted;
+	uint8_t queued;
+	uint8_t level;
+	uint8_t slot;
+	struct sigevent event;
+} timer_entry;
+
 extern timerinfo real_itimer;
 extern timerinfo virtual_itimer;
 extern timerinfo prof_itimer;
@@ -30,6 +52,18 @@ void initialize_itimers(void);
 void cleanup_itimers(void);
 
 void *itimer_proc(void *arg);
-void *timer_proc(void *arg);
+
+// Start the dispatcher thread of the wheel, and the callback threads for SIGEV_THREAD if 'callbacks' is set.
+int start_timer_wheel(int callbacks);
+
+// Time of CLOCK_MONOTONIC in 100ns units, the performance counter scaled by its frequency.
+ULONGLONG get_monotonic_time(void);
+
+// Arm the timer to expire at 'due' (monotonic), disarm it if 'due' is 0. Returns the previous period.
+LONGLONG set_wheel_timer(timer_entry *timer, ULONGLONG due, LONGLONG period);
+LONGLONG get_wheel_timer_period(timer_entry *timer);
+
+// Disarm the timer and drop the reference of its owner, it is freed once no expiration refers to it.
+void delete_wheel_timer(timer_entry *timer);
 
 #endif
@@ -0,0 +1,37 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_UIO_INTERNAL_H
+#define WLIBC_UIO_INTERNAL_H
+
+#include <internal/fcntl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Vectors up to this size are coalesced on the stack.
+#define UIO_STACK_BUFFER_SIZE 4096
+
+// Size of the pooled bounce buffers, and the number of them kept around.
+#define UIO_POOL_BUFFER_SIZE 65536
+#define UIO_POOL_SLOTS       4
+
+// Buffers smaller than this are coalesced with their neighbours, larger ones are transferred directly.
+// Vectors that fit in a bounce buffer are always coalesced.
+#define UIO_COALESCE_SIZE 4096
+
+// Segment size of native scatter/gather io.
+#define UIO_PAGE_SIZE 4096
+
+// Validate the vector and return its total size. Returns -1 (errno is set) on failure.
+ssize_t common_iov_length(const struct iovec *iov, int iovcnt);
+
+// Transfer the vector at 'offset', or at the file position of the fd if 'offset' is -1.
+// The caller validates the vector and the fd.
+ssize_t common_readv(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset);
+ssize_t common_writev(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset);
+
+#endif
@@ -487,8 +487,18 @@ WLIBC_INLINE int renameat2(int olddirfd, const char *restrict oldname, int newdi
 }
 
 // memstream
-WLIBC_API FILE *wlibc_fmemopen(void *restrict, size_t, const char *restrict);
-WLIBC_API FILE *wlibc_open_memstream(char **, size_t *);
+WLIBC_API FILE *wlibc_fmemopen(void *restrict buffer, size_t size, const char *restrict mode);
+WLIBC_API FILE *wlibc_open_memstream(char **buffer, size_t *size);
+
+WLIBC_INLINE FILE *fmemopen(void *restrict buffer, size_t size, const char *restrict mode)
+{
+	return wlibc_fmemopen(buffer, size, mode);
+}
+
+WLIBC_INLINE FILE *open_memstream(char **buffer, size_t *size)
+{
+	return wlibc_open_memstream(buffer, size);
+}
 
 // Unlocked
 
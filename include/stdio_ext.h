@@ -106,6 +106,23 @@ WLIBC_INLINE void __freadptrinc(FILE *stream, size_t size)
 	wlibc_freadptrinc(stream, size);
 }
 
+// Buffer borrowing
+// fpeek fills the buffer of the stream till at least 'min_size' bytes are available (fewer only at end of file) and
+// returns the unread part of the buffer in 'buffer' and 'size'. The buffer is grown if 'min_size' is larger than it.
+// The window is valid till the next operation on the stream. fconsume marks 'size' bytes of the window as read.
+WLIBC_API int wlibc_fpeek(FILE *restrict stream, size_t min_size, const char **restrict buffer, size_t *restrict size);
+WLIBC_API int wlibc_fconsume(FILE *stream, size_t size);
+
+WLIBC_INLINE int fpeek(FILE *restrict stream, size_t min_size, const char **restrict buffer, size_t *restrict size)
+{
+	return wlibc_fpeek(stream, min_size, buffer, size);
+}
+
+WLIBC_INLINE int fconsume(FILE *stream, size_t size)
+{
+	return wlibc_fconsume(stream, size);
+}
+
 // Stream control
 WLIBC_API void wlibc_fseterr(FILE *stream);
 WLIBC_API int wlibc_fsetlocking(FILE *stream, int type /*unused*/);
@@ -14,6 +14,7 @@
 #include <corecrt_wstdlib.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <wchar.h>
 
 _CRT_BEGIN_C_HEADER
@@ -548,6 +549,25 @@ WLIBC_INLINE void *reallocarray(void *block, size_t count, size_t size)
 	return realloc(block, size * count);
 }
 
+WLIBC_API uint32_t wlibc_arc4random(void);
+WLIBC_API void wlibc_arc4random_buf(void *buffer, size_t size);
+WLIBC_API uint32_t wlibc_arc4random_uniform(uint32_t upper_bound);
+
+WLIBC_INLINE uint32_t arc4random(void)
+{
+	return wlibc_arc4random();
+}
+
+WLIBC_INLINE void arc4random_buf(void *buffer, size_t size)
+{
+	wlibc_arc4random_buf(buffer, size);
+}
+
+WLIBC_INLINE uint32_t arc4random_uniform(uint32_t upper_bound)
+{
+	return wlibc_arc4random_uniform(upper_bound);
+}
+
 _WLIBC_END_DECLS
 
 #endif
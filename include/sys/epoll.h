@@ -0,0 +1,97 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_SYS_EPOLL_H
+#define WLIBC_SYS_EPOLL_H
+
+#include <wlibc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Flags for epoll_create1
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+// Events (same values as poll)
+#define EPOLLIN        0x001 // There is data to read.
+#define EPOLLPRI       0x002 // There is urgent data to read.
+#define EPOLLOUT       0x004 // Writing now will not block.
+#define EPOLLERR       0x008 // Error condition.
+#define EPOLLHUP       0x010 // Hung up.
+#define EPOLLRDNORM    0x040 // Normal data may be read.
+#define EPOLLRDBAND    0x080 // Priority data may be read.
+#define EPOLLWRNORM    0x100 // Writing now will not block.
+#define EPOLLWRBAND    0x200 // Priority data may be written.
+#define EPOLLMSG       0x400 // Unused.
+#define EPOLLRDHUP     0x2000 // Peer closed its end (Unsupported).
+
+// Input flags
+#define EPOLLEXCLUSIVE (1u << 28) // Wake up only one of the epoll instances (Unsupported).
+#define EPOLLWAKEUP    (1u << 29) // Prevent system suspend (Unsupported).
+#define EPOLLONESHOT   (1u << 30) // Disable the fd after an event is reported, until it is modified.
+#define EPOLLET        (1u << 31) // Edge triggered notification (Reported as level triggered).
+
+// Operations for epoll_ctl
+#define EPOLL_CTL_ADD 1 // Add an fd to the interest list.
+#define EPOLL_CTL_DEL 2 // Remove an fd from the interest list.
+#define EPOLL_CTL_MOD 3 // Change the events of an fd in the interest list.
+
+typedef union epoll_data
+{
+	void *ptr;
+	int fd;
+	uint32_t u32;
+	uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event
+{
+	uint32_t events;   // Events.
+	epoll_data_t data; // User data.
+};
+
+WLIBC_API int wlibc_epoll_create1(int flags);
+WLIBC_API int wlibc_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+WLIBC_API int wlibc_epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const sigset_t *sigmask);
+
+WLIBC_INLINE int epoll_create1(int flags)
+{
+	return wlibc_epoll_create1(flags);
+}
+
+WLIBC_INLINE int epoll_create(int size)
+{
+	if (size <= 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return wlibc_epoll_create1(0);
+}
+
+WLIBC_INLINE int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+	return wlibc_epoll_ctl(epfd, op, fd, event);
+}
+
+WLIBC_INLINE int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+	return wlibc_epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
+
+WLIBC_INLINE int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const sigset_t *sigmask)
+{
+	return wlibc_epoll_pwait(epfd, events, maxevents, timeout, sigmask);
+}
+
+_WLIBC_END_DECLS
+
+#endif
@@ -0,0 +1,46 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_SYS_EVENTFD_H
+#define WLIBC_SYS_EVENTFD_H
+
+#include <wlibc.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+_WLIBC_BEGIN_DECLS
+
+typedef uint64_t eventfd_t;
+
+// Flags for eventfd
+#define EFD_SEMAPHORE 0x1 // Reads decrement the counter by one.
+#define EFD_CLOEXEC   O_CLOEXEC
+#define EFD_NONBLOCK  O_NONBLOCK
+
+WLIBC_API int wlibc_eventfd(unsigned int initval, int flags);
+
+WLIBC_INLINE int eventfd(unsigned int initval, int flags)
+{
+	return wlibc_eventfd(initval, flags);
+}
+
+WLIBC_API int wlibc_eventfd_read(int fd, eventfd_t *value);
+WLIBC_API int wlibc_eventfd_write(int fd, eventfd_t value);
+
+WLIBC_INLINE int eventfd_read(int fd, eventfd_t *value)
+{
+	return wlibc_eventfd_read(fd, value);
+}
+
+WLIBC_INLINE int eventfd_write(int fd, eventfd_t value)
+{
+	return wlibc_eventfd_write(fd, value);
+}
+
+_WLIBC_END_DECLS
+
+#endif
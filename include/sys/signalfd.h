@@ -0,0 +1,58 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_SYS_SIGNALFD_H
+#define WLIBC_SYS_SIGNALFD_H
+
+#include <wlibc.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Flags for signalfd
+#define SFD_CLOEXEC  O_CLOEXEC
+#define SFD_NONBLOCK O_NONBLOCK
+
+// Same layout as Linux. Only the signal number and the process id are filled.
+struct signalfd_siginfo
+{
+	uint32_t ssi_signo;
+	int32_t ssi_errno;
+	int32_t ssi_code;
+	uint32_t ssi_pid;
+	uint32_t ssi_uid;
+	int32_t ssi_fd;
+	uint32_t ssi_tid;
+	uint32_t ssi_band;
+	uint32_t ssi_overrun;
+	uint32_t ssi_trapno;
+	int32_t ssi_status;
+	int32_t ssi_int;
+	uint64_t ssi_ptr;
+	uint64_t ssi_utime;
+	uint64_t ssi_stime;
+	uint64_t ssi_addr;
+	uint16_t ssi_addr_lsb;
+	uint16_t __pad2;
+	int32_t ssi_syscall;
+	uint64_t ssi_call_addr;
+	uint32_t ssi_arch;
+	uint8_t __pad[28];
+};
+
+WLIBC_API int wlibc_signalfd(int fd, const sigset_t *mask, int flags);
+
+WLIBC_INLINE int signalfd(int fd, const sigset_t *mask, int flags)
+{
+	return wlibc_signalfd(fd, mask, flags);
+}
+
+_WLIBC_END_DECLS
+
+#endif
@@ -0,0 +1,46 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_SYS_TIMERFD_H
+#define WLIBC_SYS_TIMERFD_H
+
+#include <wlibc.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Flags for timerfd_create
+#define TFD_CLOEXEC  O_CLOEXEC
+#define TFD_NONBLOCK O_NONBLOCK
+
+// Flags for timerfd_settime
+#define TFD_TIMER_ABSTIME       TIMER_ABSTIME
+#define TFD_TIMER_CANCEL_ON_SET 0x2 // Unsupported
+
+WLIBC_API int wlibc_timerfd_create(clockid_t id, int flags);
+WLIBC_API int wlibc_timerfd_gettime(int fd, struct itimerspec *current_value);
+WLIBC_API int wlibc_timerfd_settime(int fd, int flags, const struct itimerspec *restrict new_value, struct itimerspec *restrict old_value);
+
+WLIBC_INLINE int timerfd_create(clockid_t id, int flags)
+{
+	return wlibc_timerfd_create(id, flags);
+}
+
+WLIBC_INLINE int timerfd_gettime(int fd, struct itimerspec *current_value)
+{
+	return wlibc_timerfd_gettime(fd, current_value);
+}
+
+WLIBC_INLINE int timerfd_settime(int fd, int flags, const struct itimerspec *restrict new_value, struct itimerspec *restrict old_value)
+{
+	return wlibc_timerfd_settime(fd, flags, new_value, old_value);
+}
+
+_WLIBC_END_DECLS
+
+#endif
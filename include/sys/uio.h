@@ -0,0 +1,77 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#ifndef WLIBC_SYS_UIO_H
+#define WLIBC_SYS_UIO_H
+
+#include <wlibc.h>
+#include <sys/types.h>
+
+_WLIBC_BEGIN_DECLS
+
+// Maximum number of buffers in a single call.
+#define UIO_MAXIOV 1024
+
+#ifndef IOV_MAX
+#	define IOV_MAX UIO_MAXIOV
+#endif
+
+// Flags for preadv2, pwritev2
+#define RWF_HIPRI  0x01 // Ignored.
+#define RWF_DSYNC  0x02 // Flush the data of the file after the write (fdatasync).
+#define RWF_SYNC   0x04 // Flush the data and metadata of the file after the write (fsync).
+#define RWF_NOWAIT 0x08 // Unsupported.
+#define RWF_APPEND 0x10 // Write to the end of the file.
+
+struct iovec
+{
+	void *iov_base; // Start of the buffer.
+	size_t iov_len; // Size of the buffer.
+};
+
+WLIBC_API ssize_t wlibc_readv(int fd, const struct iovec *iov, int iovcnt);
+WLIBC_API ssize_t wlibc_writev(int fd, const struct iovec *iov, int iovcnt);
+
+WLIBC_INLINE ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	return wlibc_readv(fd, iov, iovcnt);
+}
+
+WLIBC_INLINE ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	return wlibc_writev(fd, iov, iovcnt);
+}
+
+WLIBC_API ssize_t wlibc_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+WLIBC_API ssize_t wlibc_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+WLIBC_INLINE ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	return wlibc_preadv(fd, iov, iovcnt, offset);
+}
+
+WLIBC_INLINE ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	return wlibc_pwritev(fd, iov, iovcnt, offset);
+}
+
+WLIBC_API ssize_t wlibc_preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+WLIBC_API ssize_t wlibc_pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+
+WLIBC_INLINE ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+	return wlibc_preadv2(fd, iov, iovcnt, offset, flags);
+}
+
+WLIBC_INLINE ssize_t pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+	return wlibc_pwritev2(fd, iov, iovcnt, offset, flags);
+}
+
+_WLIBC_END_DECLS
+
+#endif
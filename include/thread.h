@@ -57,20 +57,19 @@ typedef union _wlibc_once_t {
 
 typedef struct _wlibc_mutex_t
 {
+	int state; // Lock word
 	unsigned int owner;
 	unsigned int count;
 	int type;
-	void *handle;
+	int spins; // Average spin count
+	int magic;
 } mutex_t;
 
 typedef struct _wlibc_cond_t
 {
-	unsigned long *ptr;
-	int waiting_threads;
-	int queue_size;
-	int queue_begin;
-	int queue_end;
-	int lock;
+	unsigned int sequence; // Incremented on every wake up
+	unsigned int waiters;  // Threads waiting to be woken up
+	int magic;
 } cond_t;
 
 typedef struct _wlibc_barrier_t
@@ -0,0 +1,621 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/dirent.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define FTS_ROOTPARENTLEVEL -1
+#define FTS_ROOTLEVEL       0
+
+#define FTS_OPTIONS (FTS_COMFOLLOW | FTS_LOGICAL | FTS_NOCHDIR | FTS_NOSTAT | FTS_PHYSICAL | FTS_SEEDOT | FTS_XDEV)
+
+// The entry, its stat and its path are a single allocation.
+typedef struct _fts_entry
+{
+	FTSENT entry;
+	struct stat st;
+	char path[1];
+} fts_entry;
+
+static FTSENT *create_entry(FTSENT *parent, const char *name, size_t namlen)
+{
+	fts_entry *fentry;
+	FTSENT *entry;
+	size_t length = 0;
+
+	if (parent != NULL && parent->fts_level != FTS_ROOTPARENTLEVEL)
+	{
+		length = parent->fts_pathlen;
+	}
+
+	fentry = (fts_entry *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(fts_entry) + length + namlen + 1);
+	if (fentry == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	entry = &fentry->entry;
+	memset(entry, 0, sizeof(FTSENT));
+
+	if (length > 0)
+	{
+		memcpy(fentry->path, parent->fts_path, length);
+
+		if (fentry->path[length - 1] != '/' && fentry->path[length - 1] != '\\')
+		{
+			fentry->path[length++] = '/';
+		}
+	}
+
+	memcpy(fentry->path + length, name, namlen);
+	fentry->path[length + namlen] = '\0';
+
+	entry->fts_parent = parent;
+	entry->fts_path = fentry->path;
+	entry->fts_accpath = fentry->path;
+	entry->fts_pathlen = length + namlen;
+	entry->fts_name = fentry->path + length;
+	entry->fts_namelen = namlen;
+	entry->fts_level = parent == NULL ? FTS_ROOTPARENTLEVEL : parent->fts_level + 1;
+	entry->fts_instr = FTS_NOINSTR;
+	entry->fts_statp = &fentry->st;
+
+	return entry;
+}
+
+static void free_entry(FTSENT *entry)
+{
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, (fts_entry *)entry);
+}
+
+static void free_entries(FTSENT *entry)
+{
+	while (entry != NULL)
+	{
+		FTSENT *next = entry->fts_link;
+		free_entry(entry);
+		entry = next;
+	}
+}
+
+static void set_stat_fields(FTSENT *entry)
+{
+	entry->fts_ino = entry->fts_statp->st_ino;
+	entry->fts_dev = entry->fts_statp->st_dev;
+	entry->fts_nlink = entry->fts_statp->st_nlink;
+}
+
+// Directories on the path to the entry with the same identity are cycles.
+static unsigned short check_cycle(FTSENT *entry)
+{
+	for (FTSENT *ancestor = entry->fts_parent; ancestor->fts_level >= FTS_ROOTLEVEL; ancestor = ancestor->fts_parent)
+	{
+		if (ancestor->fts_ino == entry->fts_ino && ancestor->fts_dev == entry->fts_dev)
+		{
+			entry->fts_cycle = ancestor;
+			return FTS_DC;
+		}
+	}
+
+	return FTS_D;
+}
+
+// Stat the entry by its path.
+static unsigned short stat_entry(FTSENT *entry, int follow)
+{
+	entry->fts_errno = 0;
+
+	if (wlibc_common_stat(AT_FDCWD, entry->fts_path, entry->fts_statp, follow ? 0 : AT_SYMLINK_NOFOLLOW) == -1)
+	{
+		entry->fts_errno = errno;
+
+		// Dangling symbolic link.
+		if (follow && wlibc_common_stat(AT_FDCWD, entry->fts_path, entry->fts_statp, AT_SYMLINK_NOFOLLOW) == 0)
+		{
+			entry->fts_errno = 0;
+			set_stat_fields(entry);
+			return FTS_SLNONE;
+		}
+
+		memset(entry->fts_statp, 0, sizeof(struct stat));
+		return FTS_NS;
+	}
+
+	set_stat_fields(entry);
+
+	if (S_ISDIR(entry->fts_statp->st_mode))
+	{
+		return entry->fts_level > FTS_ROOTLEVEL ? check_cycle(entry) : FTS_D;
+	}
+
+	if (S_ISLNK(entry->fts_statp->st_mode))
+	{
+		return FTS_SL;
+	}
+
+	if (S_ISREG(entry->fts_statp->st_mode))
+	{
+		return FTS_F;
+	}
+
+	return FTS_DEFAULT;
+}
+
+// Use the stat from the listing of the parent directory, only the targets of symbolic links that are followed are stat'ed.
+static unsigned short classify_record(FTS *ftsp, FTSENT *entry, dirent_record *record)
+{
+	memcpy(entry->fts_statp, &record->st, sizeof(struct stat));
+	set_stat_fields(entry);
+
+	switch (record->type)
+	{
+	case DT_DIR:
+		return check_cycle(entry);
+	case DT_LNK:
+		if (ftsp->fts_options & FTS_LOGICAL)
+		{
+			return stat_entry(entry, 1);
+		}
+		return FTS_SL;
+	case DT_REG:
+		return FTS_F;
+	default:
+		return FTS_DEFAULT;
+	}
+}
+
+// Link the entries in the order given by the comparison function.
+static FTSENT *sort_entries(FTS *ftsp, FTSENT *head, size_t count)
+{
+	FTSENT **entries;
+	FTSENT *entry = head;
+
+	if (ftsp->fts_compar == NULL || count < 2)
+	{
+		return head;
+	}
+
+	entries = (FTSENT **)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(FTSENT *) * count);
+	if (entries == NULL)
+	{
+		// Leave them unsorted.
+		return head;
+	}
+
+	for (size_t i = 0; i < count; ++i, entry = entry->fts_link)
+	{
+		entries[i] = entry;
+	}
+
+	qsort(entries, count, sizeof(FTSENT *), (int (*)(const void *, const void *))ftsp->fts_compar);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		entries[i]->fts_link = (i + 1 < count) ? entries[i + 1] : NULL;
+	}
+
+	head = entries[0];
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, entries);
+
+	return head;
+}
+
+static FTSENT *create_dot_entry(FTSENT *parent, const char *name, size_t namlen)
+{
+	FTSENT *entry = create_entry(parent, name, namlen);
+
+	if (entry == NULL)
+	{
+		return NULL;
+	}
+
+	if (namlen == 1)
+	{
+		memcpy(entry->fts_statp, parent->fts_statp, sizeof(struct stat));
+	}
+	else if (parent->fts_level > FTS_ROOTLEVEL)
+	{
+		memcpy(entry->fts_statp, parent->fts_parent->fts_statp, sizeof(struct stat));
+	}
+	else if (wlibc_common_stat(AT_FDCWD, entry->fts_path, entry->fts_statp, 0) == -1)
+	{
+		memset(entry->fts_statp, 0, sizeof(struct stat));
+	}
+
+	set_stat_fields(entry);
+	entry->fts_info = FTS_DOT;
+
+	return entry;
+}
+
+// Read the children of a directory. Returns NULL if the directory is empty or can't be read, errno is set for the latter.
+static FTSENT *build_children(FTS *ftsp, FTSENT *parent, int for_read)
+{
+	dirent_records records;
+	dirent_record *record;
+	FTSENT *head = NULL, *tail = NULL;
+	size_t count = 0;
+
+	if (read_dirent_records(parent->fts_path, parent->fts_dev, &records) == -1)
+	{
+		if (for_read)
+		{
+			parent->fts_info = FTS_DNR;
+			parent->fts_errno = errno;
+		}
+
+		return NULL;
+	}
+
+	if (ftsp->fts_options & FTS_SEEDOT)
+	{
+		head = create_dot_entry(parent, ".", 1);
+		if (head == NULL)
+		{
+			goto fail;
+		}
+
+		head->fts_link = create_dot_entry(parent, "..", 2);
+		if (head->fts_link == NULL)
+		{
+			goto fail;
+		}
+
+		tail = head->fts_link;
+		count = 2;
+	}
+
+	record = FIRST_DIRENT_RECORD(&records);
+
+	for (size_t i = 0; i < records.count; ++i, record = NEXT_DIRENT_RECORD(record))
+	{
+		FTSENT *entry = create_entry(parent, record->name, record->namlen);
+
+		if (entry == NULL)
+		{
+			goto fail;
+		}
+
+		entry->fts_info = classify_record(ftsp, entry, record);
+
+		if (tail == NULL)
+		{
+			head = entry;
+		}
+		else
+		{
+			tail->fts_link = entry;
+		}
+
+		tail = entry;
+		++count;
+	}
+
+	free_dirent_records(&records);
+
+	if (head == NULL)
+	{
+		errno = 0;
+
+		if (for_read)
+		{
+			parent->fts_info = FTS_DP;
+		}
+
+		return NULL;
+	}
+
+	return sort_entries(ftsp, head, count);
+
+fail:
+	free_dirent_records(&records);
+	free_entries(head);
+	ftsp->fts_stop = 1;
+
+	return NULL;
+}
+
+FTS *wlibc_fts_open(char *const *paths, int options, int (*compar)(const FTSENT **, const FTSENT **))
+{
+	FTS *ftsp;
+	FTSENT *rootparent, *head = NULL, *tail = NULL, *init;
+	size_t count = 0;
+
+	if (paths == NULL || (options & ~FTS_OPTIONS) != 0)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	ftsp = (FTS *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(FTS));
+	if (ftsp == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	ftsp->fts_cur = NULL;
+	ftsp->fts_child = NULL;
+	ftsp->fts_compar = compar;
+	ftsp->fts_dev = 0;
+	ftsp->fts_options = options | FTS_NOCHDIR;
+	ftsp->fts_stop = 0;
+
+	rootparent = create_entry(NULL, "", 0);
+	if (rootparent == NULL)
+	{
+		goto fail;
+	}
+
+	rootparent->fts_info = FTS_INIT;
+
+	for (char *const *path = paths; *path != NULL; ++path)
+	{
+		size_t length = strlen(*path);
+		FTSENT *root;
+
+		if (length == 0)
+		{
+			errno = ENOENT;
+			goto fail;
+		}
+
+		root = create_entry(rootparent, *path, length);
+		if (root == NULL)
+		{
+			goto fail;
+		}
+
+		root->fts_info = stat_entry(root, options & (FTS_COMFOLLOW | FTS_LOGICAL));
+
+		if (tail == NULL)
+		{
+			head = root;
+		}
+		else
+		{
+			tail->fts_link = root;
+		}
+
+		tail = root;
+		++count;
+	}
+
+	head = sort_entries(ftsp, head, count);
+
+	// fts_read starts from this entry, the first root is after it.
+	init = create_entry(rootparent, "", 0);
+	if (init == NULL)
+	{
+		goto fail;
+	}
+
+	init->fts_info = FTS_INIT;
+	init->fts_link = head;
+	ftsp->fts_cur = init;
+
+	return ftsp;
+
+fail:
+	free_entries(head);
+
+	if (rootparent != NULL)
+	{
+		free_entry(rootparent);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, ftsp);
+
+	return NULL;
+}
+
+FTSENT *wlibc_fts_read(FTS *ftsp)
+{
+	FTSENT *entry, *next;
+	unsigned short instr;
+
+	if (ftsp == NULL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (ftsp->fts_cur == NULL || ftsp->fts_stop)
+	{
+		return NULL;
+	}
+
+	entry = ftsp->fts_cur;
+
+	instr = entry->fts_instr;
+	entry->fts_instr = FTS_NOINSTR;
+
+	if (instr == FTS_AGAIN)
+	{
+		entry->fts_info = stat_entry(entry, (ftsp->fts_options & FTS_LOGICAL) ||
+												(entry->fts_level == FTS_ROOTLEVEL && (ftsp->fts_options & FTS_COMFOLLOW)));
+		return entry;
+	}
+
+	if (instr == FTS_FOLLOW && (entry->fts_info == FTS_SL || entry->fts_info == FTS_SLNONE))
+	{
+		entry->fts_info = stat_entry(entry, 1);
+		return entry;
+	}
+
+	if (entry->fts_info == FTS_D)
+	{
+		if (instr == FTS_SKIP || ((ftsp->fts_options & FTS_XDEV) && entry->fts_dev != ftsp->fts_dev))
+		{
+			free_entries(ftsp->fts_child);
+			ftsp->fts_child = NULL;
+			entry->fts_info = FTS_DP;
+			return entry;
+		}
+
+		// The children may have been read by fts_children already.
+		if (ftsp->fts_child == NULL)
+		{
+			ftsp->fts_child = build_children(ftsp, entry, 1);
+			if (ftsp->fts_child == NULL)
+			{
+				// Empty (FTS_DP) or unreadable (FTS_DNR).
+				return ftsp->fts_stop ? NULL : entry;
+			}
+		}
+
+		entry = ftsp->fts_child;
+		ftsp->fts_child = NULL;
+		ftsp->fts_cur = entry;
+
+		return entry;
+	}
+
+	// Go to the next sibling, or the parent once the siblings are done.
+	while (1)
+	{
+		next = entry->fts_link;
+
+		if (next == NULL)
+		{
+			break;
+		}
+
+		free_entry(entry);
+		entry = next;
+		ftsp->fts_cur = entry;
+
+		if (entry->fts_level == FTS_ROOTLEVEL)
+		{
+			ftsp->fts_dev = entry->fts_dev;
+		}
+
+		if (entry->fts_instr == FTS_SKIP)
+		{
+			continue;
+		}
+
+		if (entry->fts_instr == FTS_FOLLOW)
+		{
+			entry->fts_instr = FTS_NOINSTR;
+			entry->fts_info = stat_entry(entry, 1);
+		}
+
+		return entry;
+	}
+
+	next = entry->fts_parent;
+	free_entry(entry);
+
+	if (next->fts_level == FTS_ROOTPARENTLEVEL)
+	{
+		// Done.
+		free_entry(next);
+		ftsp->fts_cur = NULL;
+		errno = 0;
+		return NULL;
+	}
+
+	next->fts_info = next->fts_errno ? FTS_ERR : FTS_DP;
+	ftsp->fts_cur = next;
+
+	return next;
+}
+
+FTSENT *wlibc_fts_children(FTS *ftsp, int options)
+{
+	FTSENT *entry;
+
+	if (ftsp == NULL || (options != 0 && options != FTS_NAMEONLY))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	entry = ftsp->fts_cur;
+	errno = 0;
+
+	if (entry == NULL || ftsp->fts_stop)
+	{
+		return NULL;
+	}
+
+	// Before the first fts_read, the children are the roots.
+	if (entry->fts_info == FTS_INIT)
+	{
+		return entry->fts_link;
+	}
+
+	if (entry->fts_info != FTS_D)
+	{
+		return NULL;
+	}
+
+	free_entries(ftsp->fts_child);
+	ftsp->fts_child = build_children(ftsp, entry, 0);
+
+	return ftsp->fts_child;
+}
+
+int wlibc_fts_set(FTS *ftsp, FTSENT *entry, int instr)
+{
+	if (ftsp == NULL || entry == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (instr != 0 && instr != FTS_AGAIN && instr != FTS_FOLLOW && instr != FTS_NOINSTR && instr != FTS_SKIP)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	entry->fts_instr = (unsigned short)(instr == 0 ? FTS_NOINSTR : instr);
+
+	return 0;
+}
+
+int wlibc_fts_close(FTS *ftsp)
+{
+	FTSENT *entry;
+
+	if (ftsp == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	free_entries(ftsp->fts_child);
+
+	// Free the remaining siblings of each level going up to the root parent.
+	entry = ftsp->fts_cur;
+	if (entry != NULL)
+	{
+		while (entry->fts_level >= FTS_ROOTLEVEL)
+		{
+			FTSENT *next = entry->fts_link != NULL ? entry->fts_link : entry->fts_parent;
+			free_entry(entry);
+			entry = next;
+		}
+
+		free_entry(entry);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, ftsp);
+
+	return 0;
+}
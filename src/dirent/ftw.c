@@ -0,0 +1,925 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/dirent.h>
+#include <internal/fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int do_open(int dirfd, const char *name, int oflags, mode_t perm);
+
+// Upper limit of the threads of a parallel walk, walks are bound by the file system beyond this.
+#define FTW_MAX_THREADS 16
+
+// Initial size of the path buffers.
+#define FTW_PATH_SIZE 512
+
+// What the walk does after visiting an entry.
+#define WALK_CONTINUE      0
+#define WALK_STOP          1
+#define WALK_SKIP_SUBTREE  2
+#define WALK_SKIP_SIBLINGS 3
+
+typedef int (*ftw_callback)(const char *path, const struct stat *statbuf, int typeflag);
+typedef int (*nftw_callback)(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf);
+
+typedef struct _ftw_state
+{
+	ftw_callback callback;   // ftw
+	nftw_callback ncallback; // nftw
+	int flags;
+	dev_t dev; // Of the starting path, for FTW_MOUNT.
+	int cwd;   // For FTW_CHDIR, the paths are relative to the starting working directory.
+	volatile LONG stop;
+	volatile LONG result;
+	int error;
+} ftw_state;
+
+typedef struct _ftw_path
+{
+	char *buffer;
+	size_t capacity;
+} ftw_path;
+
+// The directories being walked, for detecting cycles through symbolic links.
+typedef struct _ftw_ancestor
+{
+	dev_t dev;
+	ino_t ino;
+	const struct _ftw_ancestor *parent;
+} ftw_ancestor;
+
+// Stop the walk, the first result is returned by nftw.
+static void stop_walk(ftw_state *state, int result)
+{
+	if (InterlockedCompareExchange(&state->result, result, 0) == 0 && result == -1)
+	{
+		state->error = errno;
+	}
+
+	state->stop = 1;
+}
+
+static int invoke(ftw_state *state, const char *path, const struct stat *statbuf, int typeflag, size_t base, int level)
+{
+	struct FTW ftwbuf;
+	int result;
+
+	if (state->ncallback != NULL)
+	{
+		ftwbuf.base = (int)base;
+		ftwbuf.level = level;
+		result = state->ncallback(path, statbuf, typeflag, &ftwbuf);
+	}
+	else
+	{
+		result = state->callback(path, statbuf, typeflag);
+	}
+
+	if (state->flags & FTW_ACTIONRETVAL)
+	{
+		switch (result)
+		{
+		case FTW_STOP:
+			stop_walk(state, FTW_STOP);
+			return WALK_STOP;
+		case FTW_SKIP_SUBTREE:
+			return WALK_SKIP_SUBTREE;
+		case FTW_SKIP_SIBLINGS:
+			return WALK_SKIP_SIBLINGS;
+		default:
+			return WALK_CONTINUE;
+		}
+	}
+
+	if (result != 0)
+	{
+		stop_walk(state, result);
+		return WALK_STOP;
+	}
+
+	return WALK_CONTINUE;
+}
+
+// Put 'name' after the first 'length' bytes of the path. Returns the new length of the path, -1 on failure.
+static ssize_t append_path(ftw_path *path, size_t length, const char *name, size_t namlen)
+{
+	size_t required = length + namlen + 2;
+
+	if (required > path->capacity)
+	{
+		size_t capacity = __max(path->capacity * 2, required);
+		char *buffer;
+
+		if (path->buffer == NULL)
+		{
+			buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, capacity);
+		}
+		else
+		{
+			buffer = (char *)RtlReAllocateHeap(NtCurrentProcessHeap(), 0, path->buffer, capacity);
+		}
+
+		if (buffer == NULL)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+
+		path->buffer = buffer;
+		path->capacity = capacity;
+	}
+
+	if (length > 0 && path->buffer[length - 1] != '/' && path->buffer[length - 1] != '\\')
+	{
+		path->buffer[length++] = '/';
+	}
+
+	memcpy(path->buffer + length, name, namlen);
+	length += namlen;
+	path->buffer[length] = '\0';
+
+	return length;
+}
+
+static void free_path(ftw_path *path)
+{
+	if (path->buffer != NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, path->buffer);
+	}
+}
+
+// Work out the typeflag of an entry of a directory, following symbolic links unless FTW_PHYS. For links that are
+// followed 'statbuf' is replaced by the stat of the target.
+static int classify_entry(ftw_state *state, const char *path, int type, struct stat *statbuf)
+{
+	struct stat target;
+
+	switch (type)
+	{
+	case DT_DIR:
+		return FTW_D;
+	case DT_LNK:
+		if (state->flags & FTW_PHYS)
+		{
+			return FTW_SL;
+		}
+
+		if (wlibc_common_stat(AT_FDCWD, path, &target, 0) == -1)
+		{
+			return FTW_SLN;
+		}
+
+		memcpy(statbuf, &target, sizeof(struct stat));
+		return S_ISDIR(target.st_mode) ? FTW_D : FTW_F;
+	default:
+		return FTW_F;
+	}
+}
+
+// Whether a directory should be walked into.
+static int should_walk(ftw_state *state, const struct stat *statbuf, const ftw_ancestor *ancestors)
+{
+	if ((state->flags & FTW_MOUNT) && statbuf->st_dev != state->dev)
+	{
+		return 0;
+	}
+
+	// A symbolic link to a directory being walked.
+	for (const ftw_ancestor *ancestor = ancestors; ancestor != NULL; ancestor = ancestor->parent)
+	{
+		if (ancestor->ino == statbuf->st_ino && ancestor->dev == statbuf->st_dev)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// With FTW_CHDIR the working directory is the parent of the entry (except for the starting path), use its name then.
+static const char *access_path(ftw_state *state, ftw_path *path, size_t base, int level)
+{
+	if ((state->flags & FTW_CHDIR) && level > 0)
+	{
+		return path->buffer + base;
+	}
+
+	return path->buffer;
+}
+
+// Go back to the directory containing the entry whose name starts at 'base', or where we started for the starting path.
+static int change_to_parent(ftw_state *state, ftw_path *path, size_t base, int level)
+{
+	char ch;
+	int result = 0;
+
+	if (wlibc_fchdir(state->cwd) == -1)
+	{
+		return -1;
+	}
+
+	if (level > 0)
+	{
+		ch = path->buffer[base];
+		path->buffer[base] = '\0';
+		result = wlibc_chdir(path->buffer);
+		path->buffer[base] = ch;
+	}
+
+	return result;
+}
+
+static int walk_directory(ftw_state *state, ftw_path *path, size_t length, size_t base, int level, const struct stat *statbuf,
+						  const ftw_ancestor *parent)
+{
+	dirent_records records;
+	dirent_record *record;
+	ftw_ancestor self;
+	int action = WALK_CONTINUE;
+
+	if (read_dirent_records(access_path(state, path, base, level), statbuf->st_dev, &records) == -1)
+	{
+		return invoke(state, path->buffer, statbuf, FTW_DNR, base, level) == WALK_STOP ? WALK_STOP : WALK_CONTINUE;
+	}
+
+	if ((state->flags & FTW_DEPTH) == 0)
+	{
+		action = invoke(state, path->buffer, statbuf, FTW_D, base, level);
+		if (action != WALK_CONTINUE)
+		{
+			free_dirent_records(&records);
+			return action == WALK_SKIP_SUBTREE ? WALK_CONTINUE : action;
+		}
+	}
+
+	if (state->flags & FTW_CHDIR)
+	{
+		if (wlibc_chdir(access_path(state, path, base, level)) == -1)
+		{
+			free_dirent_records(&records);
+			stop_walk(state, -1);
+			return WALK_STOP;
+		}
+	}
+
+	self.dev = statbuf->st_dev;
+	self.ino = statbuf->st_ino;
+	self.parent = parent;
+
+	record = FIRST_DIRENT_RECORD(&records);
+
+	for (size_t i = 0; i < records.count; ++i, record = NEXT_DIRENT_RECORD(record))
+	{
+		struct stat entry_stat;
+		ssize_t entry_length;
+		size_t entry_base;
+		int typeflag;
+
+		entry_length = append_path(path, length, record->name, record->namlen);
+		if (entry_length == -1)
+		{
+			stop_walk(state, -1);
+			action = WALK_STOP;
+			break;
+		}
+
+		entry_base = entry_length - record->namlen;
+		memcpy(&entry_stat, &record->st, sizeof(struct stat));
+		typeflag = classify_entry(state, access_path(state, path, entry_base, level + 1), record->type, &entry_stat);
+
+		if (typeflag == FTW_D)
+		{
+			if (!should_walk(state, &entry_stat, &self))
+			{
+				continue;
+			}
+
+			action = walk_directory(state, path, entry_length, entry_base, level + 1, &entry_stat, &self);
+		}
+		else
+		{
+			action = invoke(state, path->buffer, &entry_stat, typeflag, entry_base, level + 1);
+		}
+
+		if (action == WALK_STOP || action == WALK_SKIP_SIBLINGS)
+		{
+			break;
+		}
+	}
+
+	free_dirent_records(&records);
+	path->buffer[length] = '\0';
+
+	if (state->flags & FTW_CHDIR)
+	{
+		if (change_to_parent(state, path, base, level) == -1 && action != WALK_STOP)
+		{
+			stop_walk(state, -1);
+			return WALK_STOP;
+		}
+	}
+
+	if (action == WALK_STOP)
+	{
+		return WALK_STOP;
+	}
+
+	if (state->flags & FTW_DEPTH)
+	{
+		action = invoke(state, path->buffer, statbuf, FTW_DP, base, level);
+		return action == WALK_SKIP_SUBTREE ? WALK_CONTINUE : action;
+	}
+
+	return WALK_CONTINUE;
+}
+
+/*
+ Parallel walks.
+ Each directory to be walked is a node. A worker reads the directory of a node, visits the entries that are not
+ directories and queues the subdirectories as new nodes. Workers take the newest node of their own queue and steal the
+ oldest node (likely the largest subtree) of another queue when theirs is empty. A node lives till all its subdirectories
+ are done, then it is visited again for FTW_DEPTH.
+*/
+
+typedef struct _ftw_node
+{
+	struct _ftw_node *parent;
+	volatile LONG pending; // 1 for the node itself and 1 for each subdirectory not yet done.
+	int level;
+	int readable;
+	size_t base;
+	size_t length;
+	struct stat st;
+	char path[1];
+} ftw_node;
+
+typedef struct _ftw_worker
+{
+	RTL_SRWLOCK lock;
+	ftw_node **nodes;
+	size_t head; // Stolen from here.
+	size_t tail; // Pushed and popped here.
+	size_t capacity;
+	ftw_path path;
+	struct _ftw_pool *pool;
+	int index;
+} ftw_worker;
+
+typedef struct _ftw_pool
+{
+	ftw_state *state;
+	volatile LONG outstanding; // Nodes queued or being walked.
+	volatile LONG generation;  // Changes whenever a node is queued or the walk is over, idle workers wait on it.
+	volatile LONG idle;        // Workers waiting on the generation.
+	int count;
+	ftw_worker workers[FTW_MAX_THREADS];
+} ftw_pool;
+
+static ftw_node *create_node(ftw_node *parent, const char *path, size_t length, size_t base, int level, const struct stat *statbuf)
+{
+	ftw_node *node = (ftw_node *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(ftw_node) + length);
+
+	if (node == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	node->parent = parent;
+	node->pending = 1;
+	node->level = level;
+	node->readable = 1;
+	node->base = base;
+	node->length = length;
+	memcpy(&node->st, statbuf, sizeof(struct stat));
+	memcpy(node->path, path, length + 1);
+
+	return node;
+}
+
+// Let the idle workers know there is something new, a node to steal or the end of the walk.
+static void wake_workers(ftw_pool *pool, int always)
+{
+	// The interlocked increment orders the change before the read of the idle count, see ftw_worker_routine.
+	InterlockedIncrement(&pool->generation);
+
+	if (always || ReadAcquire(&pool->idle) > 0)
+	{
+		RtlWakeAddressAll((PVOID)&pool->generation);
+	}
+}
+
+static int push_node(ftw_worker *worker, ftw_node *node)
+{
+	int result = 0;
+
+	RtlAcquireSRWLockExclusive(&worker->lock);
+
+	if (worker->tail == worker->capacity)
+	{
+		if (worker->head > 0)
+		{
+			// Reuse the space of the stolen nodes.
+			memmove(worker->nodes, worker->nodes + worker->head, (worker->tail - worker->head) * sizeof(ftw_node *));
+			worker->tail -= worker->head;
+			worker->head = 0;
+		}
+		else
+		{
+			size_t capacity = __max(worker->capacity * 2, 64);
+			ftw_node **nodes;
+
+			if (worker->nodes == NULL)
+			{
+				nodes = (ftw_node **)RtlAllocateHeap(NtCurrentProcessHeap(), 0, capacity * sizeof(ftw_node *));
+			}
+			else
+			{
+				nodes = (ftw_node **)RtlReAllocateHeap(NtCurrentProcessHeap(), 0, worker->nodes, capacity * sizeof(ftw_node *));
+			}
+
+			if (nodes == NULL)
+			{
+				errno = ENOMEM;
+				result = -1;
+			}
+			else
+			{
+				worker->nodes = nodes;
+				worker->capacity = capacity;
+			}
+		}
+	}
+
+	if (result == 0)
+	{
+		worker->nodes[worker->tail++] = node;
+	}
+
+	RtlReleaseSRWLockExclusive(&worker->lock);
+
+	if (result == 0)
+	{
+		wake_workers(worker->pool, 0);
+	}
+
+	return result;
+}
+
+static ftw_node *pop_node(ftw_worker *worker)
+{
+	ftw_node *node = NULL;
+
+	RtlAcquireSRWLockExclusive(&worker->lock);
+
+	if (worker->tail > worker->head)
+	{
+		node = worker->nodes[--worker->tail];
+	}
+
+	if (worker->tail == worker->head)
+	{
+		worker->head = 0;
+		worker->tail = 0;
+	}
+
+	RtlReleaseSRWLockExclusive(&worker->lock);
+
+	return node;
+}
+
+static ftw_node *steal_node(ftw_worker *worker)
+{
+	ftw_node *node = NULL;
+
+	// Don't wait on a busy queue, try another one.
+	if (!RtlTryAcquireSRWLockExclusive(&worker->lock))
+	{
+		return NULL;
+	}
+
+	if (worker->tail > worker->head)
+	{
+		node = worker->nodes[worker->head++];
+	}
+
+	RtlReleaseSRWLockExclusive(&worker->lock);
+
+	return node;
+}
+
+// Drop a reference to the node. The last reference visits the directory for FTW_DEPTH and goes up to the parent.
+static void release_node(ftw_state *state, ftw_node *node)
+{
+	while (node != NULL)
+	{
+		ftw_node *parent = node->parent;
+
+		if (InterlockedDecrement(&node->pending) != 0)
+		{
+			return;
+		}
+
+		if ((state->flags & FTW_DEPTH) && node->readable && !state->stop)
+		{
+			invoke(state, node->path, &node->st, FTW_DP, node->base, node->level);
+		}
+
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, node);
+		node = parent;
+	}
+}
+
+static int node_should_walk(ftw_state *state, const ftw_node *node, const struct stat *statbuf)
+{
+	if ((state->flags & FTW_MOUNT) && statbuf->st_dev != state->dev)
+	{
+		return 0;
+	}
+
+	for (; node != NULL; node = node->parent)
+	{
+		if (node->st.st_ino == statbuf->st_ino && node->st.st_dev == statbuf->st_dev)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void walk_node(ftw_worker *worker, ftw_node *node)
+{
+	ftw_state *state = worker->pool->state;
+	dirent_records records;
+	dirent_record *record;
+	int action;
+
+	if (state->stop)
+	{
+		return;
+	}
+
+	if (read_dirent_records(node->path, node->st.st_dev, &records) == -1)
+	{
+		node->readable = 0;
+		invoke(state, node->path, &node->st, FTW_DNR, node->base, node->level);
+		return;
+	}
+
+	if ((state->flags & FTW_DEPTH) == 0)
+	{
+		action = invoke(state, node->path, &node->st, FTW_D, node->base, node->level);
+		if (action == WALK_STOP || action == WALK_SKIP_SUBTREE)
+		{
+			free_dirent_records(&records);
+			return;
+		}
+	}
+
+	record = FIRST_DIRENT_RECORD(&records);
+
+	for (size_t i = 0; i < records.count && !state->stop; ++i, record = NEXT_DIRENT_RECORD(record))
+	{
+		struct stat entry_stat;
+		ssize_t entry_length;
+		size_t entry_base;
+		int typeflag;
+
+		entry_length = append_path(&worker->path, 0, node->path, node->length);
+		if (entry_length != -1)
+		{
+			entry_length = append_path(&worker->path, entry_length, record->name, record->namlen);
+		}
+
+		if (entry_length == -1)
+		{
+			stop_walk(state, -1);
+			break;
+		}
+
+		entry_base = entry_length - record->namlen;
+		memcpy(&entry_stat, &record->st, sizeof(struct stat));
+		typeflag = classify_entry(state, worker->path.buffer, record->type, &entry_stat);
+
+		if (typeflag == FTW_D)
+		{
+			ftw_node *child;
+
+			if (!node_should_walk(state, node, &entry_stat))
+			{
+				continue;
+			}
+
+			child = create_node(node, worker->path.buffer, entry_length, entry_base, node->level + 1, &entry_stat);
+			if (child == NULL)
+			{
+				stop_walk(state, -1);
+				break;
+			}
+
+			InterlockedIncrement(&node->pending);
+			InterlockedIncrement(&worker->pool->outstanding);
+
+			if (push_node(worker, child) == -1)
+			{
+				InterlockedDecrement(&worker->pool->outstanding);
+				InterlockedDecrement(&node->pending);
+				RtlFreeHeap(NtCurrentProcessHeap(), 0, child);
+				stop_walk(state, -1);
+				break;
+			}
+		}
+		else
+		{
+			invoke(state, worker->path.buffer, &entry_stat, typeflag, entry_base, node->level + 1);
+		}
+	}
+
+	free_dirent_records(&records);
+}
+
+static DWORD WINAPI ftw_worker_routine(LPVOID arg)
+{
+	ftw_worker *worker = (ftw_worker *)arg;
+	ftw_pool *pool = worker->pool;
+	ftw_node *node;
+	LONG generation;
+
+	while (1)
+	{
+		// Read the generation before looking at the queues, anything queued after this changes it.
+		generation = ReadAcquire(&pool->generation);
+		node = pop_node(worker);
+
+		for (int i = 1; node == NULL && i < pool->count; ++i)
+		{
+			node = steal_node(&pool->workers[(worker->index + i) % pool->count]);
+		}
+
+		if (node == NULL)
+		{
+			// Nothing queued, the walk is over once no node is being walked either.
+			if (ReadAcquire(&pool->outstanding) == 0)
+			{
+				break;
+			}
+
+			// Sleep till a node is queued or the walk is over. The wait returns at once if the generation has changed
+			// since it was read. A busy queue skipped by steal_node only delays its nodes, its owner walks them.
+			InterlockedIncrement(&pool->idle);
+			RtlWaitOnAddress(&pool->generation, &generation, sizeof(LONG), NULL);
+			InterlockedDecrement(&pool->idle);
+			continue;
+		}
+
+		// Once stopped, the queued nodes are only released.
+		walk_node(worker, node);
+		release_node(pool->state, node);
+
+		if (InterlockedDecrement(&pool->outstanding) == 0)
+		{
+			wake_workers(pool, 1);
+		}
+	}
+
+	return 0;
+}
+
+static int get_worker_count(void)
+{
+	SYSTEM_BASIC_INFORMATION basic_info;
+	NTSTATUS status;
+
+	status = NtQuerySystemInformation(SystemBasicInformation, &basic_info, sizeof(SYSTEM_BASIC_INFORMATION), NULL);
+	if (status != STATUS_SUCCESS)
+	{
+		return 1;
+	}
+
+	return __max(1, __min(basic_info.NumberOfProcessors, FTW_MAX_THREADS));
+}
+
+static int parallel_walk(ftw_state *state, const char *path, size_t length, size_t base, const struct stat *statbuf)
+{
+	ftw_pool *pool;
+	ftw_node *root;
+	HANDLE threads[FTW_MAX_THREADS];
+	int started = 0;
+
+	pool = (ftw_pool *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ftw_pool));
+	if (pool == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	root = create_node(NULL, path, length, base, 0, statbuf);
+	if (root == NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, pool);
+		return -1;
+	}
+
+	pool->state = state;
+	pool->count = get_worker_count();
+
+	for (int i = 0; i < pool->count; ++i)
+	{
+		RtlInitializeSRWLock(&pool->workers[i].lock);
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+	}
+
+	pool->outstanding = 1;
+	if (push_node(&pool->workers[0], root) == -1)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, root);
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, pool);
+		return -1;
+	}
+
+	// The calling thread is the first worker.
+	for (int i = 1; i < pool->count; ++i)
+	{
+		threads[started] = CreateRemoteThreadEx(NtCurrentProcess(), NULL, 0, ftw_worker_routine, &pool->workers[i], 0, NULL, NULL);
+		if (threads[started] == NULL)
+		{
+			// The nodes are only queued by their workers, the queues of the workers that were not started stay empty.
+			break;
+		}
+
+		++started;
+	}
+
+	ftw_worker_routine(&pool->workers[0]);
+
+	if (started > 0)
+	{
+		NtWaitForMultipleObjects(started, threads, WaitAll, FALSE, NULL);
+
+		for (int i = 0; i < started; ++i)
+		{
+			NtClose(threads[i]);
+		}
+	}
+
+	for (int i = 0; i < pool->count; ++i)
+	{
+		if (pool->workers[i].nodes != NULL)
+		{
+			RtlFreeHeap(NtCurrentProcessHeap(), 0, pool->workers[i].nodes);
+		}
+
+		free_path(&pool->workers[i].path);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, pool);
+
+	return 0;
+}
+
+static int common_nftw(ftw_state *state, const char *path)
+{
+	struct stat statbuf;
+	ftw_path buffer = {NULL, 0};
+	size_t length, base;
+	int typeflag;
+	int result = 0;
+
+	VALIDATE_PATH(path, ENOENT, -1);
+
+	if ((state->flags & FTW_PARALLEL) && (state->flags & FTW_CHDIR))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (wlibc_common_stat(AT_FDCWD, path, &statbuf, (state->flags & FTW_PHYS) ? AT_SYMLINK_NOFOLLOW : 0) == 0)
+	{
+		typeflag = S_ISDIR(statbuf.st_mode) ? FTW_D : (S_ISLNK(statbuf.st_mode) ? FTW_SL : FTW_F);
+	}
+	else if (wlibc_common_stat(AT_FDCWD, path, &statbuf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(statbuf.st_mode))
+	{
+		typeflag = FTW_SLN;
+	}
+	else
+	{
+		return -1;
+	}
+
+	state->dev = statbuf.st_dev;
+	state->cwd = -1;
+
+	length = strlen(path);
+	base = length;
+
+	// Trailing slashes are not part of the name.
+	while (base > 1 && (path[base - 1] == '/' || path[base - 1] == '\\'))
+	{
+		--base;
+	}
+	while (base > 0 && path[base - 1] != '/' && path[base - 1] != '\\')
+	{
+		--base;
+	}
+
+	if (typeflag != FTW_D)
+	{
+		invoke(state, path, &statbuf, typeflag, base, 0);
+		return state->result;
+	}
+
+	if (state->flags & FTW_PARALLEL)
+	{
+		if (parallel_walk(state, path, length, base, &statbuf) == -1)
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		if (state->flags & FTW_CHDIR)
+		{
+			state->cwd = do_open(AT_FDCWD, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
+			if (state->cwd == -1)
+			{
+				return -1;
+			}
+		}
+
+		if (append_path(&buffer, 0, path, length) == -1)
+		{
+			result = -1;
+		}
+		else
+		{
+			walk_directory(state, &buffer, length, base, 0, &statbuf, NULL);
+		}
+
+		free_path(&buffer);
+
+		if (state->cwd != -1)
+		{
+			// Go back to where we started.
+			wlibc_fchdir(state->cwd);
+			close_fd(state->cwd);
+		}
+
+		if (result == -1)
+		{
+			return -1;
+		}
+	}
+
+	if (state->result == -1)
+	{
+		errno = state->error;
+	}
+
+	return state->result;
+}
+
+int wlibc_ftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag), int nopenfd WLIBC_UNUSED)
+{
+	ftw_state state = {0};
+
+	if (callback == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	state.callback = callback;
+
+	return common_nftw(&state, path);
+}
+
+int wlibc_nftw(const char *path, int (*callback)(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf),
+			   int nopenfd WLIBC_UNUSED, int flags)
+{
+	ftw_state state = {0};
+
+	if (callback == NULL || (flags & ~(FTW_PHYS | FTW_MOUNT | FTW_CHDIR | FTW_DEPTH | FTW_ACTIONRETVAL | FTW_PARALLEL)) != 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	state.ncallback = callback;
+	state.flags = flags;
+
+	return common_nftw(&state, path);
+}
@@ -15,7 +15,8 @@
 
 static DIR *initialize_dirstream(int fd)
 {
-	DIR *dirstream = (DIR *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DIR) + DIRENT_DIR_BUFFER_SIZE);
+	// The buffer is not zeroed, only the parts filled by the directory queries are read.
+	DIR *dirstream = (DIR *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(DIR) + DIRENT_DIR_BUFFER_SIZE);
 
 	if (dirstream == NULL)
 	{
@@ -26,6 +27,9 @@ static DIR *initialize_dirstream(int fd)
 	dirstream->magic = DIR_STREAM_MAGIC;
 	dirstream->fd = fd;
 	dirstream->buffer = (void *)((char *)dirstream + sizeof(DIR));
+	dirstream->offset = 0;
+	dirstream->read_data = 0;
+	dirstream->received_data = 0;
 
 	RtlInitializeCriticalSection(&(dirstream->critical));
 
@@ -6,37 +6,129 @@
 */
 
 #include <internal/nt.h>
+#include <internal/convert.h>
 #include <internal/dirent.h>
 #include <internal/error.h>
 #include <internal/fcntl.h>
 #include <dirent.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <emmintrin.h>
 
-struct dirent *do_readdir(DIR *dirstream, struct dirent *entry)
+// Fetch the next block of entries. Returns 1 if entries are available, 0 at the end of the directory, -1 on error.
+static int readdir_refill(DIR *dirstream)
 {
 	NTSTATUS status;
 	IO_STATUS_BLOCK io;
-	UTF8_STRING u8_path;
-	UNICODE_STRING u16_path;
 
-	if (dirstream->read_data == dirstream->received_data)
+	// The buffer need not be cleared, only 'received_data' bytes of it are ever looked at.
+	status = NtQueryDirectoryFileEx(get_fd_handle(dirstream->fd), NULL, NULL, NULL, &io, dirstream->buffer, DIRENT_DIR_BUFFER_SIZE,
+									FileIdExtdBothDirectoryInformation, 0, NULL);
+	if (status != STATUS_SUCCESS)
 	{
-		memset(dirstream->buffer, 0, DIRENT_DIR_BUFFER_SIZE);
-		status = NtQueryDirectoryFileEx(get_fd_handle(dirstream->fd), NULL, NULL, NULL, &io, dirstream->buffer, DIRENT_DIR_BUFFER_SIZE,
-										FileIdExtdBothDirectoryInformation, 0, NULL);
-		if (status != STATUS_SUCCESS)
+		if (status != STATUS_NO_MORE_FILES)
 		{
-			if (status != STATUS_NO_MORE_FILES)
-			{
-				map_ntstatus_to_errno(status);
-			}
-			return NULL;
+			map_ntstatus_to_errno(status);
+			return -1;
 		}
-		dirstream->offset = 0;
-		dirstream->received_data = io.Information;
+		return 0;
 	}
 
+	dirstream->offset = 0;
+	dirstream->read_data = 0;
+	dirstream->received_data = io.Information;
+
+	return 1;
+}
+
+// Names are mostly ASCII, convert them 8 characters at a time. Returns the length of the name or -1 if the name has a
+// non ASCII character, the caller should do the full conversion then.
+static int convert_ascii_name(char *restrict name, const WCHAR *restrict u16_name, size_t length)
+{
+	const __m128i mask = _mm_set1_epi16((short)0xFF80);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	if (length > 255)
+	{
+		return -1;
+	}
+
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i *)(u16_name + i));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chars, mask), zero)) != 0xFFFF)
+		{
+			return -1;
+		}
+
+		_mm_storel_epi64((__m128i *)(name + i), _mm_packus_epi16(chars, chars));
+	}
+
+	for (; i < length; ++i)
+	{
+		if (u16_name[i] >= 0x80)
+		{
+			return -1;
+		}
+
+		name[i] = (char)u16_name[i];
+	}
+
+	name[length] = '\0';
+
+	return (int)length;
+}
+
+// Fill what the directory listing has of the stat of an entry. There is no per file query here, so the permissions are
+// derived from the attributes and st_dev, st_uid, st_gid, st_nlink, st_blksize are left to the caller.
+static void convert_stat(PFILE_ID_EXTD_BOTH_DIR_INFORMATION direntry, uint8_t type, struct stat *statbuf)
+{
+	memset(statbuf, 0, sizeof(struct stat));
+
+	switch (type)
+	{
+	case DT_LNK:
+		statbuf->st_mode = S_IFLNK | S_IRWXUGO;
+		break;
+	case DT_DIR:
+		statbuf->st_mode = S_IFDIR | S_IRUGO | S_IXUGO | S_IWUSR;
+		break;
+	case DT_REG:
+		statbuf->st_mode = S_IFREG | S_IRUGO | S_IWUSR;
+		break;
+	default:
+		statbuf->st_mode = S_IRUGO | S_IWUSR;
+		break;
+	}
+
+	if (type != DT_LNK && (direntry->FileAttributes & FILE_ATTRIBUTE_READONLY))
+	{
+		statbuf->st_mode &= ~S_IWUSR;
+	}
+
+	statbuf->st_attributes = direntry->FileAttributes & S_IA_MASK;
+	statbuf->st_ino = *(ino_t *)(&direntry->FileId.Identifier);
+	statbuf->st_size = direntry->EndOfFile.QuadPart;
+	statbuf->st_blocks = direntry->AllocationSize.QuadPart / 512;
+
+	statbuf->st_atim = LARGE_INTEGER_to_timespec(direntry->LastAccessTime);
+	statbuf->st_mtim = LARGE_INTEGER_to_timespec(direntry->LastWriteTime);
+	statbuf->st_ctim = LARGE_INTEGER_to_timespec(direntry->ChangeTime);
+	statbuf->st_birthtim = LARGE_INTEGER_to_timespec(direntry->CreationTime);
+}
+
+// Fill 'entry' (and 'statbuf' if given) from the entry at the current offset of the buffer and move past it.
+static void convert_entry(DIR *dirstream, struct dirent *entry, struct stat *statbuf)
+{
+	NTSTATUS status;
+	UTF8_STRING u8_path;
+	UNICODE_STRING u16_path;
+	int length;
+
 	PFILE_ID_EXTD_BOTH_DIR_INFORMATION direntry = (PFILE_ID_EXTD_BOTH_DIR_INFORMATION)((char *)dirstream->buffer + dirstream->offset);
 
 	// Copy only the lower 8 bytes, the upper 8 bytes will be zero on NTFS
@@ -68,26 +160,39 @@ struct dirent *do_readdir(DIR *dirstream, struct dirent *entry)
 
 	entry->d_reclen = (uint16_t)(offsetof(FILE_ID_EXTD_BOTH_DIR_INFORMATION, FileName) + direntry->FileNameLength);
 
-	u16_path.Length = (USHORT)direntry->FileNameLength;
-	u16_path.MaximumLength = (USHORT)direntry->FileNameLength;
-	u16_path.Buffer = direntry->FileName;
+	length = convert_ascii_name(entry->d_name, direntry->FileName, direntry->FileNameLength / sizeof(WCHAR));
 
-	u8_path.Buffer = entry->d_name;
-	u8_path.Length = 0;
-	u8_path.MaximumLength = 260;
-
-	status = RtlUnicodeStringToUTF8String(&u8_path, &u16_path, FALSE);
-
-	if (status == STATUS_SUCCESS)
+	if (length != -1)
 	{
-		memcpy(entry->d_name, u8_path.Buffer, u8_path.MaximumLength);
-		entry->d_namlen = (uint8_t)u8_path.Length; // This does not include the NULL character.
+		entry->d_namlen = (uint8_t)length;
 	}
 	else
 	{
-		// Converting the UTF-16 name to UTF-8 has failed. Treat as if the entry has no name.
-		// This really should never happen.
-		entry->d_namlen = 0;
+		u16_path.Length = (USHORT)direntry->FileNameLength;
+		u16_path.MaximumLength = (USHORT)direntry->FileNameLength;
+		u16_path.Buffer = direntry->FileName;
+
+		u8_path.Buffer = entry->d_name;
+		u8_path.Length = 0;
+		u8_path.MaximumLength = 260;
+
+		status = RtlUnicodeStringToUTF8String(&u8_path, &u16_path, FALSE);
+
+		if (status == STATUS_SUCCESS)
+		{
+			entry->d_namlen = (uint8_t)u8_path.Length; // This does not include the NULL character.
+		}
+		else
+		{
+			// Converting the UTF-16 name to UTF-8 has failed. Treat as if the entry has no name.
+			// This really should never happen.
+			entry->d_namlen = 0;
+		}
+	}
+
+	if (statbuf != NULL)
+	{
+		convert_stat(direntry, entry->d_type, statbuf);
 	}
 
 	dirstream->offset += direntry->NextEntryOffset;
@@ -97,6 +202,48 @@ struct dirent *do_readdir(DIR *dirstream, struct dirent *entry)
 	{
 		dirstream->read_data += (entry->d_reclen % sizeof(LONGLONG) == 0 ? 0 : (sizeof(LONGLONG) - entry->d_reclen % sizeof(LONGLONG)));
 	}
+}
+
+// Fill up to 'count' entries, and their stat buffers if 'stats' is not NULL. Returns the number of entries filled, 0 at the
+// end of the directory, -1 on error. The entries of a block are converted together, the directory is queried again only
+// when the block is exhausted.
+ssize_t common_readdir_batch(DIR *dirstream, struct dirent *entries, struct stat *stats, size_t count)
+{
+	size_t filled = 0;
+	int result;
+
+	while (filled < count)
+	{
+		if (dirstream->read_data == dirstream->received_data)
+		{
+			result = readdir_refill(dirstream);
+			if (result != 1)
+			{
+				// Return what we have, the error will be reported on the next call.
+				if (filled == 0)
+				{
+					return result;
+				}
+				break;
+			}
+		}
+
+		while (filled < count && dirstream->read_data != dirstream->received_data)
+		{
+			convert_entry(dirstream, &entries[filled], stats != NULL ? &stats[filled] : NULL);
+			++filled;
+		}
+	}
+
+	return (ssize_t)filled;
+}
+
+struct dirent *do_readdir(DIR *dirstream, struct dirent *entry)
+{
+	if (common_readdir_batch(dirstream, entry, NULL, 1) != 1)
+	{
+		return NULL;
+	}
 
 	return entry;
 }
@@ -137,3 +284,22 @@ int wlibc_readdir_r(DIR *restrict dirstream, struct dirent *restrict entry, stru
 	errno = old_errno;
 	return 0;
 }
+
+ssize_t wlibc_readdir_batch(DIR *restrict dirstream, struct dirent *restrict entries, size_t count)
+{
+	ssize_t result;
+
+	VALIDATE_DIR_STREAM(dirstream, -1);
+
+	if (entries == NULL)
+	{
+		errno = EFAULT;
+		return -1;
+	}
+
+	LOCK_DIR_STREAM(dirstream);
+	result = common_readdir_batch(dirstream, entries, NULL, count);
+	UNLOCK_DIR_STREAM(dirstream);
+
+	return result;
+}
@@ -21,7 +21,6 @@ void wlibc_rewinddir(DIR *dirstream)
 
 	LOCK_DIR_STREAM(dirstream);
 
-	memset(dirstream->buffer, 0, DIRENT_DIR_BUFFER_SIZE);
 	status = NtQueryDirectoryFileEx(get_fd_handle(dirstream->fd), NULL, NULL, NULL, &io, dirstream->buffer, DIRENT_DIR_BUFFER_SIZE,
 									FileIdExtdBothDirectoryInformation, FILE_QUERY_RESTART_SCAN, NULL);
 	if (status != STATUS_SUCCESS)
@@ -8,11 +8,85 @@
 #include <internal/nt.h>
 #include <internal/fcntl.h>
 #include <dirent.h>
+#include <errno.h>
+#include <locale.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 // From readdir.c
-struct dirent *do_readdir(DIR *dirstream, struct dirent *entry);
+ssize_t common_readdir_batch(DIR *dirstream, struct dirent *entries, struct stat *stats, size_t count);
+
+// Number of entries read from the directory at a time.
+#define SCANDIR_BATCH_SIZE 64
+
+typedef struct _scandir_key
+{
+	unsigned long long prefix; // First 8 bytes of the name, big endian.
+	struct dirent *entry;
+} scandir_key;
+
+// Compare the prefixes first, the names are compared only if they share the first 8 bytes.
+static int compare_keys(const void *a, const void *b)
+{
+	const scandir_key *k1 = (const scandir_key *)a;
+	const scandir_key *k2 = (const scandir_key *)b;
+
+	if (k1->prefix != k2->prefix)
+	{
+		return k1->prefix < k2->prefix ? -1 : 1;
+	}
+
+	// The names are equal if either of them ends within the prefix.
+	if (k1->entry->d_namlen < 8 || k2->entry->d_namlen < 8)
+	{
+		return 0;
+	}
+
+	return strcmp(k1->entry->d_name + 8, k2->entry->d_name + 8);
+}
+
+// alphasort compares with strcoll. In the "C" locale this is strcmp, sort on the prefixes of the names then.
+static int sort_entries_by_name(struct dirent **entries, int count)
+{
+	scandir_key *keys;
+
+	keys = (scandir_key *)malloc(sizeof(scandir_key) * count);
+	if (keys == NULL)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		unsigned long long prefix = 0;
+
+		memcpy(&prefix, entries[i]->d_name, __min(entries[i]->d_namlen, 8));
+		keys[i].prefix = _byteswap_uint64(prefix);
+		keys[i].entry = entries[i];
+	}
+
+	qsort(keys, count, sizeof(scandir_key), compare_keys);
+
+	for (int i = 0; i < count; ++i)
+	{
+		entries[i] = keys[i].entry;
+	}
+
+	free(keys);
+
+	return 0;
+}
+
+static void free_entries(struct dirent **entries, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		free(entries[i]);
+	}
+
+	free(entries);
+}
 
 int wlibc_common_scandir(int dfd, const char *path, struct dirent ***entries, int (*selector)(const struct dirent *),
 						 int (*cmp)(const struct dirent **, const struct dirent **))
@@ -32,44 +106,106 @@ int wlibc_common_scandir(int dfd, const char *path, struct dirent ***entries, in
 
 	if (dirstream == NULL)
 	{
+		close_fd(fd);
 		return -1;
 	}
 
 	int count = 0;
 	int allocated = 16;
-	struct dirent entry;
+	ssize_t result;
+	struct dirent **list;
+	struct dirent *batch;
+
+	list = (struct dirent **)malloc(sizeof(struct dirent *) * allocated);
+	batch = (struct dirent *)malloc(sizeof(struct dirent) * SCANDIR_BATCH_SIZE);
 
-	*entries = (struct dirent **)malloc(sizeof(struct dirent *) * 16);
+	if (list == NULL || batch == NULL)
+	{
+		errno = ENOMEM;
+		goto fail;
+	}
 
-	while (do_readdir(dirstream, &entry) != NULL)
+	while ((result = common_readdir_batch(dirstream, batch, NULL, SCANDIR_BATCH_SIZE)) > 0)
 	{
-		if (selector)
+		for (ssize_t i = 0; i < result; ++i)
 		{
-			// Skip the entry if the selector function return 0.
-			if (selector(&entry) == 0)
+			struct dirent *entry = &batch[i];
+
+			if (selector)
 			{
-				continue;
+				// Skip the entry if the selector function return 0.
+				if (selector(entry) == 0)
+				{
+					continue;
+				}
 			}
-		}
 
-		// Double the allocated entry list.
-		if (count == allocated)
-		{
-			*entries = realloc(*entries, sizeof(struct dirent *) * 32);
-			allocated *= 2;
+			// Double the allocated entry list.
+			if (count == allocated)
+			{
+				struct dirent **temp = (struct dirent **)realloc(list, sizeof(struct dirent *) * allocated * 2);
+				if (temp == NULL)
+				{
+					errno = ENOMEM;
+					goto fail;
+				}
+
+				list = temp;
+				allocated *= 2;
+			}
+
+			// Each entry is freed by the caller, so it has to be its own allocation. Only allocate what the name needs.
+			size_t size = offsetof(struct dirent, d_name) + entry->d_namlen + 1;
+
+			list[count] = (struct dirent *)malloc(size);
+			if (list[count] == NULL)
+			{
+				errno = ENOMEM;
+				goto fail;
+			}
+
+			memcpy(list[count], entry, size);
+			++count;
 		}
+	}
 
-		(*entries)[count] = (struct dirent *)malloc(sizeof(struct dirent));
-		memcpy((*entries)[count], &entry, sizeof(struct dirent));
-		++count;
+	// errno is set by common_readdir_batch.
+	if (result == -1)
+	{
+		goto fail;
 	}
 
 	if (cmp)
 	{
-		qsort(*entries, count, sizeof(struct dirent *), (int (*)(const void *, const void *))cmp);
+		if (cmp == wlibc_alphasort && strcmp(setlocale(LC_COLLATE, NULL), "C") == 0)
+		{
+			if (sort_entries_by_name(list, count) == -1)
+			{
+				errno = ENOMEM;
+				goto fail;
+			}
+		}
+		else
+		{
+			qsort(list, count, sizeof(struct dirent *), (int (*)(const void *, const void *))cmp);
+		}
 	}
 
+	free(batch);
 	wlibc_closedir(dirstream);
 
+	*entries = list;
+
 	return count;
+
+fail:
+	if (list != NULL)
+	{
+		free_entries(list, count);
+	}
+
+	free(batch);
+	wlibc_closedir(dirstream);
+
+	return -1;
 }
@@ -0,0 +1,139 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/dirent.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+
+// From readdir.c
+ssize_t common_readdir_batch(DIR *dirstream, struct dirent *entries, struct stat *stats, size_t count);
+
+// Number of entries read from the directory at a time.
+#define WALK_BATCH_SIZE 32
+
+// Initial size of the records buffer.
+#define WALK_RECORDS_SIZE 4096
+
+static int reserve_records(dirent_records *records, size_t size)
+{
+	size_t capacity;
+	char *buffer;
+
+	if (records->used + size <= records->capacity)
+	{
+		return 0;
+	}
+
+	capacity = __max(__max(records->capacity * 2, WALK_RECORDS_SIZE), records->used + size);
+
+	if (records->buffer == NULL)
+	{
+		buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, capacity);
+	}
+	else
+	{
+		buffer = (char *)RtlReAllocateHeap(NtCurrentProcessHeap(), 0, records->buffer, capacity);
+	}
+
+	if (buffer == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	records->buffer = buffer;
+	records->capacity = capacity;
+
+	return 0;
+}
+
+int read_dirent_records(const char *path, dev_t dev, dirent_records *records)
+{
+	DIR *dirstream;
+	ssize_t result;
+	struct dirent entries[WALK_BATCH_SIZE];
+	struct stat stats[WALK_BATCH_SIZE];
+
+	records->buffer = NULL;
+	records->used = 0;
+	records->capacity = 0;
+	records->count = 0;
+
+	dirstream = wlibc_opendir(path);
+	if (dirstream == NULL)
+	{
+		return -1;
+	}
+
+	while ((result = common_readdir_batch(dirstream, entries, stats, WALK_BATCH_SIZE)) > 0)
+	{
+		for (ssize_t i = 0; i < result; ++i)
+		{
+			dirent_record *record;
+			size_t size;
+
+			// Skip "." and "..".
+			if (entries[i].d_name[0] == '.' &&
+				(entries[i].d_namlen == 1 || (entries[i].d_namlen == 2 && entries[i].d_name[1] == '.')))
+			{
+				continue;
+			}
+
+			// Keep the records 8 byte aligned.
+			size = (offsetof(dirent_record, name) + entries[i].d_namlen + 1 + 7) & ~(size_t)7;
+
+			if (reserve_records(records, size) == -1)
+			{
+				result = -1;
+				break;
+			}
+
+			record = (dirent_record *)(records->buffer + records->used);
+
+			memcpy(&record->st, &stats[i], sizeof(struct stat));
+			record->st.st_dev = dev;
+			record->size = (uint16_t)size;
+			record->type = entries[i].d_type;
+			record->namlen = entries[i].d_namlen;
+			memcpy(record->name, entries[i].d_name, entries[i].d_namlen);
+			record->name[record->namlen] = '\0';
+
+			records->used += size;
+			records->count++;
+		}
+
+		if (result == -1)
+		{
+			break;
+		}
+	}
+
+	wlibc_closedir(dirstream);
+
+	if (result == -1)
+	{
+		free_dirent_records(records);
+		return -1;
+	}
+
+	return 0;
+}
+
+void free_dirent_records(dirent_records *records)
+{
+	if (records->buffer != NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, records->buffer);
+	}
+
+	records->buffer = NULL;
+	records->used = 0;
+	records->capacity = 0;
+	records->count = 0;
+}
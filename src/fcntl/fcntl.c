@@ -45,10 +45,12 @@ int wlibc_fcntl(int fd, int cmd, va_list args)
 	case F_GETFL:
 		return get_fd_flags(fd);
 	case F_SETFL:
-		int f_setfl_flags = (va_arg(args, int) & (O_APPEND | O_ASYNC | O_DIRECT | O_NOATIME | O_NONBLOCK));
+		int f_setfl_mask = (O_APPEND | O_ASYNC | O_DIRECT | O_NOATIME | O_NONBLOCK);
+		int f_setfl_flags = (va_arg(args, int) & f_setfl_mask);
 		// only O_APPEND works for now.
 		// O_DIRECT and O_NONBLOCK require reopening the file. TODO
-		add_fd_flags(fd, f_setfl_flags);
+		// The settable flags are replaced, so that O_APPEND can be cleared as well.
+		set_fd_flags(fd, (get_fd_flags(fd) & ~f_setfl_mask) | f_setfl_flags);
 		return 0;
 	default:
 		errno = EINVAL;
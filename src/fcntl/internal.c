@@ -11,13 +11,53 @@
 #include <errno.h>
 #include <fcntl.h>
 
-fdinfo *_wlibc_fd_table = NULL;
-size_t _wlibc_fd_table_size = 0;
+#pragma intrinsic(_BitScanForward64)
+
+fdinfo **volatile _wlibc_fd_directory = NULL;
+volatile size_t _wlibc_fd_table_size = 0;
 unsigned int _wlibc_fd_sequence = 0;
 RTL_SRWLOCK _wlibc_fd_table_srwlock;
 
+// Free fd bitmap.
+// Level 0 has one bit per fd, which is set if the fd is free.
+// Each bit of level 'n + 1' is set if the corresponding word of level 'n' has a free bit.
+// The top level is always a single word, so finding the lowest free fd is a walk from the top down.
+// 6 levels of 64 bits are enough to cover every positive int.
+#define FD_BITMAP_MAX_LEVELS 6
+
+typedef struct _fd_bitmap
+{
+	ULONGLONG *words;
+	size_t offset[FD_BITMAP_MAX_LEVELS];
+	size_t count[FD_BITMAP_MAX_LEVELS];
+	int levels;
+} fd_bitmap;
+
+static fd_bitmap _wlibc_fd_bitmap;
+
+// HANDLE -> fd index. Open addressing with linear probing, kept at most half full.
+// The same handle can be present in more than one fd (eg. inherited stdout and stderr), so keys are not unique.
+typedef struct _fd_hash_entry
+{
+	HANDLE handle;
+	int fd;
+} fd_hash_entry;
+
+static fd_hash_entry *_wlibc_fd_hash = NULL;
+static size_t _wlibc_fd_hash_size = 0;
+static size_t _wlibc_fd_hash_count = 0;
+
+// Old directories are not freed when the table grows as lock free readers might still be using them.
+// The table grows geometrically and a directory only holds page pointers, so the memory held here is small.
+#define FD_TABLE_MAX_RETIRED 64
+static fdinfo **_wlibc_fd_retired_directories[FD_TABLE_MAX_RETIRED];
+static int _wlibc_fd_retired_count = 0;
+
+static fd_close_hook _wlibc_fd_close_hooks[MAX_HANDLE_TYPE];
+
 // Declaration of static functions
 static int internal_insert_fd(int index, HANDLE _h, handle_t _type, int _flags);
+static void internal_remove_fd(int index);
 static int register_to_fd_table_internal(HANDLE _h, handle_t _type, int _flags);
 static int insert_into_fd_table_internal(int _fd, HANDLE _h, handle_t _type, int _flags);
 static void unregister_from_fd_table_internal(HANDLE _h);
@@ -197,23 +237,23 @@ void initialize_std_handles(HANDLE handle, int index, bool console_subsystem, bo
 	inherited_handle_type = determine_handle_type(handle);
 	if (inherited_handle_type != INVALID_HANDLE)
 	{
-		_wlibc_fd_table[index].handle = handle;
-		_wlibc_fd_table[index].type = inherited_handle_type;
-		_wlibc_fd_table[index].flags = determine_handle_flags(handle);
-		_wlibc_fd_table[index].sequence = ++_wlibc_fd_sequence;
+		FD_ENTRY(index)->handle = handle;
+		FD_ENTRY(index)->type = inherited_handle_type;
+		FD_ENTRY(index)->flags = determine_handle_flags(handle);
+		FD_ENTRY(index)->sequence = ++_wlibc_fd_sequence;
 	}
 	else if (console_subsystem)
 	{
-		_wlibc_fd_table[index].handle = output == true ? open_conout() : open_conin();
-		if (_wlibc_fd_table[index].handle != NULL)
+		FD_ENTRY(index)->handle = output == true ? open_conout() : open_conin();
+		if (FD_ENTRY(index)->handle != NULL)
 		{
-			_wlibc_fd_table[index].type = CONSOLE_HANDLE;
-			_wlibc_fd_table[index].flags = output == true ? O_WRONLY : O_RDONLY;
-			_wlibc_fd_table[index].sequence = ++_wlibc_fd_sequence;
+			FD_ENTRY(index)->type = CONSOLE_HANDLE;
+			FD_ENTRY(index)->flags = output == true ? O_WRONLY : O_RDONLY;
+			FD_ENTRY(index)->sequence = ++_wlibc_fd_sequence;
 		}
 		else
 		{
-			_wlibc_fd_table[index].handle = NULL;
+			FD_ENTRY(index)->handle = NULL;
 		}
 	}
 }
@@ -227,6 +267,335 @@ void initialize_std_handles(HANDLE handle, int index, bool console_subsystem, bo
 #define FNULL_FLAG      0x40 // file handle refers to a device (Originally FDEV)
 #define FCONSOLE_FLAG   0x80 // file handle is in text mode  (Originally FTEXT)
 
+///////////////////////////////////////
+// Free fd bitmap
+///////////////////////////////////////
+static int fd_bitmap_build(fd_bitmap *bitmap, fdinfo **directory, size_t size)
+{
+	size_t total = 0;
+	size_t words = size;
+	int levels = 0;
+
+	do
+	{
+		words = (words + 63) / 64;
+		bitmap->offset[levels] = total;
+		bitmap->count[levels] = words;
+		total += words;
+		++levels;
+	} while (words > 1);
+
+	bitmap->levels = levels;
+	bitmap->words = (ULONGLONG *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ULONGLONG) * total);
+
+	if (bitmap->words == NULL)
+	{
+		return -1;
+	}
+
+	// Bits beyond the size of the table are never set, so they are never handed out.
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (directory[i >> FD_TABLE_PAGE_SHIFT][i & (FD_TABLE_PAGE_SIZE - 1)].handle == NULL)
+		{
+			bitmap->words[i / 64] |= 1ull << (i % 64);
+		}
+	}
+
+	for (int level = 1; level < levels; ++level)
+	{
+		ULONGLONG *lower = bitmap->words + bitmap->offset[level - 1];
+		ULONGLONG *upper = bitmap->words + bitmap->offset[level];
+
+		for (size_t i = 0; i < bitmap->count[level - 1]; ++i)
+		{
+			if (lower[i] != 0)
+			{
+				upper[i / 64] |= 1ull << (i % 64);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void fd_bitmap_mark_used(fd_bitmap *bitmap, size_t index)
+{
+	for (int level = 0; level < bitmap->levels; ++level)
+	{
+		ULONGLONG *word = &bitmap->words[bitmap->offset[level] + index / 64];
+
+		*word &= ~(1ull << (index % 64));
+
+		// Other free bits remain in this word, the upper levels stay the same.
+		if (*word != 0)
+		{
+			break;
+		}
+
+		index /= 64;
+	}
+}
+
+static void fd_bitmap_mark_free(fd_bitmap *bitmap, size_t index)
+{
+	for (int level = 0; level < bitmap->levels; ++level)
+	{
+		ULONGLONG *word = &bitmap->words[bitmap->offset[level] + index / 64];
+		ULONGLONG old = *word;
+
+		*word |= 1ull << (index % 64);
+
+		// The word already had a free bit, the upper levels already know about it.
+		if (old != 0)
+		{
+			break;
+		}
+
+		index /= 64;
+	}
+}
+
+static int fd_bitmap_lowest_free(fd_bitmap *bitmap)
+{
+	unsigned long bit;
+	size_t index = 0;
+
+	for (int level = bitmap->levels - 1; level >= 0; --level)
+	{
+		if (_BitScanForward64(&bit, bitmap->words[bitmap->offset[level] + index]) == 0)
+		{
+			// Only possible at the top level when the table is full.
+			return -1;
+		}
+
+		index = index * 64 + bit;
+	}
+
+	return (int)index;
+}
+
+///////////////////////////////////////
+// HANDLE -> fd index
+///////////////////////////////////////
+static inline size_t fd_hash(HANDLE handle, size_t size)
+{
+	// Handle values are multiples of 4, use fibonacci hashing to spread them.
+	return (size_t)((((ULONGLONG)(ULONG_PTR)handle >> 2) * 0x9E3779B97F4A7C15ull) >> 32) & (size - 1);
+}
+
+static void fd_hash_place(fd_hash_entry *entries, size_t size, HANDLE handle, int fd)
+{
+	size_t i = fd_hash(handle, size);
+
+	while (entries[i].handle != NULL)
+	{
+		i = (i + 1) & (size - 1);
+	}
+
+	entries[i].handle = handle;
+	entries[i].fd = fd;
+}
+
+// Make sure there is space for one more entry.
+static int fd_hash_reserve(void)
+{
+	fd_hash_entry *entries;
+	size_t size;
+
+	if ((_wlibc_fd_hash_count + 1) * 2 <= _wlibc_fd_hash_size)
+	{
+		return 0;
+	}
+
+	size = _wlibc_fd_hash_size == 0 ? 16 : _wlibc_fd_hash_size * 2;
+	entries = (fd_hash_entry *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(fd_hash_entry) * size);
+
+	if (entries == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (size_t i = 0; i < _wlibc_fd_hash_size; ++i)
+	{
+		if (_wlibc_fd_hash[i].handle != NULL)
+		{
+			fd_hash_place(entries, size, _wlibc_fd_hash[i].handle, _wlibc_fd_hash[i].fd);
+		}
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_hash);
+	_wlibc_fd_hash = entries;
+	_wlibc_fd_hash_size = size;
+
+	return 0;
+}
+
+static void fd_hash_insert(HANDLE handle, int fd)
+{
+	// INVALID_HANDLE_VALUE is never looked up.
+	if (handle == NULL || handle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	fd_hash_place(_wlibc_fd_hash, _wlibc_fd_hash_size, handle, fd);
+	++_wlibc_fd_hash_count;
+}
+
+static void fd_hash_remove(HANDLE handle, int fd)
+{
+	size_t mask = _wlibc_fd_hash_size - 1;
+	size_t i, j;
+
+	if (handle == NULL || handle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	i = fd_hash(handle, _wlibc_fd_hash_size);
+
+	while (_wlibc_fd_hash[i].handle != NULL)
+	{
+		if (_wlibc_fd_hash[i].handle == handle && _wlibc_fd_hash[i].fd == fd)
+		{
+			break;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	if (_wlibc_fd_hash[i].handle == NULL)
+	{
+		return;
+	}
+
+	// Backward shift deletion, move up the entries of the probe sequence so that no tombstones are needed.
+	j = i;
+
+	while (1)
+	{
+		size_t k;
+
+		j = (j + 1) & mask;
+
+		if (_wlibc_fd_hash[j].handle == NULL)
+		{
+			break;
+		}
+
+		k = fd_hash(_wlibc_fd_hash[j].handle, _wlibc_fd_hash_size);
+
+		// Leave the entry if its home slot lies cyclically in (i, j].
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+		{
+			continue;
+		}
+
+		_wlibc_fd_hash[i] = _wlibc_fd_hash[j];
+		i = j;
+	}
+
+	_wlibc_fd_hash[i].handle = NULL;
+	--_wlibc_fd_hash_count;
+}
+
+static int fd_hash_lookup(HANDLE handle)
+{
+	size_t i;
+	int fd = -1;
+
+	if (_wlibc_fd_hash_size == 0 || handle == NULL || handle == INVALID_HANDLE_VALUE)
+	{
+		return -1;
+	}
+
+	i = fd_hash(handle, _wlibc_fd_hash_size);
+
+	// Return the lowest fd in case the handle is shared.
+	while (_wlibc_fd_hash[i].handle != NULL)
+	{
+		if (_wlibc_fd_hash[i].handle == handle && (fd == -1 || _wlibc_fd_hash[i].fd < fd))
+		{
+			fd = _wlibc_fd_hash[i].fd;
+		}
+
+		i = (i + 1) & (_wlibc_fd_hash_size - 1);
+	}
+
+	return fd;
+}
+
+///////////////////////////////////////
+// Table growth
+///////////////////////////////////////
+static int grow_fd_table(size_t new_size)
+{
+	fdinfo **new_directory;
+	fd_bitmap new_bitmap;
+	size_t old_pages = _wlibc_fd_table_size / FD_TABLE_PAGE_SIZE;
+	size_t new_pages = (new_size + FD_TABLE_PAGE_SIZE - 1) / FD_TABLE_PAGE_SIZE;
+
+	if (_wlibc_fd_retired_count == FD_TABLE_MAX_RETIRED)
+	{
+		errno = EMFILE;
+		return -1;
+	}
+
+	new_directory = (fdinfo **)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(fdinfo *) * new_pages);
+	if (new_directory == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (old_pages != 0)
+	{
+		memcpy(new_directory, _wlibc_fd_directory, sizeof(fdinfo *) * old_pages);
+	}
+
+	// Zeroed entries have a NULL handle and an INVALID_HANDLE type.
+	for (size_t i = old_pages; i < new_pages; ++i)
+	{
+		new_directory[i] = (fdinfo *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(fdinfo) * FD_TABLE_PAGE_SIZE);
+		if (new_directory[i] == NULL)
+		{
+			goto fail;
+		}
+	}
+
+	if (fd_bitmap_build(&new_bitmap, new_directory, new_pages * FD_TABLE_PAGE_SIZE) != 0)
+	{
+		goto fail;
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_bitmap.words);
+	_wlibc_fd_bitmap = new_bitmap;
+
+	// Publish the directory before the size. A reader that sees the new size is guaranteed to see the new directory,
+	// and a reader that sees the new directory with the old size stays within bounds.
+	if (_wlibc_fd_directory != NULL)
+	{
+		_wlibc_fd_retired_directories[_wlibc_fd_retired_count++] = _wlibc_fd_directory;
+	}
+
+	_wlibc_fd_directory = new_directory;
+	_wlibc_fd_table_size = new_pages * FD_TABLE_PAGE_SIZE;
+
+	return 0;
+
+fail:
+	for (size_t i = old_pages; i < new_pages && new_directory[i] != NULL; ++i)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, new_directory[i]);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, new_directory);
+	errno = ENOMEM;
+	return -1;
+}
+
 ///////////////////////////////////////
 // Initialization and cleanup functions
 ///////////////////////////////////////
@@ -253,27 +622,13 @@ void init_fd_table(void)
 	// This first 4 bytes say the number of handles inherited.
 	DWORD number_of_handles_inherited = data->Buffer == NULL ? 0 : *(DWORD *)data->Buffer;
 
-	_wlibc_fd_table_size = 4;
-	// Set the initial size of the fd tables to be the nearest 2 power enough to fit in all the handles.
-	while (_wlibc_fd_table_size < number_of_handles_inherited)
-	{
-		_wlibc_fd_table_size *= 2;
-	}
-
-	_wlibc_fd_table = (fdinfo *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(fdinfo) * _wlibc_fd_table_size);
-
+	// The initial size of the table is enough to fit in all the handles, rounded up to a page.
 	// Exit the process if the initialization routine fails.
-	if (_wlibc_fd_table == NULL)
+	if (grow_fd_table(__max(number_of_handles_inherited, (DWORD)FD_TABLE_PAGE_SIZE)) != 0)
 	{
 		RtlExitUserProcess(STATUS_NO_MEMORY);
 	}
 
-	// Mark all handles as invalid at the start.
-	for (size_t i = 0; i < _wlibc_fd_table_size; ++i)
-	{
-		_wlibc_fd_table[i].handle = NULL;
-	}
-
 	// Standard Input,Output,Error.
 	initialize_std_handles(hin, 0, console_subsystem, false);
 	initialize_std_handles(hout, 1, console_subsystem, true);
@@ -293,22 +648,37 @@ void init_fd_table(void)
 			// msvcrt sets invalid handles to INVALID_HANDLE_VALUE to inherited processes.
 			if ((handle_flag & FOPEN_FLAG) == 0 || inherited_handle == INVALID_HANDLE_VALUE)
 			{
-				_wlibc_fd_table[i].handle = NULL;
+				FD_ENTRY(i)->handle = NULL;
 				continue;
 			}
 
 			inherited_handle_type = determine_handle_type(inherited_handle);
 			if (inherited_handle_type == INVALID_HANDLE)
 			{
-				_wlibc_fd_table[i].handle = NULL;
+				FD_ENTRY(i)->handle = NULL;
 				continue;
 			}
 
 			// Valid handle. Don't trust the other flags that are passed, query the kernel for the actual values.
-			_wlibc_fd_table[i].handle = inherited_handle;
-			_wlibc_fd_table[i].flags = determine_handle_flags(inherited_handle);
-			_wlibc_fd_table[i].type = inherited_handle_type;
-			_wlibc_fd_table[i].sequence = ++_wlibc_fd_sequence;
+			FD_ENTRY(i)->handle = inherited_handle;
+			FD_ENTRY(i)->flags = determine_handle_flags(inherited_handle);
+			FD_ENTRY(i)->type = inherited_handle_type;
+			FD_ENTRY(i)->sequence = ++_wlibc_fd_sequence;
+		}
+	}
+
+	// Build the indices.
+	for (size_t i = 0; i < _wlibc_fd_table_size; ++i)
+	{
+		if (FD_ENTRY(i)->handle != NULL)
+		{
+			if (fd_hash_reserve() != 0)
+			{
+				RtlExitUserProcess(STATUS_NO_MEMORY);
+			}
+
+			fd_hash_insert(FD_ENTRY(i)->handle, (int)i);
+			fd_bitmap_mark_used(&_wlibc_fd_bitmap, i);
 		}
 	}
 }
@@ -316,19 +686,64 @@ void init_fd_table(void)
 // Not worrying about open handles (not closed by the user)
 void cleanup_fd_table(void)
 {
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_table);
+	for (int i = 0; i < _wlibc_fd_retired_count; ++i)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_retired_directories[i]);
+	}
+
+	for (size_t i = 0; i < _wlibc_fd_table_size / FD_TABLE_PAGE_SIZE; ++i)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_directory[i]);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_bitmap.words);
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_hash);
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_directory);
 }
 
 ///////////////////////////////////////
 // Primary functions
 ///////////////////////////////////////
 
+// Writers already hold the exclusive lock. The version of an entry is odd while it is being modified,
+// this lets get_fdinfo take a consistent snapshot without the lock.
+#define FD_BEGIN_UPDATE(fd) _InterlockedIncrement((volatile long *)&FD_ENTRY(fd)->version)
+#define FD_END_UPDATE(fd)   _InterlockedIncrement((volatile long *)&FD_ENTRY(fd)->version)
+
+static void internal_close_pio_handle(int index)
+{
+	HANDLE pio_handle = FD_ENTRY(index)->pio_handle;
+
+	FD_ENTRY(index)->pio_handle = NULL;
+
+	if (pio_handle != NULL && pio_handle != INVALID_HANDLE_VALUE)
+	{
+		NtClose(pio_handle);
+	}
+}
+
 static int internal_insert_fd(int index, HANDLE _h, handle_t _type, int _flags)
 {
-	_wlibc_fd_table[index].handle = _h;
-	_wlibc_fd_table[index].flags = _flags;
-	_wlibc_fd_table[index].type = _type;
-	_wlibc_fd_table[index].sequence = ++_wlibc_fd_sequence;
+	// Remove any stale entry from the index.
+	if (FD_ENTRY(index)->handle != NULL)
+	{
+		fd_hash_remove(FD_ENTRY(index)->handle, index);
+	}
+	else
+	{
+		fd_bitmap_mark_used(&_wlibc_fd_bitmap, index);
+	}
+
+	fd_hash_insert(_h, index);
+
+	// Set the handle last, lock free readers treat a non NULL handle as a valid entry.
+	FD_BEGIN_UPDATE(index);
+	internal_close_pio_handle(index);
+	FD_ENTRY(index)->flags = _flags;
+	FD_ENTRY(index)->type = _type;
+	FD_ENTRY(index)->sequence = ++_wlibc_fd_sequence;
+	FD_ENTRY(index)->handle = _h;
+	FD_END_UPDATE(index);
 
 	switch (index)
 	{
@@ -348,48 +763,40 @@ static int internal_insert_fd(int index, HANDLE _h, handle_t _type, int _flags)
 	return index;
 }
 
+static void internal_remove_fd(int index)
+{
+	fd_hash_remove(FD_ENTRY(index)->handle, index);
+	fd_bitmap_mark_free(&_wlibc_fd_bitmap, index);
+
+	FD_BEGIN_UPDATE(index);
+	internal_close_pio_handle(index);
+	FD_ENTRY(index)->handle = NULL;
+	FD_ENTRY(index)->type = INVALID_HANDLE;
+	FD_END_UPDATE(index);
+}
+
 static int register_to_fd_table_internal(HANDLE _h, handle_t _type, int _flags)
 {
-	bool is_there_free_space = false;
-	int index = -1;
-	int fd = -1;
-	for (size_t i = 0; i < _wlibc_fd_table_size; i++)
-	{
-		if (_wlibc_fd_table[i].handle == NULL)
-		{
-			is_there_free_space = true;
-			index = (int)i;
-			break;
-		}
-	}
+	int index;
 
-	if (is_there_free_space)
+	if (fd_hash_reserve() != 0)
 	{
-		fd = internal_insert_fd(index, _h, _type, _flags);
+		return -1;
 	}
 
-	else // double the table size
-	{
-		void *temp = (fdinfo *)RtlReAllocateHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_table, sizeof(fdinfo) * _wlibc_fd_table_size * 2);
-		if (temp == NULL)
-		{
-			errno = ENOMEM;
-			return -1;
-		}
-
-		_wlibc_fd_table = temp;
+	index = fd_bitmap_lowest_free(&_wlibc_fd_bitmap);
 
-		fd = internal_insert_fd((int)_wlibc_fd_table_size, _h, _type, _flags);
+	if (index == -1) // double the table size
+	{
+		index = (int)_wlibc_fd_table_size;
 
-		for (size_t i = _wlibc_fd_table_size + 1; i < _wlibc_fd_table_size * 2; i++)
+		if (grow_fd_table(_wlibc_fd_table_size * 2) != 0)
 		{
-			_wlibc_fd_table[i].handle = NULL;
+			return -1;
 		}
-
-		_wlibc_fd_table_size *= 2;
 	}
 
-	return fd;
+	return internal_insert_fd(index, _h, _type, _flags);
 }
 
 int register_to_fd_table(HANDLE _h, handle_t _type, int _flags)
@@ -402,26 +809,19 @@ int register_to_fd_table(HANDLE _h, handle_t _type, int _flags)
 
 static int insert_into_fd_table_internal(int _fd, HANDLE _h, handle_t _type, int _flags)
 {
+	if (fd_hash_reserve() != 0)
+	{
+		return -1;
+	}
+
 	// grow the table
 	if (_fd >= (int)_wlibc_fd_table_size)
 	{
-		void *temp = (fdinfo *)RtlReAllocateHeap(NtCurrentProcessHeap(), 0, _wlibc_fd_table,
-												 sizeof(fdinfo) * _fd * 2); // Allocate double the requested fd number
-
-		if (temp == NULL)
+		// Allocate double the requested fd number
+		if (grow_fd_table((size_t)_fd * 2) != 0)
 		{
-			errno = ENOMEM;
 			return -1;
 		}
-
-		_wlibc_fd_table = temp;
-
-		for (int i = (int)_wlibc_fd_table_size; i < _fd * 2; ++i)
-		{
-			_wlibc_fd_table[i].handle = NULL;
-		}
-
-		_wlibc_fd_table_size = _fd * 2;
 	}
 
 	internal_insert_fd(_fd, _h, _type, _flags);
@@ -439,14 +839,12 @@ int insert_into_fd_table(int _fd, HANDLE _h, handle_t _type, int _flags)
 
 static void unregister_from_fd_table_internal(HANDLE _h)
 {
-	for (size_t i = 0; i < _wlibc_fd_table_size; i++)
+	int fd = fd_hash_lookup(_h);
+
+	if (fd != -1)
 	{
-		if (_wlibc_fd_table[i].handle != INVALID_HANDLE_VALUE && _wlibc_fd_table[i].handle == _h)
-		{
-			// Calling this function after the handle has been closed
-			_wlibc_fd_table[i].handle = NULL;
-			break;
-		}
+		// Calling this function after the handle has been closed
+		internal_remove_fd(fd);
 	}
 }
 
@@ -459,16 +857,14 @@ void unregister_from_fd_table(HANDLE _h)
 
 static int get_fd_internal(HANDLE _h)
 {
-	for (size_t i = 0; i < _wlibc_fd_table_size; i++)
+	int fd = fd_hash_lookup(_h);
+
+	if (fd == -1)
 	{
-		if (_wlibc_fd_table[i].handle != INVALID_HANDLE_VALUE && _h == _wlibc_fd_table[i].handle)
-		{
-			return (int)i;
-		}
+		errno = EBADF;
 	}
 
-	errno = EBADF;
-	return -1;
+	return fd;
 }
 
 int get_fd(HANDLE _h)
@@ -481,15 +877,27 @@ int get_fd(HANDLE _h)
 
 static int close_fd_internal(int _fd)
 {
-	NTSTATUS status = NtClose(_wlibc_fd_table[_fd].handle);
+	NTSTATUS status;
+	fd_close_hook hook = _wlibc_fd_close_hooks[FD_ENTRY(_fd)->type];
+
+	if (hook != NULL)
+	{
+		hook(_fd, FD_ENTRY(_fd)->handle);
+	}
+
+	if (IS_OBJECT_HANDLE(FD_ENTRY(_fd)->type))
+	{
+		remove_fd_object(FD_ENTRY(_fd)->handle);
+	}
+
+	status = NtClose(FD_ENTRY(_fd)->handle);
 	if (status != STATUS_SUCCESS)
 	{
 		map_ntstatus_to_errno(status);
 		return -1;
 	}
 	// Closing the file descriptor. Mark the handle as invalid, so we can reuse the same fd again.
-	_wlibc_fd_table[_fd].handle = NULL;
-	_wlibc_fd_table[_fd].type = INVALID_HANDLE;
+	internal_remove_fd(_fd);
 	return 0;
 }
 
@@ -501,69 +909,158 @@ int close_fd(int _fd)
 	return status;
 }
 
+void register_fd_close_hook(handle_t _type, fd_close_hook _hook)
+{
+	EXCLUSIVE_LOCK_FD_TABLE();
+	_wlibc_fd_close_hooks[_type] = _hook;
+	EXCLUSIVE_UNLOCK_FD_TABLE();
+}
+
 ///////////////////////////////////////
 // Getters
 ///////////////////////////////////////
 static HANDLE get_fd_handle_internal(int _fd)
 {
-	return _wlibc_fd_table[_fd].handle;
+	return FD_ENTRY(_fd)->handle;
 }
 
+// The getters and validators below do not take the lock.
+// Pages are never moved or freed while the process is running (see grow_fd_table), so reading through a directory
+// that has just been replaced is safe. Each of them reads a single naturally aligned field.
 HANDLE get_fd_handle(int _fd)
 {
-	HANDLE handle;
-	SHARED_LOCK_FD_TABLE();
-	handle = get_fd_handle_internal(_fd);
-	SHARED_UNLOCK_FD_TABLE();
-	return handle;
+	return get_fd_handle_internal(_fd);
 }
 
 static int get_fd_flags_internal(int _fd)
 {
-	return _wlibc_fd_table[_fd].flags;
+	return FD_ENTRY(_fd)->flags;
 }
 
 int get_fd_flags(int _fd)
 {
-	int flags;
-	SHARED_LOCK_FD_TABLE();
-	flags = get_fd_flags_internal(_fd);
-	SHARED_UNLOCK_FD_TABLE();
-	return flags;
+	return get_fd_flags_internal(_fd);
 }
 
 static handle_t get_fd_type_internal(int _fd)
 {
 	if (validate_fd_internal(_fd))
-		return _wlibc_fd_table[_fd].type;
+		return FD_ENTRY(_fd)->type;
 	else
 		return INVALID_HANDLE;
 }
 
 handle_t get_fd_type(int _fd)
 {
-	handle_t type;
-	SHARED_LOCK_FD_TABLE();
-	type = get_fd_type_internal(_fd);
-	SHARED_UNLOCK_FD_TABLE();
-	return type;
+	return get_fd_type_internal(_fd);
 }
 
 void get_fdinfo(int fd, fdinfo *info)
 {
-	SHARED_LOCK_FD_TABLE();
+	fdinfo *entry;
+	unsigned int version;
 
-	if (validate_fd_internal(fd))
+	if (!validate_fd_internal(fd))
 	{
-		memcpy(info, &_wlibc_fd_table[fd], sizeof(fdinfo));
+		info->handle = NULL;
+		info->type = INVALID_HANDLE;
+		return;
 	}
-	else
+
+	entry = FD_ENTRY(fd);
+
+	// Copy the entry without the lock, retry if a writer modified it while we were copying.
+	while (1)
+	{
+		version = *(volatile unsigned int *)&entry->version;
+
+		if (version & 1)
+		{
+			_mm_pause();
+			continue;
+		}
+
+		_ReadWriteBarrier();
+		memcpy(info, entry, sizeof(fdinfo));
+		_ReadWriteBarrier();
+
+		if (*(volatile unsigned int *)&entry->version == version)
+		{
+			break;
+		}
+	}
+
+	// The fd was closed in between.
+	if (info->handle == NULL)
 	{
-		info->handle = NULL;
 		info->type = INVALID_HANDLE;
 	}
+}
+
+HANDLE get_fd_pio_handle(int fd, const fdinfo *info)
+{
+	NTSTATUS status;
+	OBJECT_BASIC_INFORMATION object_info;
+	ACCESS_MASK access;
+	ULONG options = FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE;
+	HANDLE handle = info->pio_handle;
+	HANDLE existing = NULL;
+	bool installed = false;
+	int old_errno = errno;
+
+	if (handle != NULL)
+	{
+		return handle != INVALID_HANDLE_VALUE ? handle : NULL;
+	}
+
+	// Give the new handle the same data access as the fd, nothing more.
+	status = NtQueryObject(info->handle, ObjectBasicInformation, &object_info, sizeof(OBJECT_BASIC_INFORMATION), NULL);
+	if (status == STATUS_SUCCESS)
+	{
+		access = object_info.GrantedAccess & (FILE_READ_DATA | FILE_WRITE_DATA);
+		if (access != 0)
+		{
+			if (info->flags & O_DIRECT)
+			{
+				options |= FILE_NO_INTERMEDIATE_BUFFERING;
+			}
+			if (info->flags & O_SYNC)
+			{
+				options |= FILE_WRITE_THROUGH;
+			}
+
+			handle = just_reopen(info->handle, access | SYNCHRONIZE, options);
+		}
+	}
 
+	// Remember the failure (the file might have been deleted), so that we don't try again.
+	if (handle == NULL)
+	{
+		handle = INVALID_HANDLE_VALUE;
+		errno = old_errno;
+	}
+
+	// The fd might have been closed or even reused while the file was being reopened.
+	SHARED_LOCK_FD_TABLE();
+	if (validate_fd_internal(fd) && FD_GET_SEQUENCE(fd) == info->sequence)
+	{
+		existing = InterlockedCompareExchangePointer(&FD_ENTRY(fd)->pio_handle, handle, NULL);
+		installed = (existing == NULL);
+	}
 	SHARED_UNLOCK_FD_TABLE();
+
+	// Lost the race to another thread, or the fd is gone.
+	if (!installed)
+	{
+		if (handle != INVALID_HANDLE_VALUE)
+		{
+			NtClose(handle);
+		}
+
+		handle = existing;
+	}
+
+	return handle != INVALID_HANDLE_VALUE ? handle : NULL;
 }
 
 ///////////////////////////////////////
@@ -571,7 +1068,32 @@ void get_fdinfo(int fd, fdinfo *info)
 ///////////////////////////////////////
 static void set_fd_handle_internal(int _fd, HANDLE _handle)
 {
-	_wlibc_fd_table[_fd].handle = _handle;
+	HANDLE old_handle = FD_ENTRY(_fd)->handle;
+
+	if (old_handle != NULL)
+	{
+		fd_hash_remove(old_handle, _fd);
+
+		if (_handle == NULL)
+		{
+			fd_bitmap_mark_free(&_wlibc_fd_bitmap, _fd);
+		}
+	}
+	else if (_handle != NULL)
+	{
+		fd_bitmap_mark_used(&_wlibc_fd_bitmap, _fd);
+	}
+
+	// If the index can't grow here get_fd will not find this fd, the table itself stays consistent.
+	if (_handle != NULL && fd_hash_reserve() == 0)
+	{
+		fd_hash_insert(_handle, _fd);
+	}
+
+	FD_BEGIN_UPDATE(_fd);
+	internal_close_pio_handle(_fd);
+	FD_ENTRY(_fd)->handle = _handle;
+	FD_END_UPDATE(_fd);
 }
 
 void set_fd_handle(int _fd, HANDLE _handle)
@@ -583,7 +1105,9 @@ void set_fd_handle(int _fd, HANDLE _handle)
 
 static void set_fd_flags_internal(int _fd, int _flags)
 {
-	_wlibc_fd_table[_fd].flags = _flags;
+	FD_BEGIN_UPDATE(_fd);
+	FD_ENTRY(_fd)->flags = _flags;
+	FD_END_UPDATE(_fd);
 }
 
 void set_fd_flags(int _fd, int _flags)
@@ -595,7 +1119,9 @@ void set_fd_flags(int _fd, int _flags)
 
 static void set_fd_type_internal(int _fd, handle_t _type)
 {
-	_wlibc_fd_table[_fd].type = _type;
+	FD_BEGIN_UPDATE(_fd);
+	FD_ENTRY(_fd)->type = _type;
+	FD_END_UPDATE(_fd);
 }
 
 void set_fd_type(int _fd, handle_t _type)
@@ -607,7 +1133,9 @@ void set_fd_type(int _fd, handle_t _type)
 
 static void add_fd_flags_internal(int _fd, int _flags)
 {
-	_wlibc_fd_table[_fd].flags |= _flags;
+	FD_BEGIN_UPDATE(_fd);
+	FD_ENTRY(_fd)->flags |= _flags;
+	FD_END_UPDATE(_fd);
 }
 
 void add_fd_flags(int _fd, int _flags)
@@ -622,18 +1150,15 @@ void add_fd_flags(int _fd, int _flags)
 ///////////////////////////////////////
 static bool validate_fd_internal(int _fd)
 {
+	// Read the size before the directory, see grow_fd_table.
 	if (_fd < 0 || _fd >= (int)_wlibc_fd_table_size)
 		return false;
-	if (_wlibc_fd_table[_fd].handle == NULL)
+	if (FD_ENTRY(_fd)->handle == NULL)
 		return false;
 	return true;
 }
 
 bool validate_fd(int _fd)
 {
-	bool condition = false;
-	SHARED_LOCK_FD_TABLE();
-	condition = validate_fd_internal(_fd);
-	SHARED_UNLOCK_FD_TABLE();
-	return condition;
+	return validate_fd_internal(_fd);
 }
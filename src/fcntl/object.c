@@ -0,0 +1,253 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <errno.h>
+#include <fcntl.h>
+
+// HANDLE -> object. Every fd (including duplicates) has its own handle, each of them is an alias holding a reference to the object.
+#define FD_OBJECT_BUCKETS 256
+#define FD_OBJECT_BUCKET(handle) ((((ULONG_PTR)(handle)) >> 2) & (FD_OBJECT_BUCKETS - 1))
+
+typedef struct _fd_object_alias
+{
+	struct _fd_object_alias *next;
+	HANDLE handle;
+	fd_object *object;
+} fd_object_alias;
+
+static fd_object_alias *_wlibc_fd_object_aliases[FD_OBJECT_BUCKETS];
+static RTL_SRWLOCK _wlibc_fd_object_lock = RTL_SRWLOCK_INIT;
+
+static int insert_fd_object_alias(HANDLE handle, fd_object *object)
+{
+	fd_object_alias *alias;
+
+	alias = (fd_object_alias *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(fd_object_alias));
+	if (alias == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	_InterlockedIncrement(&object->references);
+
+	alias->handle = handle;
+	alias->object = object;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_fd_object_lock);
+	alias->next = _wlibc_fd_object_aliases[FD_OBJECT_BUCKET(handle)];
+	_wlibc_fd_object_aliases[FD_OBJECT_BUCKET(handle)] = alias;
+	RtlReleaseSRWLockExclusive(&_wlibc_fd_object_lock);
+
+	return 0;
+}
+
+void release_fd_object(fd_object *object)
+{
+	if (_InterlockedDecrement(&object->references) != 0)
+	{
+		return;
+	}
+
+	if (object->destroy != NULL)
+	{
+		object->destroy(object);
+	}
+
+	if (object->handle != NULL)
+	{
+		NtClose(object->handle);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, object);
+}
+
+int register_fd_object(fd_object *object, HANDLE handle, handle_t type, int flags)
+{
+	NTSTATUS status;
+	int fd;
+
+	RtlInitializeSRWLock(&object->lock);
+	object->references = 1;
+	object->handle = NULL;
+
+	// Keep our own handle to the waitable object, blocked readers use it even if the fd is closed underneath them.
+	status = NtDuplicateObject(NtCurrentProcess(), handle, NtCurrentProcess(), &object->handle, 0, 0, DUPLICATE_SAME_ACCESS);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	if (insert_fd_object_alias(handle, object) != 0)
+	{
+		goto fail;
+	}
+
+	fd = register_to_fd_table(handle, type, flags);
+	if (fd == -1)
+	{
+		remove_fd_object(handle);
+		goto fail;
+	}
+
+	release_fd_object(object);
+
+	return fd;
+
+fail:
+	NtClose(handle);
+	release_fd_object(object);
+	return -1;
+}
+
+static fd_object *lookup_fd_object(HANDLE handle)
+{
+	fd_object_alias *alias;
+	fd_object *object = NULL;
+
+	RtlAcquireSRWLockShared(&_wlibc_fd_object_lock);
+
+	for (alias = _wlibc_fd_object_aliases[FD_OBJECT_BUCKET(handle)]; alias != NULL; alias = alias->next)
+	{
+		if (alias->handle == handle)
+		{
+			object = alias->object;
+			_InterlockedIncrement(&object->references);
+			break;
+		}
+	}
+
+	RtlReleaseSRWLockShared(&_wlibc_fd_object_lock);
+
+	return object;
+}
+
+fd_object *acquire_fd_object(int fd, handle_t type)
+{
+	fdinfo info;
+	fd_object *object;
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == INVALID_HANDLE)
+	{
+		errno = EBADF;
+		return NULL;
+	}
+
+	if (info.type != type)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	object = lookup_fd_object(info.handle);
+	if (object == NULL)
+	{
+		// The fd was closed after we took its snapshot.
+		errno = EBADF;
+	}
+
+	return object;
+}
+
+int dup_fd_object(HANDLE source, HANDLE target)
+{
+	int result;
+	fd_object *object;
+
+	object = lookup_fd_object(source);
+	if (object == NULL)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	result = insert_fd_object_alias(target, object);
+	release_fd_object(object);
+
+	return result;
+}
+
+void remove_fd_object(HANDLE handle)
+{
+	fd_object_alias *alias, *prev = NULL;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_fd_object_lock);
+
+	for (alias = _wlibc_fd_object_aliases[FD_OBJECT_BUCKET(handle)]; alias != NULL; prev = alias, alias = alias->next)
+	{
+		if (alias->handle == handle)
+		{
+			if (prev == NULL)
+			{
+				_wlibc_fd_object_aliases[FD_OBJECT_BUCKET(handle)] = alias->next;
+			}
+			else
+			{
+				prev->next = alias->next;
+			}
+
+			break;
+		}
+	}
+
+	RtlReleaseSRWLockExclusive(&_wlibc_fd_object_lock);
+
+	if (alias != NULL)
+	{
+		release_fd_object(alias->object);
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, alias);
+	}
+}
+
+ssize_t common_object_read(const fdinfo *info, void *buffer, size_t count)
+{
+	ssize_t result;
+	fd_object *object;
+
+	object = lookup_fd_object(info->handle);
+	if (object == NULL)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	result = object->read(object, buffer, count, info->flags);
+	release_fd_object(object);
+
+	return result;
+}
+
+ssize_t common_object_write(const fdinfo *info, const void *buffer, size_t count)
+{
+	ssize_t result;
+	fd_object *object;
+
+	object = lookup_fd_object(info->handle);
+	if (object == NULL)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	if (object->write == NULL)
+	{
+		release_fd_object(object);
+		errno = EINVAL;
+		return -1;
+	}
+
+	result = object->write(object, buffer, count, info->flags);
+	release_fd_object(object);
+
+	return result;
+}
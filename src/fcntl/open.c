@@ -38,6 +38,8 @@ static ACCESS_MASK determine_access_rights(int oflags)
 
 	if (oflags & O_APPEND)
 	{
+		// Keep FILE_WRITE_DATA, byte range locks and F_SETFL need it. Writes are made atomic appends with
+		// FILE_WRITE_TO_END_OF_FILE instead (see common_write).
 		access_rights |= FILE_APPEND_DATA;
 	}
 	if (oflags & O_DIRECTORY)
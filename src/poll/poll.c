@@ -7,166 +7,358 @@
 
 #include <internal/nt.h>
 #include <internal/fcntl.h>
+#include <internal/poll.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
-#include <intrin.h>
 
-int do_poll(const fdinfo *pinfo, struct pollfd *fds, nfds_t nfds, const struct timespec *timeout)
+int common_poll_check(const fdinfo *pinfo, struct pollfd *pfd)
 {
-	LARGE_INTEGER duetime = {0}, current = {0};
-	int result = 0;
+	pfd->revents = 0;
 
-	if (timeout != NULL)
+	switch (pinfo->type)
 	{
-		GetSystemTimeAsFileTime((LPFILETIME)&current);
-		duetime.QuadPart = current.QuadPart + timeout->tv_sec * 10000000 + timeout->tv_nsec / 100;
+	case INVALID_HANDLE:
+	{
+		// Don't set errno to EBADF in this case.
+		pfd->revents = POLLNVAL;
+		break;
 	}
 
-	while (1)
+	case CONSOLE_HANDLE:
 	{
-		for (nfds_t i = 0; i < nfds; ++i)
+		BOOL status;
+		DWORD events_read = 0;
+		INPUT_RECORD record[4];
+
+		status = PeekConsoleInputW(pinfo->handle, record, 4, &events_read);
+		if (status == 0)
+		{
+			pfd->revents = POLLNVAL;
+			break;
+		}
+
+		if (pinfo->flags & O_RDWR)
 		{
-			switch (pinfo[i].type)
+			pfd->revents = pfd->events & (POLLOUT | POLLWRNORM);
+			if (events_read > 0)
 			{
-			case INVALID_HANDLE:
+				pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+			}
+		}
+		else if (pinfo->flags & O_WRONLY)
+		{
+			pfd->revents = pfd->events & (POLLOUT | POLLWRNORM);
+		}
+		else // pinfo->flags == O_RDONLY
+		{
+			if (events_read > 0)
 			{
-				// Don't set errno to EBADF in this case.
-				fds[i].revents = POLLNVAL;
-				break;
+				pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
 			}
+		}
+		break;
+	}
 
-			case CONSOLE_HANDLE:
-			{
-				BOOL status;
-				DWORD events_read = 0;
-				INPUT_RECORD record[4];
+	case NULL_HANDLE:
+	case FILE_HANDLE:
+	case DIRECTORY_HANDLE:
+	{
+		// Don't worry if there is data or not.
+		if (pinfo->flags & O_RDWR)
+		{
+			pfd->revents = pfd->events & (POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM);
+		}
+		else if (pinfo->flags & O_WRONLY)
+		{
+			pfd->revents = pfd->events & (POLLOUT | POLLWRNORM);
+		}
+		else // pinfo->flags == O_RDONLY
+		{
+			pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+		}
+		break;
+	}
 
-				status = PeekConsoleInputW(pinfo[i].handle, record, 4, &events_read);
-				if (status == 0)
-				{
-					fds[i].revents = POLLNVAL;
-					break;
-				}
+	case PIPE_HANDLE:
+	{
+		NTSTATUS status;
+		IO_STATUS_BLOCK io;
+		FILE_PIPE_LOCAL_INFORMATION pipe_info;
 
-				if (pinfo[i].flags & O_RDWR)
-				{
-					fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
-					if (events_read > 0)
-					{
-						fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
-					}
-				}
-				else if (pinfo[i].flags & O_WRONLY)
-				{
-					fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
-				}
-				else // pinfo[i].flags == O_RDONLY
-				{
-					if (events_read > 0)
-					{
-						fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
-					}
-				}
-				break;
-			}
+		status = NtQueryInformationFile(pinfo->handle, &io, &pipe_info, sizeof(FILE_PIPE_LOCAL_INFORMATION), FilePipeLocalInformation);
+		if (status != STATUS_SUCCESS)
+		{
+			pfd->revents = POLLNVAL;
+			break;
+		}
 
-			case NULL_HANDLE:
-			case FILE_HANDLE:
-			case DIRECTORY_HANDLE:
+		if (pinfo->flags & O_RDWR)
+		{
+			if (pipe_info.WriteQuotaAvailable > 0)
 			{
-				// Don't worry if there is data or not.
-				if (pinfo[i].flags & O_RDWR)
-				{
-					fds[i].revents = fds[i].events & (POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM);
-				}
-				else if (pinfo[i].flags & O_WRONLY)
-				{
-					fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
-				}
-				else // pinfo[i].flags == O_RDONLY
-				{
-					fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
-				}
-				break;
+				pfd->revents = pfd->events & (POLLOUT | POLLWRNORM);
 			}
-
-			case PIPE_HANDLE:
+			if (pipe_info.ReadDataAvailable > 0)
+			{
+				pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+			}
+		}
+		else if (pinfo->flags & O_WRONLY)
+		{
+			if (pipe_info.WriteQuotaAvailable > 0)
+			{
+				pfd->revents = pfd->events & (POLLOUT | POLLWRNORM);
+			}
+			// Polling a write end of a pipe where the read end is closed.
+			if (pipe_info.NamedPipeState == FILE_PIPE_DISCONNECTED_STATE || pipe_info.NamedPipeState == FILE_PIPE_CLOSING_STATE)
+			{
+				pfd->revents |= POLLERR;
+			}
+		}
+		else // pinfo->flags == O_RDONLY
+		{
+			if (pipe_info.ReadDataAvailable > 0)
+			{
+				pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+			}
+			// Polling a read end of a pipe where the write end is closed.
+			if (pipe_info.NamedPipeState == FILE_PIPE_DISCONNECTED_STATE || pipe_info.NamedPipeState == FILE_PIPE_CLOSING_STATE)
 			{
-				NTSTATUS status;
-				IO_STATUS_BLOCK io;
-				FILE_PIPE_LOCAL_INFORMATION pipe_info;
+				pfd->revents |= POLLHUP;
+			}
+		}
+
+		break;
+	}
+
+	case EPOLL_HANDLE:
+	{
+		// The event of an epoll instance is signaled when it might have events to report.
+		LARGE_INTEGER zero = {0};
+
+		if (NtWaitForSingleObject(pinfo->handle, FALSE, &zero) == STATUS_SUCCESS)
+		{
+			pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+		}
+		break;
+	}
 
-				status =
-					NtQueryInformationFile(pinfo[i].handle, &io, &pipe_info, sizeof(FILE_PIPE_LOCAL_INFORMATION), FilePipeLocalInformation);
-				if (status != STATUS_SUCCESS)
+	case EVENTFD_HANDLE:
+	case TIMERFD_HANDLE:
+	case SIGNALFD_HANDLE:
+	{
+		// The handle of these fds is signaled while they are readable.
+		LARGE_INTEGER zero = {0};
+
+		if (NtWaitForSingleObject(pinfo->handle, FALSE, &zero) == STATUS_SUCCESS)
+		{
+			pfd->revents = pfd->events & (POLLIN | POLLRDNORM);
+		}
+
+		// Writes to an eventfd only block when the counter is about to overflow, treat it as always writable.
+		if (pinfo->type == EVENTFD_HANDLE)
+		{
+			pfd->revents |= pfd->events & (POLLOUT | POLLWRNORM);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	return pfd->revents != 0;
+}
+
+static void poll_notify(void *context)
+{
+	NtSetEvent((HANDLE)context, NULL);
+}
+
+// Sleep till one of the fds might have become ready or the timeout expires.
+static void wait_for_events(const fdinfo *pinfo, struct pollfd *fds, nfds_t nfds, LARGE_INTEGER *timeout)
+{
+	NTSTATUS status;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	HANDLE event = NULL;
+	pipe_watcher *watchers = NULL;
+	ULONG handle_count = 0;
+	nfds_t watcher_count = 0;
+	int recheck = 0;
+	int ready = 0;
+	struct pollfd pfd;
+	LARGE_INTEGER interval;
+
+	for (nfds_t i = 0; i < nfds; ++i)
+	{
+		int read_interest = (fds[i].events & (POLLIN | POLLRDNORM)) && (pinfo[i].flags & O_WRONLY) == 0;
+
+		switch (pinfo[i].type)
+		{
+		case CONSOLE_HANDLE:
+		case EPOLL_HANDLE:
+		case EVENTFD_HANDLE:
+		case TIMERFD_HANDLE:
+		case SIGNALFD_HANDLE:
+			if (read_interest)
+			{
+				// Leave room for the event of the pipe watchers.
+				if (handle_count == MAXIMUM_WAIT_OBJECTS - 1)
 				{
-					fds[i].revents = POLLNVAL;
+					recheck = 1;
 					break;
 				}
 
-				if (pinfo[i].flags & O_RDWR)
+				// Console input handles are signaled when there are input records, epoll instances when they have events
+				// and eventfd, timerfd and signalfd handles when they are readable.
+				handles[handle_count++] = pinfo[i].handle;
+			}
+			break;
+
+		case PIPE_HANDLE:
+			if (read_interest)
+			{
+				if (watchers == NULL)
 				{
-					if (pipe_info.WriteQuotaAvailable > 0)
+					watchers = (pipe_watcher *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(pipe_watcher) * nfds);
+					if (watchers == NULL)
 					{
-						fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
-					}
-					if (pipe_info.ReadDataAvailable > 0)
-					{
-						fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
+						recheck = 1;
+						break;
 					}
 				}
-				else if (pinfo[i].flags & O_WRONLY)
+
+				// All the pipes share one event.
+				if (event == NULL)
 				{
-					if (pipe_info.WriteQuotaAvailable > 0)
+					status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+					if (status != STATUS_SUCCESS)
 					{
-						fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
-					}
-					// Polling a write end of a pipe where the read end is closed.
-					if (pipe_info.NamedPipeState == FILE_PIPE_DISCONNECTED_STATE || pipe_info.NamedPipeState == FILE_PIPE_CLOSING_STATE)
-					{
-						fds[i].revents |= POLLERR;
+						event = NULL;
+						recheck = 1;
+						break;
 					}
 				}
-				else // pinfo[i].flags == O_RDONLY
+
+				watchers[watcher_count].notify = poll_notify;
+				watchers[watcher_count].context = event;
+
+				if (start_pipe_watcher(&watchers[watcher_count], pinfo[i].handle) == 0)
 				{
-					if (pipe_info.ReadDataAvailable > 0)
-					{
-						fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
-					}
-					// Polling a read end of a pipe where the write end is closed.
-					if (pipe_info.NamedPipeState == FILE_PIPE_DISCONNECTED_STATE || pipe_info.NamedPipeState == FILE_PIPE_CLOSING_STATE)
-					{
-						fds[i].revents |= POLLHUP;
-					}
-				}
+					++watcher_count;
 
-				break;
-			}
+					// Input that arrived before the watcher was started is not notified.
+					pfd = fds[i];
+					ready |= common_poll_check(&pinfo[i], &pfd);
+					break;
+				}
 			}
 
-			if (fds[i].revents != 0)
-			{
-				++result;
-			}
+			// Write readiness and errors of the write end can only be polled.
+			recheck = 1;
+			break;
+
+		default:
+			// Everything else is always ready or invalid.
+			break;
 		}
+	}
+
+	if (ready)
+	{
+		goto finish;
+	}
 
-		if (result == 0)
+	if (event != NULL)
+	{
+		handles[handle_count++] = event;
+	}
+
+	if (recheck)
+	{
+		// Wait for the shorter of the recheck interval and the timeout.
+		interval.QuadPart = -POLL_RECHECK_INTERVAL;
+		if (timeout != NULL && timeout->QuadPart > interval.QuadPart)
 		{
-			if (timeout != NULL)
-			{
-				GetSystemTimeAsFileTime((LPFILETIME)&current);
-			}
+			interval = *timeout;
+		}
+
+		timeout = &interval;
+	}
+
+	if (handle_count == 0)
+	{
+		if (timeout == NULL)
+		{
+			// Nothing to wait on, wait forever.
+			interval.QuadPart = MINLONGLONG;
+			timeout = &interval;
+		}
+
+		NtDelayExecution(FALSE, timeout);
+	}
+	else
+	{
+		NtWaitForMultipleObjects(handle_count, handles, WaitAny, FALSE, timeout);
+	}
+
+finish:
+	for (nfds_t i = 0; i < watcher_count; ++i)
+	{
+		stop_pipe_watcher(&watchers[i]);
+	}
+
+	if (watchers != NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, watchers);
+	}
+
+	if (event != NULL)
+	{
+		NtClose(event);
+	}
+}
+
+int do_poll(const fdinfo *pinfo, struct pollfd *fds, nfds_t nfds, const struct timespec *timeout)
+{
+	LARGE_INTEGER duetime = {0}, current = {0}, remaining;
+	int result;
+
+	if (timeout != NULL)
+	{
+		GetSystemTimeAsFileTime((LPFILETIME)&current);
+		duetime.QuadPart = current.QuadPart + timeout->tv_sec * 10000000 + timeout->tv_nsec / 100;
+	}
+
+	while (1)
+	{
+		result = 0;
 
-			if (current.QuadPart <= duetime.QuadPart)
+		for (nfds_t i = 0; i < nfds; ++i)
+		{
+			result += common_poll_check(&pinfo[i], &fds[i]);
+		}
+
+		if (result != 0)
+		{
+			break;
+		}
+
+		if (timeout != NULL)
+		{
+			GetSystemTimeAsFileTime((LPFILETIME)&current);
+
+			if (current.QuadPart >= duetime.QuadPart)
 			{
-				// Retry again.
-				_mm_pause();
-				continue;
+				break;
 			}
+
+			// Relative timeout.
+			remaining.QuadPart = current.QuadPart - duetime.QuadPart;
 		}
 
-		break;
+		wait_for_events(pinfo, fds, nfds, timeout == NULL ? NULL : &remaining);
 	}
 
 	return result;
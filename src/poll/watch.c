@@ -0,0 +1,200 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/poll.h>
+#include <errno.h>
+
+typedef struct _pipe_watch
+{
+	struct _pipe_watch *next;
+	HANDLE pipe;  // Our own handle to the pipe end, so that the event can be removed even if the fd is closed.
+	HANDLE event; // Assigned to the pipe end.
+	HANDLE wait;  // Thread pool wait on the event.
+	pipe_watcher *watchers;
+} pipe_watch;
+
+// Guards the list of watches and their watchers. The thread pool callbacks hold it shared.
+static RTL_SRWLOCK _wlibc_pipe_watch_lock = RTL_SRWLOCK_INIT;
+static pipe_watch *_wlibc_pipe_watches = NULL;
+
+static VOID CALLBACK pipe_watch_callback(PVOID context, BOOLEAN timeout)
+{
+	pipe_watch *watch = (pipe_watch *)context;
+
+	UNREFERENCED_PARAMETER(timeout);
+
+	RtlAcquireSRWLockShared(&_wlibc_pipe_watch_lock);
+
+	for (pipe_watcher *watcher = watch->watchers; watcher != NULL; watcher = watcher->next)
+	{
+		watcher->notify(watcher->context);
+	}
+
+	RtlReleaseSRWLockShared(&_wlibc_pipe_watch_lock);
+}
+
+static NTSTATUS assign_pipe_event(HANDLE pipe, HANDLE event)
+{
+	IO_STATUS_BLOCK io;
+	FILE_PIPE_ASSIGN_EVENT_BUFFER buffer;
+
+	buffer.EventHandle = event;
+	buffer.KeyValue = 0;
+
+	return NtFsControlFile(pipe, NULL, NULL, NULL, &io, FSCTL_PIPE_ASSIGN_EVENT, &buffer, sizeof(FILE_PIPE_ASSIGN_EVENT_BUFFER), NULL, 0);
+}
+
+// Free a watch that has been removed from the list. Call this without holding the lock, the callback might be waiting on it.
+static void free_pipe_watch(pipe_watch *watch)
+{
+	if (watch->wait != NULL)
+	{
+		UnregisterWaitEx(watch->wait, INVALID_HANDLE_VALUE);
+	}
+
+	if (watch->event != NULL)
+	{
+		NtClose(watch->event);
+	}
+
+	if (watch->pipe != NULL)
+	{
+		NtClose(watch->pipe);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, watch);
+}
+
+// Create a watch for the pipe end. The lock should be held exclusively, so that no other watch is assigned to the pipe meanwhile.
+static pipe_watch *create_pipe_watch(HANDLE pipe)
+{
+	NTSTATUS status;
+	pipe_watch *watch;
+
+	watch = (pipe_watch *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(pipe_watch));
+	if (watch == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	status = NtDuplicateObject(NtCurrentProcess(), pipe, NtCurrentProcess(), &watch->pipe, 0, 0, DUPLICATE_SAME_ACCESS);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	// Each signal runs the callback once.
+	status = NtCreateEvent(&watch->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	if (!RegisterWaitForSingleObject(&watch->wait, watch->event, pipe_watch_callback, watch, INFINITE, WT_EXECUTEDEFAULT))
+	{
+		watch->wait = NULL;
+		map_doserror_to_errno(GetLastError());
+		goto fail;
+	}
+
+	status = assign_pipe_event(watch->pipe, watch->event);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	return watch;
+
+fail:
+	// The event was never assigned, no callback can be running.
+	free_pipe_watch(watch);
+	return NULL;
+}
+
+int start_pipe_watcher(pipe_watcher *watcher, HANDLE pipe)
+{
+	pipe_watch *watch;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_pipe_watch_lock);
+
+	// Duplicates of the fd have handles of their own to the same pipe end.
+	for (watch = _wlibc_pipe_watches; watch != NULL; watch = watch->next)
+	{
+		if (NtCompareObjects(watch->pipe, pipe) == STATUS_SUCCESS)
+		{
+			break;
+		}
+	}
+
+	if (watch == NULL)
+	{
+		watch = create_pipe_watch(pipe);
+		if (watch == NULL)
+		{
+			RtlReleaseSRWLockExclusive(&_wlibc_pipe_watch_lock);
+			return -1;
+		}
+
+		watch->next = _wlibc_pipe_watches;
+		_wlibc_pipe_watches = watch;
+	}
+
+	watcher->watch = watch;
+	watcher->next = watch->watchers;
+	watch->watchers = watcher;
+
+	RtlReleaseSRWLockExclusive(&_wlibc_pipe_watch_lock);
+
+	return 0;
+}
+
+void stop_pipe_watcher(pipe_watcher *watcher)
+{
+	pipe_watch *watch = watcher->watch;
+	pipe_watch **link;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_pipe_watch_lock);
+
+	for (pipe_watcher **next = &watch->watchers; *next != NULL; next = &(*next)->next)
+	{
+		if (*next == watcher)
+		{
+			*next = watcher->next;
+			break;
+		}
+	}
+
+	watcher->watch = NULL;
+
+	if (watch->watchers != NULL)
+	{
+		RtlReleaseSRWLockExclusive(&_wlibc_pipe_watch_lock);
+		return;
+	}
+
+	// The last watcher. Remove the event from the pipe before letting go of the lock, a new watch of the pipe can be assigned
+	// its own event right after.
+	assign_pipe_event(watch->pipe, NULL);
+
+	link = &_wlibc_pipe_watches;
+	while (*link != watch)
+	{
+		link = &(*link)->next;
+	}
+
+	*link = watch->next;
+
+	RtlReleaseSRWLockExclusive(&_wlibc_pipe_watch_lock);
+
+	free_pipe_watch(watch);
+}
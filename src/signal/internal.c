@@ -9,7 +9,70 @@
 #include <thread.h>
 
 RTL_SRWLOCK _wlibc_signal_srw;
-siginfo _wlibc_signal_table[NSIG];
+sigentry _wlibc_signal_table[NSIG];
+signal_queue_hook _wlibc_signal_queue_hook = NULL;
+
+/*
+ The console handler routines are executed by a thread created by the system. In a static build we have no way of
+ initializing the TLS structure of that thread, so the handlers are run by a thread of our own instead. It is started
+ when a handler is first installed for SIGINT or SIGBREAK and waits for console signals from then on.
+*/
+static RTL_RUN_ONCE console_once = RTL_RUN_ONCE_INIT;
+static HANDLE console_event = NULL;
+static volatile LONG console_pending = 0;
+static volatile LONG console_ready = 0;
+
+static void *console_dispatcher(void *arg)
+{
+	LONG pending;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	while (1)
+	{
+		NtWaitForSingleObject(console_event, FALSE, NULL);
+
+		pending = InterlockedExchange(&console_pending, 0);
+
+		for (int sig = 1; sig < NSIG; ++sig)
+		{
+			if (pending & (1u << sig))
+			{
+				wlibc_raise(sig);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static BOOL NTAPI initialize_console_dispatcher(PRTL_RUN_ONCE once, PVOID parameter, PVOID *context)
+{
+	NTSTATUS status;
+	thread_t thread;
+
+	UNREFERENCED_PARAMETER(once);
+	UNREFERENCED_PARAMETER(parameter);
+	UNREFERENCED_PARAMETER(context);
+
+	status = NtCreateEvent(&console_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+	if (status != STATUS_SUCCESS)
+	{
+		return FALSE;
+	}
+
+	if (wlibc_thread_create(&thread, NULL, console_dispatcher, NULL) != 0)
+	{
+		NtClose(console_event);
+		console_event = NULL;
+		return FALSE;
+	}
+
+	wlibc_thread_detach(thread);
+	WriteRelease(&console_ready, 1);
+
+	return TRUE;
+}
 
 static void console_raise(int sig)
 {
@@ -23,16 +86,26 @@ static void console_raise(int sig)
 		return;
 	}
 
+	// A signalfd waiting for the signal takes it instead of its disposition.
+	if (_wlibc_signal_queue_hook != NULL && _wlibc_signal_queue_hook(sig))
+	{
+		return;
+	}
+
 	if (sinfo.action == SIG_DFL)
 	{
 		NtTerminateProcess(NtCurrentProcess(), 128 + sig);
 		return;
 	}
 
-	// The console handler routines are executed by a separate thread.
-	// In a static build we have no way of intializng the threads TLS structure.
-	// If the user has given a specific funtions for these signals, create a thread and execute them.
-	// This way we can initialize the thread's TLS structure appropriately.
+	if (ReadAcquire(&console_ready))
+	{
+		InterlockedOr(&console_pending, (LONG)(1u << sig));
+		NtSetEvent(console_event, NULL);
+		return;
+	}
+
+	// The dispatcher could not be started, run the handler in a thread of its own.
 	if (wlibc_thread_create(&thread, NULL, (thread_start_t)sinfo.action, (void *)(intptr_t)sig) == 0)
 	{
 		wlibc_thread_join(thread, NULL);
@@ -55,10 +128,31 @@ static BOOL console_handler(DWORD ctrl)
 	return FALSE;
 }
 
+void raise_process_signal(int sig)
+{
+	siginfo sinfo;
+
+	get_siginfo(sig, &sinfo);
+
+	// Ignored signals are discarded, they don't reach a signalfd either.
+	if (sinfo.action == SIG_IGN)
+	{
+		return;
+	}
+
+	// The mask of the raising thread blocks nothing, a signalfd should see the signal before the disposition runs.
+	if (_wlibc_signal_queue_hook != NULL && _wlibc_signal_queue_hook(sig))
+	{
+		return;
+	}
+
+	wlibc_raise(sig);
+}
+
 void signal_init(void)
 {
 	RtlInitializeSRWLock(&_wlibc_signal_srw);
-	memset(_wlibc_signal_table, 0, NSIG * sizeof(siginfo));
+	memset(_wlibc_signal_table, 0, NSIG * sizeof(sigentry));
 
 	// Initialize the console control signal handler.
 	SetConsoleCtrlHandler(console_handler, TRUE);
@@ -71,14 +165,63 @@ void signal_cleanup(void)
 
 void get_siginfo(int sig, siginfo *sinfo)
 {
-	SHARED_LOCK_SIGNAL_TABLE();
-	memcpy(sinfo, &_wlibc_signal_table[sig], sizeof(siginfo));
-	SHARED_UNLOCK_SIGNAL_TABLE();
+	sigentry *entry = &_wlibc_signal_table[sig];
+	LONG sequence;
+
+	while (1)
+	{
+		sequence = ReadAcquire(&entry->sequence);
+
+		if (sequence & 1)
+		{
+			// A writer is in the middle of an update.
+			YieldProcessor();
+			continue;
+		}
+
+		// The acquire loads keep the reads of the entry before the second read of the sequence.
+		sinfo->action = (signal_t)ReadPointerAcquire((PVOID volatile *)&entry->info.action);
+		sinfo->flags = ReadAcquire((volatile LONG *)&entry->info.flags);
+		sinfo->mask = ReadAcquire((volatile LONG *)&entry->info.mask);
+
+		if (ReadAcquire(&entry->sequence) == sequence)
+		{
+			break;
+		}
+	}
+}
+
+static void write_siginfo(sigentry *entry, const siginfo *sinfo)
+{
+	// The interlocked increments are full barriers.
+	InterlockedIncrement(&entry->sequence);
+	memcpy(&entry->info, sinfo, sizeof(siginfo));
+	InterlockedIncrement(&entry->sequence);
 }
 
 void set_siginfo(int sig, const siginfo *sinfo)
 {
 	EXCLUSIVE_LOCK_SIGNAL_TABLE();
-	memcpy(&_wlibc_signal_table[sig], sinfo, sizeof(siginfo));
+	write_siginfo(&_wlibc_signal_table[sig], sinfo);
+	EXCLUSIVE_UNLOCK_SIGNAL_TABLE();
+
+	// Have the dispatcher ready before the first console signal arrives.
+	if ((sig == SIGINT || sig == SIGBREAK) && sinfo->action != SIG_DFL && sinfo->action != SIG_IGN)
+	{
+		RtlRunOnceExecuteOnce(&console_once, initialize_console_dispatcher, NULL, NULL);
+	}
+}
+
+void reset_siginfo(int sig)
+{
+	sigentry *entry = &_wlibc_signal_table[sig];
+	siginfo sinfo;
+
+	EXCLUSIVE_LOCK_SIGNAL_TABLE();
+
+	sinfo = entry->info;
+	sinfo.action = SIG_DFL;
+	write_siginfo(entry, &sinfo);
+
 	EXCLUSIVE_UNLOCK_SIGNAL_TABLE();
 }
@@ -24,6 +24,12 @@ int wlibc_raise(int sig)
 	// If the signal is blocked ignore it.
 	if (blocked_signals & (1u << sig))
 	{
+		// Unless there is a signalfd waiting for it.
+		if (_wlibc_signal_queue_hook != NULL && _wlibc_signal_queue_hook(sig))
+		{
+			return 0;
+		}
+
 		tinfo->pending |= (1u << sig);
 		return 0;
 	}
@@ -48,9 +54,7 @@ int wlibc_raise(int sig)
 	// Restore the default signal handler.
 	if (sinfo.flags & SA_RESETHAND)
 	{
-		EXCLUSIVE_LOCK_SIGNAL_TABLE();
-		_wlibc_signal_table[sig].action = SIG_DFL;
-		EXCLUSIVE_UNLOCK_SIGNAL_TABLE();
+		reset_siginfo(sig);
 	}
 
 	if (sinfo.action == SIG_DFL)
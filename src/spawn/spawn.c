@@ -51,7 +51,7 @@ static int initialize_inherit_information(inherit_information *info, int max_fd)
 		if (i < (int)_wlibc_fd_table_size)
 		{
 			// The 2 structures have same alignment. Thus can be memcpy'd.
-			memcpy(&(info->fdinfo[i]), &_wlibc_fd_table[i], sizeof(inherit_fdinfo));
+			memcpy(&(info->fdinfo[i]), FD_ENTRY(i), sizeof(inherit_fdinfo));
 		}
 		else
 		{
@@ -20,9 +20,11 @@ int common_fclose(FILE *stream)
 
 	common_fflush(stream);
 
-	if ((stream->buf_mode & _IOBUFFER_INTERNAL) && (stream->buf_mode & _IOBUFFER_ALLOCATED))
+	if (fd == FD_MEMSTREAM)
 	{
-		RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+		memstream_close(stream);
+		delete_stream(stream);
+		return 0;
 	}
 
 	// stream is freed here
@@ -45,6 +45,9 @@ FILE *wlibc_fdopen(int fd, const char *mode)
 		}
 	}
 
-	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | _IOFBF | get_buf_mode(fd_flags), 512);
+	size_t buf_size;
+	int buf_type = get_buf_type(fd, &buf_size);
+
+	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | buf_type | get_buf_mode(fd_flags), (int)buf_size);
 	return stream;
 }
@@ -13,6 +13,11 @@
 
 int common_fflush(FILE *stream)
 {
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_flush(stream);
+	}
+
 	if (stream->buf_mode & _IONBF)
 	{
 		// unbuffered stream, nothing to flush
@@ -50,24 +55,30 @@ int common_fflush(FILE *stream)
 
 int common_flushall(int lock)
 {
-	FILE *start = _wlibc_stdio_head;
+	FILE *start;
 	int status = 0;
 
-	LOCK_STDIO();
-	while (start != NULL)
+	for (int i = 0; i < STDIO_SHARDS; ++i)
 	{
-		if (lock)
-		{
-			LOCK_FILE_STREAM(start);
-		}
-		status |= common_fflush(start);
-		if (lock)
+		LOCK_STDIO_SHARD(i);
+
+		start = _wlibc_stdio_shards[i].head;
+		while (start != NULL)
 		{
-			UNLOCK_FILE_STREAM(start);
+			if (lock)
+			{
+				LOCK_FILE_STREAM(start);
+			}
+			status |= common_fflush(start);
+			if (lock)
+			{
+				UNLOCK_FILE_STREAM(start);
+			}
+			start = start->prev;
 		}
-		start = start->prev;
+
+		UNLOCK_STDIO_SHARD(i);
 	}
-	UNLOCK_STDIO();
 
 	return status;
 }
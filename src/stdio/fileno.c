@@ -6,10 +6,18 @@
 */
 
 #include <internal/stdio.h>
+#include <errno.h>
 #include <stdio.h>
 
 int common_fileno(FILE *stream)
 {
+	// Memory streams don't have an fd.
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
 	return stream->fd;
 }
 
@@ -31,6 +31,9 @@ FILE *wlibc_fopen(const char *restrict name, const char *restrict mode)
 		return NULL;
 	}
 
-	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | _IOFBF | get_buf_mode(flags), 512);
+	size_t buf_size;
+	int buf_type = get_buf_type(fd, &buf_size);
+
+	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | buf_type | get_buf_mode(flags), (int)buf_size);
 	return stream;
 }
@@ -0,0 +1,1807 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/format.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+#define FLAG_LEFT  0x01 // '-'
+#define FLAG_PLUS  0x02 // '+'
+#define FLAG_SPACE 0x04 // ' '
+#define FLAG_ALT   0x08 // '#'
+#define FLAG_ZERO  0x10 // '0'
+#define FLAG_GROUP 0x20 // '\'' (no grouping in the C locale, accepted and ignored)
+
+#define LENGTH_NONE    0
+#define LENGTH_HH      1
+#define LENGTH_H       2
+#define LENGTH_L       3
+#define LENGTH_LL      4
+#define LENGTH_J       5
+#define LENGTH_Z       6
+#define LENGTH_T       7
+#define LENGTH_LDOUBLE 8
+
+#define ARG_NONE    0
+#define ARG_INT     1
+#define ARG_LONG    2
+#define ARG_LLONG   3
+#define ARG_INTMAX  4
+#define ARG_SIZE    5
+#define ARG_PTRDIFF 6
+#define ARG_DOUBLE  7
+#define ARG_LDOUBLE 8
+#define ARG_POINTER 9
+
+typedef struct _format_spec
+{
+	int position;           // Position of the value (n$), 0 if sequential
+	unsigned int flags;     // FLAG_*
+	int width;              // -1 if not given
+	int width_position;     // Position of the width argument (*n$), -1 for '*', 0 if not an argument
+	int precision;          // -1 if not given
+	int precision_position; // Same as width_position
+	int length;             // LENGTH_*
+	char conversion;
+} format_spec;
+
+typedef union _format_arg {
+	intmax_t i;
+	long double f;
+	void *p;
+} format_arg;
+
+typedef struct _format_output
+{
+	format_sink *sink;
+	size_t count; // Number of characters generated.
+	int error;    // Set if the sink failed to make room.
+} format_output;
+
+typedef struct _format_args
+{
+	va_list *list;         // Used for sequential arguments.
+	format_arg *positions; // Used for positional arguments, NULL otherwise.
+} format_args;
+
+///////////////////////////////////////
+// Output
+///////////////////////////////////////
+// Make room in the sink. Returns the space available, 0 if there is none.
+static size_t output_space(format_output *out)
+{
+	format_sink *sink = out->sink;
+
+	if (sink->used == sink->size)
+	{
+		// Fixed buffers drop what does not fit.
+		if (sink->spill == NULL || out->error)
+		{
+			return 0;
+		}
+
+		if (sink->spill(sink) == -1)
+		{
+			out->error = 1;
+			return 0;
+		}
+	}
+
+	return sink->size - sink->used;
+}
+
+static void output_chars(format_output *out, const char *data, size_t length)
+{
+	format_sink *sink = out->sink;
+
+	out->count += length;
+
+	while (length > 0)
+	{
+		size_t space = output_space(out);
+		size_t chunk = length < space ? length : space;
+
+		if (space == 0)
+		{
+			return;
+		}
+
+		memcpy(sink->buffer + sink->used, data, chunk);
+		sink->used += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+}
+
+static void output_repeat(format_output *out, char ch, size_t length)
+{
+	format_sink *sink = out->sink;
+
+	out->count += length;
+
+	while (length > 0)
+	{
+		size_t space = output_space(out);
+		size_t chunk = length < space ? length : space;
+
+		if (space == 0)
+		{
+			return;
+		}
+
+		memset(sink->buffer + sink->used, ch, chunk);
+		sink->used += chunk;
+		length -= chunk;
+	}
+}
+
+// Width padding before the value.
+static void output_pad_before(format_output *out, format_spec *spec, size_t length, int zero_allowed)
+{
+	if (spec->width > 0 && (size_t)spec->width > length && (spec->flags & FLAG_LEFT) == 0)
+	{
+		if ((spec->flags & FLAG_ZERO) && zero_allowed)
+		{
+			return; // Done by the caller after the sign and prefix.
+		}
+
+		output_repeat(out, ' ', spec->width - length);
+	}
+}
+
+static void output_zero_pad(format_output *out, format_spec *spec, size_t length, int zero_allowed)
+{
+	if (spec->width > 0 && (size_t)spec->width > length && (spec->flags & (FLAG_LEFT | FLAG_ZERO)) == FLAG_ZERO && zero_allowed)
+	{
+		output_repeat(out, '0', spec->width - length);
+	}
+}
+
+static void output_pad_after(format_output *out, format_spec *spec, size_t length)
+{
+	if (spec->width > 0 && (size_t)spec->width > length && (spec->flags & FLAG_LEFT))
+	{
+		output_repeat(out, ' ', spec->width - length);
+	}
+}
+
+///////////////////////////////////////
+// Parsing
+///////////////////////////////////////
+static int parse_number(const char **format)
+{
+	const char *p = *format;
+	int number = 0;
+
+	while (*p >= '0' && *p <= '9')
+	{
+		if (number > (INT_MAX - (*p - '0')) / 10)
+		{
+			return -1;
+		}
+
+		number = number * 10 + (*p - '0');
+		++p;
+	}
+
+	*format = p;
+	return number;
+}
+
+// Parse '*' or '*n$' for the width and precision.
+static int parse_star(const char **format, int *position)
+{
+	const char *p = *format + 1; // Skip '*'
+	const char *start = p;
+	int number;
+
+	number = parse_number(&p);
+
+	if (p != start && *p == '$')
+	{
+		if (number <= 0 || number > FORMAT_MAX_POSITIONAL_ARGS)
+		{
+			return -1;
+		}
+
+		*position = number;
+		*format = p + 1;
+		return 0;
+	}
+
+	*position = -1;
+	*format = *format + 1;
+	return 0;
+}
+
+// 'format' points to the character after '%'. Returns the character after the conversion, or NULL on error.
+static const char *parse_spec(const char *format, format_spec *spec)
+{
+	const char *p = format;
+	const char *start;
+	int number;
+
+	memset(spec, 0, sizeof(format_spec));
+	spec->width = -1;
+	spec->precision = -1;
+
+	// Position
+	start = p;
+	number = parse_number(&p);
+	if (p != start && *p == '$')
+	{
+		if (number <= 0 || number > FORMAT_MAX_POSITIONAL_ARGS)
+		{
+			return NULL;
+		}
+
+		spec->position = number;
+		++p;
+	}
+	else
+	{
+		p = start;
+	}
+
+	// Flags
+	while (1)
+	{
+		switch (*p)
+		{
+		case '-':
+			spec->flags |= FLAG_LEFT;
+			break;
+		case '+':
+			spec->flags |= FLAG_PLUS;
+			break;
+		case ' ':
+			spec->flags |= FLAG_SPACE;
+			break;
+		case '#':
+			spec->flags |= FLAG_ALT;
+			break;
+		case '0':
+			spec->flags |= FLAG_ZERO;
+			break;
+		case '\'':
+			spec->flags |= FLAG_GROUP;
+			break;
+		default:
+			goto flags_end;
+		}
+
+		++p;
+	}
+flags_end:
+
+	// Width
+	if (*p == '*')
+	{
+		if (parse_star(&p, &spec->width_position) == -1)
+		{
+			return NULL;
+		}
+	}
+	else if (*p >= '0' && *p <= '9')
+	{
+		spec->width = parse_number(&p);
+		if (spec->width == -1)
+		{
+			return NULL;
+		}
+	}
+
+	// Precision
+	if (*p == '.')
+	{
+		++p;
+
+		if (*p == '*')
+		{
+			if (parse_star(&p, &spec->precision_position) == -1)
+			{
+				return NULL;
+			}
+		}
+		else
+		{
+			// A lone '.' means a precision of 0.
+			spec->precision = parse_number(&p);
+			if (spec->precision == -1)
+			{
+				return NULL;
+			}
+		}
+	}
+
+	// Length
+	switch (*p)
+	{
+	case 'h':
+		spec->length = LENGTH_H;
+		if (*++p == 'h')
+		{
+			spec->length = LENGTH_HH;
+			++p;
+		}
+		break;
+	case 'l':
+		spec->length = LENGTH_L;
+		if (*++p == 'l')
+		{
+			spec->length = LENGTH_LL;
+			++p;
+		}
+		break;
+	case 'j':
+		spec->length = LENGTH_J;
+		++p;
+		break;
+	case 'z':
+		spec->length = LENGTH_Z;
+		++p;
+		break;
+	case 't':
+		spec->length = LENGTH_T;
+		++p;
+		break;
+	case 'L':
+		spec->length = LENGTH_LDOUBLE;
+		++p;
+		break;
+	case 'I':
+		// msvcrt extensions, I -> size_t, I32 -> 32 bit, I64 -> 64 bit
+		if (p[1] == '6' && p[2] == '4')
+		{
+			spec->length = LENGTH_LL;
+			p += 3;
+		}
+		else if (p[1] == '3' && p[2] == '2')
+		{
+			spec->length = LENGTH_NONE;
+			p += 3;
+		}
+		else
+		{
+			spec->length = LENGTH_Z;
+			p += 1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	switch (*p)
+	{
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c':
+	case 's':
+	case 'p':
+	case 'n':
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+	case '%':
+		spec->conversion = *p;
+		break;
+	case 'C':
+		spec->conversion = 'c';
+		spec->length = LENGTH_L;
+		break;
+	case 'S':
+		spec->conversion = 's';
+		spec->length = LENGTH_L;
+		break;
+	default:
+		return NULL;
+	}
+
+	return p + 1;
+}
+
+///////////////////////////////////////
+// Arguments
+///////////////////////////////////////
+static int argument_type(format_spec *spec)
+{
+	switch (spec->conversion)
+	{
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		switch (spec->length)
+		{
+		case LENGTH_L:
+			return ARG_LONG;
+		case LENGTH_LL:
+			return ARG_LLONG;
+		case LENGTH_J:
+			return ARG_INTMAX;
+		case LENGTH_Z:
+			return ARG_SIZE;
+		case LENGTH_T:
+			return ARG_PTRDIFF;
+		default:
+			// hh and h are promoted to int.
+			return ARG_INT;
+		}
+	case 'c':
+		// wint_t is promoted to int (unsigned short) or is the same size as int.
+		return ARG_INT;
+	case 's':
+	case 'p':
+	case 'n':
+		return ARG_POINTER;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		return spec->length == LENGTH_LDOUBLE ? ARG_LDOUBLE : ARG_DOUBLE;
+	default:
+		return ARG_NONE;
+	}
+}
+
+static format_arg fetch_argument(va_list *list, int type)
+{
+	format_arg arg;
+
+	switch (type)
+	{
+	case ARG_INT:
+		arg.i = va_arg(*list, int);
+		break;
+	case ARG_LONG:
+		arg.i = va_arg(*list, long);
+		break;
+	case ARG_LLONG:
+		arg.i = va_arg(*list, long long);
+		break;
+	case ARG_INTMAX:
+		arg.i = va_arg(*list, intmax_t);
+		break;
+	case ARG_SIZE:
+		arg.i = (intmax_t)va_arg(*list, size_t);
+		break;
+	case ARG_PTRDIFF:
+		arg.i = va_arg(*list, ptrdiff_t);
+		break;
+	case ARG_DOUBLE:
+		arg.f = va_arg(*list, double);
+		break;
+	case ARG_LDOUBLE:
+		arg.f = va_arg(*list, long double);
+		break;
+	case ARG_POINTER:
+	default:
+		arg.p = va_arg(*list, void *);
+		break;
+	}
+
+	return arg;
+}
+
+static format_arg next_argument(format_args *args, int position, int type)
+{
+	if (args->positions != NULL)
+	{
+		return args->positions[position - 1];
+	}
+
+	return fetch_argument(args->list, type);
+}
+
+static int record_position(unsigned char *types, int *max_position, int position, int type)
+{
+	// Conflicting types for the same argument.
+	if (types[position - 1] != ARG_NONE && types[position - 1] != type)
+	{
+		return -1;
+	}
+
+	types[position - 1] = (unsigned char)type;
+	if (position > *max_position)
+	{
+		*max_position = position;
+	}
+
+	return 0;
+}
+
+// Returns 1 if the format uses positional arguments, 0 if it does not, -1 if the format is invalid.
+// When positional arguments are used all of them are fetched in order into 'positions'.
+static int collect_positional_arguments(const char *format, va_list *list, format_arg *positions)
+{
+	unsigned char types[FORMAT_MAX_POSITIONAL_ARGS] = {0};
+	int max_position = 0;
+	int sequential = 0;
+	int positional = 0;
+	format_spec spec;
+
+	while (*format != '\0')
+	{
+		if (*format++ != '%')
+		{
+			continue;
+		}
+
+		format = parse_spec(format, &spec);
+		if (format == NULL)
+		{
+			return -1;
+		}
+
+		if (spec.conversion == '%')
+		{
+			continue;
+		}
+
+		if (spec.position == 0)
+		{
+			sequential = 1;
+			continue;
+		}
+
+		positional = 1;
+
+		if (spec.width_position > 0)
+		{
+			if (record_position(types, &max_position, spec.width_position, ARG_INT) == -1)
+			{
+				return -1;
+			}
+		}
+		else if (spec.width_position == -1)
+		{
+			sequential = 1;
+		}
+
+		if (spec.precision_position > 0)
+		{
+			if (record_position(types, &max_position, spec.precision_position, ARG_INT) == -1)
+			{
+				return -1;
+			}
+		}
+		else if (spec.precision_position == -1)
+		{
+			sequential = 1;
+		}
+
+		if (record_position(types, &max_position, spec.position, argument_type(&spec)) == -1)
+		{
+			return -1;
+		}
+	}
+
+	if (positional == 0)
+	{
+		return 0;
+	}
+
+	// Mixing both styles is not allowed.
+	if (sequential)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < max_position; ++i)
+	{
+		// Every argument must be referred to, otherwise we can't skip over it.
+		if (types[i] == ARG_NONE)
+		{
+			return -1;
+		}
+
+		positions[i] = fetch_argument(list, types[i]);
+	}
+
+	return 1;
+}
+
+///////////////////////////////////////
+// Integers
+///////////////////////////////////////
+static const char digit_pairs[201] = "00010203040506070809"
+									 "10111213141516171819"
+									 "20212223242526272829"
+									 "30313233343536373839"
+									 "40414243444546474849"
+									 "50515253545556575859"
+									 "60616263646566676869"
+									 "70717273747576777879"
+									 "80818283848586878889"
+									 "90919293949596979899";
+
+// Digits are written backwards from 'end'. Returns the start of the digits.
+static char *convert_decimal(char *end, uintmax_t value)
+{
+	// Two digits at a time.
+	while (value >= 100)
+	{
+		unsigned int pair = (unsigned int)(value % 100);
+		value /= 100;
+		end -= 2;
+		memcpy(end, digit_pairs + pair * 2, 2);
+	}
+
+	if (value >= 10)
+	{
+		end -= 2;
+		memcpy(end, digit_pairs + value * 2, 2);
+	}
+	else
+	{
+		*--end = (char)('0' + value);
+	}
+
+	return end;
+}
+
+static char *convert_hex(char *end, uintmax_t value, int upper)
+{
+	const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+	do
+	{
+		*--end = hex[value & 0xf];
+		value >>= 4;
+	} while (value != 0);
+
+	return end;
+}
+
+static char *convert_octal(char *end, uintmax_t value)
+{
+	do
+	{
+		*--end = (char)('0' + (value & 0x7));
+		value >>= 3;
+	} while (value != 0);
+
+	return end;
+}
+
+// Emit sign/prefix, zero padding, precision zeros and the digits with the width applied.
+static void output_number(format_output *out, format_spec *spec, const char *prefix, size_t prefix_length, const char *digits,
+						  size_t digits_length, size_t precision_zeros, int zero_allowed)
+{
+	size_t length = prefix_length + precision_zeros + digits_length;
+
+	output_pad_before(out, spec, length, zero_allowed);
+	output_chars(out, prefix, prefix_length);
+	output_zero_pad(out, spec, length, zero_allowed);
+	output_repeat(out, '0', precision_zeros);
+	output_chars(out, digits, digits_length);
+	output_pad_after(out, spec, length);
+}
+
+static void format_integer(format_output *out, format_spec *spec, intmax_t arg)
+{
+	char buffer[32];
+	char *end = buffer + sizeof(buffer);
+	char *digits;
+	char prefix[2];
+	size_t prefix_length = 0;
+	size_t digits_length;
+	size_t precision_zeros = 0;
+	uintmax_t value;
+	int is_signed = (spec->conversion == 'd' || spec->conversion == 'i');
+
+	// Narrow the value to the requested size.
+	if (is_signed)
+	{
+		intmax_t svalue;
+
+		switch (spec->length)
+		{
+		case LENGTH_HH:
+			svalue = (signed char)arg;
+			break;
+		case LENGTH_H:
+			svalue = (short)arg;
+			break;
+		case LENGTH_L:
+			svalue = (long)arg;
+			break;
+		case LENGTH_LL:
+			svalue = (long long)arg;
+			break;
+		case LENGTH_J:
+			svalue = arg;
+			break;
+		case LENGTH_Z:
+		case LENGTH_T:
+			svalue = (ptrdiff_t)arg;
+			break;
+		default:
+			svalue = (int)arg;
+			break;
+		}
+
+		if (svalue < 0)
+		{
+			prefix[prefix_length++] = '-';
+			value = -(uintmax_t)svalue;
+		}
+		else
+		{
+			if (spec->flags & FLAG_PLUS)
+			{
+				prefix[prefix_length++] = '+';
+			}
+			else if (spec->flags & FLAG_SPACE)
+			{
+				prefix[prefix_length++] = ' ';
+			}
+
+			value = (uintmax_t)svalue;
+		}
+	}
+	else
+	{
+		switch (spec->length)
+		{
+		case LENGTH_HH:
+			value = (unsigned char)arg;
+			break;
+		case LENGTH_H:
+			value = (unsigned short)arg;
+			break;
+		case LENGTH_L:
+			value = (unsigned long)arg;
+			break;
+		case LENGTH_LL:
+			value = (unsigned long long)arg;
+			break;
+		case LENGTH_J:
+			value = (uintmax_t)arg;
+			break;
+		case LENGTH_Z:
+		case LENGTH_T:
+			value = (size_t)arg;
+			break;
+		default:
+			value = (unsigned int)arg;
+			break;
+		}
+	}
+
+	switch (spec->conversion)
+	{
+	case 'x':
+	case 'X':
+		digits = convert_hex(end, value, spec->conversion == 'X');
+		if ((spec->flags & FLAG_ALT) && value != 0)
+		{
+			prefix[prefix_length++] = '0';
+			prefix[prefix_length++] = spec->conversion;
+		}
+		break;
+	case 'o':
+		digits = convert_octal(end, value);
+		break;
+	default:
+		digits = convert_decimal(end, value);
+		break;
+	}
+
+	digits_length = end - digits;
+
+	// A precision of 0 with a value of 0 prints no digits.
+	if (spec->precision == 0 && value == 0)
+	{
+		digits_length = 0;
+	}
+
+	if (spec->precision > 0 && (size_t)spec->precision > digits_length)
+	{
+		precision_zeros = spec->precision - digits_length;
+	}
+
+	// '#' with octal forces the first digit to be 0.
+	if (spec->conversion == 'o' && (spec->flags & FLAG_ALT) && precision_zeros == 0 && (digits_length == 0 || digits[0] != '0'))
+	{
+		precision_zeros = 1;
+	}
+
+	// The '0' flag is ignored when a precision is given.
+	output_number(out, spec, prefix, prefix_length, digits, digits_length, precision_zeros, spec->precision < 0);
+}
+
+///////////////////////////////////////
+// Floating point
+///////////////////////////////////////
+
+// Enough for the exact decimal expansion of any double.
+// Either the integer part (at most 309 digits) is present, or the fraction (at most 1074 digits)
+// along with an integer part of at most 16 digits.
+#define DECIMAL_MAX_DIGITS 1100
+#define BIG_MAX_LIMBS      96
+#define BIG_LIMB_BASE      1000000000u
+
+typedef struct _decimal
+{
+	char digits[DECIMAL_MAX_DIGITS]; // No leading or trailing zeros.
+	int count;
+	int exponent; // value = 0.d1d2d3... * 10^exponent
+} decimal;
+
+typedef struct _big
+{
+	uint32_t limbs[BIG_MAX_LIMBS]; // Little endian, base 10^9
+	int count;
+} big;
+
+static void big_set(big *b, uint64_t value)
+{
+	b->count = 0;
+
+	do
+	{
+		b->limbs[b->count++] = (uint32_t)(value % BIG_LIMB_BASE);
+		value /= BIG_LIMB_BASE;
+	} while (value != 0);
+}
+
+static void big_multiply(big *b, uint32_t factor)
+{
+	uint64_t carry = 0;
+
+	for (int i = 0; i < b->count; ++i)
+	{
+		uint64_t t = (uint64_t)b->limbs[i] * factor + carry;
+		b->limbs[i] = (uint32_t)(t % BIG_LIMB_BASE);
+		carry = t / BIG_LIMB_BASE;
+	}
+
+	while (carry != 0)
+	{
+		b->limbs[b->count++] = (uint32_t)(carry % BIG_LIMB_BASE);
+		carry /= BIG_LIMB_BASE;
+	}
+}
+
+// Write the decimal digits of 'b' to 'out' padded with leading zeros to at least 'width' digits.
+static int big_to_digits(big *b, char *out, int width)
+{
+	char temp[9];
+	int length = 0;
+	int total;
+
+	// Number of digits of the top limb.
+	char *top = convert_decimal(temp + 9, b->limbs[b->count - 1]);
+	int top_length = (int)(temp + 9 - top);
+
+	total = top_length + (b->count - 1) * 9;
+
+	// Skip a lone 0.
+	if (b->count == 1 && b->limbs[0] == 0)
+	{
+		total = 0;
+	}
+
+	while (length + total < width)
+	{
+		out[length++] = '0';
+	}
+
+	if (total == 0)
+	{
+		return length;
+	}
+
+	memcpy(out + length, top, top_length);
+	length += top_length;
+
+	for (int i = b->count - 2; i >= 0; --i)
+	{
+		char *limb = temp + 9;
+		uint32_t value = b->limbs[i];
+
+		for (int j = 0; j < 9; ++j)
+		{
+			*--limb = (char)('0' + value % 10);
+			value /= 10;
+		}
+
+		memcpy(out + length, temp, 9);
+		length += 9;
+	}
+
+	return length;
+}
+
+// Exact decimal expansion of a finite non negative double.
+static void double_to_decimal(decimal *d, uint64_t mantissa, int exponent)
+{
+	big b;
+	int integer_length = 0;
+	int length = 0;
+	int first;
+
+	// value = mantissa * 2^exponent
+	if (mantissa == 0)
+	{
+		d->count = 0;
+		d->exponent = 0;
+		return;
+	}
+
+	if (exponent >= 0)
+	{
+		big_set(&b, mantissa);
+
+		while (exponent > 0)
+		{
+			int shift = exponent > 29 ? 29 : exponent;
+			big_multiply(&b, 1u << shift);
+			exponent -= shift;
+		}
+
+		length = big_to_digits(&b, d->digits, 0);
+		integer_length = length;
+	}
+	else
+	{
+		int k = -exponent;
+		uint64_t integer = k < 64 ? mantissa >> k : 0;
+		uint64_t fraction = k < 64 ? mantissa & ((1ull << k) - 1) : mantissa;
+
+		if (integer != 0)
+		{
+			big_set(&b, integer);
+			length = big_to_digits(&b, d->digits, 0);
+			integer_length = length;
+		}
+
+		// fraction / 2^k = (fraction * 5^k) / 10^k
+		if (fraction != 0)
+		{
+			big_set(&b, fraction);
+
+			while (k >= 13)
+			{
+				big_multiply(&b, 1220703125u); // 5^13
+				k -= 13;
+			}
+
+			if (k > 0)
+			{
+				uint32_t power = 1;
+				for (int i = 0; i < k; ++i)
+				{
+					power *= 5;
+				}
+
+				big_multiply(&b, power);
+			}
+
+			length += big_to_digits(&b, d->digits + length, -exponent);
+		}
+	}
+
+	// Remove the leading and trailing zeros.
+	first = 0;
+	while (first < length && d->digits[first] == '0')
+	{
+		++first;
+	}
+
+	while (length > first && d->digits[length - 1] == '0')
+	{
+		--length;
+	}
+
+	memmove(d->digits, d->digits + first, length - first);
+	d->count = length - first;
+	d->exponent = integer_length - first;
+}
+
+// Round to 'keep' significant digits, ties to even.
+static void round_decimal(decimal *d, int keep)
+{
+	int up;
+
+	if (keep >= d->count)
+	{
+		return;
+	}
+
+	if (keep < 0)
+	{
+		d->count = 0;
+		return;
+	}
+
+	// Trailing zeros are never stored, so any digit after the rounding digit means we are above the half way point.
+	if (d->digits[keep] > '5')
+	{
+		up = 1;
+	}
+	else if (d->digits[keep] < '5')
+	{
+		up = 0;
+	}
+	else if (d->count > keep + 1)
+	{
+		up = 1;
+	}
+	else
+	{
+		up = keep > 0 ? ((d->digits[keep - 1] - '0') & 1) : 0;
+	}
+
+	d->count = keep;
+
+	if (up)
+	{
+		int i = keep - 1;
+
+		while (i >= 0 && d->digits[i] == '9')
+		{
+			--i;
+		}
+
+		if (i < 0)
+		{
+			// All nines, carry into a new digit.
+			d->digits[0] = '1';
+			d->count = 1;
+			d->exponent += 1;
+			return;
+		}
+
+		d->digits[i] += 1;
+		d->count = i + 1;
+	}
+
+	while (d->count > 0 && d->digits[d->count - 1] == '0')
+	{
+		--d->count;
+	}
+
+	if (d->count == 0)
+	{
+		d->exponent = 0;
+	}
+}
+
+static char decimal_digit(decimal *d, int index)
+{
+	if (index >= 0 && index < d->count)
+	{
+		return d->digits[index];
+	}
+
+	return '0';
+}
+
+static void output_fixed(format_output *out, format_spec *spec, const char *sign, size_t sign_length, decimal *d, int precision)
+{
+	int integer_length = d->exponent > 0 ? d->exponent : 1;
+	int point = (precision > 0 || (spec->flags & FLAG_ALT)) ? 1 : 0;
+	size_t length = sign_length + integer_length + point + precision;
+
+	output_pad_before(out, spec, length, 1);
+	output_chars(out, sign, sign_length);
+	output_zero_pad(out, spec, length, 1);
+
+	if (d->exponent > 0)
+	{
+		int available = d->count < d->exponent ? d->count : d->exponent;
+		output_chars(out, d->digits, available);
+		output_repeat(out, '0', d->exponent - available);
+	}
+	else
+	{
+		output_chars(out, "0", 1);
+	}
+
+	if (point)
+	{
+		output_chars(out, ".", 1);
+	}
+
+	if (precision > 0)
+	{
+		int index = d->exponent;
+		int remaining = precision;
+
+		// Leading zeros of the fraction.
+		if (index < 0)
+		{
+			int zeros = -index < remaining ? -index : remaining;
+			output_repeat(out, '0', zeros);
+			remaining -= zeros;
+			index += zeros;
+		}
+
+		// Digits of the fraction.
+		if (remaining > 0 && index < d->count)
+		{
+			int available = d->count - index < remaining ? d->count - index : remaining;
+			output_chars(out, d->digits + index, available);
+			remaining -= available;
+		}
+
+		// Trailing zeros.
+		output_repeat(out, '0', remaining);
+	}
+
+	output_pad_after(out, spec, length);
+}
+
+static void output_exponential(format_output *out, format_spec *spec, const char *sign, size_t sign_length, decimal *d, int precision,
+							   int upper)
+{
+	char buffer[8];
+	char *end = buffer + sizeof(buffer);
+	char *exponent_digits;
+	int exponent = d->count == 0 ? 0 : d->exponent - 1;
+	int point = (precision > 0 || (spec->flags & FLAG_ALT)) ? 1 : 0;
+	size_t exponent_length;
+	size_t length;
+
+	exponent_digits = convert_decimal(end, (uintmax_t)(exponent < 0 ? -exponent : exponent));
+	if (end - exponent_digits < 2)
+	{
+		*--exponent_digits = '0';
+	}
+	*--exponent_digits = exponent < 0 ? '-' : '+';
+	*--exponent_digits = upper ? 'E' : 'e';
+	exponent_length = end - exponent_digits;
+
+	length = sign_length + 1 + point + precision + exponent_length;
+
+	output_pad_before(out, spec, length, 1);
+	output_chars(out, sign, sign_length);
+	output_zero_pad(out, spec, length, 1);
+
+	buffer[0] = decimal_digit(d, 0);
+	output_chars(out, buffer, 1);
+
+	if (point)
+	{
+		output_chars(out, ".", 1);
+	}
+
+	if (precision > 0)
+	{
+		int available = d->count - 1 < precision ? d->count - 1 : precision;
+
+		if (available > 0)
+		{
+			output_chars(out, d->digits + 1, available);
+		}
+		else
+		{
+			available = 0;
+		}
+
+		output_repeat(out, '0', precision - available);
+	}
+
+	output_chars(out, exponent_digits, exponent_length);
+	output_pad_after(out, spec, length);
+}
+
+static void output_hex_float(format_output *out, format_spec *spec, const char *sign, size_t sign_length, uint64_t fraction,
+							 int exponent, int lead, int upper)
+{
+	const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char prefix[4];
+	char digits[16];
+	char buffer[8];
+	char *end = buffer + sizeof(buffer);
+	char *exponent_digits;
+	int precision = spec->precision;
+	int count = 13;
+	int point;
+	size_t exponent_length;
+	size_t length;
+	size_t prefix_length;
+
+	// 52 bits of fraction -> 13 hex digits.
+	if (precision >= 0 && precision < 13)
+	{
+		int shift = 52 - 4 * precision;
+		uint64_t remainder = fraction & ((1ull << shift) - 1);
+		uint64_t half = 1ull << (shift - 1);
+
+		fraction >>= shift;
+
+		// Ties go to even, with no fraction digits left the leading digit decides.
+		if (remainder > half || (remainder == half && ((precision > 0 ? fraction : (uint64_t)lead) & 1)))
+		{
+			++fraction;
+
+			if (fraction >> (4 * precision))
+			{
+				fraction &= (1ull << (4 * precision)) - 1;
+				++lead;
+			}
+		}
+
+		count = precision;
+	}
+
+	for (int i = count - 1; i >= 0; --i)
+	{
+		digits[i] = hex[fraction & 0xf];
+		fraction >>= 4;
+	}
+
+	if (precision < 0)
+	{
+		// Remove the trailing zeros.
+		while (count > 0 && digits[count - 1] == '0')
+		{
+			--count;
+		}
+
+		precision = count;
+	}
+
+	exponent_digits = convert_decimal(end, (uintmax_t)(exponent < 0 ? -exponent : exponent));
+	*--exponent_digits = exponent < 0 ? '-' : '+';
+	*--exponent_digits = upper ? 'P' : 'p';
+	exponent_length = end - exponent_digits;
+
+	memcpy(prefix, sign, sign_length);
+	prefix_length = sign_length;
+	prefix[prefix_length++] = '0';
+	prefix[prefix_length++] = upper ? 'X' : 'x';
+
+	point = (precision > 0 || (spec->flags & FLAG_ALT)) ? 1 : 0;
+	length = prefix_length + 1 + point + precision + exponent_length;
+
+	output_pad_before(out, spec, length, 1);
+	output_chars(out, prefix, prefix_length);
+	output_zero_pad(out, spec, length, 1);
+
+	buffer[0] = hex[lead];
+	output_chars(out, buffer, 1);
+
+	if (point)
+	{
+		output_chars(out, ".", 1);
+	}
+
+	output_chars(out, digits, count);
+	output_repeat(out, '0', precision - count);
+	output_chars(out, exponent_digits, exponent_length);
+	output_pad_after(out, spec, length);
+}
+
+static void format_float(format_output *out, format_spec *spec, double value)
+{
+	decimal d;
+	char sign[1];
+	size_t sign_length = 0;
+	uint64_t bits;
+	uint64_t fraction;
+	int biased_exponent;
+	int upper = (spec->conversion >= 'A' && spec->conversion <= 'Z');
+	int precision = spec->precision < 0 ? 6 : spec->precision;
+
+	memcpy(&bits, &value, sizeof(double));
+	fraction = bits & ((1ull << 52) - 1);
+	biased_exponent = (int)((bits >> 52) & 0x7ff);
+
+	if (bits >> 63)
+	{
+		sign[sign_length++] = '-';
+	}
+	else if (spec->flags & FLAG_PLUS)
+	{
+		sign[sign_length++] = '+';
+	}
+	else if (spec->flags & FLAG_SPACE)
+	{
+		sign[sign_length++] = ' ';
+	}
+
+	// Infinity and NaN, never zero padded.
+	if (biased_exponent == 0x7ff)
+	{
+		const char *text = fraction == 0 ? (upper ? "INF" : "inf") : (upper ? "NAN" : "nan");
+
+		output_pad_before(out, spec, sign_length + 3, 0);
+		output_chars(out, sign, sign_length);
+		output_chars(out, text, 3);
+		output_pad_after(out, spec, sign_length + 3);
+		return;
+	}
+
+	if (spec->conversion == 'a' || spec->conversion == 'A')
+	{
+		if (biased_exponent == 0)
+		{
+			// Zero is printed with an exponent of 0, subnormals with the minimum exponent.
+			output_hex_float(out, spec, sign, sign_length, fraction, fraction == 0 ? 0 : -1022, 0, upper);
+		}
+		else
+		{
+			output_hex_float(out, spec, sign, sign_length, fraction, biased_exponent - 1023, 1, upper);
+		}
+
+		return;
+	}
+
+	if (biased_exponent == 0)
+	{
+		double_to_decimal(&d, fraction, -1074);
+	}
+	else
+	{
+		double_to_decimal(&d, fraction | (1ull << 52), biased_exponent - 1075);
+	}
+
+	switch (spec->conversion)
+	{
+	case 'f':
+	case 'F':
+		round_decimal(&d, d.exponent + precision);
+		output_fixed(out, spec, sign, sign_length, &d, precision);
+		break;
+	case 'e':
+	case 'E':
+		round_decimal(&d, precision + 1);
+		output_exponential(out, spec, sign, sign_length, &d, precision, upper);
+		break;
+	case 'g':
+	case 'G':
+	{
+		int exponent;
+
+		if (precision == 0)
+		{
+			precision = 1;
+		}
+
+		round_decimal(&d, precision);
+		exponent = d.count == 0 ? 0 : d.exponent - 1;
+
+		if (precision > exponent && exponent >= -4)
+		{
+			precision = precision - 1 - exponent;
+
+			// Remove the trailing zeros unless '#' is given.
+			if ((spec->flags & FLAG_ALT) == 0)
+			{
+				int significant = d.count - d.exponent;
+				precision = significant < precision ? (significant > 0 ? significant : 0) : precision;
+			}
+
+			output_fixed(out, spec, sign, sign_length, &d, precision);
+		}
+		else
+		{
+			precision = precision - 1;
+
+			if ((spec->flags & FLAG_ALT) == 0)
+			{
+				int significant = d.count - 1;
+				precision = significant < precision ? (significant > 0 ? significant : 0) : precision;
+			}
+
+			output_exponential(out, spec, sign, sign_length, &d, precision, upper);
+		}
+	}
+	break;
+	}
+}
+
+///////////////////////////////////////
+// Characters and strings
+///////////////////////////////////////
+
+// Returns the number of bytes, or -1 for an invalid code point.
+static int encode_utf8(char *out, uint32_t codepoint)
+{
+	if (codepoint < 0x80)
+	{
+		out[0] = (char)codepoint;
+		return 1;
+	}
+
+	if (codepoint < 0x800)
+	{
+		out[0] = (char)(0xc0 | (codepoint >> 6));
+		out[1] = (char)(0x80 | (codepoint & 0x3f));
+		return 2;
+	}
+
+	if (codepoint >= 0xd800 && codepoint <= 0xdfff)
+	{
+		return -1;
+	}
+
+	if (codepoint < 0x10000)
+	{
+		out[0] = (char)(0xe0 | (codepoint >> 12));
+		out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (codepoint & 0x3f));
+		return 3;
+	}
+
+	if (codepoint < 0x110000)
+	{
+		out[0] = (char)(0xf0 | (codepoint >> 18));
+		out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3f));
+		out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+		out[3] = (char)(0x80 | (codepoint & 0x3f));
+		return 4;
+	}
+
+	return -1;
+}
+
+// Decode the next code point of a wide string, combining surrogate pairs when wchar_t is 16 bits.
+static uint32_t next_wide_char(const wchar_t **string)
+{
+	const wchar_t *p = *string;
+	uint32_t codepoint = (uint32_t)*p++;
+
+#if WCHAR_MAX == 0xffff
+	if (codepoint >= 0xd800 && codepoint <= 0xdbff && *p >= 0xdc00 && *p <= 0xdfff)
+	{
+		codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + ((uint32_t)*p++ - 0xdc00);
+	}
+#endif
+
+	*string = p;
+	return codepoint;
+}
+
+static int format_wide_string(format_output *out, format_spec *spec, const wchar_t *string)
+{
+	const wchar_t *p = string;
+	char encoded[4];
+	size_t length = 0;
+	int result;
+
+	// First pass for the length, the precision limits the number of bytes without splitting a character.
+	while (*p != L'\0')
+	{
+		result = encode_utf8(encoded, next_wide_char(&p));
+		if (result == -1)
+		{
+			errno = EILSEQ;
+			return -1;
+		}
+
+		if (spec->precision >= 0 && length + result > (size_t)spec->precision)
+		{
+			break;
+		}
+
+		length += result;
+	}
+
+	output_pad_before(out, spec, length, 0);
+
+	p = string;
+	for (size_t written = 0; written < length; written += result)
+	{
+		result = encode_utf8(encoded, next_wide_char(&p));
+		output_chars(out, encoded, result);
+	}
+
+	output_pad_after(out, spec, length);
+
+	return 0;
+}
+
+static int format_string_arg(format_output *out, format_spec *spec, void *arg)
+{
+	const char *string = arg;
+	size_t length;
+
+	if (arg == NULL)
+	{
+		string = "(null)";
+	}
+	else if (spec->length == LENGTH_L)
+	{
+		return format_wide_string(out, spec, (const wchar_t *)arg);
+	}
+
+	if (spec->precision >= 0)
+	{
+		const char *nul = memchr(string, '\0', spec->precision);
+		length = nul != NULL ? (size_t)(nul - string) : (size_t)spec->precision;
+	}
+	else
+	{
+		length = strlen(string);
+	}
+
+	output_pad_before(out, spec, length, 0);
+	output_chars(out, string, length);
+	output_pad_after(out, spec, length);
+
+	return 0;
+}
+
+static int format_char(format_output *out, format_spec *spec, intmax_t arg)
+{
+	char encoded[4];
+	int length = 1;
+
+	if (spec->length == LENGTH_L)
+	{
+#if WCHAR_MAX == 0xffff
+		length = encode_utf8(encoded, (uint16_t)arg);
+#else
+		length = encode_utf8(encoded, (uint32_t)arg);
+#endif
+		if (length == -1)
+		{
+			errno = EILSEQ;
+			return -1;
+		}
+	}
+	else
+	{
+		encoded[0] = (char)arg;
+	}
+
+	output_pad_before(out, spec, length, 0);
+	output_chars(out, encoded, length);
+	output_pad_after(out, spec, length);
+
+	return 0;
+}
+
+static void format_pointer(format_output *out, format_spec *spec, void *arg)
+{
+	char buffer[32];
+	char *end = buffer + sizeof(buffer);
+	char *digits;
+
+	if (arg == NULL)
+	{
+		output_pad_before(out, spec, 5, 0);
+		output_chars(out, "(nil)", 5);
+		output_pad_after(out, spec, 5);
+		return;
+	}
+
+	digits = convert_hex(end, (uintptr_t)arg, 0);
+	output_number(out, spec, "0x", 2, digits, end - digits, 0, 0);
+}
+
+static void store_count(format_spec *spec, void *arg, size_t count)
+{
+	switch (spec->length)
+	{
+	case LENGTH_HH:
+		*(signed char *)arg = (signed char)count;
+		break;
+	case LENGTH_H:
+		*(short *)arg = (short)count;
+		break;
+	case LENGTH_L:
+		*(long *)arg = (long)count;
+		break;
+	case LENGTH_LL:
+		*(long long *)arg = (long long)count;
+		break;
+	case LENGTH_J:
+		*(intmax_t *)arg = (intmax_t)count;
+		break;
+	case LENGTH_Z:
+		*(size_t *)arg = count;
+		break;
+	case LENGTH_T:
+		*(ptrdiff_t *)arg = (ptrdiff_t)count;
+		break;
+	default:
+		*(int *)arg = (int)count;
+		break;
+	}
+}
+
+///////////////////////////////////////
+// Main loop
+///////////////////////////////////////
+int format_to_sink(format_sink *sink, const char *format, va_list args)
+{
+	format_arg positions[FORMAT_MAX_POSITIONAL_ARGS];
+	format_output out;
+	format_args state;
+	format_spec spec;
+	format_arg arg;
+	va_list list;
+	const char *p;
+	int sequential_position = 0;
+	int result;
+
+	if (format == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	out.sink = sink;
+	out.count = 0;
+	out.error = 0;
+
+	va_copy(list, args);
+	state.list = &list;
+	state.positions = NULL;
+
+	// Only do the extra pass if there is a '$' in the format.
+	if (strchr(format, '$') != NULL)
+	{
+		result = collect_positional_arguments(format, &list, positions);
+		if (result == -1)
+		{
+			va_end(list);
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (result == 1)
+		{
+			state.positions = positions;
+		}
+	}
+
+	p = format;
+
+	while (*p != '\0' && out.error == 0)
+	{
+		// Copy the literal text up to the next conversion.
+		const char *percent = strchr(p, '%');
+
+		if (percent == NULL)
+		{
+			output_chars(&out, p, strlen(p));
+			break;
+		}
+
+		if (percent != p)
+		{
+			output_chars(&out, p, percent - p);
+		}
+
+		p = parse_spec(percent + 1, &spec);
+		if (p == NULL)
+		{
+			va_end(list);
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (spec.conversion == '%')
+		{
+			output_chars(&out, "%", 1);
+			continue;
+		}
+
+		if (spec.width_position != 0)
+		{
+			arg = next_argument(&state, spec.width_position, ARG_INT);
+			spec.width = (int)arg.i;
+
+			// A negative width is taken as the '-' flag.
+			if (spec.width < 0)
+			{
+				spec.flags |= FLAG_LEFT;
+				spec.width = spec.width == INT_MIN ? INT_MAX : -spec.width;
+			}
+		}
+
+		if (spec.precision_position != 0)
+		{
+			arg = next_argument(&state, spec.precision_position, ARG_INT);
+			spec.precision = (int)arg.i;
+
+			// A negative precision is taken as if it was omitted.
+			if (spec.precision < 0)
+			{
+				spec.precision = -1;
+			}
+		}
+
+		arg = next_argument(&state, spec.position != 0 ? spec.position : ++sequential_position, argument_type(&spec));
+
+		switch (spec.conversion)
+		{
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			format_integer(&out, &spec, arg.i);
+			break;
+		case 'c':
+			if (format_char(&out, &spec, arg.i) == -1)
+			{
+				va_end(list);
+				return -1;
+			}
+			break;
+		case 's':
+			if (format_string_arg(&out, &spec, arg.p) == -1)
+			{
+				va_end(list);
+				return -1;
+			}
+			break;
+		case 'p':
+			format_pointer(&out, &spec, arg.p);
+			break;
+		case 'n':
+			store_count(&spec, arg.p, out.count);
+			break;
+		default:
+			format_float(&out, &spec, (double)arg.f);
+			break;
+		}
+	}
+
+	va_end(list);
+
+	if (out.error)
+	{
+		return -1;
+	}
+
+	if (out.count > INT_MAX)
+	{
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	return (int)out.count;
+}
+
+int format_string(char *buffer, size_t size, const char *format, va_list args)
+{
+	format_sink sink;
+	int result;
+
+	sink.buffer = buffer;
+	sink.size = size > 0 ? size - 1 : 0;
+	sink.used = 0;
+	sink.spill = NULL;
+	sink.context = NULL;
+
+	result = format_to_sink(&sink, format, args);
+
+	if (size > 0)
+	{
+		buffer[sink.used] = '\0';
+	}
+
+	return result;
+}
@@ -0,0 +1,181 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/stdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <string.h>
+#include <unistd.h>
+
+int common_fflush(FILE *stream);
+
+// Make room for 'size' bytes of unread data, moving the unread data to the front of the buffer.
+// Buffers too small for it are replaced by a larger internal one.
+static int fpeek_reserve(FILE *stream, size_t size)
+{
+	size_t available = stream->end - stream->pos;
+	char *unread = stream->buffer + (stream->pos - stream->start);
+
+	if (size > stream->buf_size || stream->buffer == NULL)
+	{
+		size_t buf_size = __max(size, stream->buf_size);
+		char *buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, buf_size);
+
+		if (buffer == NULL)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+
+		if (available != 0)
+		{
+			memcpy(buffer, unread, available);
+		}
+
+		if ((stream->buf_mode & _IOBUFFER_INTERNAL) && (stream->buf_mode & _IOBUFFER_ALLOCATED))
+		{
+			RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+		}
+
+		// A buffer given by setvbuf is left alone from here on.
+		stream->buffer = buffer;
+		stream->buf_size = buf_size;
+		stream->buf_mode = (stream->buf_mode & ~_IOBUFFER_EXTERNAL) | _IOBUFFER_INTERNAL | _IOBUFFER_ALLOCATED;
+	}
+	else if (available != 0 && unread != stream->buffer)
+	{
+		memmove(stream->buffer, unread, available);
+	}
+
+	stream->start = stream->pos;
+	stream->end = stream->pos + available;
+
+	return 0;
+}
+
+static int common_fpeek(FILE *restrict stream, size_t min_size, const char **restrict buffer, size_t *restrict size)
+{
+	size_t available;
+
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_peek(stream, buffer, size);
+	}
+
+	if (stream->error == _IOERROR)
+	{
+		errno = EIO;
+		return -1;
+	}
+
+	// Stream was opened for writing only.
+	if (stream->buf_mode & _IOBUFFER_WRONLY)
+	{
+		errno = EACCES;
+		stream->error = _IOERROR;
+		return -1;
+	}
+
+	// No buffer to lend.
+	if (stream->buf_mode & _IONBF)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Flush the stream if we have written to it previously
+	if (stream->prev_op == OP_WRITE)
+	{
+		if (common_fflush(stream) == -1)
+		{
+			return -1;
+		}
+
+		stream->end = stream->start;
+	}
+	stream->prev_op = OP_READ;
+
+	available = stream->end - stream->pos;
+
+	if (available < min_size && (stream->error & _IOEOF) == 0)
+	{
+		if (fpeek_reserve(stream, min_size) == -1)
+		{
+			return -1;
+		}
+
+		// Fill up the rest of the buffer, pipes and consoles might need more than one read.
+		while (available < min_size)
+		{
+			ssize_t result = read(stream->fd, stream->buffer + available, stream->buf_size - available);
+
+			if (result == -1)
+			{
+				stream->error = _IOERROR;
+				return -1;
+			}
+
+			if (result == 0)
+			{
+				stream->error = _IOEOF;
+				break;
+			}
+
+			stream->end += result;
+			available += result;
+		}
+	}
+
+	*buffer = stream->buffer + (stream->pos - stream->start);
+	*size = available;
+
+	return 0;
+}
+
+int wlibc_fpeek(FILE *restrict stream, size_t min_size, const char **restrict buffer, size_t *restrict size)
+{
+	int result;
+
+	VALIDATE_FILE_STREAM(stream, -1);
+
+	if (buffer == NULL || size == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	LOCK_FILE_STREAM(stream);
+	result = common_fpeek(stream, min_size, buffer, size);
+	UNLOCK_FILE_STREAM(stream);
+
+	return result;
+}
+
+int wlibc_fconsume(FILE *stream, size_t size)
+{
+	int result = 0;
+
+	VALIDATE_FILE_STREAM(stream, -1);
+
+	LOCK_FILE_STREAM(stream);
+
+	// Only what was handed out by fpeek can be consumed.
+	if (stream->prev_op != OP_READ || size > stream->end - stream->pos)
+	{
+		errno = EINVAL;
+		result = -1;
+	}
+	else
+	{
+		stream->pos += size;
+	}
+
+	UNLOCK_FILE_STREAM(stream);
+
+	return result;
+}
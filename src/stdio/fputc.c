@@ -12,7 +12,8 @@ size_t common_fwrite(void *restrict buffer, size_t size, size_t count, FILE *res
 
 int common_fputc(int ch, FILE *stream)
 {
-	if (((stream->buf_mode & _IONBF) == 0) && stream->prev_op == OP_WRITE)
+	// Newlines on line buffered streams take the slow path, it does the flush.
+	if (((stream->buf_mode & _IONBF) == 0) && stream->prev_op == OP_WRITE && (ch != '\n' || (stream->buf_mode & _IOLBF) == 0))
 	{
 		if (stream->start != stream->end && stream->pos != stream->end)
 		{
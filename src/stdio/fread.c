@@ -13,7 +13,17 @@ int common_fflush(FILE *stream);
 
 static ssize_t read_wrapper(FILE *restrict stream, void *restrict buffer, size_t size)
 {
-	ssize_t result = read(stream->fd, buffer, size);
+	ssize_t result;
+
+	// Reading from an interactive stream, flush a line buffered stdout first so that any prompt is seen.
+	if ((stream->buf_mode & _IOLBF) && stdout != NULL && stream != stdout && (stdout->buf_mode & _IOLBF))
+	{
+		LOCK_FILE_STREAM(stdout);
+		common_fflush(stdout);
+		UNLOCK_FILE_STREAM(stdout);
+	}
+
+	result = read(stream->fd, buffer, size);
 	// Set the stream error states
 	if (result == 0)
 	{
@@ -31,6 +41,11 @@ size_t common_fread(void *restrict buffer, size_t size, size_t count, FILE *rest
 {
 	ssize_t result = 0;
 
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_read(stream, buffer, size * count) / size;
+	}
+
 	// Stream has reached it's end or an error has occured.
 	if (stream->error == _IOEOF || stream->error == _IOERROR)
 	{
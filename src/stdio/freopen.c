@@ -24,6 +24,13 @@ FILE *wlibc_freopen(const char *restrict name, const char *restrict mode, FILE *
 	int new_fd;
 	int flags = parse_mode(mode);
 
+	// Memory streams can't be reopened.
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		errno = EBADF;
+		return NULL;
+	}
+
 	// Flush the stream first
 	common_fflush(stream);
 
@@ -61,10 +68,6 @@ FILE *wlibc_freopen(const char *restrict name, const char *restrict mode, FILE *
 	if (new_fd == -1)
 	{
 		// Failed to create a new stream, cleanup the current stream properly
-		if ((stream->buf_mode & _IOBUFFER_INTERNAL) && (stream->buf_mode & _IOBUFFER_ALLOCATED))
-		{
-			RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
-		}
 		delete_stream(stream);
 		return NULL;
 	}
@@ -75,6 +78,7 @@ FILE *wlibc_freopen(const char *restrict name, const char *restrict mode, FILE *
 	stream->end = 0;
 	stream->pos = 0;
 	stream->prev_op = 0;
+	stream->flags = (get_fd_flags(new_fd) & O_APPEND) ? _IOSTREAM_APPEND : 0;
 	// Remove these buffer bits as we are setting them below based on mode
 	stream->buf_mode = stream->buf_mode & ~(_IOBUFFER_RDONLY | _IOBUFFER_WRONLY | _IOBUFFER_RDWR);
 	stream->buf_mode |= get_buf_mode(flags);
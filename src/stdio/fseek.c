@@ -14,6 +14,11 @@ int common_fflush(FILE *stream);
 
 int common_fseek(FILE *stream, ssize_t offset, int whence)
 {
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_seek(stream, offset, whence);
+	}
+
 	// If the stream was written to previously flush
 	if (stream->prev_op == OP_WRITE)
 	{
@@ -35,6 +40,7 @@ int common_fseek(FILE *stream, ssize_t offset, int whence)
 
 	if (result != -1)
 	{
+		stream->flags &= ~_IOSTREAM_RELPOS;
 		stream->pos = result;
 		stream->start = stream->pos;
 		stream->end = stream->pos;
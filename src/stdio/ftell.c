@@ -9,13 +9,57 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+
+int common_fposition(FILE *stream)
+{
+	off_t position;
+	ssize_t delta;
+
+	if ((stream->flags & _IOSTREAM_RELPOS) == 0)
+	{
+		return 0;
+	}
+
+	if (stream->prev_op == OP_WRITE)
+	{
+		// Everything written so far is at the end of the file, the buffered data will follow it.
+		position = lseek(stream->fd, 0, SEEK_END);
+		if (position == -1)
+		{
+			return -1;
+		}
+
+		position += stream->pos - stream->start;
+	}
+	else
+	{
+		// Reading after appending, the read ahead data is before the file position.
+		position = lseek(stream->fd, 0, SEEK_CUR);
+		if (position == -1)
+		{
+			return -1;
+		}
+
+		position -= stream->end - stream->pos;
+	}
+
+	delta = position - stream->pos;
+
+	stream->pos += delta;
+	stream->start += delta;
+	stream->end += delta;
+	stream->flags &= ~_IOSTREAM_RELPOS;
+
+	return 0;
+}
 
 ssize_t wlibc_ftell(FILE *stream)
 {
 	VALIDATE_FILE_STREAM(stream, EOF);
 	ssize_t result;
 	LOCK_FILE_STREAM(stream);
-	result = stream->pos;
+	result = (common_fposition(stream) == 0) ? (ssize_t)stream->pos : -1;
 	UNLOCK_FILE_STREAM(stream);
 	return result;
 }
@@ -9,16 +9,22 @@
 #include <internal/stdio.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
-size_t common_fwrite(const void *restrict buffer, size_t size, size_t count, FILE *restrict stream)
+// Check the stream can be written to and for buffered streams, set up the write buffer.
+int common_fwrite_begin(FILE *stream)
 {
-	ssize_t result = 0;
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_write_begin(stream);
+	}
 
 	// An error has occured.
 	if (stream->error == _IOERROR)
 	{
-		return 0;
+		return -1;
 	}
 
 	// Stream was opened for reading only.
@@ -26,115 +32,188 @@ size_t common_fwrite(const void *restrict buffer, size_t size, size_t count, FIL
 	{
 		errno = EACCES;
 		stream->error = _IOERROR;
-		return 0;
+		return -1;
 	}
 
 	// unbuffered stream
-	if ((stream->buf_mode & _IONBF))
+	if (stream->buf_mode & _IONBF)
 	{
+		if (stream->flags & _IOSTREAM_APPEND)
+		{
+			stream->flags |= _IOSTREAM_RELPOS;
+		}
 
-		result = write(stream->fd, buffer, size * count);
-		stream->prev_op = OP_WRITE;
+		return 0;
+	}
 
-		if (result != -1)
+	if (stream->prev_op != OP_WRITE) // OP_READ or 'nothing'
+	{
+		// Appending writes are positioned by the file system, there is no need to seek to the end here.
+		// The position is found only if ftell asks for it.
+		if (stream->flags & _IOSTREAM_APPEND)
 		{
-			stream->pos += result;
-			stream->start = stream->pos;
-			stream->end = stream->pos;
+			stream->flags |= _IOSTREAM_RELPOS;
+		}
+		// If the previous operation was a read, seek to where the stream position actually is.
+		else if (stream->prev_op == OP_READ) // not appending
+		{
+			lseek(stream->fd, stream->pos, SEEK_SET);
 		}
+		stream->start = stream->pos;
+		stream->end = stream->pos;
 	}
-	else
-	{
+	stream->prev_op = OP_WRITE;
 
-		if (stream->prev_op != OP_WRITE) // OP_READ or 'nothing'
+	// allocate the buffer if not allocated already
+	if ((stream->buf_mode & _IOBUFFER_INTERNAL) && ((stream->buf_mode & _IOBUFFER_ALLOCATED) == 0))
+	{
+		stream->buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(char) * stream->buf_size);
+		if (stream->buffer == NULL)
 		{
-			// Seek to end of file if we are 'starting' to append.
-			if (get_fd_flags(stream->fd) & O_APPEND)
-			{
-				stream->pos = lseek(stream->fd, 0, SEEK_END);
-			}
-			// If the previous operation was a read, seek to where the stream position actually is.
-			else if (stream->prev_op == OP_READ) // not appending
-			{
-				lseek(stream->fd, stream->pos, SEEK_SET);
-			}
-			stream->start = stream->pos;
-			stream->end = stream->pos;
+			errno = ENOMEM;
+			return -1;
 		}
-		stream->prev_op = OP_WRITE;
 
-		// allocate the buffer if not allocated already
-		if ((stream->buf_mode & _IOBUFFER_INTERNAL) && ((stream->buf_mode & _IOBUFFER_ALLOCATED) == 0))
-		{
-			stream->buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(char) * stream->buf_size);
-			if (stream->buffer == NULL)
-			{
-				errno = ENOMEM;
-				return 0;
-			}
+		stream->buf_mode |= _IOBUFFER_ALLOCATED;
+	}
+
+	if (stream->start == stream->end && ((stream->buf_mode & _IOBUFFER_ALLOCATED) || (stream->buf_mode & _IOBUFFER_EXTERNAL)))
+	{
+		stream->start = stream->pos;
+		stream->end = stream->pos + stream->buf_size;
+	}
+
+	return 0;
+}
+
+// Write out the buffered data and make the whole buffer available again.
+int common_fwrite_spill(FILE *stream)
+{
+	// Memory streams grow instead.
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_spill(stream);
+	}
 
-			stream->buf_mode |= _IOBUFFER_ALLOCATED;
+	if (stream->pos != stream->start)
+	{
+		if (write(stream->fd, stream->buffer, stream->pos - stream->start) == -1)
+		{
+			stream->error = _IOERROR;
+			return -1;
 		}
+	}
+
+	stream->start = stream->pos;
+	stream->end = stream->pos + stream->buf_size;
 
-		if (stream->start == stream->end && ((stream->buf_mode & _IOBUFFER_ALLOCATED) || (stream->buf_mode & _IOBUFFER_EXTERNAL)))
+	return 0;
+}
+
+int common_fflush(FILE *stream);
+
+// Line buffered streams are flushed once a newline is written to them.
+static void line_flush(FILE *stream, const void *buffer, size_t size)
+{
+	if ((stream->buf_mode & _IOLBF) && memchr(buffer, '\n', size) != NULL)
+	{
+		common_fflush(stream);
+	}
+}
+
+size_t common_fwrite(const void *restrict buffer, size_t size, size_t count, FILE *restrict stream)
+{
+	ssize_t result = 0;
+
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return memstream_write(stream, buffer, size * count) / size;
+	}
+
+	if (common_fwrite_begin(stream) == -1)
+	{
+		return 0;
+	}
+
+	// unbuffered stream
+	if ((stream->buf_mode & _IONBF))
+	{
+
+		result = write(stream->fd, buffer, size * count);
+		stream->prev_op = OP_WRITE;
+
+		if (result != -1)
 		{
+			stream->pos += result;
 			stream->start = stream->pos;
-			stream->end = stream->pos + stream->buf_size;
+			stream->end = stream->pos;
 		}
-
+	}
+	else
+	{
 		size_t data_size = size * count;
 
 		if (data_size <= stream->end - stream->pos)
 		{
 			memcpy(stream->buffer + (stream->pos - stream->start), buffer, data_size);
 			stream->pos += data_size;
+			line_flush(stream, buffer, data_size);
 			return count;
 		}
 
 		else // if (data_size > stream->end - stream->pos)
 		{
-			size_t bytes_written = 0;
-			ssize_t write_result = 1;
+			// Write out the buffered data along with the new data in one call.
+			struct iovec iov[2];
+			size_t pending = stream->pos - stream->start;
+			size_t total = pending + data_size;
+			size_t written = 0;
+			int index = (pending == 0) ? 1 : 0;
 
-			// fill out the write buffer first if not empty.
-			if (stream->end - stream->pos != stream->buf_size)
+			iov[0].iov_base = stream->buffer;
+			iov[0].iov_len = pending;
+			iov[1].iov_base = (void *)buffer;
+			iov[1].iov_len = data_size;
+
+			while (written < total)
 			{
-				memcpy(stream->buffer + (stream->pos - stream->start), buffer, stream->end - stream->pos);
-				if (write(stream->fd, stream->buffer, stream->buf_size) == -1)
+				ssize_t write_result = writev(stream->fd, iov + index, 2 - index);
+				if (write_result <= 0)
 				{
 					stream->error = _IOERROR;
-					return 0;
+					break;
 				}
 
-				bytes_written = stream->end - stream->pos;
-			}
+				written += write_result;
 
-			while (bytes_written + stream->buf_size < data_size)
-			{
-				// Write directly from the target buffer
-				write_result = write(stream->fd, (char *)buffer + bytes_written, stream->buf_size);
-				if (write_result == -1) // ERROR
+				// Short write, skip past what was written.
+				while (index < 2 && (size_t)write_result >= iov[index].iov_len)
 				{
-					break;
+					write_result -= iov[index].iov_len;
+					++index;
+				}
+
+				if (index < 2)
+				{
+					iov[index].iov_base = (char *)iov[index].iov_base + write_result;
+					iov[index].iov_len -= write_result;
 				}
-				bytes_written += write_result;
 			}
-			result = bytes_written;
-			stream->pos += bytes_written;
-			// writes until this point are not buffered by us
-			stream->start = stream->pos;
-			stream->end = stream->pos;
 
-			if (write_result > 0)
+			if (written < pending)
 			{
-				// copy the remaining bytes into the stream buffer
-				size_t remaining_copy_size = (data_size - bytes_written);
-				memcpy(stream->buffer, (char *)buffer + bytes_written, remaining_copy_size);
-				stream->end = stream->pos + stream->buf_size;
-				stream->start = stream->pos;
-				stream->pos += remaining_copy_size;
-				result += remaining_copy_size;
+				// Keep the part of the buffered data that was not written, like a failed flush does.
+				memmove(stream->buffer, stream->buffer + written, pending - written);
+				stream->start += written;
+				stream->end = stream->start + stream->buf_size;
+				return 0;
 			}
+
+			// The buffered data was already accounted for.
+			result = written - pending;
+			stream->pos += result;
+			stream->start = stream->pos;
+			stream->end = stream->pos + stream->buf_size;
 		}
 	}
 
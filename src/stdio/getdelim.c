@@ -10,74 +10,112 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int common_fgetc(FILE *stream);
-int common_fseek(FILE *stream, ssize_t offset, int whence);
 size_t common_fread(void *restrict buffer, size_t size, size_t count, FILE *restrict stream);
 
+static int reserve_line_buffer(char **restrict buffer, size_t *restrict size, size_t required)
+{
+	size_t buffer_size = *size;
+	char *temp;
+
+	if (required <= buffer_size)
+	{
+		return 0;
+	}
+
+	// Double the buffer.
+	while (buffer_size < required)
+	{
+		buffer_size *= 2;
+	}
+
+	temp = (char *)realloc(*buffer, buffer_size);
+	if (temp == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	*buffer = temp;
+	*size = buffer_size;
+
+	return 0;
+}
+
 ssize_t common_getdelim(char **restrict buffer, size_t *restrict size, int delimiter, FILE *restrict stream)
 {
 	char ch = 0;
-	ssize_t result = 0;
-	size_t buffer_size = *size;
+	size_t result = 0;
 
 	if (*buffer == NULL)
 	{
 		// Allocate 512 bytes initially
-		buffer_size = 512;
-		*buffer = (char *)malloc(buffer_size);
+		*buffer = (char *)malloc(512);
 		if (*buffer == NULL)
 		{
 			errno = ENOMEM;
 			return -1;
 		}
 
-		*size = buffer_size;
+		*size = 512;
 	}
 
-	/*
-	 TODO : Improve preformance of this function.
-	 NOTE : While doing so keep in mind that this needs to work with pipes as well.
-	*/
 	while (1)
 	{
-		ch = (char)common_fgetc(stream);
-		if (ch == EOF)
+		// Consume whatever is present in the stream buffer in one go.
+		if (((stream->buf_mode & _IONBF) == 0) && stream->prev_op == OP_READ && stream->pos < stream->end)
 		{
-			result = -1;
-			break;
-		}
+			char *window = stream->buffer + (stream->pos - stream->start);
+			size_t available = stream->end - stream->pos;
+			char *found = (char *)memchr(window, delimiter, available);
+			size_t count = (found != NULL) ? (size_t)(found - window) + 1 : available;
+
+			// Leave space for the NULL terminator.
+			if (reserve_line_buffer(buffer, size, result + count + 1) == -1)
+			{
+				return -1;
+			}
 
-		(*buffer)[result] = ch;
-		++result;
+			memcpy(*buffer + result, window, count);
+			stream->pos += count;
+			result += count;
 
-		if (ch == delimiter)
-		{
-			break;
+			if (found != NULL)
+			{
+				break;
+			}
 		}
 
-		if (result == (ssize_t)*size)
+		// The stream buffer is empty. Read one byte through fread, this refills the stream buffer with a block
+		// for buffered streams. For pipes the refill returns whatever is available, so we never block on a partial line.
+		if (common_fread(&ch, 1, 1, stream) == 0)
 		{
-			// Double the buffer.
-			char *temp = (char *)realloc(*buffer, buffer_size * 2);
-			if (temp == NULL)
+			// Return an unterminated last line as is.
+			if (result == 0)
 			{
-				errno = ENOMEM;
 				return -1;
 			}
 
-			*buffer = temp;
-			buffer_size *= 2;
-			*size = buffer_size;
+			break;
 		}
-	}
 
-	if (result != -1)
-	{
-		(*buffer)[result] = '\0';
+		if (reserve_line_buffer(buffer, size, result + 2) == -1)
+		{
+			return -1;
+		}
+
+		(*buffer)[result++] = ch;
+
+		if (ch == (char)delimiter)
+		{
+			break;
+		}
 	}
 
-	return result;
+	(*buffer)[result] = '\0';
+
+	return (ssize_t)result;
 }
 
 ssize_t wlibc_getdelim(char **restrict buffer, size_t *restrict size, int delimiter, FILE *restrict stream)
@@ -8,91 +8,186 @@
 #include <internal/nt.h>
 #include <internal/fcntl.h>
 #include <internal/stdio.h>
+#include <fcntl.h>
 
-FILE *_wlibc_stdio_head = NULL;
+stdio_shard _wlibc_stdio_shards[STDIO_SHARDS];
 
 FILE *_wlibc_stdin = NULL;
 FILE *_wlibc_stdout = NULL;
 FILE *_wlibc_stderr = NULL;
 
-RTL_CRITICAL_SECTION _wlibc_stdio_critical;
-
-static void insert_stream(FILE *stream);
-
 void initialize_stdio(void)
 {
-	RtlInitializeCriticalSection(&_wlibc_stdio_critical);
+	size_t buf_size;
+	int buf_type;
+
+	for (int i = 0; i < STDIO_SHARDS; ++i)
+	{
+		RtlInitializeCriticalSection(&(_wlibc_stdio_shards[i].critical));
+		_wlibc_stdio_shards[i].head = NULL;
+		_wlibc_stdio_shards[i].cache = NULL;
+		_wlibc_stdio_shards[i].cache_count = 0;
+	}
+
+	buf_type = get_buf_type(0, &buf_size);
+	_wlibc_stdin = create_stream(0, buf_type | _IOBUFFER_INTERNAL | _IOBUFFER_RDONLY, (int)buf_size);
 
-	_wlibc_stdin = create_stream(0, _IOFBF | _IOBUFFER_INTERNAL | _IOBUFFER_RDONLY, 512);
-	_wlibc_stdout = create_stream(1, _IOFBF | _IOBUFFER_INTERNAL | _IOBUFFER_WRONLY, 512);
+	buf_type = get_buf_type(1, &buf_size);
+	_wlibc_stdout = create_stream(1, buf_type | _IOBUFFER_INTERNAL | _IOBUFFER_WRONLY, (int)buf_size);
 	_wlibc_stderr = create_stream(2, _IONBF | _IOBUFFER_WRONLY, 0);
 }
 
 int common_fflush(FILE *stream);
 
+static void free_stream(FILE *stream)
+{
+	if (stream->buffer != NULL && (stream->buf_mode & _IOBUFFER_INTERNAL) && (stream->buf_mode & _IOBUFFER_ALLOCATED))
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+	}
+
+	RtlDeleteCriticalSection(&(stream->critical));
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, stream);
+}
+
 void close_all_streams(void)
 {
-	LOCK_STDIO();
+	FILE *stream;
 
-	FILE *head = _wlibc_stdio_head;
+	// Hold every shard so that the streams are flushed before any of the descriptors are closed.
+	for (int i = 0; i < STDIO_SHARDS; ++i)
+	{
+		LOCK_STDIO_SHARD(i);
+	}
 
 	// Flush all streams first.
-	while (_wlibc_stdio_head != NULL)
+	for (int i = 0; i < STDIO_SHARDS; ++i)
 	{
-		FILE *prev = _wlibc_stdio_head->prev;
-
-		// Flush buffered data.
-		common_fflush(_wlibc_stdio_head);
-
-		// Free internal buffers if any.
-		if (_wlibc_stdio_head->buffer != NULL && (_wlibc_stdio_head->buf_mode & _IOBUFFER_INTERNAL))
+		for (stream = _wlibc_stdio_shards[i].head; stream != NULL; stream = stream->prev)
 		{
-			RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_stdio_head->buffer);
-		}
-		RtlDeleteCriticalSection(&(_wlibc_stdio_head->critical));
+			// Flush buffered data.
+			common_fflush(stream);
 
-		_wlibc_stdio_head = prev;
+			if (stream->fd == FD_MEMSTREAM)
+			{
+				memstream_close(stream);
+			}
+		}
 	}
 
-	_wlibc_stdio_head = head;
+	_wlibc_stdin = NULL;
+	_wlibc_stdout = NULL;
+	_wlibc_stderr = NULL;
 
 	// Then close all associated file descriptors.
-	while (_wlibc_stdio_head != NULL)
+	for (int i = 0; i < STDIO_SHARDS; ++i)
 	{
-		FILE *prev = _wlibc_stdio_head->prev;
+		stdio_shard *shard = &_wlibc_stdio_shards[i];
+
+		while (shard->head != NULL)
+		{
+			stream = shard->head;
+			shard->head = stream->prev;
 
-		close_fd(_wlibc_stdio_head->fd);
-		RtlFreeHeap(NtCurrentProcessHeap(), 0, _wlibc_stdio_head);
+			if (stream->fd != FD_MEMSTREAM)
+			{
+				close_fd(stream->fd);
+			}
 
-		_wlibc_stdio_head = prev;
+			free_stream(stream);
+		}
+
+		while (shard->cache != NULL)
+		{
+			stream = shard->cache;
+			shard->cache = stream->next;
+			free_stream(stream);
+		}
+
+		shard->cache_count = 0;
 	}
 
-	UNLOCK_STDIO();
+	for (int i = STDIO_SHARDS - 1; i >= 0; --i)
+	{
+		UNLOCK_STDIO_SHARD(i);
+	}
 }
 
 void cleanup_stdio(void)
 {
 	close_all_streams();
-	RtlDeleteCriticalSection(&_wlibc_stdio_critical);
+
+	for (int i = 0; i < STDIO_SHARDS; ++i)
+	{
+		RtlDeleteCriticalSection(&(_wlibc_stdio_shards[i].critical));
+	}
 }
 
-FILE *create_stream(int fd, int buf_mode, int buf_size)
+FILE *allocate_stream(int fd, int buf_mode, int buf_size)
 {
-	FILE *stream = (FILE *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FILE));
+	unsigned int index = STDIO_CURRENT_SHARD();
+	stdio_shard *shard = &_wlibc_stdio_shards[index];
+	FILE *stream;
+
+	LOCK_STDIO_SHARD(index);
+
+	stream = shard->cache;
+	if (stream != NULL)
+	{
+		shard->cache = stream->next;
+		shard->cache_count--;
+	}
+
+	UNLOCK_STDIO_SHARD(index);
 
 	if (stream == NULL)
 	{
-		errno = ENOMEM;
-		return NULL;
+		stream = (FILE *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FILE));
+
+		if (stream == NULL)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+
+		RtlInitializeCriticalSection(&(stream->critical));
+	}
+	else
+	{
+		// A cached stream keeps its critical section and possibly its buffer. Keep the buffer if it is of the same size.
+		if (stream->buffer != NULL && ((buf_mode & _IOBUFFER_INTERNAL) == 0 || stream->buf_size != (size_t)buf_size))
+		{
+			RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+			stream->buffer = NULL;
+		}
+
+		if (stream->buffer != NULL)
+		{
+			buf_mode |= _IOBUFFER_ALLOCATED;
+		}
+
+		stream->error = 0;
+		stream->start = 0;
+		stream->end = 0;
+		stream->pos = 0;
+		stream->prev_op = 0;
+		stream->flags = 0;
+		stream->phandle = NULL;
+		stream->memstream = NULL;
 	}
 
 	stream->magic = FILE_STREAM_MAGIC;
 	stream->fd = fd;
 	stream->buf_mode = buf_mode;
 	stream->buf_size = buf_size;
+	stream->shard = index;
+	stream->prev = NULL;
+	stream->next = NULL;
 
-	RtlInitializeCriticalSection(&(stream->critical));
-	insert_stream(stream);
+	if (fd >= 0 && (get_fd_flags(fd) & O_APPEND))
+	{
+		stream->flags |= _IOSTREAM_APPEND;
+	}
 
 	return stream;
 }
@@ -100,25 +195,44 @@ FILE *create_stream(int fd, int buf_mode, int buf_size)
 void insert_stream(FILE *stream)
 {
 	// stream won't be null here.
-	LOCK_STDIO();
+	stdio_shard *shard = &_wlibc_stdio_shards[stream->shard];
 
-	stream->prev = _wlibc_stdio_head;
+	LOCK_STDIO_SHARD(stream->shard);
+
+	stream->prev = shard->head;
 	stream->next = NULL;
 
-	if (_wlibc_stdio_head != NULL)
+	if (shard->head != NULL)
+	{
+		shard->head->next = stream;
+	}
+
+	shard->head = stream;
+
+	UNLOCK_STDIO_SHARD(stream->shard);
+}
+
+FILE *create_stream(int fd, int buf_mode, int buf_size)
+{
+	FILE *stream = allocate_stream(fd, buf_mode, buf_size);
+
+	if (stream == NULL)
 	{
-		_wlibc_stdio_head->next = stream;
+		return NULL;
 	}
 
-	_wlibc_stdio_head = stream;
+	insert_stream(stream);
 
-	UNLOCK_STDIO();
+	return stream;
 }
 
 void delete_stream(FILE *stream)
 {
 	// stream won't be null here.
-	LOCK_STDIO();
+	stdio_shard *shard = &_wlibc_stdio_shards[stream->shard];
+	int cached = 0;
+
+	LOCK_STDIO_SHARD(stream->shard);
 
 	if (stream->prev != NULL && stream->next != NULL)
 	{
@@ -128,7 +242,7 @@ void delete_stream(FILE *stream)
 	else if (stream->prev != NULL && stream->next == NULL)
 	{
 		stream->prev->next = NULL;
-		_wlibc_stdio_head = stream->prev;
+		shard->head = stream->prev;
 	}
 	else if (stream->prev == NULL && stream->next != NULL)
 	{
@@ -136,11 +250,50 @@ void delete_stream(FILE *stream)
 	}
 	else // if(stream->prev == NULL && stream->next == NULL)
 	{
-		_wlibc_stdio_head = NULL;
+		shard->head = NULL;
 	}
 
-	RtlDeleteCriticalSection(&(stream->critical));
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, stream);
+	// Closing one of the standard streams.
+	if (stream == _wlibc_stdin)
+	{
+		_wlibc_stdin = NULL;
+	}
+	if (stream == _wlibc_stdout)
+	{
+		_wlibc_stdout = NULL;
+	}
+	if (stream == _wlibc_stderr)
+	{
+		_wlibc_stderr = NULL;
+	}
+
+	// Keep the stream around for the next open. Large buffers are not worth holding on to.
+	if (shard->cache_count < STDIO_CACHE_SIZE)
+	{
+		if ((stream->buf_mode & _IOBUFFER_INTERNAL) == 0 || (stream->buf_mode & _IOBUFFER_ALLOCATED) == 0 ||
+			stream->buf_size > STDIO_FILE_BUFFER_SIZE)
+		{
+			if (stream->buffer != NULL && (stream->buf_mode & _IOBUFFER_INTERNAL) && (stream->buf_mode & _IOBUFFER_ALLOCATED))
+			{
+				RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+			}
+
+			stream->buffer = NULL;
+		}
 
-	UNLOCK_STDIO();
+		// Stale uses of the stream fail validation.
+		stream->magic = 0;
+		stream->prev = NULL;
+		stream->next = shard->cache;
+		shard->cache = stream;
+		shard->cache_count++;
+		cached = 1;
+	}
+
+	UNLOCK_STDIO_SHARD(stream->shard);
+
+	if (!cached)
+	{
+		free_stream(stream);
+	}
 }
@@ -0,0 +1,464 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEMSTREAM_DYNAMIC 0x1 // open_memstream, the buffer grows and is handed to the caller.
+#define MEMSTREAM_OWNED   0x2 // fmemopen with a NULL buffer, freed on close.
+#define MEMSTREAM_APPEND  0x4 // Writes always go to the end.
+
+// Initial capacity of open_memstream buffers.
+#define MEMSTREAM_INITIAL_SIZE 512
+
+typedef struct _WLIBC_MEMSTREAM
+{
+	size_t length; // Size of the contents. Stale while writing, the writes only advance 'pos'.
+	int flags;
+	char **bufferp; // open_memstream
+	size_t *sizep;  // open_memstream
+} memstream;
+
+// Bring the length up to date after writes and publish the buffer for open_memstream.
+static void memstream_sync(FILE *stream)
+{
+	memstream *mem = stream->memstream;
+
+	if (stream->prev_op == OP_WRITE)
+	{
+		if (stream->pos > mem->length)
+		{
+			mem->length = stream->pos;
+		}
+
+		// Dynamic buffers always have space for the NULL terminator, fixed ones only if it fits.
+		if ((mem->flags & MEMSTREAM_DYNAMIC) || mem->length < stream->buf_size)
+		{
+			stream->buffer[mem->length] = '\0';
+		}
+	}
+
+	if (mem->flags & MEMSTREAM_DYNAMIC)
+	{
+		*mem->bufferp = stream->buffer;
+		*mem->sizep = __min(stream->pos, mem->length);
+	}
+}
+
+// Make sure the buffer can hold 'size' bytes. Fixed buffers can't grow.
+static int memstream_reserve(FILE *stream, size_t size)
+{
+	memstream *mem = stream->memstream;
+	size_t capacity = stream->buf_size;
+	char *buffer;
+
+	if (size <= capacity)
+	{
+		return 0;
+	}
+
+	if ((mem->flags & MEMSTREAM_DYNAMIC) == 0)
+	{
+		errno = ENOSPC;
+		return -1;
+	}
+
+	// Grow geometrically so that a stream built up by small writes is copied only a few times.
+	capacity = __max(capacity * 2, size);
+
+	// Caller freeable buffer, use realloc. One more byte for the NULL terminator.
+	buffer = (char *)realloc(stream->buffer, capacity + 1);
+	if (buffer == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	stream->buffer = buffer;
+	stream->buf_size = capacity;
+
+	return 0;
+}
+
+int memstream_write_begin(FILE *stream)
+{
+	memstream *mem = stream->memstream;
+
+	// An error has occured.
+	if (stream->error == _IOERROR)
+	{
+		return -1;
+	}
+
+	// Stream was opened for reading only.
+	if (stream->buf_mode & _IOBUFFER_RDONLY)
+	{
+		errno = EACCES;
+		stream->error = _IOERROR;
+		return -1;
+	}
+
+	if (stream->prev_op != OP_WRITE)
+	{
+		if (mem->flags & MEMSTREAM_APPEND)
+		{
+			stream->pos = mem->length;
+		}
+
+		// Seeked past the end, the gap reads as zeros.
+		if (stream->pos > mem->length)
+		{
+			if (memstream_reserve(stream, stream->pos) == -1)
+			{
+				stream->error = _IOERROR;
+				return -1;
+			}
+
+			memset(stream->buffer + mem->length, 0, stream->pos - mem->length);
+			mem->length = stream->pos;
+		}
+
+		stream->prev_op = OP_WRITE;
+	}
+
+	// The whole buffer can be written into.
+	stream->start = 0;
+	stream->end = stream->buf_size;
+
+	return 0;
+}
+
+int memstream_spill(FILE *stream)
+{
+	if (memstream_reserve(stream, stream->pos + 1) == -1)
+	{
+		stream->error = _IOERROR;
+		return -1;
+	}
+
+	stream->end = stream->buf_size;
+
+	return 0;
+}
+
+size_t memstream_write(FILE *restrict stream, const void *restrict buffer, size_t size)
+{
+	size_t available;
+
+	if (memstream_write_begin(stream) == -1)
+	{
+		return 0;
+	}
+
+	available = stream->buf_size - stream->pos;
+
+	if (size > available)
+	{
+		if (memstream_reserve(stream, stream->pos + size) == -1)
+		{
+			// Fixed buffers take what fits.
+			if (available == 0)
+			{
+				stream->error = _IOERROR;
+				return 0;
+			}
+
+			size = available;
+		}
+
+		stream->end = stream->buf_size;
+	}
+
+	memcpy(stream->buffer + stream->pos, buffer, size);
+	stream->pos += size;
+
+	return size;
+}
+
+size_t memstream_read(FILE *restrict stream, void *restrict buffer, size_t size)
+{
+	memstream *mem = stream->memstream;
+	size_t count;
+
+	// Stream has reached it's end or an error has occured.
+	if (stream->error == _IOEOF || stream->error == _IOERROR)
+	{
+		return 0;
+	}
+
+	// Stream was opened for writing only.
+	if (stream->buf_mode & _IOBUFFER_WRONLY)
+	{
+		errno = EACCES;
+		stream->error = _IOERROR;
+		return 0;
+	}
+
+	memstream_sync(stream);
+
+	// Everything up to the length can be read, the fast paths read from the buffer directly.
+	stream->prev_op = OP_READ;
+	stream->start = 0;
+	stream->end = __max(mem->length, stream->pos);
+
+	if (stream->pos >= mem->length)
+	{
+		stream->error = _IOEOF;
+		return 0;
+	}
+
+	count = __min(size, mem->length - stream->pos);
+	memcpy(buffer, stream->buffer + stream->pos, count);
+	stream->pos += count;
+
+	if (count < size)
+	{
+		stream->error = _IOEOF;
+	}
+
+	return count;
+}
+
+int memstream_peek(FILE *stream, const char **buffer, size_t *size)
+{
+	memstream *mem = stream->memstream;
+
+	if (stream->error == _IOERROR)
+	{
+		errno = EIO;
+		return -1;
+	}
+
+	// Stream was opened for writing only.
+	if (stream->buf_mode & _IOBUFFER_WRONLY)
+	{
+		errno = EACCES;
+		stream->error = _IOERROR;
+		return -1;
+	}
+
+	memstream_sync(stream);
+
+	// All of the contents are already in memory.
+	stream->prev_op = OP_READ;
+	stream->start = 0;
+	stream->end = __max(mem->length, stream->pos);
+
+	*buffer = stream->buffer + stream->pos;
+	*size = stream->end - stream->pos;
+
+	return 0;
+}
+
+int memstream_seek(FILE *stream, ssize_t offset, int whence)
+{
+	memstream *mem = stream->memstream;
+	size_t base = 0;
+
+	memstream_sync(stream);
+
+	switch (whence)
+	{
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = stream->pos;
+		break;
+	case SEEK_END:
+		base = mem->length;
+		break;
+	}
+
+	if (offset < 0 && (size_t)-offset > base)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Fixed buffers can't be seeked past their size.
+	if ((mem->flags & MEMSTREAM_DYNAMIC) == 0 && base + offset > stream->buf_size)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	stream->pos = base + offset;
+
+	// The next operation sets up the window again.
+	stream->prev_op = 0;
+	stream->start = 0;
+	stream->end = 0;
+
+	if (whence == SEEK_SET && offset == 0)
+	{
+		// Clear any error
+		stream->error = 0;
+	}
+	else
+	{
+		// Clear eof only
+		stream->error = stream->error & ~_IOEOF;
+	}
+
+	return 0;
+}
+
+int memstream_flush(FILE *stream)
+{
+	memstream_sync(stream);
+	return 0;
+}
+
+void memstream_close(FILE *stream)
+{
+	memstream *mem = stream->memstream;
+
+	memstream_sync(stream);
+
+	// The buffer of open_memstream now belongs to the caller.
+	if (mem->flags & MEMSTREAM_OWNED)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, stream->buffer);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, mem);
+
+	stream->buffer = NULL;
+	stream->memstream = NULL;
+}
+
+static FILE *create_memstream(const memstream *state, char *buffer, size_t size, size_t pos, int buf_mode)
+{
+	FILE *stream;
+	memstream *mem;
+
+	mem = (memstream *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(memstream));
+	if (mem == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	*mem = *state;
+
+	stream = allocate_stream(FD_MEMSTREAM, _IOFBF | _IOBUFFER_EXTERNAL | buf_mode, 0);
+	if (stream == NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, mem);
+		return NULL;
+	}
+
+	stream->buffer = buffer;
+	stream->buf_size = size;
+	stream->pos = pos;
+	stream->memstream = mem;
+
+	// Only insert the stream once it is complete, fflush(NULL) might visit it otherwise.
+	insert_stream(stream);
+
+	return stream;
+}
+
+FILE *wlibc_fmemopen(void *restrict buffer, size_t size, const char *restrict mode)
+{
+	FILE *stream;
+	memstream state = {0};
+	char *memory = (char *)buffer;
+	int oflags;
+
+	if (size == 0 || mode == NULL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	oflags = parse_mode(mode);
+
+	if (memory == NULL)
+	{
+		memory = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, size);
+		if (memory == NULL)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+
+		state.flags |= MEMSTREAM_OWNED;
+	}
+
+	if (oflags & O_APPEND)
+	{
+		// Append from the first NULL byte.
+		state.flags |= MEMSTREAM_APPEND;
+		state.length = strnlen(memory, size);
+	}
+	else if (oflags & O_TRUNC)
+	{
+		state.length = 0;
+		memory[0] = '\0';
+	}
+	else
+	{
+		state.length = size;
+	}
+
+	stream = create_memstream(&state, memory, size, (state.flags & MEMSTREAM_APPEND) ? state.length : 0, get_buf_mode(oflags));
+	if (stream == NULL)
+	{
+		if (state.flags & MEMSTREAM_OWNED)
+		{
+			RtlFreeHeap(NtCurrentProcessHeap(), 0, memory);
+		}
+	}
+
+	return stream;
+}
+
+FILE *wlibc_open_memstream(char **buffer, size_t *size)
+{
+	FILE *stream;
+	memstream state = {0};
+	char *memory;
+
+	if (buffer == NULL || size == NULL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// Caller freeable buffer, use malloc.
+	memory = (char *)malloc(MEMSTREAM_INITIAL_SIZE + 1);
+	if (memory == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memory[0] = '\0';
+
+	state.flags = MEMSTREAM_DYNAMIC;
+	state.bufferp = buffer;
+	state.sizep = size;
+
+	stream = create_memstream(&state, memory, MEMSTREAM_INITIAL_SIZE, 0, _IOBUFFER_WRONLY);
+	if (stream == NULL)
+	{
+		free(memory);
+		return NULL;
+	}
+
+	*buffer = memory;
+	*size = 0;
+
+	return stream;
+}
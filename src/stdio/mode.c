@@ -5,6 +5,8 @@
    Refer to the LICENSE file at the root directory for details.
 */
 
+#include <internal/nt.h>
+#include <internal/fcntl.h>
 #include <internal/stdio.h>
 #include <fcntl.h>
 #include <string.h>
@@ -83,3 +85,71 @@ int get_buf_mode(int flags)
 		return _IOBUFFER_RDONLY;
 	}
 }
+
+int get_buf_type(int fd, size_t *size)
+{
+	NTSTATUS status;
+	IO_STATUS_BLOCK io;
+	fdinfo info;
+	size_t buf_size = STDIO_DEFAULT_BUFFER_SIZE;
+	int type = _IOFBF;
+
+	get_fdinfo(fd, &info);
+
+	switch (info.type)
+	{
+	case CONSOLE_HANDLE:
+		// Interactive, flush on every newline.
+		type = _IOLBF;
+		break;
+
+	case FILE_HANDLE:
+	{
+		FILE_FS_SIZE_INFORMATION size_info;
+		size_t cluster_size;
+
+		buf_size = STDIO_FILE_BUFFER_SIZE;
+
+		// Keep the buffer a multiple of the cluster size so that buffered io stays aligned to it.
+		status = NtQueryVolumeInformationFile(info.handle, &io, &size_info, sizeof(FILE_FS_SIZE_INFORMATION), FileFsSizeInformation);
+		if (status == STATUS_SUCCESS)
+		{
+			cluster_size = (size_t)size_info.BytesPerSector * size_info.SectorsPerAllocationUnit;
+			if (cluster_size != 0)
+			{
+				buf_size = ((STDIO_FILE_BUFFER_SIZE + cluster_size - 1) / cluster_size) * cluster_size;
+			}
+		}
+		break;
+	}
+
+	case PIPE_HANDLE:
+	{
+		FILE_PIPE_LOCAL_INFORMATION pipe_info;
+
+		// Match the pipe's buffer, a larger write would only block midway.
+		status = NtQueryInformationFile(info.handle, &io, &pipe_info, sizeof(FILE_PIPE_LOCAL_INFORMATION), FilePipeLocalInformation);
+		if (status == STATUS_SUCCESS)
+		{
+			buf_size = __max(pipe_info.InboundQuota, pipe_info.OutboundQuota);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	if (buf_size < STDIO_DEFAULT_BUFFER_SIZE)
+	{
+		buf_size = STDIO_DEFAULT_BUFFER_SIZE;
+	}
+
+	if (buf_size > STDIO_MAX_BUFFER_SIZE)
+	{
+		buf_size = STDIO_MAX_BUFFER_SIZE;
+	}
+
+	*size = buf_size;
+	return type;
+}
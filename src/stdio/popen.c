@@ -105,7 +105,10 @@ FILE *wlibc_popen(const char *restrict command, const char *restrict mode)
 		fd = register_to_fd_table(write_end, PIPE_HANDLE, O_WRONLY);
 	}
 
-	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | _IOFBF | get_buf_mode(pmode), 4096);
+	size_t buf_size;
+	int buf_type = get_buf_type(fd, &buf_size);
+
+	FILE *stream = create_stream(fd, _IOBUFFER_INTERNAL | buf_type | get_buf_mode(pmode), (int)buf_size);
 	stream->phandle = PINFO.hProcess;
 
 	return stream;
@@ -6,82 +6,181 @@
 */
 
 #include <internal/nt.h>
+#include <internal/format.h>
+#include <internal/stdio.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <corecrt_stdio_config.h>
 
-int __cdecl __stdio_common_vsprintf_p(_In_ unsigned __int64 _Options, _Out_writes_z_(_BufferCount) char *_Buffer, _In_ size_t _BufferCount,
-									  _In_z_ _Printf_format_string_params_(2) char const *_Format, _In_opt_ _locale_t _Locale,
-									  va_list _ArgList);
+size_t common_fwrite(const void *restrict buffer, size_t size, size_t count, FILE *restrict stream);
+int common_fwrite_begin(FILE *stream);
+int common_fwrite_spill(FILE *stream);
+int common_fflush(FILE *stream);
 
-int number_of_chars(const char *restrict format, va_list args)
+// Most formatted output is small, format it on the stack and only go to the heap when it does not fit.
+#define PRINTF_STACK_BUFFER_SIZE 512
+
+int print_chars(char *restrict buffer, size_t size, const char *restrict format, va_list args)
+{
+	return format_string(buffer, size, format, args);
+}
+
+// Format into the given buffer. If the output does not fit, format again into a heap buffer.
+// Returns the buffer holding the output (NULL terminated), or NULL on failure. Release it with release_chars.
+static char *format_chars(char *restrict buffer, size_t size, int *restrict count, const char *restrict format, va_list args)
 {
+	va_list args_copy;
+	char *heap_buffer;
+
 	if (format == NULL)
 	{
 		errno = EINVAL;
-		return -1;
+		return NULL;
+	}
+
+	va_copy(args_copy, args);
+	*count = print_chars(buffer, size, format, args);
+
+	if (*count < 0)
+	{
+		va_end(args_copy);
+		return NULL;
+	}
+
+	// Common case, everything fit in one pass.
+	if ((size_t)*count < size)
+	{
+		va_end(args_copy);
+		return buffer;
 	}
 
-	return __stdio_common_vsprintf_p(_CRT_INTERNAL_LOCAL_PRINTF_OPTIONS | _CRT_INTERNAL_PRINTF_STANDARD_SNPRINTF_BEHAVIOR, NULL, 0, format,
-									 NULL, args);
+	heap_buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, *count + 1);
+	if (heap_buffer == NULL)
+	{
+		va_end(args_copy);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	print_chars(heap_buffer, *count + 1, format, args_copy);
+	va_end(args_copy);
+
+	return heap_buffer;
 }
 
-int print_chars(char *restrict buffer, size_t size, const char *restrict format, va_list args)
+static void release_chars(char *restrict buffer, char *restrict stack_buffer)
 {
-	return __stdio_common_vsprintf_p(_CRT_INTERNAL_LOCAL_PRINTF_OPTIONS | _CRT_INTERNAL_PRINTF_STANDARD_SNPRINTF_BEHAVIOR, buffer, size,
-									 format, NULL, args);
+	if (buffer != stack_buffer)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, buffer);
+	}
 }
 
-int wlibc_vfprintf(FILE *restrict stream, const char *restrict format, va_list args)
+// The stream buffer is full, write it out and continue formatting from its beginning.
+static int spill_stream(format_sink *sink)
 {
-	int count = number_of_chars(format, args);
-	if (count == -1)
+	FILE *stream = (FILE *)sink->context;
+
+	stream->pos += sink->used;
+	sink->used = 0;
+
+	if (common_fwrite_spill(stream) == -1)
 	{
 		return -1;
 	}
 
-	char *buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, count + 1);
-	if (buffer == NULL)
+	sink->buffer = stream->buffer + (stream->pos - stream->start);
+	sink->size = stream->end - stream->pos;
+
+	return 0;
+}
+
+int wlibc_vfprintf(FILE *restrict stream, const char *restrict format, va_list args)
+{
+	char stack_buffer[PRINTF_STACK_BUFFER_SIZE];
+	char *buffer;
+	format_sink sink;
+	int count;
+	int result;
+
+	VALIDATE_FILE_STREAM(stream, -1);
+
+	LOCK_FILE_STREAM(stream);
+
+	if (common_fwrite_begin(stream) == -1)
 	{
-		errno = ENOMEM;
+		UNLOCK_FILE_STREAM(stream);
 		return -1;
 	}
 
-	print_chars(buffer, count + 1, format, args);
-	int result = (int)fwrite(buffer, 1, count, stream);
+	// Unbuffered streams, format everything first so that it goes out in one write.
+	if (stream->buf_mode & _IONBF)
+	{
+		buffer = format_chars(stack_buffer, PRINTF_STACK_BUFFER_SIZE, &count, format, args);
+		if (buffer == NULL)
+		{
+			UNLOCK_FILE_STREAM(stream);
+			return -1;
+		}
+
+		result = count > 0 ? (int)common_fwrite(buffer, 1, count, stream) : 0;
+		release_chars(buffer, stack_buffer);
+		UNLOCK_FILE_STREAM(stream);
+
+		return result;
+	}
+
+	// Buffered streams, format directly into the stream buffer.
+	sink.buffer = stream->buffer + (stream->pos - stream->start);
+	sink.size = stream->end - stream->pos;
+	sink.used = 0;
+	sink.spill = spill_stream;
+	sink.context = stream;
+
+	result = format_to_sink(&sink, format, args);
+	stream->pos += sink.used;
+
+	// Whatever was spilled has been written already, only the rest needs to be checked for a newline.
+	if ((stream->buf_mode & _IOLBF) && memchr(sink.buffer, '\n', sink.used) != NULL)
+	{
+		common_fflush(stream);
+	}
+
+	UNLOCK_FILE_STREAM(stream);
 
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, buffer);
 	return result;
 }
 
 int wlibc_vdprintf(int fd, const char *restrict format, va_list args)
 {
-	int count = number_of_chars(format, args);
-	if (count == -1)
-	{
-		return -1;
-	}
+	char stack_buffer[PRINTF_STACK_BUFFER_SIZE];
+	char *buffer;
+	int count;
+	int result;
 
-	char *buffer = (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, count + 1);
+	buffer = format_chars(stack_buffer, PRINTF_STACK_BUFFER_SIZE, &count, format, args);
 	if (buffer == NULL)
 	{
-		errno = ENOMEM;
 		return -1;
 	}
 
-	print_chars(buffer, count + 1, format, args);
-	int result = (int)write(fd, buffer, count);
+	result = (int)write(fd, buffer, count);
+	release_chars(buffer, stack_buffer);
 
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, buffer);
 	return result;
 }
 
 int wlibc_vasprintf(char **restrict buffer, const char *restrict format, va_list args)
 {
-	int count = number_of_chars(format, args);
-	if (count == -1)
+	char stack_buffer[PRINTF_STACK_BUFFER_SIZE];
+	char *temp;
+	int count;
+
+	temp = format_chars(stack_buffer, PRINTF_STACK_BUFFER_SIZE, &count, format, args);
+	if (temp == NULL)
 	{
 		return -1;
 	}
@@ -90,11 +189,15 @@ int wlibc_vasprintf(char **restrict buffer, const char *restrict format, va_list
 	*buffer = (char *)malloc(count + 1);
 	if (*buffer == NULL)
 	{
+		release_chars(temp, stack_buffer);
 		errno = ENOMEM;
 		return -1;
 	}
 
-	return print_chars(*buffer, count + 1, format, args);
+	memcpy(*buffer, temp, count + 1);
+	release_chars(temp, stack_buffer);
+
+	return count;
 }
 
 int wlibc_vsnprintf(char *restrict buffer, size_t size, const char *restrict format, va_list args)
@@ -110,37 +213,51 @@ int wlibc_vsnprintf(char *restrict buffer, size_t size, const char *restrict for
 		return -1;
 	}
 
-	return __stdio_common_vsprintf_p(_CRT_INTERNAL_LOCAL_PRINTF_OPTIONS | _CRT_INTERNAL_PRINTF_STANDARD_SNPRINTF_BEHAVIOR, buffer, size,
-									 format, NULL, args);
+	return format_string(buffer, size, format, args);
 }
 
 char *wlibc_vasnprintf(char *restrict buffer, size_t *size, const char *restrict format, va_list args)
 {
-	int count = number_of_chars(format, args);
-	if (count == -1)
-	{
-		return NULL;
-	}
+	char stack_buffer[PRINTF_STACK_BUFFER_SIZE];
+	char *temp;
+	int count;
 
-	// Use the buffer provided.
-	if (buffer != NULL && *size >= (size_t)count)
+	// Use the buffer provided, if it is large enough.
+	if (buffer != NULL && *size > 0)
 	{
-		count = print_chars(buffer, *size, format, args);
-		*size = count;
-		return buffer;
+		temp = format_chars(buffer, *size, &count, format, args);
+		if (temp == NULL)
+		{
+			return NULL;
+		}
+
+		if (temp == buffer)
+		{
+			*size = count;
+			return buffer;
+		}
 	}
 	else
 	{
-		// Allocate a new buffer.
-		buffer = (char *)malloc(count + 1);
-		if (buffer == NULL)
+		temp = format_chars(stack_buffer, PRINTF_STACK_BUFFER_SIZE, &count, format, args);
+		if (temp == NULL)
 		{
-			errno = ENOMEM;
 			return NULL;
 		}
+	}
 
-		count = print_chars(buffer, *size, format, args);
-		*size = count;
-		return buffer;
+	// Allocate a new buffer.
+	buffer = (char *)malloc(count + 1);
+	if (buffer == NULL)
+	{
+		release_chars(temp, stack_buffer);
+		errno = ENOMEM;
+		return NULL;
 	}
+
+	memcpy(buffer, temp, count + 1);
+	release_chars(temp, stack_buffer);
+
+	*size = count;
+	return buffer;
 }
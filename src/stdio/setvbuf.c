@@ -17,7 +17,14 @@ int common_setvbuf(FILE *restrict stream, char *restrict buffer, int mode, size_
 {
 	int buf_type = stream->buf_mode & (_IOBUFFER_RDONLY | _IOBUFFER_WRONLY | _IOBUFFER_RDWR);
 
+	// Memory streams are their own buffer.
+	if (stream->fd == FD_MEMSTREAM)
+	{
+		return 0;
+	}
+
 	// Always seek first
+	common_fposition(stream);
 	lseek(stream->fd, stream->pos, SEEK_SET);
 	stream->start = stream->pos;
 	stream->end = stream->pos;
@@ -20,8 +20,20 @@ int common_ungetc(int ch, FILE *stream)
 
 	if (stream->pos > stream->start)
 	{
+		// The buffer of a memory stream is the caller's memory, don't modify it. Only the character that was read can be pushed back.
+		if (stream->fd == FD_MEMSTREAM)
+		{
+			if (stream->buffer[stream->pos - stream->start - 1] != (char)ch)
+			{
+				return EOF;
+			}
+		}
+		else
+		{
+			stream->buffer[stream->pos - stream->start - 1] = (char)ch;
+		}
+
 		stream->pos--;
-		stream->buffer[stream->pos - stream->start] = (char)ch;
 		// clear eof flag
 		stream->error = stream->error & ~_IOEOF;
 		return ch;
@@ -0,0 +1,856 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <internal/poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+
+#define EPOLL_READ_EVENTS   (EPOLLIN | EPOLLRDNORM)
+#define EPOLL_WRITE_EVENTS  (EPOLLOUT | EPOLLWRNORM)
+#define EPOLL_POLL_EVENTS   0xffff // The lower bits match the poll events.
+#define EPOLL_INITIAL_SLOTS 64
+
+// How an entry is waited on for input.
+#define EPOLL_WATCH_NONE   0 // Checked on every wait.
+#define EPOLL_WATCH_PIPE   1 // A pipe watcher (see internal/poll.h).
+#define EPOLL_WATCH_HANDLE 2 // A thread pool wait on the handle of the fd.
+
+/*
+ The interest list is kept in the instance indexed by fd, the fdinfo of each fd is captured when it is added.
+ Only the entries on the ready list are checked by epoll_wait.
+
+ Entries with read interest are put back on the ready list once they might have input, without a thread of their own.
+ Pipes (blocking or not) are watched through the event their file system signals on every change. Consoles, eventfds,
+ timerfds, signalfds and nested epoll instances have handles that are signaled while they are readable, a one shot thread
+ pool wait is registered on them. An entry is armed after it is found to be not ready, which is done with the instance locked,
+ so nothing that happens in between is missed.
+
+ Readiness of pipes for writing can't be waited on. Entries with write interest on a pipe stay on the ready list and are
+ checked on every wait, at an interval of 10ms while nothing is ready. So are entries that could not be watched.
+
+ Events are always reported level triggered, EPOLLET is accepted but behaves the same.
+*/
+
+typedef struct _epoll_entry
+{
+	struct _epoll_entry *next; // Links of the ready list.
+	struct _epoll_entry *prev;
+	struct _epoll_instance *instance;
+	fdinfo info;
+	int fd;
+	int queued;   // On the ready list.
+	int disabled; // An EPOLLONESHOT entry that has reported its events.
+	uint32_t events;
+	epoll_data_t data;
+	int watch;         // EPOLL_WATCH_*
+	int armed;         // Waiting for input, cleared when it is notified.
+	pipe_watcher pipe; // EPOLL_WATCH_PIPE
+	HANDLE wait;       // EPOLL_WATCH_HANDLE, the last wait registered.
+	int stop;          // Removed from the instance.
+} epoll_entry;
+
+typedef struct _epoll_instance
+{
+	struct _epoll_instance *next; // Link of the registry.
+	HANDLE handle;                // Handle of the fd.
+	HANDLE event;                 // Signaled when there might be events to report. Duplicate of 'handle'.
+	RTL_SRWLOCK lock;
+	volatile LONG references;
+	int closed;
+	epoll_entry **slots; // fd -> entry
+	int slot_count;
+	epoll_entry *head; // Ready list
+	epoll_entry *tail;
+	size_t ready_count;
+} epoll_instance;
+
+// Registry of the open epoll instances.
+static epoll_instance *_wlibc_epoll_instances = NULL;
+static RTL_SRWLOCK _wlibc_epoll_registry_lock;
+
+static void ready_push(epoll_instance *instance, epoll_entry *entry)
+{
+	if (entry->queued)
+	{
+		return;
+	}
+
+	entry->next = NULL;
+	entry->prev = instance->tail;
+
+	if (instance->tail != NULL)
+	{
+		instance->tail->next = entry;
+	}
+	else
+	{
+		instance->head = entry;
+	}
+
+	instance->tail = entry;
+	entry->queued = 1;
+	++instance->ready_count;
+}
+
+static void ready_remove(epoll_instance *instance, epoll_entry *entry)
+{
+	if (!entry->queued)
+	{
+		return;
+	}
+
+	if (entry->prev != NULL)
+	{
+		entry->prev->next = entry->next;
+	}
+	else
+	{
+		instance->head = entry->next;
+	}
+
+	if (entry->next != NULL)
+	{
+		entry->next->prev = entry->prev;
+	}
+	else
+	{
+		instance->tail = entry->prev;
+	}
+
+	entry->next = NULL;
+	entry->prev = NULL;
+	entry->queued = 0;
+	--instance->ready_count;
+}
+
+// Called by the thread pool when an armed entry might have input.
+static void epoll_entry_notify(void *context)
+{
+	epoll_entry *entry = (epoll_entry *)context;
+	epoll_instance *instance = entry->instance;
+
+	RtlAcquireSRWLockExclusive(&instance->lock);
+
+	if (entry->armed && entry->stop == 0)
+	{
+		entry->armed = 0;
+		ready_push(instance, entry);
+		NtSetEvent(instance->event, NULL);
+	}
+
+	RtlReleaseSRWLockExclusive(&instance->lock);
+}
+
+static VOID CALLBACK epoll_wait_callback(PVOID context, BOOLEAN timeout)
+{
+	UNREFERENCED_PARAMETER(timeout);
+	epoll_entry_notify(context);
+}
+
+static int epoll_watch_type(const fdinfo *info)
+{
+	if (info->flags & O_WRONLY)
+	{
+		return EPOLL_WATCH_NONE;
+	}
+
+	switch (info->type)
+	{
+	case PIPE_HANDLE:
+		return EPOLL_WATCH_PIPE;
+	case CONSOLE_HANDLE:
+	case EPOLL_HANDLE:
+	case EVENTFD_HANDLE:
+	case TIMERFD_HANDLE:
+	case SIGNALFD_HANDLE:
+		// Console input handles are signaled when there are input records, epoll instances when they might have events
+		// and eventfd, timerfd and signalfd handles when they are readable.
+		return EPOLL_WATCH_HANDLE;
+	default:
+		return EPOLL_WATCH_NONE;
+	}
+}
+
+// Create an entry for the fd. Starting a pipe watcher takes locks of its own, call this without holding the instance lock.
+static epoll_entry *epoll_entry_create(epoll_instance *instance, int fd, const fdinfo *info, const struct epoll_event *event)
+{
+	epoll_entry *entry;
+
+	entry = (epoll_entry *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(epoll_entry));
+	if (entry == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	entry->instance = instance;
+	entry->info = *info;
+	entry->fd = fd;
+	entry->events = event->events;
+	entry->data = event->data;
+	entry->watch = epoll_watch_type(info);
+
+	if (entry->watch == EPOLL_WATCH_PIPE)
+	{
+		entry->pipe.notify = epoll_entry_notify;
+		entry->pipe.context = entry;
+
+		// Fall back to checking it on every wait.
+		if (start_pipe_watcher(&entry->pipe, info->handle) == -1)
+		{
+			entry->watch = EPOLL_WATCH_NONE;
+		}
+	}
+
+	return entry;
+}
+
+// Wait for input on the entry. The instance lock should be held. Returns -1 if it can't be waited on.
+static int epoll_entry_arm(epoll_entry *entry)
+{
+	if (entry->watch == EPOLL_WATCH_HANDLE)
+	{
+		// The previous wait has fired (the entry is not armed), its callback is done with the entry.
+		if (entry->wait != NULL)
+		{
+			UnregisterWait(entry->wait);
+			entry->wait = NULL;
+		}
+
+		if (!RegisterWaitForSingleObject(&entry->wait, entry->info.handle, epoll_wait_callback, entry, INFINITE,
+										 WT_EXECUTEONLYONCE))
+		{
+			entry->wait = NULL;
+			return -1;
+		}
+	}
+
+	entry->armed = 1;
+	return 0;
+}
+
+// Remove the entry from the instance. The instance lock should be held, the entry is freed later with `epoll_entry_free`.
+static void epoll_entry_unlink(epoll_instance *instance, epoll_entry *entry)
+{
+	ready_remove(instance, entry);
+	instance->slots[entry->fd] = NULL;
+	entry->stop = 1;
+}
+
+// Stop watching and free the entry. Call this without holding the instance lock, a callback might be waiting on it.
+static void epoll_entry_free(epoll_entry *entry)
+{
+	if (entry->watch == EPOLL_WATCH_PIPE)
+	{
+		stop_pipe_watcher(&entry->pipe);
+	}
+
+	if (entry->wait != NULL)
+	{
+		UnregisterWaitEx(entry->wait, INVALID_HANDLE_VALUE);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, entry);
+}
+
+static void epoll_entry_free_list(epoll_entry *list)
+{
+	epoll_entry *next;
+
+	while (list != NULL)
+	{
+		next = list->next;
+		epoll_entry_free(list);
+		list = next;
+	}
+}
+
+static int epoll_reserve_slot(epoll_instance *instance, int fd)
+{
+	epoll_entry **slots;
+	int count;
+
+	if (fd < instance->slot_count)
+	{
+		return 0;
+	}
+
+	count = instance->slot_count == 0 ? EPOLL_INITIAL_SLOTS : instance->slot_count;
+
+	while (count <= fd)
+	{
+		count *= 2;
+	}
+
+	if (instance->slots == NULL)
+	{
+		slots = (epoll_entry **)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(epoll_entry *) * count);
+	}
+	else
+	{
+		slots = (epoll_entry **)RtlReAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, instance->slots, sizeof(epoll_entry *) * count);
+	}
+
+	if (slots == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	instance->slots = slots;
+	instance->slot_count = count;
+
+	return 0;
+}
+
+static epoll_instance *epoll_acquire(int epfd)
+{
+	fdinfo info;
+	epoll_instance *instance;
+
+	get_fdinfo(epfd, &info);
+
+	if (info.type == INVALID_HANDLE)
+	{
+		errno = EBADF;
+		return NULL;
+	}
+
+	if (info.type != EPOLL_HANDLE)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	RtlAcquireSRWLockShared(&_wlibc_epoll_registry_lock);
+
+	for (instance = _wlibc_epoll_instances; instance != NULL; instance = instance->next)
+	{
+		if (instance->handle == info.handle)
+		{
+			_InterlockedIncrement(&instance->references);
+			break;
+		}
+	}
+
+	RtlReleaseSRWLockShared(&_wlibc_epoll_registry_lock);
+
+	// Duplicates of an epoll fd are not tracked.
+	if (instance == NULL)
+	{
+		errno = EINVAL;
+	}
+
+	return instance;
+}
+
+static void epoll_release(epoll_instance *instance)
+{
+	epoll_entry *list = NULL;
+
+	if (_InterlockedDecrement(&instance->references) != 0)
+	{
+		return;
+	}
+
+	// The watchers might still notify the entries.
+	RtlAcquireSRWLockExclusive(&instance->lock);
+
+	for (int i = 0; i < instance->slot_count; ++i)
+	{
+		epoll_entry *entry = instance->slots[i];
+
+		if (entry != NULL)
+		{
+			epoll_entry_unlink(instance, entry);
+			entry->next = list;
+			list = entry;
+		}
+	}
+
+	RtlReleaseSRWLockExclusive(&instance->lock);
+
+	epoll_entry_free_list(list);
+
+	if (instance->slots != NULL)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, instance->slots);
+	}
+
+	NtClose(instance->event);
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, instance);
+}
+
+// Close hook of the fds that can be added to an instance. Closed fds are removed from the interest lists they are part of.
+static void epoll_close_fd(int fd, HANDLE handle)
+{
+	epoll_instance *instance;
+	epoll_entry *entry, *list = NULL;
+
+	RtlAcquireSRWLockShared(&_wlibc_epoll_registry_lock);
+
+	for (instance = _wlibc_epoll_instances; instance != NULL; instance = instance->next)
+	{
+		RtlAcquireSRWLockExclusive(&instance->lock);
+
+		if (fd < instance->slot_count && instance->slots[fd] != NULL && instance->slots[fd]->info.handle == handle)
+		{
+			entry = instance->slots[fd];
+			epoll_entry_unlink(instance, entry);
+			entry->next = list;
+			list = entry;
+		}
+
+		RtlReleaseSRWLockExclusive(&instance->lock);
+	}
+
+	RtlReleaseSRWLockShared(&_wlibc_epoll_registry_lock);
+
+	epoll_entry_free_list(list);
+}
+
+// Close hook of epoll fds.
+static void epoll_close_instance(int fd, HANDLE handle)
+{
+	epoll_instance *instance, *prev = NULL;
+
+	// The instance might be part of other interest lists, their waits on it have to go before the handle does.
+	if (fd >= 0)
+	{
+		epoll_close_fd(fd, handle);
+	}
+
+	RtlAcquireSRWLockExclusive(&_wlibc_epoll_registry_lock);
+
+	for (instance = _wlibc_epoll_instances; instance != NULL; prev = instance, instance = instance->next)
+	{
+		if (instance->handle == handle)
+		{
+			if (prev == NULL)
+			{
+				_wlibc_epoll_instances = instance->next;
+			}
+			else
+			{
+				prev->next = instance->next;
+			}
+
+			break;
+		}
+	}
+
+	RtlReleaseSRWLockExclusive(&_wlibc_epoll_registry_lock);
+
+	if (instance == NULL)
+	{
+		return;
+	}
+
+	// Wake up any waiters, they will see the instance is closed.
+	RtlAcquireSRWLockExclusive(&instance->lock);
+	instance->closed = 1;
+	NtSetEvent(instance->event, NULL);
+	RtlReleaseSRWLockExclusive(&instance->lock);
+
+	epoll_release(instance);
+}
+
+int wlibc_epoll_create1(int flags)
+{
+	NTSTATUS status;
+	epoll_instance *instance;
+	HANDLE handle = NULL;
+	int fd;
+
+	if (flags & ~EPOLL_CLOEXEC)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	instance = (epoll_instance *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(epoll_instance));
+	if (instance == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	status = NtCreateEvent(&handle, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	// Keep our own handle to the event, waiters use it even if the fd is closed underneath them.
+	status = NtDuplicateObject(NtCurrentProcess(), handle, NtCurrentProcess(), &instance->event, 0, 0, DUPLICATE_SAME_ACCESS);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		goto fail;
+	}
+
+	RtlInitializeSRWLock(&instance->lock);
+	instance->handle = handle;
+	instance->references = 1;
+
+	register_fd_close_hook(EPOLL_HANDLE, epoll_close_instance);
+	register_fd_close_hook(PIPE_HANDLE, epoll_close_fd);
+	register_fd_close_hook(CONSOLE_HANDLE, epoll_close_fd);
+	register_fd_close_hook(EVENTFD_HANDLE, epoll_close_fd);
+	register_fd_close_hook(TIMERFD_HANDLE, epoll_close_fd);
+	register_fd_close_hook(SIGNALFD_HANDLE, epoll_close_fd);
+
+	RtlAcquireSRWLockExclusive(&_wlibc_epoll_registry_lock);
+	instance->next = _wlibc_epoll_instances;
+	_wlibc_epoll_instances = instance;
+	RtlReleaseSRWLockExclusive(&_wlibc_epoll_registry_lock);
+
+	fd = register_to_fd_table(handle, EPOLL_HANDLE, O_RDONLY | (flags & EPOLL_CLOEXEC));
+	if (fd == -1)
+	{
+		// Nothing can refer to the instance yet.
+		epoll_close_instance(-1, handle);
+		NtClose(handle);
+		return -1;
+	}
+
+	return fd;
+
+fail:
+	if (instance->event != NULL)
+	{
+		NtClose(instance->event);
+	}
+
+	if (handle != NULL)
+	{
+		NtClose(handle);
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, instance);
+	return -1;
+}
+
+int wlibc_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+	epoll_instance *instance;
+	epoll_entry *entry, *created = NULL, *stale = NULL;
+	fdinfo info;
+	int result = -1;
+
+	if (op != EPOLL_CTL_ADD && op != EPOLL_CTL_DEL && op != EPOLL_CTL_MOD)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (op != EPOLL_CTL_DEL && event == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	instance = epoll_acquire(epfd);
+	if (instance == NULL)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == INVALID_HANDLE)
+	{
+		errno = EBADF;
+		goto finish;
+	}
+
+	if (info.handle == instance->handle)
+	{
+		errno = EINVAL;
+		goto finish;
+	}
+
+	// Like Linux, regular files and directories are always ready and can't be added.
+	if (info.type == FILE_HANDLE || info.type == DIRECTORY_HANDLE || info.type == NULL_HANDLE)
+	{
+		errno = EPERM;
+		goto finish;
+	}
+
+	// Starting the watcher of the entry can't be done with the instance lock held.
+	if (op == EPOLL_CTL_ADD)
+	{
+		created = epoll_entry_create(instance, fd, &info, event);
+		if (created == NULL)
+		{
+			goto finish;
+		}
+	}
+
+	RtlAcquireSRWLockExclusive(&instance->lock);
+
+	entry = fd < instance->slot_count ? instance->slots[fd] : NULL;
+
+	// The fd was closed and reused after it was added.
+	if (entry != NULL && entry->info.sequence != info.sequence)
+	{
+		epoll_entry_unlink(instance, entry);
+		stale = entry;
+		entry = NULL;
+	}
+
+	switch (op)
+	{
+	case EPOLL_CTL_ADD:
+		if (entry != NULL)
+		{
+			errno = EEXIST;
+			break;
+		}
+
+		if (epoll_reserve_slot(instance, fd) == -1)
+		{
+			break;
+		}
+
+		// Check the fd on the next wait, the entry is armed after that.
+		entry = created;
+		created = NULL;
+		instance->slots[fd] = entry;
+		ready_push(instance, entry);
+		NtSetEvent(instance->event, NULL);
+		result = 0;
+		break;
+
+	case EPOLL_CTL_MOD:
+		if (entry == NULL)
+		{
+			errno = ENOENT;
+			break;
+		}
+
+		entry->events = event->events;
+		entry->data = event->data;
+		entry->disabled = 0;
+
+		ready_push(instance, entry);
+		NtSetEvent(instance->event, NULL);
+		result = 0;
+		break;
+
+	case EPOLL_CTL_DEL:
+		if (entry == NULL)
+		{
+			errno = ENOENT;
+			break;
+		}
+
+		epoll_entry_unlink(instance, entry);
+		entry->next = stale;
+		stale = entry;
+		result = 0;
+		break;
+	}
+
+	RtlReleaseSRWLockExclusive(&instance->lock);
+
+	if (created != NULL)
+	{
+		epoll_entry_free(created);
+	}
+
+	epoll_entry_free_list(stale);
+
+finish:
+	epoll_release(instance);
+	return result;
+}
+
+// Report the ready entries. The instance lock should be held.
+// Entries of closed fds are moved to 'stale', 'recheck' is set if there are entries that have to be checked again later.
+static int epoll_collect(epoll_instance *instance, struct epoll_event *events, int maxevents, epoll_entry **stale, int *recheck)
+{
+	int result = 0;
+	size_t count = instance->ready_count;
+	epoll_entry *entry;
+	struct pollfd pfd;
+	fdinfo info;
+
+	// Entries that stay ready go to the back of the list, every entry is looked at once.
+	for (; count > 0 && result < maxevents; --count)
+	{
+		entry = instance->head;
+		ready_remove(instance, entry);
+
+		get_fdinfo(entry->fd, &info);
+
+		if (info.type == INVALID_HANDLE || info.sequence != entry->info.sequence)
+		{
+			epoll_entry_unlink(instance, entry);
+			entry->next = *stale;
+			*stale = entry;
+			continue;
+		}
+
+		if (entry->disabled)
+		{
+			continue;
+		}
+
+		pfd.fd = entry->fd;
+		pfd.events = (short)(entry->events & EPOLL_POLL_EVENTS);
+		common_poll_check(&entry->info, &pfd);
+
+		if (pfd.revents == 0)
+		{
+			// Wait for input. Without interest in it the entry stays off the list until it is modified.
+			if ((entry->events & EPOLL_READ_EVENTS) && entry->watch != EPOLL_WATCH_NONE && !entry->armed)
+			{
+				if (epoll_entry_arm(entry) == -1)
+				{
+					entry->watch = EPOLL_WATCH_NONE;
+				}
+			}
+
+			// Write readiness of pipes is checked again later, as is everything that can't be watched.
+			if (entry->watch == EPOLL_WATCH_NONE ||
+				(entry->info.type == PIPE_HANDLE && (entry->info.flags & (O_WRONLY | O_RDWR)) && (entry->events & EPOLL_WRITE_EVENTS)))
+			{
+				ready_push(instance, entry);
+				*recheck = 1;
+			}
+
+			continue;
+		}
+
+		events[result].events = (uint32_t)(unsigned short)pfd.revents;
+		events[result].data = entry->data;
+
+		if (events[result].events & POLLNVAL)
+		{
+			events[result].events = (events[result].events & ~POLLNVAL) | EPOLLERR;
+		}
+
+		++result;
+
+		if (entry->events & EPOLLONESHOT)
+		{
+			entry->disabled = 1;
+			continue;
+		}
+
+		ready_push(instance, entry);
+	}
+
+	return result;
+}
+
+int wlibc_epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const sigset_t *sigmask)
+{
+	epoll_instance *instance;
+	epoll_entry *stale;
+	LARGE_INTEGER duetime = {0}, current = {0}, remaining, *wait;
+	sigset_t oldmask;
+	int recheck;
+	int result;
+
+	if (events == NULL || maxevents <= 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	instance = epoll_acquire(epfd);
+	if (instance == NULL)
+	{
+		return -1;
+	}
+
+	if (sigmask)
+	{
+		sigprocmask(SIG_SETMASK, sigmask, &oldmask);
+	}
+
+	if (timeout >= 0)
+	{
+		GetSystemTimeAsFileTime((LPFILETIME)&current);
+		duetime.QuadPart = current.QuadPart + (LONGLONG)timeout * 10000;
+	}
+
+	while (1)
+	{
+		stale = NULL;
+		recheck = 0;
+
+		RtlAcquireSRWLockExclusive(&instance->lock);
+
+		if (instance->closed)
+		{
+			RtlReleaseSRWLockExclusive(&instance->lock);
+			errno = EBADF;
+			result = -1;
+			break;
+		}
+
+		result = epoll_collect(instance, events, maxevents, &stale, &recheck);
+
+		if (result == 0)
+		{
+			// Anything that becomes ready from here on sets the event again.
+			NtResetEvent(instance->event, NULL);
+		}
+
+		RtlReleaseSRWLockExclusive(&instance->lock);
+
+		epoll_entry_free_list(stale);
+
+		if (result != 0)
+		{
+			break;
+		}
+
+		wait = NULL;
+
+		if (timeout >= 0)
+		{
+			GetSystemTimeAsFileTime((LPFILETIME)&current);
+
+			if (current.QuadPart >= duetime.QuadPart)
+			{
+				break;
+			}
+
+			// Relative timeout.
+			remaining.QuadPart = current.QuadPart - duetime.QuadPart;
+			wait = &remaining;
+		}
+
+		if (recheck && (wait == NULL || wait->QuadPart < -POLL_RECHECK_INTERVAL))
+		{
+			remaining.QuadPart = -POLL_RECHECK_INTERVAL;
+			wait = &remaining;
+		}
+
+		NtWaitForSingleObject(instance->event, FALSE, wait);
+	}
+
+	if (sigmask)
+	{
+		sigprocmask(SIG_SETMASK, &oldmask, NULL);
+	}
+
+	epoll_release(instance);
+
+	return result;
+}
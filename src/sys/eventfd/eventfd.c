@@ -0,0 +1,213 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <internal/validate.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+#define EVENTFD_MAX 0xfffffffffffffffeull
+
+/*
+ The handle of the fd is a notification event, set while the counter is not zero.
+ Writers blocked on a full counter wait on 'space', which is set by every read.
+*/
+
+typedef struct _eventfd_object
+{
+	fd_object object;
+	HANDLE space;
+	uint64_t counter;
+	int semaphore;
+} eventfd_object;
+
+static ssize_t eventfd_object_read(fd_object *object, void *buffer, size_t count, int flags)
+{
+	eventfd_object *eventfd = (eventfd_object *)object;
+	uint64_t value;
+
+	if (count < sizeof(uint64_t))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	RtlAcquireSRWLockExclusive(&object->lock);
+
+	while (eventfd->counter == 0)
+	{
+		RtlReleaseSRWLockExclusive(&object->lock);
+
+		if (flags & O_NONBLOCK)
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+
+		NtWaitForSingleObject(object->handle, FALSE, NULL);
+		RtlAcquireSRWLockExclusive(&object->lock);
+	}
+
+	value = eventfd->semaphore ? 1 : eventfd->counter;
+	eventfd->counter -= value;
+
+	if (eventfd->counter == 0)
+	{
+		NtResetEvent(object->handle, NULL);
+	}
+
+	NtSetEvent(eventfd->space, NULL);
+
+	RtlReleaseSRWLockExclusive(&object->lock);
+
+	memcpy(buffer, &value, sizeof(uint64_t));
+
+	return sizeof(uint64_t);
+}
+
+static ssize_t eventfd_object_write(fd_object *object, const void *buffer, size_t count, int flags)
+{
+	eventfd_object *eventfd = (eventfd_object *)object;
+	uint64_t value;
+
+	if (count < sizeof(uint64_t))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(&value, buffer, sizeof(uint64_t));
+
+	if (value > EVENTFD_MAX)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	RtlAcquireSRWLockExclusive(&object->lock);
+
+	while (value > EVENTFD_MAX - eventfd->counter)
+	{
+		// Reset with the lock held, a read in between the release and the wait will set it again.
+		NtResetEvent(eventfd->space, NULL);
+		RtlReleaseSRWLockExclusive(&object->lock);
+
+		if (flags & O_NONBLOCK)
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+
+		NtWaitForSingleObject(eventfd->space, FALSE, NULL);
+		RtlAcquireSRWLockExclusive(&object->lock);
+	}
+
+	eventfd->counter += value;
+
+	if (eventfd->counter != 0)
+	{
+		NtSetEvent(object->handle, NULL);
+	}
+
+	RtlReleaseSRWLockExclusive(&object->lock);
+
+	return sizeof(uint64_t);
+}
+
+static void eventfd_object_destroy(fd_object *object)
+{
+	eventfd_object *eventfd = (eventfd_object *)object;
+
+	if (eventfd->space != NULL)
+	{
+		NtClose(eventfd->space);
+	}
+}
+
+int wlibc_eventfd(unsigned int initval, int flags)
+{
+	NTSTATUS status;
+	eventfd_object *eventfd;
+	HANDLE handle;
+
+	if (flags & ~(EFD_SEMAPHORE | EFD_CLOEXEC | EFD_NONBLOCK))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	eventfd = (eventfd_object *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(eventfd_object));
+	if (eventfd == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	eventfd->object.read = eventfd_object_read;
+	eventfd->object.write = eventfd_object_write;
+	eventfd->object.destroy = eventfd_object_destroy;
+	eventfd->counter = initval;
+	eventfd->semaphore = (flags & EFD_SEMAPHORE) != 0;
+
+	status = NtCreateEvent(&eventfd->space, EVENT_ALL_ACCESS, NULL, NotificationEvent, TRUE);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, eventfd);
+		return -1;
+	}
+
+	status = NtCreateEvent(&handle, EVENT_ALL_ACCESS, NULL, NotificationEvent, initval != 0);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		NtClose(eventfd->space);
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, eventfd);
+		return -1;
+	}
+
+	return register_fd_object(&eventfd->object, handle, EVENTFD_HANDLE, O_RDWR | (flags & (EFD_CLOEXEC | EFD_NONBLOCK)));
+}
+
+int wlibc_eventfd_read(int fd, eventfd_t *value)
+{
+	fd_object *object;
+	ssize_t result;
+
+	VALIDATE_PTR(value, EINVAL, -1);
+
+	object = acquire_fd_object(fd, EVENTFD_HANDLE);
+	if (object == NULL)
+	{
+		return -1;
+	}
+
+	result = object->read(object, value, sizeof(eventfd_t), get_fd_flags(fd));
+	release_fd_object(object);
+
+	return result == -1 ? -1 : 0;
+}
+
+int wlibc_eventfd_write(int fd, eventfd_t value)
+{
+	fd_object *object;
+	ssize_t result;
+
+	object = acquire_fd_object(fd, EVENTFD_HANDLE);
+	if (object == NULL)
+	{
+		return -1;
+	}
+
+	result = object->write(object, &value, sizeof(eventfd_t), get_fd_flags(fd));
+	release_fd_object(object);
+
+	return result == -1 ? -1 : 0;
+}
@@ -0,0 +1,101 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/random.h>
+#include <immintrin.h>
+#include <string.h>
+
+// Rotations by 16 and 8 are byte shuffles.
+#define ROTL256(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define ROTL256_16(v) _mm256_shuffle_epi8(v, rot16)
+#define ROTL256_8(v)  _mm256_shuffle_epi8(v, rot8)
+
+#define QUARTERROUND256(a, b, c, d) \
+	a = _mm256_add_epi32(a, b);     \
+	d = _mm256_xor_si256(d, a);     \
+	d = ROTL256_16(d);              \
+	c = _mm256_add_epi32(c, d);     \
+	b = _mm256_xor_si256(b, c);     \
+	b = ROTL256(b, 12);             \
+	a = _mm256_add_epi32(a, b);     \
+	d = _mm256_xor_si256(d, a);     \
+	d = ROTL256_8(d);               \
+	c = _mm256_add_epi32(c, d);     \
+	b = _mm256_xor_si256(b, c);     \
+	b = ROTL256(b, 7);
+
+/*
+ Same as the SSE2 version with 8 blocks. The transpose works within the 128 bit lanes, the lower lane ends up with
+ blocks 0-3 and the upper lane with blocks 4-7.
+ This is in its own file as it needs to be compiled with AVX2 enabled.
+*/
+void chacha20_blocks_avx2(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+						  uint8_t output[8 * CHACHA20_BLOCK_SIZE])
+{
+	const __m256i rot16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1,
+										  0, 3, 2);
+	const __m256i rot8 = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, 14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2,
+										 1, 0, 3);
+	uint32_t state[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+	__m256i s[16], x[16];
+
+	memcpy(state + 4, key, CHACHA20_KEY_WORDS * sizeof(uint32_t));
+	state[12] = counter;
+	memcpy(state + 13, nonce, CHACHA20_NONCE_WORDS * sizeof(uint32_t));
+
+	for (int i = 0; i < 16; ++i)
+	{
+		s[i] = _mm256_set1_epi32((int)state[i]);
+	}
+
+	// Blocks 0-3 in the lower lane, 4-7 in the upper lane.
+	s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+	for (int i = 0; i < 16; ++i)
+	{
+		x[i] = s[i];
+	}
+
+	for (int i = 0; i < 10; ++i)
+	{
+		QUARTERROUND256(x[0], x[4], x[8], x[12]);
+		QUARTERROUND256(x[1], x[5], x[9], x[13]);
+		QUARTERROUND256(x[2], x[6], x[10], x[14]);
+		QUARTERROUND256(x[3], x[7], x[11], x[15]);
+
+		QUARTERROUND256(x[0], x[5], x[10], x[15]);
+		QUARTERROUND256(x[1], x[6], x[11], x[12]);
+		QUARTERROUND256(x[2], x[7], x[8], x[13]);
+		QUARTERROUND256(x[3], x[4], x[9], x[14]);
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		x[i] = _mm256_add_epi32(x[i], s[i]);
+	}
+
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m256i t0 = _mm256_unpacklo_epi32(x[i], x[i + 1]);
+		__m256i t1 = _mm256_unpacklo_epi32(x[i + 2], x[i + 3]);
+		__m256i t2 = _mm256_unpackhi_epi32(x[i], x[i + 1]);
+		__m256i t3 = _mm256_unpackhi_epi32(x[i + 2], x[i + 3]);
+		__m256i b0 = _mm256_unpacklo_epi64(t0, t1);
+		__m256i b1 = _mm256_unpackhi_epi64(t0, t1);
+		__m256i b2 = _mm256_unpacklo_epi64(t2, t3);
+		__m256i b3 = _mm256_unpackhi_epi64(t2, t3);
+
+		_mm_storeu_si128((__m128i *)(output + 0 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_castsi256_si128(b0));
+		_mm_storeu_si128((__m128i *)(output + 1 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_castsi256_si128(b1));
+		_mm_storeu_si128((__m128i *)(output + 2 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_castsi256_si128(b2));
+		_mm_storeu_si128((__m128i *)(output + 3 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_castsi256_si128(b3));
+		_mm_storeu_si128((__m128i *)(output + 4 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_extracti128_si256(b0, 1));
+		_mm_storeu_si128((__m128i *)(output + 5 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_extracti128_si256(b1, 1));
+		_mm_storeu_si128((__m128i *)(output + 6 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_extracti128_si256(b2, 1));
+		_mm_storeu_si128((__m128i *)(output + 7 * CHACHA20_BLOCK_SIZE + i * 4), _mm256_extracti128_si256(b3, 1));
+	}
+}
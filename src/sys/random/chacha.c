@@ -0,0 +1,206 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/random.h>
+#include <emmintrin.h>
+#include <intrin.h>
+#include <string.h>
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d) \
+	a += b;                      \
+	d ^= a;                      \
+	d = ROTL32(d, 16);           \
+	c += d;                      \
+	b ^= c;                      \
+	b = ROTL32(b, 12);           \
+	a += b;                      \
+	d ^= a;                      \
+	d = ROTL32(d, 8);            \
+	c += d;                      \
+	b ^= c;                      \
+	b = ROTL32(b, 7);
+
+// "expand 32-byte k"
+static const uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+
+static void chacha20_init(uint32_t state[16], const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter,
+						  const uint32_t nonce[CHACHA20_NONCE_WORDS])
+{
+	memcpy(state, sigma, 4 * sizeof(uint32_t));
+	memcpy(state + 4, key, CHACHA20_KEY_WORDS * sizeof(uint32_t));
+	state[12] = counter;
+	memcpy(state + 13, nonce, CHACHA20_NONCE_WORDS * sizeof(uint32_t));
+}
+
+void chacha20_block_generic(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+							uint8_t output[CHACHA20_BLOCK_SIZE])
+{
+	uint32_t state[16], x[16];
+
+	chacha20_init(state, key, counter, nonce);
+	memcpy(x, state, sizeof(state));
+
+	for (int i = 0; i < 10; ++i)
+	{
+		// Columns
+		QUARTERROUND(x[0], x[4], x[8], x[12]);
+		QUARTERROUND(x[1], x[5], x[9], x[13]);
+		QUARTERROUND(x[2], x[6], x[10], x[14]);
+		QUARTERROUND(x[3], x[7], x[11], x[15]);
+
+		// Diagonals
+		QUARTERROUND(x[0], x[5], x[10], x[15]);
+		QUARTERROUND(x[1], x[6], x[11], x[12]);
+		QUARTERROUND(x[2], x[7], x[8], x[13]);
+		QUARTERROUND(x[3], x[4], x[9], x[14]);
+	}
+
+	// The words are serialized little endian, same as us.
+	for (int i = 0; i < 16; ++i)
+	{
+		x[i] += state[i];
+	}
+
+	memcpy(output, x, CHACHA20_BLOCK_SIZE);
+}
+
+#define ROTL128(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+#define QUARTERROUND128(a, b, c, d) \
+	a = _mm_add_epi32(a, b);        \
+	d = _mm_xor_si128(d, a);        \
+	d = ROTL128(d, 16);             \
+	c = _mm_add_epi32(c, d);        \
+	b = _mm_xor_si128(b, c);        \
+	b = ROTL128(b, 12);             \
+	a = _mm_add_epi32(a, b);        \
+	d = _mm_xor_si128(d, a);        \
+	d = ROTL128(d, 8);              \
+	c = _mm_add_epi32(c, d);        \
+	b = _mm_xor_si128(b, c);        \
+	b = ROTL128(b, 7);
+
+/*
+ Each vector holds the same word of 4 consecutive blocks, so the rounds are the same as the generic one.
+ The words are transposed back into blocks at the end.
+*/
+void chacha20_blocks_sse2(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+						  uint8_t output[4 * CHACHA20_BLOCK_SIZE])
+{
+	uint32_t state[16];
+	__m128i s[16], x[16];
+
+	chacha20_init(state, key, counter, nonce);
+
+	for (int i = 0; i < 16; ++i)
+	{
+		s[i] = _mm_set1_epi32((int)state[i]);
+	}
+
+	s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+
+	for (int i = 0; i < 16; ++i)
+	{
+		x[i] = s[i];
+	}
+
+	for (int i = 0; i < 10; ++i)
+	{
+		QUARTERROUND128(x[0], x[4], x[8], x[12]);
+		QUARTERROUND128(x[1], x[5], x[9], x[13]);
+		QUARTERROUND128(x[2], x[6], x[10], x[14]);
+		QUARTERROUND128(x[3], x[7], x[11], x[15]);
+
+		QUARTERROUND128(x[0], x[5], x[10], x[15]);
+		QUARTERROUND128(x[1], x[6], x[11], x[12]);
+		QUARTERROUND128(x[2], x[7], x[8], x[13]);
+		QUARTERROUND128(x[3], x[4], x[9], x[14]);
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		x[i] = _mm_add_epi32(x[i], s[i]);
+	}
+
+	// Transpose each group of 4 words, giving the group for each of the blocks.
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128i t0 = _mm_unpacklo_epi32(x[i], x[i + 1]);
+		__m128i t1 = _mm_unpacklo_epi32(x[i + 2], x[i + 3]);
+		__m128i t2 = _mm_unpackhi_epi32(x[i], x[i + 1]);
+		__m128i t3 = _mm_unpackhi_epi32(x[i + 2], x[i + 3]);
+
+		_mm_storeu_si128((__m128i *)(output + 0 * CHACHA20_BLOCK_SIZE + i * 4), _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128((__m128i *)(output + 1 * CHACHA20_BLOCK_SIZE + i * 4), _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128((__m128i *)(output + 2 * CHACHA20_BLOCK_SIZE + i * 4), _mm_unpacklo_epi64(t2, t3));
+		_mm_storeu_si128((__m128i *)(output + 3 * CHACHA20_BLOCK_SIZE + i * 4), _mm_unpackhi_epi64(t2, t3));
+	}
+}
+
+static int avx2_supported = -1;
+
+int chacha20_avx2_supported(void)
+{
+	int info[4];
+	int result = 0;
+
+	if (avx2_supported != -1)
+	{
+		return avx2_supported;
+	}
+
+	__cpuid(info, 0);
+
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+
+		// The OS should save the ymm registers (OSXSAVE, and XCR0 with the SSE and AVX states).
+		if ((info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(info, 7, 0);
+			result = (info[1] & (1 << 5)) != 0;
+		}
+	}
+
+	avx2_supported = result;
+
+	return result;
+}
+
+void chacha20_blocks(const uint32_t key[CHACHA20_KEY_WORDS], uint32_t counter, const uint32_t nonce[CHACHA20_NONCE_WORDS],
+					 uint8_t *output, size_t blocks)
+{
+	if (blocks >= 8 && chacha20_avx2_supported())
+	{
+		while (blocks >= 8)
+		{
+			chacha20_blocks_avx2(key, counter, nonce, output);
+			counter += 8;
+			output += 8 * CHACHA20_BLOCK_SIZE;
+			blocks -= 8;
+		}
+	}
+
+	while (blocks >= 4)
+	{
+		chacha20_blocks_sse2(key, counter, nonce, output);
+		counter += 4;
+		output += 4 * CHACHA20_BLOCK_SIZE;
+		blocks -= 4;
+	}
+
+	while (blocks > 0)
+	{
+		chacha20_block_generic(key, counter, nonce, output);
+		counter += 1;
+		output += CHACHA20_BLOCK_SIZE;
+		blocks -= 1;
+	}
+}
@@ -5,10 +5,16 @@
    Refer to the LICENSE file at the root directory for details.
 */
 
+#include <internal/nt.h>
+#include <internal/random.h>
 #include <sys/random.h>
 #include <sys/types.h>
+#include <bcrypt.h>
 #include <errno.h>
 #include <immintrin.h>
+#include <intrin.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define RD_RAND 1 // random
 #define RD_SEED 2 // entropy
@@ -16,126 +22,280 @@
 #define MAX_LENGTH 1048576 // 1MB
 
 /*
-   Intrinsics don't play well with function pointers.
-   Using macros works but clang throws incorrect errors
-   Hence, do it the tedious way
+ Each thread has its own ChaCha20 generator, keyed from the system RNG mixed with RDSEED (or RDRAND) output.
+ The keystream is generated 16 blocks at a time. The first 32 bytes of every batch replace the key and are erased,
+ so the bytes already handed out can't be recovered from the state (fast key erasure). Bytes are erased from the
+ buffer as they are handed out for the same reason.
+
+ The generator is reseeded after every RESEED_BYTES bytes, on getentropy and when the process id changes, i.e the
+ memory of the process has been cloned into another one. Spawned processes start with fresh state anyway.
 */
 
-static ssize_t fill_buffer_using_rdrand(void *buffer, size_t length)
+#define BUFFER_BLOCKS 16
+#define BUFFER_SIZE   (BUFFER_BLOCKS * CHACHA20_BLOCK_SIZE)
+#define KEY_SIZE      (CHACHA20_KEY_WORDS * sizeof(uint32_t))
+#define SEED_SIZE     (KEY_SIZE + CHACHA20_NONCE_WORDS * sizeof(uint32_t))
+#define RESEED_BYTES  1638400 // 1.6MB
+
+#define HARDWARE_RETRIES 16
+
+typedef struct _chacha20_rng
+{
+	uint32_t key[CHACHA20_KEY_WORDS];
+	uint32_t nonce[CHACHA20_NONCE_WORDS];
+	DWORD pid;
+	size_t available; // Unused bytes at the end of the buffer.
+	size_t reseed;    // Bytes left before the next reseed.
+	uint8_t buffer[BUFFER_SIZE];
+} chacha20_rng;
+
+static RTL_RUN_ONCE rng_once = RTL_RUN_ONCE_INIT;
+static DWORD rng_index = FLS_OUT_OF_INDEXES;
+
+// 0 -> none, 1 -> rdrand, 2 -> rdseed
+static int hardware_source = -1;
+
+static void NTAPI free_rng(PVOID state)
 {
-	size_t bytes_filled = 0;
+	if (state != NULL)
+	{
+		SecureZeroMemory(state, sizeof(chacha20_rng));
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, state);
+	}
+}
+
+static BOOL NTAPI initialize_rng(PRTL_RUN_ONCE once, PVOID parameter, PVOID *context)
+{
+	int info[4];
+
+	UNREFERENCED_PARAMETER(once);
+	UNREFERENCED_PARAMETER(parameter);
+	UNREFERENCED_PARAMETER(context);
+
+	// The state of the thread is freed when it exits.
+	rng_index = FlsAlloc(free_rng);
+	if (rng_index == FLS_OUT_OF_INDEXES)
+	{
+		return FALSE;
+	}
+
+	hardware_source = 0;
+
+	__cpuid(info, 1);
+	if (info[2] & (1 << 30))
+	{
+		hardware_source = RD_RAND;
+	}
 
-	while (bytes_filled != length)
+	__cpuid(info, 0);
+	if (info[0] >= 7)
 	{
-		if (length - bytes_filled >= 8)
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 18))
 		{
-			_rdrand64_step((unsigned long long *)((char *)buffer + bytes_filled));
-			bytes_filled += 8;
-			continue;
+			hardware_source = RD_SEED;
 		}
+	}
+
+	return TRUE;
+}
 
-		// We do not fill the last byte if lenght % 2 != 0
-		// NOTE: filling the entire length of the buffer is not a requirement
-		switch (length - bytes_filled)
+// The step intrinsics can fail when the hardware runs out of entropy, retry a few times before giving up.
+static int hardware_entropy(uint8_t *buffer, size_t length)
+{
+	unsigned long long value;
+	int result;
+
+	for (size_t i = 0; i < length; i += sizeof(unsigned long long))
+	{
+		result = 0;
+
+		for (int retries = 0; retries < HARDWARE_RETRIES && result == 0; ++retries)
 		{
-		case 7:
-			_rdrand32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			_rdrand16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 6:
-			_rdrand32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			_rdrand16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 5:
-			_rdrand32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			break;
-		case 4:
-			_rdrand32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			break;
-		case 3:
-			_rdrand16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 2:
-			_rdrand16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 1:
-			break;
+			if (hardware_source == RD_SEED)
+			{
+				result = _rdseed64_step(&value);
+			}
+			else
+			{
+				result = _rdrand64_step(&value);
+			}
+
+			if (result == 0)
+			{
+				_mm_pause();
+			}
 		}
 
-		// break the loop after the switch is executed
-		break;
+		if (result == 0)
+		{
+			return -1;
+		}
+
+		memcpy(buffer + i, &value, __min(sizeof(unsigned long long), length - i));
+	}
+
+	SecureZeroMemory(&value, sizeof(value));
+
+	return 0;
+}
+
+static int rng_seed(chacha20_rng *rng)
+{
+	NTSTATUS status;
+	uint8_t seed[SEED_SIZE];
+	uint8_t hardware[SEED_SIZE];
+	int seeded = 0;
+
+	status = BCryptGenRandom(NULL, seed, SEED_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+	if (status == STATUS_SUCCESS)
+	{
+		seeded = 1;
+	}
+
+	if (hardware_source != 0 && hardware_entropy(hardware, SEED_SIZE) == 0)
+	{
+		for (size_t i = 0; i < SEED_SIZE; ++i)
+		{
+			seed[i] = seeded ? seed[i] ^ hardware[i] : hardware[i];
+		}
+
+		seeded = 1;
 	}
 
-	return bytes_filled;
+	if (!seeded)
+	{
+		errno = EIO;
+		return -1;
+	}
+
+	memcpy(rng->key, seed, KEY_SIZE);
+	memcpy(rng->nonce, seed + KEY_SIZE, SEED_SIZE - KEY_SIZE);
+
+	SecureZeroMemory(seed, SEED_SIZE);
+	SecureZeroMemory(hardware, SEED_SIZE);
+	SecureZeroMemory(rng->buffer, BUFFER_SIZE);
+
+	rng->available = 0;
+	rng->reseed = RESEED_BYTES;
+	rng->pid = GetCurrentProcessId();
+
+	return 0;
+}
+
+static void rng_refill(chacha20_rng *rng)
+{
+	// The key changes with every batch, the counter can start from 0 always.
+	chacha20_blocks(rng->key, 0, rng->nonce, rng->buffer, BUFFER_BLOCKS);
+
+	memcpy(rng->key, rng->buffer, KEY_SIZE);
+	SecureZeroMemory(rng->buffer, KEY_SIZE);
+
+	rng->available = BUFFER_SIZE - KEY_SIZE;
+}
+
+static void rng_read(chacha20_rng *rng, uint8_t *buffer, size_t length)
+{
+	uint8_t *start;
+	size_t count;
+
+	while (length > 0)
+	{
+		if (rng->available == 0)
+		{
+			rng_refill(rng);
+		}
+
+		count = __min(length, rng->available);
+		start = rng->buffer + BUFFER_SIZE - rng->available;
+
+		memcpy(buffer, start, count);
+		SecureZeroMemory(start, count);
+
+		rng->available -= count;
+		buffer += count;
+		length -= count;
+	}
 }
 
-static ssize_t fill_buffer_using_rdseed(void *buffer, size_t length)
+static chacha20_rng *get_rng(int source)
 {
-	size_t bytes_filled = 0;
+	chacha20_rng *rng;
 
-	while (bytes_filled != length)
+	if (!RtlRunOnceExecuteOnce(&rng_once, initialize_rng, NULL, NULL))
 	{
-		if (length - bytes_filled >= 8)
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	rng = (chacha20_rng *)FlsGetValue(rng_index);
+
+	if (rng == NULL)
+	{
+		rng = (chacha20_rng *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(chacha20_rng));
+		if (rng == NULL)
 		{
-			_rdseed64_step((unsigned long long *)((char *)buffer + bytes_filled));
-			bytes_filled += 8;
-			continue;
+			errno = ENOMEM;
+			return NULL;
 		}
 
-		// We do not fill the last byte if lenght % 2 != 0
-		// NOTE: filling the entire length of the buffer is not a requirement
-		switch (length - bytes_filled)
+		if (rng_seed(rng) == -1)
 		{
-		case 7:
-			_rdseed32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			_rdseed16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 6:
-			_rdseed32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			_rdseed16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 5:
-			_rdseed32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			break;
-		case 4:
-			_rdseed32_step((unsigned int *)((char *)buffer + bytes_filled));
-			bytes_filled += 4;
-			break;
-		case 3:
-			_rdseed16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 2:
-			_rdseed16_step((unsigned short *)((char *)buffer + bytes_filled));
-			bytes_filled += 2;
-			break;
-		case 1:
-			break;
+			RtlFreeHeap(NtCurrentProcessHeap(), 0, rng);
+			return NULL;
 		}
 
-		// break the loop after the switch is executed
-		break;
+		FlsSetValue(rng_index, rng);
+
+		return rng;
+	}
+
+	if (source == RD_SEED || rng->pid != GetCurrentProcessId())
+	{
+		if (rng_seed(rng) == -1)
+		{
+			return NULL;
+		}
 	}
 
-	return bytes_filled;
+	return rng;
+}
+
+static void rng_generate(chacha20_rng *rng, void *buffer, size_t length)
+{
+	uint32_t key[CHACHA20_KEY_WORDS];
+	size_t blocks = length / CHACHA20_BLOCK_SIZE;
+	size_t total = length;
+
+	if (length >= BUFFER_SIZE)
+	{
+		// Large requests are written directly, with a key of their own from the stream.
+		rng_read(rng, (uint8_t *)key, KEY_SIZE);
+		chacha20_blocks(key, 0, rng->nonce, buffer, blocks);
+		SecureZeroMemory(key, KEY_SIZE);
+
+		buffer = (uint8_t *)buffer + blocks * CHACHA20_BLOCK_SIZE;
+		length -= blocks * CHACHA20_BLOCK_SIZE;
+	}
+
+	rng_read(rng, buffer, length);
+
+	// Reseed once the current key has covered enough.
+	rng->reseed -= __min(rng->reseed, total);
+
+	if (rng->reseed == 0)
+	{
+		// On failure keep using the current key, it is still good.
+		if (rng_seed(rng) == -1)
+		{
+			rng->reseed = RESEED_BYTES;
+		}
+	}
 }
 
 ssize_t wlibc_generate_random_bytes(void *buffer, size_t length, int source)
 {
-	size_t bytes_filled = 0;
+	chacha20_rng *rng;
 
 	if (buffer == NULL || length > MAX_LENGTH)
 	{
@@ -149,14 +309,67 @@ ssize_t wlibc_generate_random_bytes(void *buffer, size_t length, int source)
 		return -1;
 	}
 
-	if (source == RD_RAND)
+	rng = get_rng(source);
+	if (rng == NULL)
 	{
-		bytes_filled = fill_buffer_using_rdrand(buffer, length);
+		return -1;
 	}
-	else // source == RD_SEED
+
+	rng_generate(rng, buffer, length);
+
+	return length;
+}
+
+void wlibc_arc4random_buf(void *buffer, size_t size)
+{
+	chacha20_rng *rng;
+
+	rng = get_rng(RD_RAND);
+	if (rng == NULL)
 	{
-		bytes_filled = fill_buffer_using_rdseed(buffer, length);
+		// arc4random can't fail.
+		abort();
+	}
+
+	rng_generate(rng, buffer, size);
+}
+
+uint32_t wlibc_arc4random(void)
+{
+	uint32_t value;
+
+	wlibc_arc4random_buf(&value, sizeof(uint32_t));
+
+	return value;
+}
+
+uint32_t wlibc_arc4random_uniform(uint32_t upper_bound)
+{
+	uint64_t product;
+	uint32_t low, threshold;
+
+	if (upper_bound < 2)
+	{
+		return 0;
+	}
+
+	/*
+	 Scale the random number to the bound by multiplication. The low half of the product is biased only when it is
+	 less than 2^32 % upper_bound, draw again in that case.
+	*/
+	product = (uint64_t)wlibc_arc4random() * upper_bound;
+	low = (uint32_t)product;
+
+	if (low < upper_bound)
+	{
+		threshold = (0u - upper_bound) % upper_bound;
+
+		while (low < threshold)
+		{
+			product = (uint64_t)wlibc_arc4random() * upper_bound;
+			low = (uint32_t)product;
+		}
 	}
 
-	return bytes_filled;
+	return (uint32_t)(product >> 32);
 }
@@ -0,0 +1,235 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <internal/signal.h>
+#include <internal/thread.h>
+#include <internal/validate.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/signalfd.h>
+
+/*
+ A blocked signal that is raised is taken by the first signalfd whose mask has it, instead of being marked pending
+ in the raising thread. Like standard signals on Linux, a signal is queued at most once.
+ The handle of the fd is a notification event, set while there are queued signals.
+*/
+
+typedef struct _signalfd_object
+{
+	fd_object object;
+	struct _signalfd_object *next; // Link of the registry.
+	struct _signalfd_object *prev;
+	sigset_t mask;
+	sigset_t queued;
+} signalfd_object;
+
+// Registry of the open signalfds.
+static signalfd_object *_wlibc_signalfd_objects = NULL;
+static RTL_SRWLOCK _wlibc_signalfd_registry_lock;
+
+static int signalfd_queue(int sig)
+{
+	signalfd_object *signalfd;
+	int result = 0;
+
+	RtlAcquireSRWLockShared(&_wlibc_signalfd_registry_lock);
+
+	for (signalfd = _wlibc_signalfd_objects; signalfd != NULL; signalfd = signalfd->next)
+	{
+		RtlAcquireSRWLockExclusive(&signalfd->object.lock);
+
+		if (signalfd->mask & (1u << sig))
+		{
+			signalfd->queued |= 1u << sig;
+			NtSetEvent(signalfd->object.handle, NULL);
+			result = 1;
+		}
+
+		RtlReleaseSRWLockExclusive(&signalfd->object.lock);
+
+		if (result)
+		{
+			break;
+		}
+	}
+
+	RtlReleaseSRWLockShared(&_wlibc_signalfd_registry_lock);
+
+	return result;
+}
+
+static ssize_t signalfd_object_read(fd_object *object, void *buffer, size_t count, int flags)
+{
+	signalfd_object *signalfd = (signalfd_object *)object;
+	struct signalfd_siginfo *info = (struct signalfd_siginfo *)buffer;
+	size_t result = 0;
+
+	if (count < sizeof(struct signalfd_siginfo))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	RtlAcquireSRWLockExclusive(&object->lock);
+
+	while ((signalfd->queued & signalfd->mask) == 0)
+	{
+		RtlReleaseSRWLockExclusive(&object->lock);
+
+		if (flags & O_NONBLOCK)
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+
+		NtWaitForSingleObject(object->handle, FALSE, NULL);
+		RtlAcquireSRWLockExclusive(&object->lock);
+	}
+
+	// Lowest numbered signals first, as many as the buffer can hold.
+	for (int sig = 1; sig < NSIG && count - result >= sizeof(struct signalfd_siginfo); ++sig)
+	{
+		if ((signalfd->queued & signalfd->mask) & (1u << sig))
+		{
+			signalfd->queued &= ~(1u << sig);
+
+			memset(info, 0, sizeof(struct signalfd_siginfo));
+			info->ssi_signo = sig;
+			info->ssi_pid = GetCurrentProcessId();
+
+			++info;
+			result += sizeof(struct signalfd_siginfo);
+		}
+	}
+
+	if ((signalfd->queued & signalfd->mask) == 0)
+	{
+		NtResetEvent(object->handle, NULL);
+	}
+
+	RtlReleaseSRWLockExclusive(&object->lock);
+
+	return result;
+}
+
+static void signalfd_object_destroy(fd_object *object)
+{
+	signalfd_object *signalfd = (signalfd_object *)object;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_signalfd_registry_lock);
+
+	if (signalfd->prev != NULL)
+	{
+		signalfd->prev->next = signalfd->next;
+	}
+	else if (_wlibc_signalfd_objects == signalfd)
+	{
+		_wlibc_signalfd_objects = signalfd->next;
+	}
+
+	if (signalfd->next != NULL)
+	{
+		signalfd->next->prev = signalfd->prev;
+	}
+
+	RtlReleaseSRWLockExclusive(&_wlibc_signalfd_registry_lock);
+}
+
+int wlibc_signalfd(int fd, const sigset_t *mask, int flags)
+{
+	NTSTATUS status;
+	fd_object *object;
+	signalfd_object *signalfd;
+	threadinfo *tinfo;
+	HANDLE handle;
+	sigset_t signals;
+
+	VALIDATE_PTR(mask, EINVAL, -1);
+
+	if (flags & ~(SFD_CLOEXEC | SFD_NONBLOCK))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// These can't be caught, they are silently ignored.
+	signals = *mask & ~((1u << SIGKILL) | (1u << SIGSTOP) | 1u);
+
+	if (fd != -1)
+	{
+		// Change the mask of an existing signalfd.
+		object = acquire_fd_object(fd, SIGNALFD_HANDLE);
+		if (object == NULL)
+		{
+			return -1;
+		}
+
+		signalfd = (signalfd_object *)object;
+
+		RtlAcquireSRWLockExclusive(&object->lock);
+
+		signalfd->mask = signals;
+
+		if (signalfd->queued & signalfd->mask)
+		{
+			NtSetEvent(object->handle, NULL);
+		}
+		else
+		{
+			NtResetEvent(object->handle, NULL);
+		}
+
+		RtlReleaseSRWLockExclusive(&object->lock);
+
+		release_fd_object(object);
+
+		return fd;
+	}
+
+	signalfd = (signalfd_object *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(signalfd_object));
+	if (signalfd == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	signalfd->object.read = signalfd_object_read;
+	signalfd->object.destroy = signalfd_object_destroy;
+	signalfd->mask = signals;
+
+	// Signals of the mask already pending in this thread are moved to the signalfd.
+	tinfo = (threadinfo *)TlsGetValue(_wlibc_threadinfo_index);
+	signalfd->queued = tinfo->pending & signals;
+	tinfo->pending &= ~signals;
+
+	status = NtCreateEvent(&handle, EVENT_ALL_ACCESS, NULL, NotificationEvent, signalfd->queued != 0);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		tinfo->pending |= signalfd->queued;
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, signalfd);
+		return -1;
+	}
+
+	RtlAcquireSRWLockExclusive(&_wlibc_signalfd_registry_lock);
+
+	signalfd->next = _wlibc_signalfd_objects;
+	if (_wlibc_signalfd_objects != NULL)
+	{
+		_wlibc_signalfd_objects->prev = signalfd;
+	}
+	_wlibc_signalfd_objects = signalfd;
+
+	_wlibc_signal_queue_hook = signalfd_queue;
+
+	RtlReleaseSRWLockExclusive(&_wlibc_signalfd_registry_lock);
+
+	return register_fd_object(&signalfd->object, handle, SIGNALFD_HANDLE, O_RDONLY | flags);
+}
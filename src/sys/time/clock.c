@@ -8,6 +8,7 @@
 #include <internal/nt.h>
 #include <internal/validate.h>
 #include <internal/error.h>
+#include <internal/timer.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -20,6 +21,24 @@
 		}                                                  \
 	}
 
+static LONGLONG frequency = 0;
+
+ULONGLONG get_monotonic_time(void)
+{
+	LARGE_INTEGER counter;
+
+	if (frequency == 0)
+	{
+		// The frequency is fixed at boot, racing callers store the same value.
+		QueryPerformanceFrequency(&counter);
+		frequency = counter.QuadPart;
+	}
+
+	QueryPerformanceCounter(&counter);
+
+	return (counter.QuadPart / frequency) * 10000000 + ((counter.QuadPart % frequency) * 10000000) / frequency;
+}
+
 int wlibc_clock_getres(clockid_t id, struct timespec *res)
 {
 	VALIDATE_CLOCK(id);
@@ -47,13 +66,13 @@ int wlibc_clock_gettime(clockid_t id, struct timespec *ts)
 		GetSystemTimePreciseAsFileTime((LPFILETIME)&epoch);
 		break;
 	case CLOCK_MONOTONIC:
-		QueryPerformanceCounter(&epoch);
+		epoch.QuadPart = (LONGLONG)get_monotonic_time();
 		break;
 	}
 
 	// The values reported here should be from January 1st 1601 UTC.
 	ts->tv_sec = epoch.QuadPart / 10000000;
-	ts->tv_nsec = (epoch.QuadPart % 10) * 100;
+	ts->tv_nsec = (epoch.QuadPart % 10000000) * 100;
 
 	return 0;
 }
@@ -73,35 +73,3 @@ void *itimer_proc(void *arg)
 		}
 	}
 }
-
-void *timer_proc(void *arg)
-{
-	NTSTATUS status;
-	timerinfo *tinfo = (timerinfo *)arg;
-
-	while (1)
-	{
-		status = NtWaitForSingleObject(tinfo->handle, TRUE, NULL);
-
-		if (status == STATUS_SUCCESS)
-		{
-			switch (tinfo->event.sigev_notify)
-			{
-			case SIGEV_NONE:
-				// nop
-				continue;
-				break;
-			case SIGEV_SIGNAL:
-				wlibc_raise(tinfo->event.sigev_signo);
-				break;
-			case SIGEV_THREAD:
-				if (tinfo->event.sigev_notify_function != NULL)
-				{
-					// Invoke the notification function.
-					tinfo->event.sigev_notify_function(tinfo->event.sigev_value);
-				}
-				break;
-			}
-		}
-	}
-}
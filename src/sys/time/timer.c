@@ -6,13 +6,11 @@
 */
 
 #include <internal/nt.h>
-#include <internal/error.h>
-#include <internal/thread.h>
 #include <internal/timer.h>
 #include <internal/validate.h>
-#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/time.h>
-#include <thread.h>
 
 #define VALIDATE_TIMER(timer) VALIDATE_PTR(timer, EINVAL, -1)
 
@@ -25,11 +23,45 @@
 		}                                                  \
 	}
 
+// Monotonic time of expiration from 'value'.
+static ULONGLONG get_due_time(timer_entry *timer, int flags, const struct timespec *value)
+{
+	LONGLONG time = value->tv_sec * 10000000 + value->tv_nsec / 100;
+	LARGE_INTEGER realtime;
+	ULONGLONG now;
+
+	now = get_monotonic_time();
+
+	if (flags != TIMER_ABSTIME)
+	{
+		// Less than 100ns is still something.
+		return now + __max(time, 1);
+	}
+
+	if (timer->clock == CLOCK_MONOTONIC)
+	{
+		return __max((ULONGLONG)time, 1);
+	}
+
+	// CLOCK_REALTIME is converted when the timer is armed, changes to the system time later do not affect the timer.
+	GetSystemTimePreciseAsFileTime((LPFILETIME)&realtime);
+	time -= realtime.QuadPart;
+
+	return time > 0 ? now + time : now;
+}
+
+// Just fill in the period.
+static void fill_itimerspec(struct itimerspec *value, LONGLONG period)
+{
+	value->it_interval.tv_sec = period / 10000000;
+	value->it_interval.tv_nsec = (period % 10000000) * 100;
+	value->it_value.tv_sec = 0;
+	value->it_value.tv_nsec = 0;
+}
+
 int wlibc_timer_create(clockid_t id, struct sigevent *restrict event, timer_t *restrict timer)
 {
-	NTSTATUS status;
-	timerinfo *tinfo;
-	thread_attr_t *attributes = NULL;
+	timer_entry *entry;
 
 	VALIDATE_CLOCK(id);
 	VALIDATE_PTR(event, EINVAL, -1);
@@ -41,104 +73,65 @@ int wlibc_timer_create(clockid_t id, struct sigevent *restrict event, timer_t *r
 		return -1;
 	}
 
-	*timer = RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(timerinfo));
-	tinfo = (timerinfo *)*timer;
-
-	if (*timer == NULL)
+	// The callbacks of SIGEV_THREAD are run by a pool of threads, 'sigev_notify_attributes' is ignored.
+	if (start_timer_wheel(event->sigev_notify == SIGEV_THREAD) == -1)
 	{
-		errno = ENOMEM;
+		errno = EAGAIN;
 		return -1;
 	}
 
-	status = NtCreateTimer2(&(tinfo->handle), NULL, NULL, TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
-	if (status != STATUS_SUCCESS)
-	{
-		map_ntstatus_to_errno(status);
-		goto fail;
-	}
-
-	// If the notification method is SIGEV_THREAD, make use of the passed in thread attributes.
-	if (event->sigev_notify == SIGEV_THREAD)
+	entry = (timer_entry *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(timer_entry));
+	if (entry == NULL)
 	{
-		attributes = event->sigev_notify_attributes;
+		errno = ENOMEM;
+		return -1;
 	}
 
-	status = (NTSTATUS)wlibc_thread_create(&(tinfo->thread), attributes, timer_proc, tinfo);
-	if (status != 0)
-	{
-		goto fail;
-	}
+	entry->clock = id;
+	entry->references = 1;
+	memcpy(&(entry->event), event, sizeof(struct sigevent));
 
-	memcpy(&(tinfo->event), event, sizeof(struct sigevent));
+	*timer = entry;
 
 	return 0;
-
-fail:
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, *timer);
-	return -1;
 }
 
 int wlibc_timer_delete(timer_t timer)
 {
-	NTSTATUS status;
-	threadinfo *thread;
-	timerinfo *tinfo = (timerinfo *)timer;
-
 	VALIDATE_TIMER(timer);
-	thread = (threadinfo *)tinfo->thread;
-
-	status = NtClose(tinfo->handle);
-	if (status != STATUS_SUCCESS)
-	{
-		map_ntstatus_to_errno(status);
-		return -1;
-	}
 
-	// Kill the timer thread. Just use NtTerminateThread directly.
-	status = NtTerminateThread(thread->handle, (NTSTATUS)(LONG_PTR)WLIBC_THREAD_CANCELED);
-	if (status != STATUS_SUCCESS)
-	{
-		map_ntstatus_to_errno(status);
-		return -1;
-	}
-
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, thread);
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, timer);
+	delete_wheel_timer((timer_entry *)timer);
 
 	return 0;
 }
 
 int wlibc_timer_getoverrun(timer_t timer)
 {
-	// Just validate and return 0.
+	timer_entry *entry = (timer_entry *)timer;
+
 	VALIDATE_TIMER(timer);
 
-	return 0;
+	return entry->overrun;
 }
 
 int wlibc_timer_gettime(timer_t timer, struct itimerspec *current_value)
 {
-	timerinfo *tinfo = (timerinfo *)timer;
-
 	VALIDATE_TIMER(timer);
+	VALIDATE_PTR(current_value, EINVAL, -1);
 
-	// Just fill in the period.
-	current_value->it_interval.tv_sec = tinfo->period / 10000000;
-	current_value->it_interval.tv_nsec = (tinfo->period % 10000000) * 100;
-	current_value->it_value.tv_sec = 0;
-	current_value->it_value.tv_nsec = 0;
+	fill_itimerspec(current_value, get_wheel_timer_period((timer_entry *)timer));
 
 	return 0;
 }
 
 int wlibc_timer_settime(timer_t timer, int flags, const struct itimerspec *restrict new_value, struct itimerspec *restrict old_value)
 {
-	NTSTATUS status;
-	LARGE_INTEGER period, due;
-	T2_SET_PARAMETERS parameters = {0, 0, 0};
-	timerinfo *tinfo = (timerinfo *)timer;
+	timer_entry *entry = (timer_entry *)timer;
+	ULONGLONG due = 0;
+	LONGLONG period = 0, old_period;
 
 	VALIDATE_TIMER(timer);
+	VALIDATE_PTR(new_value, EINVAL, -1);
 
 	if (flags != 0 && flags != TIMER_ABSTIME)
 	{
@@ -146,48 +139,25 @@ int wlibc_timer_settime(timer_t timer, int flags, const struct itimerspec *restr
 		return -1;
 	}
 
-	if (old_value != NULL)
+	if (new_value->it_value.tv_nsec < 0 || new_value->it_value.tv_nsec >= 1000000000 || new_value->it_interval.tv_nsec < 0 ||
+		new_value->it_interval.tv_nsec >= 1000000000)
 	{
-		// Just fill in the period.
-		old_value->it_interval.tv_sec = tinfo->period / 10000000;
-		old_value->it_interval.tv_nsec = (tinfo->period % 10000000) * 100;
-		old_value->it_value.tv_sec = 0;
-		old_value->it_value.tv_nsec = 0;
+		errno = EINVAL;
+		return -1;
 	}
 
-	if (new_value->it_value.tv_sec == 0 && new_value->it_value.tv_nsec == 0)
+	// A zero it_value disarms the timer.
+	if (new_value->it_value.tv_sec != 0 || new_value->it_value.tv_nsec != 0)
 	{
-		// Cancel the timer
-		status = NtCancelTimer2(tinfo->handle, NULL);
-
-		if (status != STATUS_SUCCESS)
-		{
-			map_ntstatus_to_errno(status);
-			return -1;
-		}
-
-		// Zero the period.
-		tinfo->period = 0;
+		due = get_due_time(entry, flags, &new_value->it_value);
+		period = new_value->it_interval.tv_sec * 10000000 + new_value->it_interval.tv_nsec / 100;
 	}
-	else
-	{
-		period.QuadPart = new_value->it_interval.tv_sec * 10000000 + new_value->it_interval.tv_nsec / 100;
-		due.QuadPart = new_value->it_value.tv_sec * 10000000 + new_value->it_value.tv_nsec / 100;
-
-		if (flags != TIMER_ABSTIME)
-		{
-			due.QuadPart = -1 * due.QuadPart; // relative time.
-		}
-
-		status = NtSetTimer2(tinfo->handle, &due, &period, &parameters);
 
-		if (status != STATUS_SUCCESS)
-		{
-			map_ntstatus_to_errno(status);
-			return -1;
-		}
+	old_period = set_wheel_timer(entry, due, period);
 
-		tinfo->period = period.QuadPart;
+	if (old_value != NULL)
+	{
+		fill_itimerspec(old_value, old_period);
 	}
 
 	return 0;
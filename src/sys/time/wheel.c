@@ -0,0 +1,533 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/signal.h>
+#include <internal/timer.h>
+#include <intrin.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <thread.h>
+
+#pragma intrinsic(_BitScanForward64)
+#pragma intrinsic(_rotr64)
+
+/*
+ Hierarchical timer wheel.
+ The wheel moves in ticks of 1024 * 100ns (~102us). Each level has 64 slots, a slot of level L spans 64^L ticks.
+ A timer goes into the lowest level that can hold the time left till its expiration. Whenever the wheel crosses the
+ boundary of a slot of a higher level, the timers of that slot are moved down (cascaded). The timers of a slot of
+ level 0 expire together. Arming and disarming a timer is just linking and unlinking it from a slot.
+
+ A single thread waits on a high resolution kernel timer set to the next tick something has to be done.
+ Callbacks of SIGEV_THREAD timers are run by a small pool of threads.
+*/
+
+#define TIMER_WHEEL_TICK_SHIFT 10
+#define TIMER_WHEEL_BITS       6
+#define TIMER_WHEEL_SLOTS      (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK       (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS     6 // 2^36 ticks, ~81 days. Timers further away are cascaded at the top level till they get closer.
+#define TIMER_WHEEL_RANGE      (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define TIMER_WHEEL_NEVER      (~0ull)
+
+#define TIMER_CALLBACK_THREADS 4
+
+typedef struct _timer_wheel
+{
+	RTL_SRWLOCK lock;
+	ULONGLONG current;  // The next tick to be processed.
+	ULONGLONG deadline; // When the dispatcher wakes up next.
+	ULONGLONG occupied[TIMER_WHEEL_LEVELS];
+	timer_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	HANDLE timer;
+	thread_t dispatcher;
+} timer_wheel;
+
+typedef struct _timer_callbacks
+{
+	RTL_SRWLOCK lock;
+	RTL_CONDITION_VARIABLE available;
+	timer_entry *head;
+	timer_entry *tail;
+	thread_t threads[TIMER_CALLBACK_THREADS];
+} timer_callbacks;
+
+static timer_wheel wheel = {RTL_SRWLOCK_INIT};
+static timer_callbacks callbacks = {RTL_SRWLOCK_INIT, RTL_CONDITION_VARIABLE_INIT};
+static RTL_RUN_ONCE wheel_once = RTL_RUN_ONCE_INIT;
+static RTL_RUN_ONCE callbacks_once = RTL_RUN_ONCE_INIT;
+
+static void release_timer(timer_entry *timer)
+{
+	if (InterlockedDecrement(&timer->references) == 0)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, timer);
+	}
+}
+
+static void insert_timer(timer_entry *timer)
+{
+	ULONGLONG tick = timer->tick;
+	ULONGLONG delta;
+	unsigned int level = 0;
+
+	if (tick < wheel.current)
+	{
+		tick = wheel.current;
+	}
+
+	delta = tick - wheel.current;
+
+	if (delta >= TIMER_WHEEL_RANGE)
+	{
+		delta = TIMER_WHEEL_RANGE - 1;
+		tick = wheel.current + delta;
+	}
+
+	while ((delta >> (TIMER_WHEEL_BITS * (level + 1))) != 0)
+	{
+		++level;
+	}
+
+	timer->level = (uint8_t)level;
+	timer->slot = (uint8_t)((tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+	timer->prev = NULL;
+	timer->next = wheel.slots[level][timer->slot];
+
+	if (timer->next != NULL)
+	{
+		timer->next->prev = timer;
+	}
+
+	wheel.slots[level][timer->slot] = timer;
+	wheel.occupied[level] |= 1ull << timer->slot;
+	timer->armed = 1;
+}
+
+static void remove_timer(timer_entry *timer)
+{
+	if (timer->prev != NULL)
+	{
+		timer->prev->next = timer->next;
+	}
+	else
+	{
+		wheel.slots[timer->level][timer->slot] = timer->next;
+		if (timer->next == NULL)
+		{
+			wheel.occupied[timer->level] &= ~(1ull << timer->slot);
+		}
+	}
+
+	if (timer->next != NULL)
+	{
+		timer->next->prev = timer->prev;
+	}
+
+	timer->next = NULL;
+	timer->prev = NULL;
+	timer->armed = 0;
+}
+
+// The tick at which the next slot of any level has to be processed.
+static ULONGLONG next_wheel_tick(void)
+{
+	ULONGLONG next = TIMER_WHEEL_NEVER;
+
+	for (unsigned int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+	{
+		unsigned int shift = TIMER_WHEEL_BITS * level;
+		ULONGLONG position = wheel.current >> shift;
+		unsigned int index = (unsigned int)(position & TIMER_WHEEL_MASK);
+		unsigned long distance;
+		ULONGLONG tick;
+
+		if (wheel.occupied[level] == 0)
+		{
+			continue;
+		}
+
+		if ((wheel.current & ((1ull << shift) - 1)) == 0)
+		{
+			// The slot at this position is yet to be processed.
+			_BitScanForward64(&distance, _rotr64(wheel.occupied[level], index));
+		}
+		else
+		{
+			// The slot at this position has been cascaded already, what is in it belongs to the next round.
+			_BitScanForward64(&distance, _rotr64(wheel.occupied[level], (index + 1) & TIMER_WHEEL_MASK));
+			distance += 1;
+		}
+
+		tick = (position + distance) << shift;
+
+		if (tick < next)
+		{
+			next = tick;
+		}
+	}
+
+	return next;
+}
+
+// Move the timers of the higher level slots whose boundary is 'tick' down, then collect the expired timers of level 0.
+static timer_entry *expire_wheel_tick(ULONGLONG tick, ULONGLONG now, timer_entry *expired)
+{
+	timer_entry *timer, *next;
+	unsigned int slot;
+
+	wheel.current = tick;
+
+	for (unsigned int level = TIMER_WHEEL_LEVELS - 1; level > 0; --level)
+	{
+		unsigned int shift = TIMER_WHEEL_BITS * level;
+
+		if ((tick & ((1ull << shift) - 1)) != 0)
+		{
+			continue;
+		}
+
+		slot = (unsigned int)((tick >> shift) & TIMER_WHEEL_MASK);
+		timer = wheel.slots[level][slot];
+		wheel.slots[level][slot] = NULL;
+		wheel.occupied[level] &= ~(1ull << slot);
+
+		for (; timer != NULL; timer = next)
+		{
+			next = timer->next;
+			insert_timer(timer);
+		}
+	}
+
+	slot = (unsigned int)(tick & TIMER_WHEEL_MASK);
+	timer = wheel.slots[0][slot];
+	wheel.slots[0][slot] = NULL;
+	wheel.occupied[0] &= ~(1ull << slot);
+
+	for (; timer != NULL; timer = next)
+	{
+		next = timer->next;
+
+		timer->next = NULL;
+		timer->prev = NULL;
+		timer->armed = 0;
+
+		// Hold on to the timer till it is delivered.
+		InterlockedIncrement(&timer->references);
+		timer->expired = expired;
+		expired = timer;
+
+		if (timer->period != 0)
+		{
+			timer->due += timer->period;
+
+			// Skip the periods that have already passed.
+			if (timer->due <= now)
+			{
+				ULONGLONG missed = (now - timer->due) / timer->period + 1;
+
+				timer->due += missed * timer->period;
+				InterlockedExchangeAdd(&timer->missed, (LONG)__min(missed, LONG_MAX));
+			}
+
+			timer->tick = (timer->due + (1ull << TIMER_WHEEL_TICK_SHIFT) - 1) >> TIMER_WHEEL_TICK_SHIFT;
+			insert_timer(timer);
+		}
+	}
+
+	wheel.current = tick + 1;
+
+	return expired;
+}
+
+// Wake the dispatcher at 'deadline' if it would sleep past it.
+static void update_deadline(ULONGLONG deadline, ULONGLONG now)
+{
+	LARGE_INTEGER due;
+	T2_SET_PARAMETERS parameters = {0, 0, 0};
+
+	if (deadline >= wheel.deadline)
+	{
+		return;
+	}
+
+	wheel.deadline = deadline;
+
+	// Relative time.
+	due.QuadPart = deadline > now ? -(LONGLONG)(deadline - now) : -1;
+	NtSetTimer2(wheel.timer, &due, NULL, &parameters);
+}
+
+static void queue_callback(timer_entry *timer)
+{
+	RtlAcquireSRWLockExclusive(&callbacks.lock);
+
+	if (timer->queued)
+	{
+		// The previous expiration has not been delivered yet.
+		InterlockedIncrement(&timer->missed);
+		RtlReleaseSRWLockExclusive(&callbacks.lock);
+		return;
+	}
+
+	timer->queued = 1;
+	timer->queue = NULL;
+	InterlockedIncrement(&timer->references);
+
+	if (callbacks.tail == NULL)
+	{
+		callbacks.head = timer;
+	}
+	else
+	{
+		callbacks.tail->queue = timer;
+	}
+
+	callbacks.tail = timer;
+
+	RtlReleaseSRWLockExclusive(&callbacks.lock);
+	RtlWakeConditionVariable(&callbacks.available);
+}
+
+static void deliver_timer(timer_entry *timer)
+{
+	if (timer->deleted)
+	{
+		return;
+	}
+
+	switch (timer->event.sigev_notify)
+	{
+	case SIGEV_NONE:
+		timer->overrun = InterlockedExchange(&timer->missed, 0);
+		break;
+	case SIGEV_SIGNAL:
+		timer->overrun = InterlockedExchange(&timer->missed, 0);
+		raise_process_signal(timer->event.sigev_signo);
+		break;
+	case SIGEV_THREAD:
+		queue_callback(timer);
+		break;
+	}
+}
+
+static void *timer_dispatcher(void *arg)
+{
+	timer_entry *expired, *next;
+	ULONGLONG now, tick;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	while (1)
+	{
+		expired = NULL;
+
+		RtlAcquireSRWLockExclusive(&wheel.lock);
+
+		now = get_monotonic_time();
+
+		while ((tick = next_wheel_tick()) <= (now >> TIMER_WHEEL_TICK_SHIFT))
+		{
+			expired = expire_wheel_tick(tick, now, expired);
+		}
+
+		// Nothing happens till the next tick, skip to now.
+		if (wheel.current <= (now >> TIMER_WHEEL_TICK_SHIFT))
+		{
+			wheel.current = (now >> TIMER_WHEEL_TICK_SHIFT) + 1;
+		}
+
+		wheel.deadline = TIMER_WHEEL_NEVER;
+		if (tick != TIMER_WHEEL_NEVER)
+		{
+			update_deadline(tick << TIMER_WHEEL_TICK_SHIFT, now);
+		}
+
+		RtlReleaseSRWLockExclusive(&wheel.lock);
+
+		for (; expired != NULL; expired = next)
+		{
+			next = expired->expired;
+			deliver_timer(expired);
+			release_timer(expired);
+		}
+
+		NtWaitForSingleObject(wheel.timer, FALSE, NULL);
+	}
+
+	return NULL;
+}
+
+static void *timer_callback_thread(void *arg)
+{
+	timer_entry *timer;
+	void (*function)(union sigval);
+	union sigval value;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	while (1)
+	{
+		RtlAcquireSRWLockExclusive(&callbacks.lock);
+
+		while (callbacks.head == NULL)
+		{
+			RtlSleepConditionVariableSRW(&callbacks.available, &callbacks.lock, NULL, 0);
+		}
+
+		timer = callbacks.head;
+		callbacks.head = timer->queue;
+		if (callbacks.head == NULL)
+		{
+			callbacks.tail = NULL;
+		}
+
+		timer->queued = 0;
+		function = timer->event.sigev_notify_function;
+		value = timer->event.sigev_value;
+
+		RtlReleaseSRWLockExclusive(&callbacks.lock);
+
+		if (!timer->deleted && function != NULL)
+		{
+			timer->overrun = InterlockedExchange(&timer->missed, 0);
+			function(value);
+		}
+
+		release_timer(timer);
+	}
+
+	return NULL;
+}
+
+static BOOL NTAPI initialize_wheel(PRTL_RUN_ONCE once, PVOID parameter, PVOID *context)
+{
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(once);
+	UNREFERENCED_PARAMETER(parameter);
+	UNREFERENCED_PARAMETER(context);
+
+	status = NtCreateTimer2(&wheel.timer, NULL, NULL, TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (status != STATUS_SUCCESS)
+	{
+		return FALSE;
+	}
+
+	wheel.current = get_monotonic_time() >> TIMER_WHEEL_TICK_SHIFT;
+	wheel.deadline = TIMER_WHEEL_NEVER;
+
+	if (wlibc_thread_create(&wheel.dispatcher, NULL, timer_dispatcher, NULL) != 0)
+	{
+		NtClose(wheel.timer);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL NTAPI initialize_callbacks(PRTL_RUN_ONCE once, PVOID parameter, PVOID *context)
+{
+	UNREFERENCED_PARAMETER(once);
+	UNREFERENCED_PARAMETER(parameter);
+	UNREFERENCED_PARAMETER(context);
+
+	for (int i = 0; i < TIMER_CALLBACK_THREADS; ++i)
+	{
+		if (wlibc_thread_create(&callbacks.threads[i], NULL, timer_callback_thread, NULL) != 0)
+		{
+			// Make do with what we have.
+			return i > 0;
+		}
+	}
+
+	return TRUE;
+}
+
+int start_timer_wheel(int callback)
+{
+	if (!RtlRunOnceExecuteOnce(&wheel_once, initialize_wheel, NULL, NULL))
+	{
+		return -1;
+	}
+
+	if (callback)
+	{
+		if (!RtlRunOnceExecuteOnce(&callbacks_once, initialize_callbacks, NULL, NULL))
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+LONGLONG set_wheel_timer(timer_entry *timer, ULONGLONG due, LONGLONG period)
+{
+	ULONGLONG now;
+	LONGLONG old_period;
+
+	RtlAcquireSRWLockExclusive(&wheel.lock);
+
+	old_period = timer->period;
+
+	if (timer->armed)
+	{
+		remove_timer(timer);
+	}
+
+	timer->due = due;
+	timer->period = period;
+	InterlockedExchange(&timer->missed, 0);
+
+	if (due != 0)
+	{
+		now = get_monotonic_time();
+
+		// Round up, a timer never expires early.
+		timer->tick = (due + (1ull << TIMER_WHEEL_TICK_SHIFT) - 1) >> TIMER_WHEEL_TICK_SHIFT;
+		insert_timer(timer);
+		update_deadline(__max(timer->tick, wheel.current) << TIMER_WHEEL_TICK_SHIFT, now);
+	}
+	else
+	{
+		timer->period = 0;
+	}
+
+	RtlReleaseSRWLockExclusive(&wheel.lock);
+
+	return old_period;
+}
+
+LONGLONG get_wheel_timer_period(timer_entry *timer)
+{
+	LONGLONG period;
+
+	RtlAcquireSRWLockShared(&wheel.lock);
+	period = timer->period;
+	RtlReleaseSRWLockShared(&wheel.lock);
+
+	return period;
+}
+
+void delete_wheel_timer(timer_entry *timer)
+{
+	RtlAcquireSRWLockExclusive(&wheel.lock);
+
+	if (timer->armed)
+	{
+		remove_timer(timer);
+	}
+
+	timer->deleted = 1;
+
+	RtlReleaseSRWLockExclusive(&wheel.lock);
+
+	release_timer(timer);
+}
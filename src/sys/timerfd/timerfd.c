@@ -0,0 +1,310 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <internal/timer.h>
+#include <internal/validate.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+
+/*
+ The handle of the fd is a notification timer, signaled once the next expiration is due. Periodic timers are not
+ rearmed by the kernel, the number of expirations is worked out from the time of the read which then sets the timer
+ to the next one. No thread is involved, reads and polls wait on the timer directly.
+
+ Times are kept in 100ns units of the clock of the timer. For CLOCK_REALTIME this is the system time, which the kernel
+ timer is set to as an absolute time. CLOCK_MONOTONIC is the scaled performance counter (get_monotonic_time), which is converted to a relative
+ time when the kernel timer is set.
+*/
+
+typedef struct _timerfd_object
+{
+	fd_object object;
+	clockid_t clock;
+	int armed;
+	ULONGLONG due;
+	ULONGLONG period;
+} timerfd_object;
+
+static ULONGLONG timerfd_now(clockid_t clock)
+{
+	LARGE_INTEGER counter;
+
+	if (clock == CLOCK_REALTIME)
+	{
+		GetSystemTimePreciseAsFileTime((LPFILETIME)&counter);
+		return counter.QuadPart;
+	}
+
+	return get_monotonic_time();
+}
+
+// Setting the timer also resets it. Call these with the object lock held.
+static void timerfd_arm(timerfd_object *timerfd)
+{
+	LARGE_INTEGER due;
+
+	if (timerfd->clock == CLOCK_REALTIME)
+	{
+		due.QuadPart = timerfd->due;
+	}
+	else
+	{
+		due.QuadPart = -(LONGLONG)(timerfd->due - __min(timerfd->due, timerfd_now(CLOCK_MONOTONIC)));
+	}
+
+	// Zero would be an absolute time.
+	if (due.QuadPart == 0)
+	{
+		due.QuadPart = -1;
+	}
+
+	timerfd->armed = 1;
+	NtSetTimer(timerfd->object.handle, &due, NULL, NULL, FALSE, 0, NULL);
+}
+
+static void timerfd_disarm(timerfd_object *timerfd)
+{
+	LARGE_INTEGER due;
+
+	// Cancelling a timer does not change its state, set it first to reset a timer that has already expired.
+	due.QuadPart = MINLONGLONG;
+	timerfd->armed = 0;
+	NtSetTimer(timerfd->object.handle, &due, NULL, NULL, FALSE, 0, NULL);
+	NtCancelTimer(timerfd->object.handle, NULL);
+}
+
+static int timerfd_expired(timerfd_object *timerfd, ULONGLONG now)
+{
+	LARGE_INTEGER zero = {0};
+
+	if (!timerfd->armed)
+	{
+		return 0;
+	}
+
+	// The kernel timer and our clock might not agree to the last tick, go with whichever expired first.
+	return now >= timerfd->due || NtWaitForSingleObject(timerfd->object.handle, FALSE, &zero) == STATUS_SUCCESS;
+}
+
+static ssize_t timerfd_object_read(fd_object *object, void *buffer, size_t count, int flags)
+{
+	timerfd_object *timerfd = (timerfd_object *)object;
+	ULONGLONG now;
+	uint64_t expirations = 1;
+
+	if (count < sizeof(uint64_t))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	RtlAcquireSRWLockExclusive(&object->lock);
+
+	while (1)
+	{
+		now = timerfd_now(timerfd->clock);
+
+		if (timerfd_expired(timerfd, now))
+		{
+			break;
+		}
+
+		RtlReleaseSRWLockExclusive(&object->lock);
+
+		if (flags & O_NONBLOCK)
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+
+		NtWaitForSingleObject(object->handle, FALSE, NULL);
+		RtlAcquireSRWLockExclusive(&object->lock);
+	}
+
+	if (timerfd->period != 0)
+	{
+		// Count the periods that were missed and move on to the next expiration in the future.
+		if (now > timerfd->due)
+		{
+			expirations += (now - timerfd->due) / timerfd->period;
+		}
+
+		timerfd->due += expirations * timerfd->period;
+		timerfd_arm(timerfd);
+	}
+	else
+	{
+		timerfd_disarm(timerfd);
+	}
+
+	RtlReleaseSRWLockExclusive(&object->lock);
+
+	memcpy(buffer, &expirations, sizeof(uint64_t));
+
+	return sizeof(uint64_t);
+}
+
+static void fill_itimerspec(timerfd_object *timerfd, struct itimerspec *value)
+{
+	ULONGLONG now, remaining = 0;
+
+	if (timerfd->armed)
+	{
+		now = timerfd_now(timerfd->clock);
+
+		if (now < timerfd->due)
+		{
+			remaining = timerfd->due - now;
+		}
+		else if (timerfd->period != 0)
+		{
+			// Expirations that have not been read yet.
+			remaining = timerfd->period - (now - timerfd->due) % timerfd->period;
+		}
+	}
+
+	value->it_value.tv_sec = remaining / 10000000;
+	value->it_value.tv_nsec = (remaining % 10000000) * 100;
+	value->it_interval.tv_sec = timerfd->period / 10000000;
+	value->it_interval.tv_nsec = (timerfd->period % 10000000) * 100;
+}
+
+int wlibc_timerfd_create(clockid_t id, int flags)
+{
+	NTSTATUS status;
+	timerfd_object *timerfd;
+	HANDLE handle;
+
+	if (id != CLOCK_REALTIME && id != CLOCK_MONOTONIC)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ~(TFD_CLOEXEC | TFD_NONBLOCK))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	timerfd = (timerfd_object *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(timerfd_object));
+	if (timerfd == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	timerfd->object.read = timerfd_object_read;
+	timerfd->clock = id;
+
+	status = NtCreateTimer(&handle, TIMER_ALL_ACCESS, NULL, NotificationTimer);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, timerfd);
+		return -1;
+	}
+
+	return register_fd_object(&timerfd->object, handle, TIMERFD_HANDLE, O_RDONLY | flags);
+}
+
+int wlibc_timerfd_gettime(int fd, struct itimerspec *current_value)
+{
+	fd_object *object;
+
+	VALIDATE_PTR(current_value, EFAULT, -1);
+
+	object = acquire_fd_object(fd, TIMERFD_HANDLE);
+	if (object == NULL)
+	{
+		return -1;
+	}
+
+	RtlAcquireSRWLockShared(&object->lock);
+	fill_itimerspec((timerfd_object *)object, current_value);
+	RtlReleaseSRWLockShared(&object->lock);
+
+	release_fd_object(object);
+
+	return 0;
+}
+
+int wlibc_timerfd_settime(int fd, int flags, const struct itimerspec *restrict new_value, struct itimerspec *restrict old_value)
+{
+	fd_object *object;
+	timerfd_object *timerfd;
+	LONGLONG time;
+
+	VALIDATE_PTR(new_value, EFAULT, -1);
+
+	// TFD_TIMER_CANCEL_ON_SET is not supported (yet). Fail instead of silently arming a timer that won't be canceled.
+	if (flags & ~TFD_TIMER_ABSTIME)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (new_value->it_value.tv_sec < 0 || new_value->it_value.tv_nsec < 0 || new_value->it_value.tv_nsec >= 1000000000 ||
+		new_value->it_interval.tv_sec < 0 || new_value->it_interval.tv_nsec < 0 || new_value->it_interval.tv_nsec >= 1000000000)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	object = acquire_fd_object(fd, TIMERFD_HANDLE);
+	if (object == NULL)
+	{
+		return -1;
+	}
+
+	timerfd = (timerfd_object *)object;
+
+	RtlAcquireSRWLockExclusive(&object->lock);
+
+	if (old_value != NULL)
+	{
+		fill_itimerspec(timerfd, old_value);
+	}
+
+	if (new_value->it_value.tv_sec == 0 && new_value->it_value.tv_nsec == 0)
+	{
+		timerfd->period = 0;
+		timerfd_disarm(timerfd);
+	}
+	else
+	{
+		time = new_value->it_value.tv_sec * 10000000 + new_value->it_value.tv_nsec / 100;
+
+		if (flags & TFD_TIMER_ABSTIME)
+		{
+			timerfd->due = time;
+		}
+		else
+		{
+			// Less than 100ns is still something.
+			timerfd->due = timerfd_now(timerfd->clock) + __max(time, 1);
+		}
+
+		timerfd->period = new_value->it_interval.tv_sec * 10000000 + new_value->it_interval.tv_nsec / 100;
+		if (timerfd->period == 0 && new_value->it_interval.tv_nsec != 0)
+		{
+			timerfd->period = 1;
+		}
+
+		timerfd_arm(timerfd);
+	}
+
+	RtlReleaseSRWLockExclusive(&object->lock);
+
+	release_fd_object(object);
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/fcntl.h>
+#include <internal/uio.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+int common_pio_check(const fdinfo *info);
+
+ssize_t wlibc_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t total;
+	fdinfo info;
+
+	total = common_iov_length(iov, iovcnt);
+	if (total == -1)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
+	{
+		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
+		return -1;
+	}
+
+	return common_readv(fd, &info, iov, iovcnt, total, -1);
+}
+
+ssize_t wlibc_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	ssize_t total;
+	fdinfo info;
+
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	total = common_iov_length(iov, iovcnt);
+	if (total == -1)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (common_pio_check(&info) == -1)
+	{
+		return -1;
+	}
+
+	return common_readv(fd, &info, iov, iovcnt, total, offset);
+}
+
+ssize_t wlibc_preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+	// Reads are always done synchronously, RWF_NOWAIT can't be honoured.
+	if (flags & ~(RWF_HIPRI | RWF_DSYNC | RWF_SYNC | RWF_APPEND))
+	{
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (offset == -1)
+	{
+		return wlibc_readv(fd, iov, iovcnt);
+	}
+
+	return wlibc_preadv(fd, iov, iovcnt, offset);
+}
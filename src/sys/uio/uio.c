@@ -0,0 +1,401 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/error.h>
+#include <internal/fcntl.h>
+#include <internal/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+ssize_t common_read(const fdinfo *info, void *buffer, size_t count);
+ssize_t common_write(const fdinfo *info, const void *buffer, size_t count);
+ssize_t common_pread(int fd, const fdinfo *info, void *buffer, size_t count, off_t offset);
+ssize_t common_pwrite(int fd, const fdinfo *info, const void *buffer, size_t count, off_t offset);
+
+/*
+ NT can only do scatter/gather io on handles opened without intermediate buffering, with page aligned buffers
+ whose sizes are multiples of the page size. Such vectors (from O_DIRECT fds) are transferred natively.
+
+ For everything else adjacent small buffers are coalesced into a bounce buffer, so that a header, body and trailer
+ go out in one request. Large buffers are transferred directly, copying them would cost more than the extra request.
+ The bounce buffers are pooled so that a heap allocation is not needed for each call.
+*/
+
+static PVOID volatile uio_pool[UIO_POOL_SLOTS];
+
+static char *uio_get_bounce_buffer(void)
+{
+	for (int i = 0; i < UIO_POOL_SLOTS; ++i)
+	{
+		char *buffer = (char *)InterlockedExchangePointer(&uio_pool[i], NULL);
+		if (buffer != NULL)
+		{
+			return buffer;
+		}
+	}
+
+	return (char *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, UIO_POOL_BUFFER_SIZE);
+}
+
+static void uio_put_bounce_buffer(char *buffer)
+{
+	for (int i = 0; i < UIO_POOL_SLOTS; ++i)
+	{
+		if (InterlockedCompareExchangePointer(&uio_pool[i], buffer, NULL) == NULL)
+		{
+			return;
+		}
+	}
+
+	RtlFreeHeap(NtCurrentProcessHeap(), 0, buffer);
+}
+
+ssize_t common_iov_length(const struct iovec *iov, int iovcnt)
+{
+	size_t total = 0;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (iov == NULL && iovcnt != 0)
+	{
+		errno = EFAULT;
+		return -1;
+	}
+
+	for (int i = 0; i < iovcnt; ++i)
+	{
+		if (iov[i].iov_base == NULL && iov[i].iov_len != 0)
+		{
+			errno = EFAULT;
+			return -1;
+		}
+
+		// The total should fit in a ssize_t.
+		if (iov[i].iov_len > (SIZE_MAX >> 1) - total)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		total += iov[i].iov_len;
+	}
+
+	return (ssize_t)total;
+}
+
+static ssize_t uio_read(int fd, const fdinfo *info, void *buffer, size_t count, off_t offset)
+{
+	// eventfd, timerfd and signalfd descriptors have no file position, positional io is rejected by common_pio_check.
+	if (IS_OBJECT_HANDLE(info->type))
+	{
+		if (offset != -1)
+		{
+			errno = ESPIPE;
+			return -1;
+		}
+
+		return common_object_read(info, buffer, count);
+	}
+
+	if (offset == -1)
+	{
+		return common_read(info, buffer, count);
+	}
+
+	return common_pread(fd, info, buffer, count, offset);
+}
+
+static ssize_t uio_write(int fd, const fdinfo *info, const void *buffer, size_t count, off_t offset)
+{
+	// eventfd, timerfd and signalfd descriptors have no file position, positional io is rejected by common_pio_check.
+	if (IS_OBJECT_HANDLE(info->type))
+	{
+		if (offset != -1)
+		{
+			errno = ESPIPE;
+			return -1;
+		}
+
+		return common_object_write(info, buffer, count);
+	}
+
+	if (offset == -1)
+	{
+		return common_write(info, buffer, count);
+	}
+
+	return common_pwrite(fd, info, buffer, count, offset);
+}
+
+static int uio_is_page_aligned(const struct iovec *iov, int iovcnt, size_t total)
+{
+	if (total == 0 || total > ULONG_MAX - UIO_PAGE_SIZE)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < iovcnt; ++i)
+	{
+		if (((ULONG_PTR)iov[i].iov_base % UIO_PAGE_SIZE) != 0 || (iov[i].iov_len % UIO_PAGE_SIZE) != 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Transfer the vector with NtReadFileScatter or NtWriteFileGather. Returns 0 if the transfer was done ('result' is set),
+// -1 if it can't be done natively.
+static int uio_native(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset, int write,
+					  ssize_t *result)
+{
+	NTSTATUS status;
+	IO_STATUS_BLOCK io;
+	HANDLE handle;
+	LARGE_INTEGER byte_offset;
+	PLARGE_INTEGER pbyte_offset = NULL;
+	FILE_SEGMENT_ELEMENT stack_segments[64];
+	PFILE_SEGMENT_ELEMENT segments = stack_segments;
+	size_t count = total / UIO_PAGE_SIZE;
+	size_t index = 0;
+
+	if (info->type != FILE_HANDLE || (info->flags & O_DIRECT) == 0 || !uio_is_page_aligned(iov, iovcnt, total))
+	{
+		return -1;
+	}
+
+	if (offset == -1)
+	{
+		// Positional io on a synchronous handle moves the file position, as a plain read/write should.
+		handle = info->handle;
+
+		if (write && (info->flags & O_APPEND))
+		{
+			byte_offset.HighPart = -1;
+			byte_offset.LowPart = FILE_WRITE_TO_END_OF_FILE;
+			pbyte_offset = &byte_offset;
+		}
+	}
+	else
+	{
+		handle = get_fd_pio_handle(fd, info);
+		if (handle == NULL)
+		{
+			return -1;
+		}
+
+		byte_offset.QuadPart = offset;
+		pbyte_offset = &byte_offset;
+	}
+
+	// The segment array is terminated by a NULL element.
+	if (count + 1 > ARRAYSIZE(stack_segments))
+	{
+		segments = (PFILE_SEGMENT_ELEMENT)RtlAllocateHeap(NtCurrentProcessHeap(), 0, sizeof(FILE_SEGMENT_ELEMENT) * (count + 1));
+		if (segments == NULL)
+		{
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < iovcnt; ++i)
+	{
+		for (size_t j = 0; j < iov[i].iov_len; j += UIO_PAGE_SIZE)
+		{
+			segments[index++].Buffer = PtrToPtr64((char *)iov[i].iov_base + j);
+		}
+	}
+
+	segments[index].Alignment = 0;
+	io.Information = 0;
+
+	if (write)
+	{
+		status = NtWriteFileGather(handle, NULL, NULL, NULL, &io, segments, (ULONG)total, pbyte_offset, NULL);
+	}
+	else
+	{
+		status = NtReadFileScatter(handle, NULL, NULL, NULL, &io, segments, (ULONG)total, pbyte_offset, NULL);
+	}
+
+	if (segments != stack_segments)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, segments);
+	}
+
+	// Let the other path deal with these.
+	if (status == STATUS_NOT_SUPPORTED || status == STATUS_INVALID_PARAMETER || status == STATUS_FILE_LOCK_CONFLICT)
+	{
+		return -1;
+	}
+
+	if (status != STATUS_SUCCESS && status != STATUS_PENDING && status != STATUS_END_OF_FILE)
+	{
+		map_ntstatus_to_errno(status);
+		*result = -1;
+		return 0;
+	}
+
+	*result = io.Information;
+	return 0;
+}
+
+// Small buffers are coalesced.
+#define UIO_COALESCE(len, total) ((total) <= UIO_POOL_BUFFER_SIZE || (len) < UIO_COALESCE_SIZE)
+
+static ssize_t uio_vector(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset, int write)
+{
+	char stack_buffer[UIO_STACK_BUFFER_SIZE];
+	char *bounce = NULL;
+	size_t bounce_size = 0;
+	bool bounce_acquired = false;
+	ssize_t result = 0;
+	int i = 0;
+
+	// Nothing to scatter or gather.
+	if (iovcnt == 1)
+	{
+		if (write)
+		{
+			return uio_write(fd, info, iov[0].iov_base, iov[0].iov_len, offset);
+		}
+
+		return uio_read(fd, info, iov[0].iov_base, iov[0].iov_len, offset);
+	}
+
+	if (uio_native(fd, info, iov, iovcnt, total, offset, write, &result) == 0)
+	{
+		return result;
+	}
+
+	result = 0;
+
+	while (i < iovcnt)
+	{
+		ssize_t count;
+		size_t expected = 0;
+		off_t position = (offset == -1) ? -1 : offset + result;
+
+		if (iov[i].iov_len == 0)
+		{
+			++i;
+			continue;
+		}
+
+		if (UIO_COALESCE(iov[i].iov_len, total) && !bounce_acquired)
+		{
+			bounce_acquired = true;
+
+			if (total <= UIO_STACK_BUFFER_SIZE)
+			{
+				bounce = stack_buffer;
+				bounce_size = UIO_STACK_BUFFER_SIZE;
+			}
+			else
+			{
+				// Without a bounce buffer, every buffer is transferred directly.
+				bounce = uio_get_bounce_buffer();
+				bounce_size = (bounce != NULL) ? UIO_POOL_BUFFER_SIZE : 0;
+			}
+		}
+
+		if (UIO_COALESCE(iov[i].iov_len, total) && iov[i].iov_len <= bounce_size)
+		{
+			int first = i;
+
+			while (i < iovcnt && UIO_COALESCE(iov[i].iov_len, total) && expected + iov[i].iov_len <= bounce_size)
+			{
+				if (write)
+				{
+					memcpy(bounce + expected, iov[i].iov_base, iov[i].iov_len);
+				}
+
+				expected += iov[i].iov_len;
+				++i;
+			}
+
+			if (write)
+			{
+				count = uio_write(fd, info, bounce, expected, position);
+			}
+			else
+			{
+				count = uio_read(fd, info, bounce, expected, position);
+
+				// Scatter what was read.
+				for (size_t copied = 0; count > 0 && copied < (size_t)count; ++first)
+				{
+					size_t size = __min(iov[first].iov_len, (size_t)count - copied);
+
+					memcpy(iov[first].iov_base, bounce + copied, size);
+					copied += size;
+				}
+			}
+		}
+		else
+		{
+			expected = iov[i].iov_len;
+
+			if (write)
+			{
+				count = uio_write(fd, info, iov[i].iov_base, expected, position);
+			}
+			else
+			{
+				count = uio_read(fd, info, iov[i].iov_base, expected, position);
+			}
+
+			++i;
+		}
+
+		if (count == -1)
+		{
+			// Report what was transferred before the error.
+			if (result == 0)
+			{
+				result = -1;
+			}
+
+			break;
+		}
+
+		result += count;
+
+		// Short transfer, stop here.
+		if ((size_t)count < expected)
+		{
+			break;
+		}
+	}
+
+	if (bounce != NULL && bounce != stack_buffer)
+	{
+		uio_put_bounce_buffer(bounce);
+	}
+
+	return result;
+}
+
+ssize_t common_readv(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset)
+{
+	return uio_vector(fd, info, iov, iovcnt, total, offset, 0);
+}
+
+ssize_t common_writev(int fd, const fdinfo *info, const struct iovec *iov, int iovcnt, size_t total, off_t offset)
+{
+	return uio_vector(fd, info, iov, iovcnt, total, offset, 1);
+}
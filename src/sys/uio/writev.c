@@ -0,0 +1,127 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/nt.h>
+#include <internal/fcntl.h>
+#include <internal/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+int common_pio_check(const fdinfo *info);
+int common_sync(int fd, int sync_all);
+
+ssize_t wlibc_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	ssize_t total;
+	fdinfo info;
+
+	total = common_iov_length(iov, iovcnt);
+	if (total == -1)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
+	{
+		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
+		return -1;
+	}
+
+	return common_writev(fd, &info, iov, iovcnt, total, -1);
+}
+
+ssize_t wlibc_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	ssize_t total;
+	fdinfo info;
+
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	total = common_iov_length(iov, iovcnt);
+	if (total == -1)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (common_pio_check(&info) == -1)
+	{
+		return -1;
+	}
+
+	return common_writev(fd, &info, iov, iovcnt, total, offset);
+}
+
+ssize_t wlibc_pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+	ssize_t total;
+	ssize_t result;
+	fdinfo info;
+
+	if (flags & ~(RWF_HIPRI | RWF_DSYNC | RWF_SYNC | RWF_APPEND))
+	{
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (offset < -1)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	total = common_iov_length(iov, iovcnt);
+	if (total == -1)
+	{
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (offset == -1 || (flags & RWF_APPEND))
+	{
+		if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
+		{
+			errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
+			return -1;
+		}
+	}
+	else
+	{
+		if (common_pio_check(&info) == -1)
+		{
+			return -1;
+		}
+	}
+
+	// Appending writes ignore the offset, they go through the fd as if it was opened with O_APPEND.
+	if (flags & RWF_APPEND)
+	{
+		info.flags |= O_APPEND;
+		offset = -1;
+	}
+
+	result = common_writev(fd, &info, iov, iovcnt, total, offset);
+
+	if (result > 0 && info.type == FILE_HANDLE && (flags & (RWF_DSYNC | RWF_SYNC)))
+	{
+		if (common_sync(fd, (flags & RWF_SYNC) ? 1 : 0) == -1)
+		{
+			return -1;
+		}
+	}
+
+	return result;
+}
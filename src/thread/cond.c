@@ -7,58 +7,38 @@
 
 #include <internal/nt.h>
 #include <internal/convert.h>
-#include <internal/error.h>
+#include <internal/thread.h>
 #include <internal/validate.h>
 #include <errno.h>
 #include <intrin.h>
 #include <thread.h>
 
-#define VALIDATE_COND(cond)        \
-	VALIDATE_PTR(cond, EINVAL, -1) \
-	if (cond->ptr == NULL)         \
-	{                              \
-		errno = EINVAL;            \
-		return -1;                 \
-	}
-
-#define VALIDATE_MUTEX(mutex)       \
-	VALIDATE_PTR(mutex, EINVAL, -1) \
-	if (mutex->handle == 0)         \
-	{                               \
-		errno = EINVAL;             \
-		return -1;                  \
+#define COND_MAGIC 0x1
+#define VALIDATE_COND(cond)                        \
+	if (cond == NULL || cond->magic != COND_MAGIC) \
+	{                                              \
+		errno = EINVAL;                            \
+		return -1;                                 \
 	}
 
 #define VALIDATE_COND_ATTR(cond_attr) VALIDATE_PTR(cond_attr, EINVAL, -1)
 
-// Spin till we get a lock on the queue.
-#define LOCK_QUEUE(lock)                                                   \
-	while (_InterlockedCompareExchange((volatile LONG *)&lock, 1, 0) != 0) \
-	{                                                                      \
-		_mm_pause();                                                       \
-	}
+int common_mutex_relock(mutex_t *mutex);
 
-#define UNLOCK_QUEUE(lock) _InterlockedCompareExchange((volatile LONG *)&lock, 0, 1);
+/*
+ * Waiters note the sequence number while holding the mutex and sleep on its address until it changes.
+ * Since the sequence is read before the mutex is released, a wake up between the release and the wait can't be missed.
+ * 'waiters' counts the threads yet to be woken up, so that signals with no one waiting do not go to the kernel.
+ */
 
 int wlibc_cond_init(cond_t *restrict cond, const cond_attr_t *restrict attributes)
 {
 	VALIDATE_PTR(cond, EINVAL, -1);
 	UNREFERENCED_PARAMETER(attributes);
 
-	// start with a size of 64.
-	cond->queue_size = 64;
-	cond->queue_begin = 0;
-	cond->queue_end = 0;
-	cond->waiting_threads = 0;
-	cond->lock = 0;
-
-	// Create an array to store 64 thread ids.
-	cond->ptr = (DWORD *)RtlAllocateHeap(NtCurrentProcessHeap(), 0, 64 * sizeof(DWORD));
-	if (cond->ptr == NULL)
-	{
-		errno = ENOMEM;
-		return -1;
-	}
+	cond->sequence = 0;
+	cond->waiters = 0;
+	cond->magic = COND_MAGIC;
 
 	return 0;
 }
@@ -67,51 +47,40 @@ int wlibc_cond_destroy(cond_t *restrict cond)
 {
 	VALIDATE_COND(cond);
 
-	RtlFreeHeap(NtCurrentProcessHeap(), 0, cond->ptr);
-	cond->ptr = NULL;
-	cond->queue_size = 0;
-	cond->queue_begin = 0;
-	cond->queue_end = 0;
-	cond->waiting_threads = 0;
+	cond->magic = 0;
+	cond->sequence = 0;
+	cond->waiters = 0;
 
 	return 0;
 }
 
-int wlibc_cond_signal(cond_t *cond)
+// Take one waiter off the count. Returns 0 if there were none.
+static int cond_consume_waiter(cond_t *cond)
 {
-	VALIDATE_COND(cond);
-
-	NTSTATUS status;
-	DWORD thread_id = 0;
+	LONG waiters = *(volatile LONG *)&cond->waiters;
 
-	LOCK_QUEUE(cond->lock);
-
-	// Queue is now ours.
-	if (cond->waiting_threads > 0)
+	while (waiters != 0)
 	{
-		thread_id = cond->ptr[cond->queue_begin];
-		cond->ptr[cond->queue_begin] = 0;
-
-		if (cond->queue_begin + 1 == cond->queue_end)
+		LONG old = _InterlockedCompareExchange((volatile LONG *)&cond->waiters, waiters - 1, waiters);
+		if (old == waiters)
 		{
-			// There was just one element in the queue reset it.
-			cond->queue_begin = 0;
-			cond->queue_end = 0;
+			return 1;
 		}
 
-		--cond->waiting_threads;
+		waiters = old;
 	}
 
-	UNLOCK_QUEUE(cond->lock);
+	return 0;
+}
+
+int wlibc_cond_signal(cond_t *cond)
+{
+	VALIDATE_COND(cond);
 
-	if (thread_id != 0)
+	if (cond_consume_waiter(cond))
 	{
-		status = NtAlertThreadByThreadId((HANDLE)(SIZE_T)thread_id);
-		if (status != STATUS_SUCCESS)
-		{
-			map_ntstatus_to_errno(status);
-			return -1;
-		}
+		_InterlockedIncrement((volatile LONG *)&cond->sequence);
+		RtlWakeAddressSingle(&cond->sequence);
 	}
 
 	return 0;
@@ -121,111 +90,67 @@ int wlibc_cond_broadcast(cond_t *cond)
 {
 	VALIDATE_COND(cond);
 
-	DWORD thread_id = 0;
-
-	// We are holding the lock here for a long time here. Is this really necessary?.
-	LOCK_QUEUE(cond->lock);
-
-	// Traverse the queue multiple times (atmost 2) to get all the waiting threads.
-	while (cond->waiting_threads != 0)
+	if (_InterlockedExchange((volatile LONG *)&cond->waiters, 0) != 0)
 	{
-		thread_id = cond->ptr[cond->queue_begin];
-		cond->ptr[cond->queue_begin] = 0;
-
-		++cond->queue_begin;
-		--cond->waiting_threads;
-
-		// End of queues memory, go back to the start.
-		if (cond->queue_begin == cond->queue_size)
-		{
-			cond->queue_begin = 0;
-		}
-
-		if (thread_id != 0)
-		{
-			// Ignore errors here.
-			NtAlertThreadByThreadId((HANDLE)(SIZE_T)thread_id);
-		}
+		// Every waiter is woken up with a single call. They then line up on the mutex (see common_mutex_relock),
+		// so only one of them runs at a time instead of all of them fighting for the mutex.
+		_InterlockedIncrement((volatile LONG *)&cond->sequence);
+		RtlWakeAddressAll(&cond->sequence);
 	}
 
-	// No more waiting threads, reset the queue and return.
-	cond->queue_begin = 0;
-	cond->queue_end = 0;
-
-	UNLOCK_QUEUE(cond->lock);
-
 	return 0;
 }
 
 int wlibc_cond_common_wait(cond_t *restrict cond, mutex_t *restrict mutex, const struct timespec *restrict abstime)
 {
-	NTSTATUS status;
+	NTSTATUS status = STATUS_SUCCESS;
 	LARGE_INTEGER timeout;
-	DWORD thread_id = NtCurrentThreadId();
-
-	// First release the mutex.
-	if (wlibc_mutex_unlock(mutex) == -1)
-	{
-		return -1;
-	}
+	unsigned int sequence;
 
-	// Do the wait.
 	if (abstime != NULL)
 	{
 		timeout = timespec_to_LARGE_INTEGER(abstime);
 	}
 
-	// Insert self in the queue.
-	int index;
-
-	LOCK_QUEUE(cond->lock);
+	sequence = *(volatile unsigned int *)&cond->sequence;
+	_InterlockedIncrement((volatile LONG *)&cond->waiters);
 
-	if (cond->queue_end == cond->queue_size)
+	// First release the mutex.
+	if (wlibc_mutex_unlock(mutex) == -1)
 	{
-		// Temporary hack to go back to the beginning. This will be fixed later. FIXME
-		cond->queue_end = 0;
+		cond_consume_waiter(cond);
+		return -1;
 	}
 
-	index = cond->queue_end;
-
-#if 0
-	// TODO
-	// Double the queue buffer if all slots are filled
-	if (cond->queue_end == cond->queue_size && cond->ptr[0] != 0)
+	// The wait can return spuriously, keep waiting till the sequence changes.
+	while (*(volatile unsigned int *)&cond->sequence == sequence)
 	{
-		// Double the queue.
-		DWORD *temp = (DWORD *)malloc(sizeof(DWORD) * cond->queue_size * 2);
-
-
-		cond->queue_size *= 2;
+		status = RtlWaitOnAddress(&cond->sequence, &sequence, sizeof(unsigned int), abstime == NULL ? NULL : &timeout);
+		if (status == STATUS_TIMEOUT)
+		{
+			break;
+		}
 	}
-#endif
-
-	cond->ptr[cond->queue_end++] = thread_id;
-	++cond->waiting_threads;
 
-	UNLOCK_QUEUE(cond->lock);
-
-	// The first argument to this function is pretty much pointless as it does not alert the thread on change automatically.
-	status = NtWaitForAlertByThreadId(NULL, abstime == NULL ? NULL : &timeout);
-	if (status != STATUS_SUCCESS)
+	if (status == STATUS_TIMEOUT)
 	{
-		if (status == STATUS_TIMEOUT)
+		// A wake up might have come in just as we timed out, take it.
+		if (*(volatile unsigned int *)&cond->sequence != sequence)
 		{
-			// Remove self from the queue.
-			LOCK_QUEUE(cond->lock);
-			cond->ptr[index] = 0;
-			--cond->waiting_threads;
-			UNLOCK_QUEUE(cond->lock);
+			status = STATUS_SUCCESS;
+		}
+		else
+		{
+			cond_consume_waiter(cond);
 		}
-
-		map_ntstatus_to_errno(status);
-		return -1;
 	}
 
-	// Finally require the mutex.
-	if (wlibc_mutex_lock(mutex) == -1)
+	// The mutex is reacquired even if the wait timed out.
+	common_mutex_relock(mutex);
+
+	if (status == STATUS_TIMEOUT)
 	{
+		errno = ETIMEDOUT;
 		return -1;
 	}
 
@@ -9,19 +9,22 @@
 #include <internal/thread.h>
 
 DWORD _wlibc_threadinfo_index;
-ULONGLONG _wlibc_tls_bitmap;
-dtor_t _wlibc_tls_destructors[64];
+tls_key _wlibc_tls_keys[TLS_MAX_KEYS];
+RTL_SRWLOCK _wlibc_tls_lock;
 
 void threads_init(void)
 {
-	// Initialize the bitmap to zero.
-	_wlibc_tls_bitmap = 0;
+	RtlInitializeSRWLock(&_wlibc_tls_lock);
 
 	// Allocate the index.
 	_wlibc_threadinfo_index = TlsAlloc();
 
-	// Initialize the destructors.
-	memset(_wlibc_tls_destructors, 0, sizeof(dtor_t) * 64);
+	// All the keys are free, with generation 0.
+	for (int i = 0; i < TLS_MAX_KEYS; ++i)
+	{
+		_wlibc_tls_keys[i].key = i | TLS_KEY_FREE;
+		_wlibc_tls_keys[i].destructor = NULL;
+	}
 
 	// Initialize the main thread's info structure.
 	threadinfo *tinfo = (threadinfo *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(threadinfo));
@@ -53,34 +56,51 @@ void threads_cleanup(void)
 	TlsFree(_wlibc_threadinfo_index);
 }
 
-void cleanup_tls(threadinfo *tinfo)
+static void cleanup_tls_entry(tls_entry *entry, key_t index)
 {
-	if (_wlibc_tls_bitmap == 0)
+	tls_key *key = &_wlibc_tls_keys[index];
+
+	// Check if the value is non zero (non NULL) and was set with the current key of this index.
+	if (entry->value != NULL && entry->key == key->key)
 	{
-		// Quick return if no tls has been allocated.
-		return;
+		// Check if a destructor for the key has been registered.
+		if (key->destructor != NULL)
+		{
+			// Set the value to NULL and execute the destructor with the old value at as its argument.
+			void *value = entry->value;
+			entry->value = NULL;
+			key->destructor(value);
+		}
 	}
+}
 
-	// Iterate through all the active tls slots only once.
+void cleanup_tls(threadinfo *tinfo)
+{
+	// Iterate through all the tls entries only once.
 	// There is no point in repeating this procedure.
-	for (int i = 0; i < 64; ++i)
+	for (int i = 0; i < TLS_INLINE_KEYS; ++i)
 	{
-		// Check if tls slot is active.
-		if (_wlibc_tls_bitmap & (1ull << i))
+		cleanup_tls_entry(&tinfo->slots[i], i);
+	}
+
+	for (int i = 0; i < TLS_PAGES; ++i)
+	{
+		if (tinfo->pages[i] == NULL)
 		{
-			// Check if value at slot is non zero (non NULL).
-			if (tinfo->slots[i].value != NULL)
-			{
-				// Check if a destructor for the slot has been registered.
-				if (_wlibc_tls_destructors[i] != NULL)
-				{
-					// Set the value to NULL and execute the destructor with the old value at as its argument.
-					void *value = tinfo->slots[i].value;
-					tinfo->slots[i].value = NULL;
-					_wlibc_tls_destructors[i](value);
-				}
-			}
+			continue;
 		}
+
+		for (int j = 0; j < TLS_PAGE_KEYS; ++j)
+		{
+			cleanup_tls_entry(&tinfo->pages[i][j], TLS_INLINE_KEYS + i * TLS_PAGE_KEYS + j);
+		}
+	}
+
+	// Free the pages after all the destructors have run, they might set values of other keys.
+	for (int i = 0; i < TLS_PAGES; ++i)
+	{
+		RtlFreeHeap(NtCurrentProcessHeap(), 0, tinfo->pages[i]);
+		tinfo->pages[i] = NULL;
 	}
 }
 
@@ -8,52 +8,149 @@
 #include <internal/nt.h>
 #include <internal/thread.h>
 #include <thread.h>
-#include <intrin.h>
+#include <errno.h>
 
-#pragma intrinsic(_BitScanForward64)
+#define TLS_KEY_GENERATION_MASK ((TLS_KEY_FREE - 1) >> TLS_KEY_INDEX_BITS)
 
-#define VALIDATE_TLS_ENTRY(index, result)           \
-	if ((_wlibc_tls_bitmap & (1ull << index)) == 0) \
-	{                                               \
-		return result;                              \
+#define VALIDATE_TLS_KEY(key, result)                                           \
+	if ((key & TLS_KEY_FREE) || _wlibc_tls_keys[TLS_KEY_INDEX(key)].key != key) \
+	{                                                                           \
+		errno = EINVAL;                                                         \
+		return result;                                                          \
 	}
 
+static tls_entry *get_tls_entry(threadinfo *tinfo, key_t index)
+{
+	if (index < TLS_INLINE_KEYS)
+	{
+		return &tinfo->slots[index];
+	}
+
+	index -= TLS_INLINE_KEYS;
+
+	if (tinfo->pages[index / TLS_PAGE_KEYS] == NULL)
+	{
+		return NULL;
+	}
+
+	return &tinfo->pages[index / TLS_PAGE_KEYS][index % TLS_PAGE_KEYS];
+}
+
 int wlibc_tss_create(key_t *index, dtor_t destructor)
 {
-	// Find a free slot.
-	if (_BitScanForward64(index, ~_wlibc_tls_bitmap) == 1)
+	key_t key;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_tls_lock);
+
+	// Find a free index. The lowest ones are preferred as they are inline.
+	for (int i = 0; i < TLS_MAX_KEYS; ++i)
 	{
-		_wlibc_tls_bitmap |= (1ull << *index);
-		_wlibc_tls_destructors[*index] = destructor;
-		return 0;
+		key = _wlibc_tls_keys[i].key;
+
+		if (key & TLS_KEY_FREE)
+		{
+			key &= ~TLS_KEY_FREE;
+
+			_wlibc_tls_keys[i].destructor = destructor;
+			_wlibc_tls_keys[i].key = key;
+
+			RtlReleaseSRWLockExclusive(&_wlibc_tls_lock);
+
+			*index = key;
+			return 0;
+		}
 	}
 
-	// No free slot found.
+	RtlReleaseSRWLockExclusive(&_wlibc_tls_lock);
+
+	// No free index found.
+	errno = EAGAIN;
 	return -1;
 }
 
-void *wlibc_tss_get(key_t index)
+void *wlibc_tss_get(key_t key)
 {
-	VALIDATE_TLS_ENTRY(index, NULL);
+	threadinfo *tinfo;
+	tls_entry *entry;
+	key_t index = TLS_KEY_INDEX(key);
+
+	// Only the inline slots here, this is the common case.
+	if (index < TLS_INLINE_KEYS)
+	{
+		entry = &get_threadinfo()->slots[index];
 
-	threadinfo *tinfo = TlsGetValue(_wlibc_threadinfo_index);
-	return tinfo->slots[index].value;
+		if (entry->key == key && _wlibc_tls_keys[index].key == key)
+		{
+			return entry->value;
+		}
+
+		return NULL;
+	}
+
+	tinfo = get_threadinfo();
+	entry = get_tls_entry(tinfo, index);
+
+	if (entry != NULL && entry->key == key && _wlibc_tls_keys[index].key == key)
+	{
+		return entry->value;
+	}
+
+	return NULL;
 }
 
-int wlibc_tss_set(key_t index, const void *data)
+int wlibc_tss_set(key_t key, const void *data)
 {
-	VALIDATE_TLS_ENTRY(index, -1);
+	threadinfo *tinfo;
+	tls_entry *entry;
+	key_t index = TLS_KEY_INDEX(key);
+	key_t page;
+
+	VALIDATE_TLS_KEY(key, -1);
+
+	tinfo = get_threadinfo();
+	entry = get_tls_entry(tinfo, index);
+
+	if (entry == NULL)
+	{
+		page = (index - TLS_INLINE_KEYS) / TLS_PAGE_KEYS;
+
+		tinfo->pages[page] = (tls_entry *)RtlAllocateHeap(NtCurrentProcessHeap(), HEAP_ZERO_MEMORY, sizeof(tls_entry) * TLS_PAGE_KEYS);
+		if (tinfo->pages[page] == NULL)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+
+		entry = get_tls_entry(tinfo, index);
+	}
+
+	entry->value = (void *)data;
+	entry->key = key;
 
-	threadinfo *tinfo = TlsGetValue(_wlibc_threadinfo_index);
-	tinfo->slots[index].value = (void *)data;
 	return 0;
 }
 
-int wlibc_tss_delete(key_t index)
+int wlibc_tss_delete(key_t key)
 {
-	VALIDATE_TLS_ENTRY(index, -1);
+	key_t index = TLS_KEY_INDEX(key);
+	key_t generation;
+
+	RtlAcquireSRWLockExclusive(&_wlibc_tls_lock);
+
+	if ((key & TLS_KEY_FREE) || _wlibc_tls_keys[index].key != key)
+	{
+		RtlReleaseSRWLockExclusive(&_wlibc_tls_lock);
+		errno = EINVAL;
+		return -1;
+	}
+
+	// The values set with this key become stale, the next key of this index will have a different generation.
+	generation = ((key >> TLS_KEY_INDEX_BITS) + 1) & TLS_KEY_GENERATION_MASK;
+
+	_wlibc_tls_keys[index].destructor = NULL;
+	_wlibc_tls_keys[index].key = (generation << TLS_KEY_INDEX_BITS) | index | TLS_KEY_FREE;
+
+	RtlReleaseSRWLockExclusive(&_wlibc_tls_lock);
 
-	_wlibc_tls_bitmap &= ~(1ull << index);
-	_wlibc_tls_destructors[index] = NULL;
 	return 0;
 }
@@ -7,21 +7,22 @@
 
 #include <internal/nt.h>
 #include <internal/convert.h>
-#include <internal/error.h>
+#include <internal/thread.h>
 #include <internal/validate.h>
 #include <errno.h>
+#include <intrin.h>
 #include <thread.h>
 
-#define VALIDATE_MUTEX(mutex)       \
-	VALIDATE_PTR(mutex, EINVAL, -1) \
-	if (mutex->handle == 0)         \
-	{                               \
-		errno = EINVAL;             \
-		return -1;                  \
-	}
-
 #define VALIDATE_MUTEX_ATTR(mutex_attr) VALIDATE_PTR(mutex_attr, EINVAL, -1)
 
+// Lock word states.
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1 // Locked, no waiters
+#define MUTEX_CONTENDED 2 // Locked, there might be waiters
+
+// Upper bound for the spin phase. The spins are adapted to the average time taken to acquire the lock by spinning.
+#define MUTEX_MAX_SPINS 100
+
 int wlibc_mutex_init(mutex_t *mutex, const mutex_attr_t *attributes)
 {
 	VALIDATE_PTR(mutex, EINVAL, -1);
@@ -39,19 +40,10 @@ int wlibc_mutex_init(mutex_t *mutex, const mutex_attr_t *attributes)
 		}
 	}
 
-	NTSTATUS status;
-	HANDLE handle;
-
-	status = NtCreateMutant(&handle, MUTANT_ALL_ACCESS, NULL, FALSE);
-	if (status != STATUS_SUCCESS)
-	{
-		map_ntstatus_to_errno(status);
-		return -1;
-	}
-
-	mutex->handle = handle;
+	mutex->state = MUTEX_UNLOCKED;
 	mutex->owner = 0;
 	mutex->count = 0;
+	mutex->spins = 0;
 
 	if (attributes == NULL)
 	{
@@ -63,6 +55,8 @@ int wlibc_mutex_init(mutex_t *mutex, const mutex_attr_t *attributes)
 		mutex->type = attributes->type;
 	}
 
+	mutex->magic = MUTEX_MAGIC;
+
 	return 0;
 }
 
@@ -70,71 +64,132 @@ int wlibc_mutex_destroy(mutex_t *mutex)
 {
 	VALIDATE_MUTEX(mutex);
 
-	NTSTATUS status;
-
-	status = NtClose(mutex->handle);
-	if (status != STATUS_SUCCESS)
+	if (mutex->state != MUTEX_UNLOCKED)
 	{
-		map_ntstatus_to_errno(status);
+		errno = EBUSY;
 		return -1;
 	}
 
-	mutex->handle = 0;
+	mutex->magic = 0;
 	mutex->owner = 0;
 	mutex->count = 0;
 
 	return 0;
 }
 
-int wlibc_mutex_common_lock(mutex_t *restrict mutex, const struct timespec *restrict abstime)
+static int mutex_try_acquire(mutex_t *mutex)
 {
-	NTSTATUS status;
-	LARGE_INTEGER timeout = {0};
+	return _InterlockedCompareExchange((volatile long *)&mutex->state, MUTEX_LOCKED, MUTEX_UNLOCKED) == MUTEX_UNLOCKED;
+}
+
+static int mutex_spin(mutex_t *mutex)
+{
+	int max_spins = mutex->spins * 2 + 10;
+	int spins;
 
-	// First check if we are trying to acquire a non-recursive mutex recursively.
-	if ((mutex->type & WLIBC_MUTEX_RECURSIVE) != WLIBC_MUTEX_RECURSIVE)
+	if (max_spins > MUTEX_MAX_SPINS)
 	{
-		DWORD thread_id = NtCurrentThreadId();
+		max_spins = MUTEX_MAX_SPINS;
+	}
+
+	for (spins = 0; spins < max_spins; ++spins)
+	{
+		_mm_pause();
 
-		if (_InterlockedCompareExchange((volatile long *)&mutex->owner, thread_id, thread_id) == (LONG)thread_id)
+		if (*(volatile int *)&mutex->state == MUTEX_UNLOCKED && mutex_try_acquire(mutex))
 		{
-			// Trying to acquired a recursive mutex lock when the mutex is supposed to be locked onlt one once.
-			// Set errno to 'EDEADLK' (would deadlock) an return.
-			errno = EDEADLK;
-			return -1;
+			// Racy update, this is only a hint.
+			mutex->spins += (spins - mutex->spins) / 8;
+			return 1;
 		}
 	}
 
+	mutex->spins += (max_spins - mutex->spins) / 8;
+	return 0;
+}
+
+int wlibc_mutex_common_lock(mutex_t *restrict mutex, const struct timespec *restrict abstime, int try)
+{
+	NTSTATUS status;
+	LARGE_INTEGER timeout;
+	DWORD thread_id = NtCurrentThreadId();
+	int contended = MUTEX_CONTENDED;
+
+	// Only the owning thread can set the owner to its id, no atomics are needed here.
+	if (*(volatile unsigned int *)&mutex->owner == thread_id)
+	{
+		if (mutex->type & WLIBC_MUTEX_RECURSIVE)
+		{
+			++mutex->count;
+			return 0;
+		}
+
+		// Trying to acquired a recursive mutex lock when the mutex is supposed to be locked only once.
+		// Set errno to 'EDEADLK' (would deadlock) an return.
+		errno = EDEADLK;
+		return -1;
+	}
+
+	// Fast path, uncontended lock.
+	if (mutex_try_acquire(mutex))
+	{
+		goto acquired;
+	}
+
+	if (try)
+	{
+		errno = EBUSY;
+		return -1;
+	}
+
+	// The lock is usually held only briefly, spin for a while before going to sleep.
+	if (mutex_spin(mutex))
+	{
+		goto acquired;
+	}
+
 	// Mutex does not support timed waits for locks.
 	if ((mutex->type & WLIBC_MUTEX_TIMED) == 0)
 	{
 		abstime = NULL;
 	}
-	else
+
+	if (abstime != NULL)
 	{
-		timeout.QuadPart = 0;
-		// If abstime is null                    -> infinite wait for lock.
-		// If abstime is 0(tv_sec, tv_nsec is 0) -> try lock.
-		if (abstime != NULL && abstime->tv_sec != 0 && abstime->tv_nsec != 0)
-		{
-			timeout = timespec_to_LARGE_INTEGER(abstime);
-		}
+		timeout = timespec_to_LARGE_INTEGER(abstime);
 	}
 
-	status = NtWaitForSingleObject(mutex->handle, FALSE, abstime == NULL ? NULL : &timeout);
-	if (status != STATUS_SUCCESS)
+	// Mark the lock as contended so that the owner wakes us when it unlocks.
+	while (_InterlockedExchange((volatile long *)&mutex->state, MUTEX_CONTENDED) != MUTEX_UNLOCKED)
 	{
-		map_ntstatus_to_errno(status);
-		// If we are doing a try lock errno should be set to EBUSY.
-		if (timeout.QuadPart == 0 && errno == ETIMEDOUT)
+		status = RtlWaitOnAddress(&mutex->state, &contended, sizeof(int), abstime == NULL ? NULL : &timeout);
+		if (status == STATUS_TIMEOUT)
 		{
-			errno = EBUSY;
+			errno = ETIMEDOUT;
+			return -1;
 		}
-		return -1;
 	}
 
-	_InterlockedExchange((volatile long *)&mutex->owner, (LONG)NtCurrentThreadId());
-	_InterlockedIncrement((volatile long *)&mutex->count);
+acquired:
+	mutex->owner = thread_id;
+	mutex->count = 1;
+
+	return 0;
+}
+
+// Used by condition variables after a wake up. Skip the spin phase and queue up on the lock word straight away,
+// so that threads woken up together by a broadcast are handed the mutex one at a time.
+int common_mutex_relock(mutex_t *mutex)
+{
+	int contended = MUTEX_CONTENDED;
+
+	while (_InterlockedExchange((volatile long *)&mutex->state, MUTEX_CONTENDED) != MUTEX_UNLOCKED)
+	{
+		RtlWaitOnAddress(&mutex->state, &contended, sizeof(int), NULL);
+	}
+
+	mutex->owner = NtCurrentThreadId();
+	mutex->count = 1;
 
 	return 0;
 }
@@ -142,15 +197,13 @@ int wlibc_mutex_common_lock(mutex_t *restrict mutex, const struct timespec *rest
 int wlibc_mutex_lock(mutex_t *mutex)
 {
 	VALIDATE_MUTEX(mutex);
-	return wlibc_mutex_common_lock(mutex, NULL);
+	return wlibc_mutex_common_lock(mutex, NULL, 0);
 }
 
 int wlibc_mutex_trylock(mutex_t *mutex)
 {
 	VALIDATE_MUTEX(mutex);
-
-	struct timespec timeout = {0, 0};
-	return wlibc_mutex_common_lock(mutex, &timeout);
+	return wlibc_mutex_common_lock(mutex, NULL, 1);
 }
 
 int wlibc_mutex_timedlock(mutex_t *restrict mutex, const struct timespec *restrict abstime)
@@ -158,26 +211,32 @@ int wlibc_mutex_timedlock(mutex_t *restrict mutex, const struct timespec *restri
 	VALIDATE_MUTEX(mutex);
 	VALIDATE_PTR(abstime, EINVAL, -1);
 
-	return wlibc_mutex_common_lock(mutex, abstime);
+	return wlibc_mutex_common_lock(mutex, abstime, 0);
 }
 
 int wlibc_mutex_unlock(mutex_t *mutex)
 {
 	VALIDATE_MUTEX(mutex);
 
-	NTSTATUS status;
-
-	status = NtReleaseMutant(mutex->handle, NULL);
-	if (status != STATUS_SUCCESS)
+	// Only the owner can unlock the mutex.
+	if (*(volatile unsigned int *)&mutex->owner != NtCurrentThreadId())
 	{
-		map_ntstatus_to_errno(status);
+		errno = EPERM;
 		return -1;
 	}
 
-	// If the lock count reaches zero, mutex has no owner.
-	if (_InterlockedDecrement((volatile long *)&mutex->count) == 0)
+	// Recursive locks.
+	if (--mutex->count != 0)
+	{
+		return 0;
+	}
+
+	mutex->owner = 0;
+
+	// Wake up one waiter if there are any.
+	if (_InterlockedExchange((volatile long *)&mutex->state, MUTEX_UNLOCKED) == MUTEX_CONTENDED)
 	{
-		_InterlockedExchange((volatile long *)&mutex->owner, 0);
+		RtlWakeAddressSingle(&mutex->state);
 	}
 
 	return 0;
@@ -18,6 +18,7 @@ int do_dup(int oldfd, int newfd, int flags)
 	HANDLE source;
 	HANDLE target;
 	fdinfo oldfd_info;
+	int fd;
 
 	get_fdinfo(oldfd, &oldfd_info);
 
@@ -40,10 +41,23 @@ int do_dup(int oldfd, int newfd, int flags)
 		return -1;
 	}
 
+	// The duplicate shares the state of the object.
+	if (IS_OBJECT_HANDLE(oldfd_info.type) && dup_fd_object(source, target) == -1)
+	{
+		NtClose(target);
+		return -1;
+	}
+
 	// For dup
 	if (newfd == -1)
 	{
-		return register_to_fd_table(target, oldfd_info.type, oldfd_info.flags);
+		fd = register_to_fd_table(target, oldfd_info.type, oldfd_info.flags);
+		if (fd == -1)
+		{
+			goto fail;
+		}
+
+		return fd;
 	}
 
 	// For dup2, dup3
@@ -53,15 +67,30 @@ int do_dup(int oldfd, int newfd, int flags)
 		// newfd exists in the table
 		if (validate_fd(newfd))
 		{
-			status = (NTSTATUS)close_fd(newfd);
-			if (status == -1)
+			if (close_fd(newfd) == -1)
 			{
-				return -1;
+				goto fail;
 			}
 		}
 
-		return insert_into_fd_table(newfd, target, oldfd_info.type, oldfd_info.flags | flags);
+		fd = insert_into_fd_table(newfd, target, oldfd_info.type, oldfd_info.flags | flags);
+		if (fd == -1)
+		{
+			goto fail;
+		}
+
+		return fd;
 	}
+
+fail:
+	// The duplicate was never installed, drop its share of the object as well.
+	if (IS_OBJECT_HANDLE(oldfd_info.type))
+	{
+		remove_fd_object(target);
+	}
+
+	NtClose(target);
+	return -1;
 }
 
 int wlibc_common_dup(int oldfd, int newfd, int flags)
@@ -11,65 +11,125 @@
 #include <errno.h>
 #include <unistd.h>
 
-ssize_t wlibc_pread(int fd, void *buffer, size_t count, off_t offset)
+// Read through the fd's own handle and put its file position back after. This costs 3 system calls.
+static ssize_t pread_restore_position(HANDLE handle, void *buffer, size_t count, off_t offset)
 {
 	ssize_t result = 0;
 	NTSTATUS status;
 	IO_STATUS_BLOCK io;
-	HANDLE handle;
 	LARGE_INTEGER byte_offset;
 	FILE_POSITION_INFORMATION pos_info;
-	fdinfo info;
 
-	if (buffer == NULL)
+	status = NtQueryInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
+	if (status != STATUS_SUCCESS)
 	{
-		errno = EFAULT;
+		map_ntstatus_to_errno(status);
 		return -1;
 	}
 
-	get_fdinfo(fd, &info);
+	byte_offset.QuadPart = offset;
+	io.Information = 0;
 
-	switch (info.type)
+	status = NtReadFile(handle, NULL, NULL, NULL, &io, buffer, (ULONG)count, &byte_offset, NULL);
+	if (status != STATUS_SUCCESS && status != STATUS_PENDING && status != STATUS_END_OF_FILE)
+	{
+		map_ntstatus_to_errno(status);
+		return -1;
+	}
+	result = io.Information;
+
+	status = NtSetInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
+	if (status != STATUS_SUCCESS)
+	{
+		map_ntstatus_to_errno(status);
+		return -1;
+	}
+
+	return result;
+}
+
+// Check whether positional io can be done on the fd. Returns 0 if it can, -1 (errno is set) otherwise.
+int common_pio_check(const fdinfo *info)
+{
+	switch (info->type)
 	{
 	case FILE_HANDLE:
 	case NULL_HANDLE:
-		break;
+		return 0;
 	case DIRECTORY_HANDLE:
 		errno = EISDIR;
 		return -1;
-	case CONSOLE_HANDLE:
-	case PIPE_HANDLE:
-		errno = ESPIPE;
-		return -1;
 	case INVALID_HANDLE:
 		errno = EBADF;
 		return -1;
+	default:
+		// Consoles, pipes, ...
+		errno = ESPIPE;
+		return -1;
 	}
+}
 
-	handle = info.handle;
+// Read at 'offset' with a single system call, the file position of the fd is not changed.
+ssize_t common_pread(int fd, const fdinfo *info, void *buffer, size_t count, off_t offset)
+{
+	NTSTATUS status;
+	IO_STATUS_BLOCK io;
+	LARGE_INTEGER byte_offset;
+	HANDLE handle = info->handle;
 
-	status = NtQueryInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
-	if (status != STATUS_SUCCESS)
+	// The null device has no position to preserve.
+	if (info->type == FILE_HANDLE)
 	{
-		map_ntstatus_to_errno(status);
-		return -1;
+		handle = get_fd_pio_handle(fd, info);
+		if (handle == NULL)
+		{
+			return pread_restore_position(info->handle, buffer, count, offset);
+		}
 	}
 
 	byte_offset.QuadPart = offset;
+	io.Information = 0;
+
 	status = NtReadFile(handle, NULL, NULL, NULL, &io, buffer, (ULONG)count, &byte_offset, NULL);
+
+	// Byte range locks taken through the fd apply to the other handles of the file as well, ours included.
+	// The lock holder can still read through the fd.
+	if (status == STATUS_FILE_LOCK_CONFLICT && handle != info->handle)
+	{
+		return pread_restore_position(info->handle, buffer, count, offset);
+	}
+
 	if (status != STATUS_SUCCESS && status != STATUS_PENDING && status != STATUS_END_OF_FILE)
 	{
 		map_ntstatus_to_errno(status);
 		return -1;
 	}
-	result = io.Information;
 
-	status = NtSetInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
-	if (status != STATUS_SUCCESS)
+	return io.Information;
+}
+
+ssize_t wlibc_pread(int fd, void *buffer, size_t count, off_t offset)
+{
+	fdinfo info;
+
+	if (buffer == NULL)
 	{
-		map_ntstatus_to_errno(status);
+		errno = EFAULT;
 		return -1;
 	}
 
-	return result;
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (common_pio_check(&info) == -1)
+	{
+		return -1;
+	}
+
+	return common_pread(fd, &info, buffer, count, offset);
 }
@@ -11,65 +11,108 @@
 #include <errno.h>
 #include <unistd.h>
 
-ssize_t wlibc_pwrite(int fd, const void *buffer, size_t count, off_t offset)
+int common_pio_check(const fdinfo *info);
+
+// Write through the fd's own handle and put its file position back after. This costs 3 system calls.
+static ssize_t pwrite_restore_position(HANDLE handle, const void *buffer, size_t count, LARGE_INTEGER *byte_offset)
 {
 	ssize_t result = 0;
 	NTSTATUS status;
 	IO_STATUS_BLOCK io;
-	HANDLE handle;
-	LARGE_INTEGER byte_offset;
 	FILE_POSITION_INFORMATION pos_info;
-	fdinfo info;
 
-	if (buffer == NULL)
+	status = NtQueryInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
+	if (status != STATUS_SUCCESS)
 	{
-		errno = EFAULT;
+		map_ntstatus_to_errno(status);
 		return -1;
 	}
 
-	get_fdinfo(fd, &info);
-
-	switch (info.type)
+	status = NtWriteFile(handle, NULL, NULL, NULL, &io, (PVOID)buffer, (ULONG)count, byte_offset, NULL);
+	if (status != STATUS_SUCCESS && status != STATUS_PENDING)
 	{
-	case FILE_HANDLE:
-	case NULL_HANDLE:
-		break;
-	case DIRECTORY_HANDLE:
-		errno = EISDIR;
-		return -1;
-	case CONSOLE_HANDLE:
-	case PIPE_HANDLE:
-		errno = ESPIPE;
-		return -1;
-	case INVALID_HANDLE:
-		errno = EBADF;
+		map_ntstatus_to_errno(status);
 		return -1;
 	}
+	result = io.Information;
 
-	handle = info.handle;
-
-	status = NtQueryInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
+	status = NtSetInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
 	if (status != STATUS_SUCCESS)
 	{
 		map_ntstatus_to_errno(status);
 		return -1;
 	}
 
+	return result;
+}
+
+// Write at 'offset' with a single system call, the file position of the fd is not changed.
+ssize_t common_pwrite(int fd, const fdinfo *info, const void *buffer, size_t count, off_t offset)
+{
+	NTSTATUS status;
+	IO_STATUS_BLOCK io;
+	LARGE_INTEGER byte_offset;
+	HANDLE handle = info->handle;
+
 	byte_offset.QuadPart = offset;
+
+	// O_APPEND writes go to the end of the file whatever the offset, as on Linux.
+	if (info->flags & O_APPEND)
+	{
+		byte_offset.HighPart = -1;
+		byte_offset.LowPart = FILE_WRITE_TO_END_OF_FILE;
+	}
+
+	// The null device has no position to preserve.
+	if (info->type == FILE_HANDLE)
+	{
+		handle = get_fd_pio_handle(fd, info);
+		if (handle == NULL)
+		{
+			return pwrite_restore_position(info->handle, buffer, count, &byte_offset);
+		}
+	}
+
 	status = NtWriteFile(handle, NULL, NULL, NULL, &io, (PVOID)buffer, (ULONG)count, &byte_offset, NULL);
+
+	// Byte range locks taken through the fd apply to the other handles of the file as well, ours included.
+	// The lock holder can still write through the fd.
+	if (status == STATUS_FILE_LOCK_CONFLICT && handle != info->handle)
+	{
+		return pwrite_restore_position(info->handle, buffer, count, &byte_offset);
+	}
+
 	if (status != STATUS_SUCCESS && status != STATUS_PENDING)
 	{
 		map_ntstatus_to_errno(status);
 		return -1;
 	}
-	result = io.Information;
 
-	status = NtSetInformationFile(handle, &io, &pos_info, sizeof(FILE_POSITION_INFORMATION), FilePositionInformation);
-	if (status != STATUS_SUCCESS)
+	return io.Information;
+}
+
+ssize_t wlibc_pwrite(int fd, const void *buffer, size_t count, off_t offset)
+{
+	fdinfo info;
+
+	if (buffer == NULL)
 	{
-		map_ntstatus_to_errno(status);
+		errno = EFAULT;
 		return -1;
 	}
 
-	return result;
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (common_pio_check(&info) == -1)
+	{
+		return -1;
+	}
+
+	return common_pwrite(fd, &info, buffer, count, offset);
 }
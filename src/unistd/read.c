@@ -12,28 +12,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-ssize_t wlibc_read(int fd, void *buffer, size_t count)
+// Read from the file position of the fd.
+ssize_t common_read(const fdinfo *info, void *buffer, size_t count)
 {
 	NTSTATUS status;
 	IO_STATUS_BLOCK io;
 	HANDLE handle;
-	fdinfo info;
-
-	if (buffer == NULL)
-	{
-		errno = EFAULT;
-		return -1;
-	}
-
-	get_fdinfo(fd, &info);
 
-	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
-	{
-		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
-		return -1;
-	}
-
-	handle = info.handle;
+	handle = info->handle;
 	io.Information = 0;
 
 	status = NtReadFile(handle, NULL, NULL, NULL, &io, buffer, (ULONG)count, NULL, NULL);
@@ -52,3 +38,29 @@ ssize_t wlibc_read(int fd, void *buffer, size_t count)
 	// We strictly don't have to conform to this as applications will check for the result of read, if 0 it means no more data is left.
 	return io.Information;
 }
+
+ssize_t wlibc_read(int fd, void *buffer, size_t count)
+{
+	fdinfo info;
+
+	if (buffer == NULL)
+	{
+		errno = EFAULT;
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
+	{
+		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
+		return -1;
+	}
+
+	if (IS_OBJECT_HANDLE(info.type))
+	{
+		return common_object_read(&info, buffer, count);
+	}
+
+	return common_read(&info, buffer, count);
+}
@@ -12,32 +12,18 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-ssize_t wlibc_write(int fd, const void *buffer, size_t count)
+// Write at the file position of the fd (or at the end for O_APPEND).
+ssize_t common_write(const fdinfo *info, const void *buffer, size_t count)
 {
 	NTSTATUS status;
 	IO_STATUS_BLOCK io;
 	HANDLE handle;
 	LARGE_INTEGER offset;
-	fdinfo info;
-
-	if (buffer == NULL)
-	{
-		errno = EFAULT;
-		return -1;
-	}
-
-	get_fdinfo(fd, &info);
 
-	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
-	{
-		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
-		return -1;
-	}
-
-	handle = info.handle;
+	handle = info->handle;
 	offset.HighPart = -1;
 
-	if (info.flags & O_APPEND)
+	if (info->flags & O_APPEND)
 	{
 		offset.LowPart = FILE_WRITE_TO_END_OF_FILE;
 	}
@@ -57,3 +43,29 @@ ssize_t wlibc_write(int fd, const void *buffer, size_t count)
 
 	return io.Information;
 }
+
+ssize_t wlibc_write(int fd, const void *buffer, size_t count)
+{
+	fdinfo info;
+
+	if (buffer == NULL)
+	{
+		errno = EFAULT;
+		return -1;
+	}
+
+	get_fdinfo(fd, &info);
+
+	if (info.type == DIRECTORY_HANDLE || info.type == INVALID_HANDLE)
+	{
+		errno = (info.type == DIRECTORY_HANDLE ? EISDIR : EBADF);
+		return -1;
+	}
+
+	if (IS_OBJECT_HANDLE(info.type))
+	{
+		return common_object_write(&info, buffer, count);
+	}
+
+	return common_write(&info, buffer, count);
+}
@@ -0,0 +1,145 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of listing a directory with readdir compared to readdir_batch.
+ A directory with the given number of entries is created if no directory is given.
+
+ Usage: bench-readdir [entries | directory]
+*/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH_SIZE 512
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t entries, double time)
+{
+	printf("%16s%12zu%14.1f%12.3f\n", name, entries, (double)entries / time / 1e6, time * 1000);
+}
+
+static int populate(const char *dir, int entries)
+{
+	char name[64];
+	int fd;
+
+	if (mkdir(dir, 0700) == -1)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < entries; ++i)
+	{
+		snprintf(name, 64, "%s/file-%08d", dir, i);
+		fd = creat(name, 0700);
+		if (fd == -1)
+		{
+			return -1;
+		}
+		close(fd);
+	}
+
+	return 0;
+}
+
+static void depopulate(const char *dir, int entries)
+{
+	char name[64];
+
+	for (int i = 0; i < entries; ++i)
+	{
+		snprintf(name, 64, "%s/file-%08d", dir, i);
+		unlink(name);
+	}
+
+	rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "bench-readdir.dir";
+	int entries = 100000;
+	int created = 0;
+	struct dirent *batch;
+	DIR *D;
+	size_t count;
+	ssize_t result;
+	double start;
+
+	if (argc > 1)
+	{
+		entries = atoi(argv[1]);
+		if (entries == 0)
+		{
+			dir = argv[1];
+		}
+	}
+
+	if (entries != 0)
+	{
+		if (populate(dir, entries) == -1)
+		{
+			perror("populate");
+			return 1;
+		}
+		created = 1;
+	}
+
+	batch = (struct dirent *)malloc(sizeof(struct dirent) * BATCH_SIZE);
+	if (batch == NULL)
+	{
+		return 1;
+	}
+
+	printf("%16s%12s%14s%12s\n", "", "entries", "M entries/s", "ms");
+
+	D = opendir(dir);
+	if (D == NULL)
+	{
+		perror("opendir");
+		return 1;
+	}
+
+	count = 0;
+	start = now();
+	while (readdir(D) != NULL)
+	{
+		++count;
+	}
+	report("readdir", count, now() - start);
+
+	count = 0;
+	rewinddir(D);
+	start = now();
+	while ((result = readdir_batch(D, batch, BATCH_SIZE)) > 0)
+	{
+		count += result;
+	}
+	report("readdir_batch", count, now() - start);
+
+	closedir(D);
+	free(batch);
+
+	if (created)
+	{
+		depopulate(dir, entries);
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of scandir on a large directory, unsorted, sorted with alphasort and sorted with a comparator of our own.
+ A directory with the given number of entries is created for this.
+
+ Usage: bench-scandir [entries]
+*/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *dir = "bench-scandir.dir";
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int compare(const struct dirent **e1, const struct dirent **e2)
+{
+	return strcmp((*e1)->d_name, (*e2)->d_name);
+}
+
+static void make_name(char *name, int index)
+{
+	// Created out of order.
+	snprintf(name, 64, "%s/entry-%08d", dir, (int)(((long long)index * 7919) % 100000007));
+}
+
+static int run(const char *name, int (*cmp)(const struct dirent **, const struct dirent **))
+{
+	struct dirent **entries;
+	double start;
+	int count;
+
+	start = now();
+	count = scandir(dir, &entries, NULL, cmp);
+	if (count == -1)
+	{
+		perror("scandir");
+		return -1;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		free(entries[i]);
+	}
+	free(entries);
+
+	printf("%16s%12d%12.3f\n", name, count, (now() - start) * 1000);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int entries = 100000;
+	char name[64];
+	int fd;
+	int result = 0;
+
+	if (argc > 1)
+	{
+		entries = atoi(argv[1]);
+	}
+
+	if (mkdir(dir, 0700) == -1)
+	{
+		perror("mkdir");
+		return 1;
+	}
+
+	for (int i = 0; i < entries; ++i)
+	{
+		make_name(name, i);
+		fd = creat(name, 0700);
+		if (fd == -1)
+		{
+			perror("creat");
+			return 1;
+		}
+		close(fd);
+	}
+
+	printf("%16s%12s%12s\n", "", "entries", "ms");
+
+	result |= run("unsorted", NULL);
+	result |= run("alphasort", alphasort);
+	result |= run("strcmp", compare);
+
+	for (int i = 0; i < entries; ++i)
+	{
+		make_name(name, i);
+		unlink(name);
+	}
+	rmdir(dir);
+
+	return result == 0 ? 0 : 1;
+}
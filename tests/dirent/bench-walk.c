@@ -0,0 +1,198 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of walking a directory tree with readdir and stat on each entry, with nftw, with parallel nftw and with fts.
+ A tree with the given number of directories, each with the given number of files, is created for this.
+
+ Usage: bench-walk [directories] [files]
+*/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <fts.h>
+#include <intrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *dir = "bench-walk.dir";
+static volatile long long total_size;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long long readdir_walk(const char *path)
+{
+	DIR *dirstream;
+	struct dirent *entry;
+	struct stat statbuf;
+	char child[512];
+	long long count = 0;
+
+	dirstream = opendir(path);
+	if (dirstream == NULL)
+	{
+		return 0;
+	}
+
+	while ((entry = readdir(dirstream)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+		{
+			continue;
+		}
+
+		snprintf(child, 512, "%s/%s", path, entry->d_name);
+		if (lstat(child, &statbuf) == -1)
+		{
+			continue;
+		}
+
+		++count;
+		total_size += statbuf.st_size;
+
+		if (S_ISDIR(statbuf.st_mode))
+		{
+			count += readdir_walk(child);
+		}
+	}
+
+	closedir(dirstream);
+
+	return count;
+}
+
+static volatile long nftw_count;
+
+static int nftw_callback(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf)
+{
+	(void)path;
+	(void)statbuf;
+	(void)typeflag;
+	(void)ftwbuf;
+
+	// Called concurrently with FTW_PARALLEL.
+	_InterlockedIncrement(&nftw_count);
+
+	return 0;
+}
+
+static long long fts_walk(void)
+{
+	FTS *ftsp;
+	FTSENT *entry;
+	char *paths[] = {(char *)dir, NULL};
+	long long count = 0;
+
+	ftsp = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, NULL);
+	if (ftsp == NULL)
+	{
+		return 0;
+	}
+
+	while ((entry = fts_read(ftsp)) != NULL)
+	{
+		if (entry->fts_info != FTS_DP)
+		{
+			++count;
+			total_size += entry->fts_statp->st_size;
+		}
+	}
+
+	fts_close(ftsp);
+
+	// The root is counted.
+	return count - 1;
+}
+
+static void report(const char *name, long long count, double start)
+{
+	printf("%16s%12lld%12.3f\n", name, count, (now() - start) * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	int directories = 100, files = 100;
+	char name[256];
+	double start;
+	int fd;
+
+	if (argc > 1)
+	{
+		directories = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		files = atoi(argv[2]);
+	}
+
+	if (mkdir(dir, 0700) == -1)
+	{
+		perror("mkdir");
+		return 1;
+	}
+
+	for (int i = 0; i < directories; ++i)
+	{
+		snprintf(name, 256, "%s/dir-%d", dir, i);
+		mkdir(name, 0700);
+
+		for (int j = 0; j < files; ++j)
+		{
+			snprintf(name, 256, "%s/dir-%d/file-%d", dir, i, j);
+			fd = creat(name, 0700);
+			if (fd == -1)
+			{
+				perror("creat");
+				return 1;
+			}
+			close(fd);
+		}
+	}
+
+	printf("%16s%12s%12s\n", "", "entries", "ms");
+
+	start = now();
+	report("readdir+lstat", readdir_walk(dir), start);
+
+	nftw_count = 0;
+	start = now();
+	nftw(dir, nftw_callback, 16, FTW_PHYS);
+	report("nftw", nftw_count - 1, start);
+
+	nftw_count = 0;
+	start = now();
+	nftw(dir, nftw_callback, 16, FTW_PHYS | FTW_PARALLEL);
+	report("nftw parallel", nftw_count - 1, start);
+
+	start = now();
+	report("fts", fts_walk(), start);
+
+	for (int i = 0; i < directories; ++i)
+	{
+		for (int j = 0; j < files; ++j)
+		{
+			snprintf(name, 256, "%s/dir-%d/file-%d", dir, i, j);
+			unlink(name);
+		}
+
+		snprintf(name, 256, "%s/dir-%d", dir, i);
+		rmdir(name);
+	}
+	rmdir(dir);
+
+	return 0;
+}
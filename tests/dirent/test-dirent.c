@@ -9,6 +9,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -281,6 +282,146 @@ int test_readdir_r() // telldir is also tested
 	return 0;
 }
 
+int test_readdir_batch()
+{
+	ssize_t count;
+	struct dirent entries[16];
+	const char *names[] = {".", "..", "a1", "a2", "a3", "a4", "a5", "a6", "d", "s1", "s2", "sd"};
+	const int types[] = {DT_DIR, DT_DIR, DT_REG, DT_REG, DT_REG, DT_REG, DT_REG, DT_REG, DT_DIR, DT_LNK, DT_LNK, DT_LNK};
+
+	DIR *D = opendir("t");
+	ASSERT_NOTNULL(D);
+
+	count = readdir_batch(D, entries, 5);
+	ASSERT_EQ(count, 5);
+	for (int i = 0; i < 5; ++i)
+	{
+		ASSERT_STREQ(entries[i].d_name, names[i]);
+		ASSERT_EQ(entries[i].d_namlen, strlen(names[i]));
+		ASSERT_EQ(entries[i].d_type, types[i]);
+	}
+
+	// Batches mix with readdir.
+	struct dirent *d = readdir(D);
+	ASSERT_STREQ(d->d_name, "a4");
+
+	count = readdir_batch(D, entries, 16);
+	ASSERT_EQ(count, 6);
+	for (int i = 0; i < 6; ++i)
+	{
+		ASSERT_STREQ(entries[i].d_name, names[i + 6]);
+		ASSERT_EQ(entries[i].d_namlen, strlen(names[i + 6]));
+		ASSERT_EQ(entries[i].d_type, types[i + 6]);
+	}
+
+	// End of directory.
+	count = readdir_batch(D, entries, 16);
+	ASSERT_EQ(count, 0);
+
+	rewinddir(D);
+	count = readdir_batch(D, entries, 16);
+	ASSERT_EQ(count, 12);
+	ASSERT_STREQ(entries[0].d_name, ".");
+	ASSERT_STREQ(entries[11].d_name, "sd");
+
+	ASSERT_SUCCESS(closedir(D));
+
+	count = readdir_batch(NULL, entries, 16);
+	ASSERT_EQ(count, -1);
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
+#define LARGE_DIR_ENTRIES 3000
+
+// Long names so that the entries do not fit in a single query. Every tenth name is not ASCII.
+static void large_dir_name(char *name, const char *dir, int index)
+{
+	snprintf(name, 64, "%s%s-entry-with-a-long-name-%04d", dir, (index % 10 == 0) ? "\xc3\xa9t\xc3\xa9" : "summer", index);
+}
+
+int test_readdir_large()
+{
+	int fd;
+	ssize_t count;
+	size_t total = 0;
+	char name[64];
+	char *seen;
+	struct dirent *d;
+	struct dirent *entries;
+	DIR *D;
+
+	ASSERT_SUCCESS(mkdir("t-large", 0700));
+	for (int i = 0; i < LARGE_DIR_ENTRIES; ++i)
+	{
+		large_dir_name(name, "t-large/", i);
+		fd = creat(name, 0700);
+		ASSERT_NOTEQ(fd, -1);
+		ASSERT_SUCCESS(close(fd));
+	}
+
+	seen = (char *)calloc(LARGE_DIR_ENTRIES, 1);
+	ASSERT_NOTNULL(seen);
+	entries = (struct dirent *)malloc(sizeof(struct dirent) * 256);
+	ASSERT_NOTNULL(entries);
+
+	D = opendir("t-large");
+	ASSERT_NOTNULL(D);
+
+	while ((count = readdir_batch(D, entries, 256)) > 0)
+	{
+		for (ssize_t i = 0; i < count; ++i)
+		{
+			const char *suffix;
+			int index;
+
+			if (entries[i].d_name[0] == '.')
+			{
+				continue;
+			}
+
+			suffix = strrchr(entries[i].d_name, '-');
+			ASSERT_NOTNULL(suffix);
+			index = atoi(suffix + 1);
+			ASSERT_EQ(seen[index], 0);
+			seen[index] = 1;
+
+			large_dir_name(name, "", index);
+			ASSERT_STREQ(entries[i].d_name, name);
+			ASSERT_EQ(entries[i].d_namlen, strlen(name));
+			ASSERT_EQ(entries[i].d_type, DT_REG);
+			++total;
+		}
+	}
+
+	ASSERT_EQ(count, 0);
+	ASSERT_EQ(total, LARGE_DIR_ENTRIES);
+
+	// readdir should see all of them as well.
+	total = 0;
+	rewinddir(D);
+	while ((d = readdir(D)) != NULL)
+	{
+		++total;
+	}
+	ASSERT_EQ(total, LARGE_DIR_ENTRIES + 2);
+
+	ASSERT_SUCCESS(closedir(D));
+
+	for (int i = 0; i < LARGE_DIR_ENTRIES; ++i)
+	{
+		large_dir_name(name, "t-large/", i);
+		ASSERT_SUCCESS(unlink(name));
+	}
+	ASSERT_SUCCESS(rmdir("t-large"));
+
+	free(seen);
+	free(entries);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -293,6 +434,7 @@ int main()
 		TEST(test_readdir());
 		TEST(test_seekdir());
 		TEST(test_readdir_r());
+		TEST(test_readdir_batch());
 		if (cleanup() == 1)
 		{
 			printf("Cleanup failed\n");
@@ -305,5 +447,7 @@ int main()
 		exit(1);
 	}
 
+	TEST(test_readdir_large());
+
 	VERIFY_RESULT_AND_EXIT();
 }
@@ -0,0 +1,283 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ t
+ |-- a1
+ |-- a2
+ |-- d1
+ |   |-- b1
+ |   |-- d3
+ |       |-- c1
+ |-- d2
+*/
+
+int setup()
+{
+	int fd;
+
+	ASSERT_SUCCESS(mkdir("t", 0700));
+	ASSERT_SUCCESS(mkdir("t/d1", 0700));
+	ASSERT_SUCCESS(mkdir("t/d1/d3", 0700));
+	ASSERT_SUCCESS(mkdir("t/d2", 0700));
+
+	fd = creat("t/a1", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/a2", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/d1/b1", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/d1/d3/c1", 0700);
+	ASSERT_EQ(write(fd, "hello", 5), 5);
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int cleanup()
+{
+	ASSERT_SUCCESS(unlink("t/d1/d3/c1"));
+	ASSERT_SUCCESS(unlink("t/d1/b1"));
+	ASSERT_SUCCESS(unlink("t/a1"));
+	ASSERT_SUCCESS(unlink("t/a2"));
+	ASSERT_SUCCESS(rmdir("t/d1/d3"));
+	ASSERT_SUCCESS(rmdir("t/d1"));
+	ASSERT_SUCCESS(rmdir("t/d2"));
+	ASSERT_SUCCESS(rmdir("t"));
+
+	return 0;
+}
+
+static int compare(const FTSENT **a, const FTSENT **b)
+{
+	return strcmp((*a)->fts_name, (*b)->fts_name);
+}
+
+int test_fts_read()
+{
+	FTS *ftsp;
+	FTSENT *entry;
+	char *paths[] = {"t", NULL};
+	// Expected order with the names sorted.
+	const char *expected_paths[] = {"t",	  "t/a1",		"t/a2", "t/d1", "t/d1/b1", "t/d1/d3", "t/d1/d3/c1",
+									"t/d1/d3", "t/d1", "t/d2", "t/d2", "t"};
+	const int expected_info[] = {FTS_D, FTS_F, FTS_F, FTS_D, FTS_F, FTS_D, FTS_F, FTS_DP, FTS_DP, FTS_D, FTS_DP, FTS_DP};
+	const int expected_level[] = {0, 1, 1, 1, 2, 2, 3, 2, 1, 1, 1, 0};
+	int count = 0;
+
+	ftsp = fts_open(paths, FTS_PHYSICAL, compare);
+	ASSERT_NOTNULL(ftsp);
+
+	while ((entry = fts_read(ftsp)) != NULL)
+	{
+		ASSERT_GTEQ(11, count);
+		ASSERT_STREQ(entry->fts_path, expected_paths[count]);
+		ASSERT_EQ(entry->fts_info, expected_info[count]);
+		ASSERT_EQ(entry->fts_level, expected_level[count]);
+		ASSERT_EQ(entry->fts_pathlen, strlen(expected_paths[count]));
+
+		if (entry->fts_info == FTS_F)
+		{
+			ASSERT_EQ(S_ISREG(entry->fts_statp->st_mode), 1);
+		}
+
+		if (strcmp(entry->fts_path, "t/d1/d3/c1") == 0)
+		{
+			ASSERT_STREQ(entry->fts_name, "c1");
+			ASSERT_EQ(entry->fts_namelen, 2);
+			ASSERT_EQ(entry->fts_statp->st_size, 5);
+			ASSERT_STREQ(entry->fts_parent->fts_name, "d3");
+		}
+
+		++count;
+	}
+
+	ASSERT_ERRNO(0);
+	ASSERT_EQ(count, 12);
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	return 0;
+}
+
+int test_fts_set()
+{
+	FTS *ftsp;
+	FTSENT *entry;
+	char *paths[] = {"t/d1", "t/a1", NULL};
+	int files = 0, directories = 0, again = 0;
+
+	ftsp = fts_open(paths, FTS_PHYSICAL, NULL);
+	ASSERT_NOTNULL(ftsp);
+
+	while ((entry = fts_read(ftsp)) != NULL)
+	{
+		if (strcmp(entry->fts_path, "t/d1/d3") == 0 && entry->fts_info == FTS_D)
+		{
+			ASSERT_SUCCESS(fts_set(ftsp, entry, FTS_SKIP));
+		}
+
+		if (strcmp(entry->fts_path, "t/d1/b1") == 0 && again++ == 0)
+		{
+			ASSERT_SUCCESS(fts_set(ftsp, entry, FTS_AGAIN));
+		}
+
+		if (entry->fts_info == FTS_F)
+		{
+			++files;
+		}
+
+		if (entry->fts_info == FTS_D)
+		{
+			++directories;
+		}
+	}
+
+	// b1 twice and a1.
+	ASSERT_EQ(files, 3);
+	ASSERT_EQ(directories, 2);
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	ftsp = fts_open(paths, FTS_PHYSICAL, NULL);
+	ASSERT_NOTNULL(ftsp);
+	entry = fts_read(ftsp);
+	ASSERT_NOTNULL(entry);
+	ASSERT_FAIL(fts_set(ftsp, entry, 100));
+	ASSERT_ERRNO(EINVAL);
+	// Close in the middle of the walk.
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	return 0;
+}
+
+int test_fts_children()
+{
+	FTS *ftsp;
+	FTSENT *entry, *children;
+	char *paths[] = {"t", NULL};
+	int count = 0;
+
+	ftsp = fts_open(paths, FTS_PHYSICAL, compare);
+	ASSERT_NOTNULL(ftsp);
+
+	// Before fts_read the roots are given.
+	children = fts_children(ftsp, 0);
+	ASSERT_NOTNULL(children);
+	ASSERT_STREQ(children->fts_path, "t");
+	ASSERT_NULL(children->fts_link);
+
+	entry = fts_read(ftsp);
+	ASSERT_NOTNULL(entry);
+	ASSERT_EQ(entry->fts_info, FTS_D);
+
+	children = fts_children(ftsp, 0);
+	ASSERT_NOTNULL(children);
+
+	for (FTSENT *child = children; child != NULL; child = child->fts_link)
+	{
+		++count;
+	}
+
+	ASSERT_EQ(count, 4);
+	ASSERT_STREQ(children->fts_name, "a1");
+	ASSERT_STREQ(children->fts_link->fts_link->fts_link->fts_name, "d2");
+
+	// fts_read continues with the children.
+	entry = fts_read(ftsp);
+	ASSERT_NOTNULL(entry);
+	ASSERT_STREQ(entry->fts_path, "t/a1");
+
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	return 0;
+}
+
+int test_fts_seedot()
+{
+	FTS *ftsp;
+	FTSENT *entry;
+	char *paths[] = {"t/d2", NULL};
+	int dots = 0;
+
+	ftsp = fts_open(paths, FTS_PHYSICAL | FTS_SEEDOT, NULL);
+	ASSERT_NOTNULL(ftsp);
+
+	while ((entry = fts_read(ftsp)) != NULL)
+	{
+		if (entry->fts_info == FTS_DOT)
+		{
+			ASSERT_EQ(S_ISDIR(entry->fts_statp->st_mode), 1);
+			++dots;
+		}
+	}
+
+	ASSERT_EQ(dots, 2);
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	return 0;
+}
+
+int test_fts_errors()
+{
+	FTS *ftsp;
+	FTSENT *entry;
+	char *paths[] = {"t/bad", NULL};
+	char *empty[] = {"", NULL};
+
+	ftsp = fts_open(paths, FTS_PHYSICAL, NULL);
+	ASSERT_NOTNULL(ftsp);
+	entry = fts_read(ftsp);
+	ASSERT_NOTNULL(entry);
+	ASSERT_EQ(entry->fts_info, FTS_NS);
+	ASSERT_EQ(entry->fts_errno, ENOENT);
+	ASSERT_NULL(fts_read(ftsp));
+	ASSERT_SUCCESS(fts_close(ftsp));
+
+	ftsp = fts_open(empty, FTS_PHYSICAL, NULL);
+	ASSERT_NULL(ftsp);
+	ASSERT_ERRNO(ENOENT);
+
+	ftsp = fts_open(paths, 0x10000, NULL);
+	ASSERT_NULL(ftsp);
+	ASSERT_ERRNO(EINVAL);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	// If the setup or cleanup fails exit the program
+	if (setup() == 0)
+	{
+		TEST(test_fts_read());
+		TEST(test_fts_set());
+		TEST(test_fts_children());
+		TEST(test_fts_seedot());
+		TEST(test_fts_errors());
+		if (cleanup() == 1)
+		{
+			printf("Cleanup failed\n");
+			exit(1);
+		}
+	}
+	else
+	{
+		printf("Setup failed\n");
+		exit(1);
+	}
+
+	VERIFY_RESULT_AND_EXIT()
+}
@@ -0,0 +1,340 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <Windows.h>
+
+/*
+ t
+ |-- a1
+ |-- a2
+ |-- d1
+ |   |-- b1
+ |   |-- d3
+ |       |-- c1
+ |-- d2
+*/
+
+int setup()
+{
+	int fd;
+
+	ASSERT_SUCCESS(mkdir("t", 0700));
+	ASSERT_SUCCESS(mkdir("t/d1", 0700));
+	ASSERT_SUCCESS(mkdir("t/d1/d3", 0700));
+	ASSERT_SUCCESS(mkdir("t/d2", 0700));
+
+	fd = creat("t/a1", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/a2", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/d1/b1", 0700);
+	ASSERT_SUCCESS(close(fd));
+	fd = creat("t/d1/d3/c1", 0700);
+	ASSERT_EQ(write(fd, "hello", 5), 5);
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int cleanup()
+{
+	ASSERT_SUCCESS(unlink("t/d1/d3/c1"));
+	ASSERT_SUCCESS(unlink("t/d1/b1"));
+	ASSERT_SUCCESS(unlink("t/a1"));
+	ASSERT_SUCCESS(unlink("t/a2"));
+	ASSERT_SUCCESS(rmdir("t/d1/d3"));
+	ASSERT_SUCCESS(rmdir("t/d1"));
+	ASSERT_SUCCESS(rmdir("t/d2"));
+	ASSERT_SUCCESS(rmdir("t"));
+
+	return 0;
+}
+
+static volatile LONG files, directories, post_directories, others;
+static volatile LONG order_errors;
+
+static void reset_counts()
+{
+	files = 0;
+	directories = 0;
+	post_directories = 0;
+	others = 0;
+	order_errors = 0;
+}
+
+static int count_callback(const char *path, const struct stat *statbuf, int typeflag)
+{
+	switch (typeflag)
+	{
+	case FTW_F:
+		InterlockedIncrement(&files);
+		if (!S_ISREG(statbuf->st_mode))
+		{
+			InterlockedIncrement(&order_errors);
+		}
+		if (strcmp(path, "t/d1/d3/c1") == 0 && statbuf->st_size != 5)
+		{
+			InterlockedIncrement(&order_errors);
+		}
+		break;
+	case FTW_D:
+		InterlockedIncrement(&directories);
+		if (!S_ISDIR(statbuf->st_mode))
+		{
+			InterlockedIncrement(&order_errors);
+		}
+		break;
+	case FTW_DP:
+		InterlockedIncrement(&post_directories);
+		break;
+	default:
+		InterlockedIncrement(&others);
+		break;
+	}
+
+	return 0;
+}
+
+static int ncount_callback(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf)
+{
+	if (strcmp(path + ftwbuf->base, "c1") == 0 && ftwbuf->level != 3)
+	{
+		InterlockedIncrement(&order_errors);
+	}
+
+	if (strcmp(path, "t") == 0 && ftwbuf->level != 0)
+	{
+		InterlockedIncrement(&order_errors);
+	}
+
+	return count_callback(path, statbuf, typeflag);
+}
+
+int test_ftw()
+{
+	int result;
+
+	reset_counts();
+	result = ftw("t", count_callback, 16);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(directories, 4);
+	ASSERT_EQ(post_directories, 0);
+	ASSERT_EQ(others, 0);
+	ASSERT_EQ(order_errors, 0);
+
+	// Not a directory.
+	reset_counts();
+	result = ftw("t/a1", count_callback, 16);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 1);
+	ASSERT_EQ(directories, 0);
+
+	result = ftw("t/bad", count_callback, 16);
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(ENOENT);
+
+	result = ftw("t", NULL, 16);
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(EINVAL);
+
+	return 0;
+}
+
+static char last_path[256];
+
+static int depth_callback(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf)
+{
+	// With FTW_DEPTH the contents of a directory come before it.
+	if (typeflag == FTW_DP && strcmp(path, "t/d1") == 0 && strcmp(last_path, "t/d1/b1") != 0 && strcmp(last_path, "t/d1/d3") != 0)
+	{
+		InterlockedIncrement(&order_errors);
+	}
+
+	strcpy(last_path, path);
+
+	return ncount_callback(path, statbuf, typeflag, ftwbuf);
+}
+
+int test_nftw()
+{
+	int result;
+
+	reset_counts();
+	result = nftw("t", ncount_callback, 16, FTW_PHYS);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(directories, 4);
+	ASSERT_EQ(post_directories, 0);
+	ASSERT_EQ(order_errors, 0);
+
+	reset_counts();
+	last_path[0] = '\0';
+	result = nftw("t", depth_callback, 16, FTW_PHYS | FTW_DEPTH);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(directories, 0);
+	ASSERT_EQ(post_directories, 4);
+	ASSERT_EQ(order_errors, 0);
+	ASSERT_STREQ(last_path, "t");
+
+	// Trailing slash.
+	reset_counts();
+	result = nftw("t/", ncount_callback, 16, FTW_CHDIR);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(directories, 4);
+
+	result = nftw("t", ncount_callback, 16, 0x1000);
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(EINVAL);
+
+	return 0;
+}
+
+static int stop_callback(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf)
+{
+	ncount_callback(path, statbuf, typeflag, ftwbuf);
+
+	if (strcmp(path, "t/d1/b1") == 0)
+	{
+		return 42;
+	}
+
+	return 0;
+}
+
+static int skip_callback(const char *path, const struct stat *statbuf, int typeflag, struct FTW *ftwbuf)
+{
+	ncount_callback(path, statbuf, typeflag, ftwbuf);
+
+	if (strcmp(path, "t/d1") == 0)
+	{
+		return FTW_SKIP_SUBTREE;
+	}
+
+	return FTW_CONTINUE;
+}
+
+int test_nftw_return()
+{
+	int result;
+
+	// The walk stops with the value returned by the callback.
+	reset_counts();
+	result = nftw("t", stop_callback, 16, FTW_PHYS);
+	ASSERT_EQ(result, 42);
+	ASSERT_EQ(order_errors, 0);
+
+	reset_counts();
+	result = nftw("t", skip_callback, 16, FTW_PHYS | FTW_ACTIONRETVAL);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 2);
+	ASSERT_EQ(directories, 3);
+
+	return 0;
+}
+
+int test_nftw_parallel()
+{
+	int result;
+
+	reset_counts();
+	result = nftw("t", ncount_callback, 16, FTW_PHYS | FTW_PARALLEL);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(directories, 4);
+	ASSERT_EQ(order_errors, 0);
+
+	reset_counts();
+	result = nftw("t", ncount_callback, 16, FTW_PHYS | FTW_PARALLEL | FTW_DEPTH);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 4);
+	ASSERT_EQ(post_directories, 4);
+	ASSERT_EQ(order_errors, 0);
+
+	reset_counts();
+	result = nftw("t", stop_callback, 16, FTW_PHYS | FTW_PARALLEL);
+	ASSERT_EQ(result, 42);
+
+	result = nftw("t", ncount_callback, 16, FTW_PARALLEL | FTW_CHDIR);
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(EINVAL);
+
+	return 0;
+}
+
+int test_nftw_large()
+{
+	int result;
+	int fd;
+	char path[64];
+
+	// More entries than a single batch of the directory reads.
+	ASSERT_SUCCESS(mkdir("t/d2/big", 0700));
+	for (int i = 0; i < 500; ++i)
+	{
+		snprintf(path, 64, "t/d2/big/file-%d", i);
+		fd = creat(path, 0700);
+		ASSERT_SUCCESS(close(fd));
+	}
+
+	reset_counts();
+	result = nftw("t", ncount_callback, 16, FTW_PHYS);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 504);
+	ASSERT_EQ(directories, 5);
+
+	reset_counts();
+	result = nftw("t", ncount_callback, 16, FTW_PHYS | FTW_PARALLEL);
+	ASSERT_EQ(result, 0);
+	ASSERT_EQ(files, 504);
+	ASSERT_EQ(directories, 5);
+
+	for (int i = 0; i < 500; ++i)
+	{
+		snprintf(path, 64, "t/d2/big/file-%d", i);
+		ASSERT_SUCCESS(unlink(path));
+	}
+	ASSERT_SUCCESS(rmdir("t/d2/big"));
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	// If the setup or cleanup fails exit the program
+	if (setup() == 0)
+	{
+		TEST(test_ftw());
+		TEST(test_nftw());
+		TEST(test_nftw_return());
+		TEST(test_nftw_parallel());
+		TEST(test_nftw_large());
+		if (cleanup() == 1)
+		{
+			printf("Cleanup failed\n");
+			exit(1);
+		}
+	}
+	else
+	{
+		printf("Setup failed\n");
+		exit(1);
+	}
+
+	VERIFY_RESULT_AND_EXIT()
+}
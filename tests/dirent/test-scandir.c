@@ -9,6 +9,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -100,6 +101,98 @@ int test_scandir()
 	return 0;
 }
 
+int test_alphasort()
+{
+	struct dirent **entries = NULL;
+	const char *names[] = {".", "..", "a1", "a2", "a3", "d1", "d2"};
+	int count = scandir("t", &entries, NULL, alphasort);
+
+	ASSERT_EQ(count, 7);
+
+	for (int i = 0; i < count; ++i)
+	{
+		ASSERT_STREQ(entries[i]->d_name, names[i]);
+		ASSERT_EQ(entries[i]->d_namlen, strlen(names[i]));
+		ASSERT_EQ(entries[i]->d_type, (names[i][0] == 'a' ? DT_REG : DT_DIR));
+		free(entries[i]);
+	}
+	free(entries);
+
+	return 0;
+}
+
+int reject(const struct dirent *entry WLIBC_UNUSED)
+{
+	return 0;
+}
+
+int test_scandir_none()
+{
+	struct dirent **entries = NULL;
+	int count = scandir("t", &entries, reject, alphasort);
+
+	ASSERT_EQ(count, 0);
+	free(entries);
+
+	errno = 0;
+	count = scandir("t-none", &entries, NULL, alphasort);
+	ASSERT_EQ(count, -1);
+	ASSERT_ERRNO(ENOENT);
+
+	return 0;
+}
+
+#define LARGE_DIR_ENTRIES 2500
+
+// Names share long prefixes and vary in length, created in an order different from the sorted one.
+static void large_dir_name(char *name, const char *dir, int index)
+{
+	snprintf(name, 64, "%s%s%d", dir, (index % 2) ? "common-prefix-" : "c", (index * 7919) % LARGE_DIR_ENTRIES);
+}
+
+int test_scandir_large()
+{
+	int fd;
+	int count;
+	char name[64];
+	struct dirent **entries = NULL;
+
+	ASSERT_SUCCESS(mkdir("t-large", 0700));
+	for (int i = 0; i < LARGE_DIR_ENTRIES; ++i)
+	{
+		large_dir_name(name, "t-large/", i);
+		fd = creat(name, 0700);
+		ASSERT_NOTEQ(fd, -1);
+		ASSERT_SUCCESS(close(fd));
+	}
+
+	count = scandir("t-large", &entries, NULL, alphasort);
+	ASSERT_EQ(count, LARGE_DIR_ENTRIES + 2);
+
+	ASSERT_STREQ(entries[0]->d_name, ".");
+	ASSERT_STREQ(entries[1]->d_name, "..");
+	for (int i = 1; i < count; ++i)
+	{
+		ASSERT_EQ(strcmp(entries[i - 1]->d_name, entries[i]->d_name) < 0, 1);
+		ASSERT_EQ(entries[i]->d_namlen, strlen(entries[i]->d_name));
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		free(entries[i]);
+	}
+	free(entries);
+
+	for (int i = 0; i < LARGE_DIR_ENTRIES; ++i)
+	{
+		large_dir_name(name, "t-large/", i);
+		ASSERT_SUCCESS(unlink(name));
+	}
+	ASSERT_SUCCESS(rmdir("t-large"));
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -108,6 +201,8 @@ int main()
 	if (setup() == 0)
 	{
 		TEST(test_scandir());
+		TEST(test_alphasort());
+		TEST(test_scandir_none());
 		if (cleanup() == 1)
 		{
 			printf("Cleanup failed\n");
@@ -120,5 +215,7 @@ int main()
 		exit(1);
 	}
 
+	TEST(test_scandir_large());
+
 	VERIFY_RESULT_AND_EXIT();
 }
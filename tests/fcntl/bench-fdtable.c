@@ -0,0 +1,257 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of opening and closing fds from many threads at once. Each thread opens its share of the fds, keeping them all
+ open, and then closes them. The fd table is compared against the previous scheme of a table that is scanned for the
+ lowest free slot on open and for the handle on close, under an exclusive lock.
+
+ Usage: bench-fdtable [fds] [threads]
+*/
+
+#include <Windows.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct _bench_thread
+{
+	pthread_t thread;
+	size_t count;
+	int *fds;
+	HANDLE *handles;
+	double open_time;
+	double close_time;
+	int failed;
+} bench_thread;
+
+// The previous table.
+static SRWLOCK old_lock = SRWLOCK_INIT;
+static HANDLE *old_table;
+static size_t old_size;
+
+static pthread_barrier_t barrier;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int old_register(HANDLE handle)
+{
+	int fd = -1;
+
+	AcquireSRWLockExclusive(&old_lock);
+
+	for (size_t i = 0; i < old_size; ++i)
+	{
+		if (old_table[i] == NULL)
+		{
+			old_table[i] = handle;
+			fd = (int)i;
+			break;
+		}
+	}
+
+	ReleaseSRWLockExclusive(&old_lock);
+
+	return fd;
+}
+
+static void old_unregister(HANDLE handle)
+{
+	AcquireSRWLockExclusive(&old_lock);
+
+	for (size_t i = 0; i < old_size; ++i)
+	{
+		if (old_table[i] == handle)
+		{
+			old_table[i] = NULL;
+			break;
+		}
+	}
+
+	ReleaseSRWLockExclusive(&old_lock);
+}
+
+static void *old_proc(void *arg)
+{
+	bench_thread *bench = (bench_thread *)arg;
+	double start;
+
+	pthread_barrier_wait(&barrier);
+
+	start = now();
+	for (size_t i = 0; i < bench->count; ++i)
+	{
+		bench->handles[i] = CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+		if (bench->handles[i] == INVALID_HANDLE_VALUE || old_register(bench->handles[i]) == -1)
+		{
+			bench->failed = 1;
+			bench->count = i;
+			break;
+		}
+	}
+	bench->open_time = now() - start;
+
+	pthread_barrier_wait(&barrier);
+
+	start = now();
+	for (size_t i = 0; i < bench->count; ++i)
+	{
+		old_unregister(bench->handles[i]);
+		CloseHandle(bench->handles[i]);
+	}
+	bench->close_time = now() - start;
+
+	return NULL;
+}
+
+static void *fd_proc(void *arg)
+{
+	bench_thread *bench = (bench_thread *)arg;
+	double start;
+
+	pthread_barrier_wait(&barrier);
+
+	start = now();
+	for (size_t i = 0; i < bench->count; ++i)
+	{
+		bench->fds[i] = open("/dev/null", O_RDONLY);
+		if (bench->fds[i] == -1)
+		{
+			bench->failed = 1;
+			bench->count = i;
+			break;
+		}
+	}
+	bench->open_time = now() - start;
+
+	pthread_barrier_wait(&barrier);
+
+	start = now();
+	for (size_t i = 0; i < bench->count; ++i)
+	{
+		close(bench->fds[i]);
+	}
+	bench->close_time = now() - start;
+
+	return NULL;
+}
+
+// The slowest thread decides the time of each phase.
+static int run(const char *name, void *(*proc)(void *), bench_thread *threads, int thread_count, size_t total)
+{
+	double open_time = 0, close_time = 0;
+	int failed = 0;
+
+	pthread_barrier_init(&barrier, NULL, thread_count);
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		threads[i].count = total / thread_count + (i < (int)(total % thread_count) ? 1 : 0);
+		threads[i].open_time = 0;
+		threads[i].close_time = 0;
+		threads[i].failed = 0;
+
+		if (pthread_create(&threads[i].thread, NULL, proc, &threads[i]) != 0)
+		{
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		pthread_join(threads[i].thread, NULL);
+
+		open_time = threads[i].open_time > open_time ? threads[i].open_time : open_time;
+		close_time = threads[i].close_time > close_time ? threads[i].close_time : close_time;
+		failed |= threads[i].failed;
+	}
+
+	pthread_barrier_destroy(&barrier);
+
+	if (failed)
+	{
+		printf("%20s failed\n", name);
+		return 1;
+	}
+
+	printf("%20s%12.2f%12.2f%12.3f\n", name, open_time * 1e9 / total, close_time * 1e9 / total, (open_time + close_time) * 1000);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t total = 100000;
+	int thread_count = 16;
+	bench_thread threads[MAX_THREADS];
+	size_t share;
+	int result = 0;
+
+	if (argc > 1)
+	{
+		total = (size_t)atoll(argv[1]);
+	}
+
+	if (argc > 2)
+	{
+		thread_count = atoi(argv[2]);
+	}
+
+	if (total == 0 || thread_count <= 0 || thread_count > MAX_THREADS)
+	{
+		printf("Usage: bench-fdtable [fds] [threads (1 - %d)]\n", MAX_THREADS);
+		return 1;
+	}
+
+	share = total / thread_count + 1;
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		threads[i].fds = (int *)malloc(sizeof(int) * share);
+		threads[i].handles = (HANDLE *)malloc(sizeof(HANDLE) * share);
+
+		if (threads[i].fds == NULL || threads[i].handles == NULL)
+		{
+			return 1;
+		}
+	}
+
+	// Room for all the fds, the previous table had already grown by then.
+	old_size = total + 3;
+	old_table = (HANDLE *)calloc(old_size, sizeof(HANDLE));
+	if (old_table == NULL)
+	{
+		return 1;
+	}
+
+	printf("%zu fds, %d threads\n", total, thread_count);
+	printf("%20s%12s%12s%12s\n", "", "ns/open", "ns/close", "ms");
+
+	result |= run("scanned table", old_proc, threads, thread_count, total);
+	result |= run("fd table", fd_proc, threads, thread_count, total);
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		free(threads[i].fds);
+		free(threads[i].handles);
+	}
+
+	free(old_table);
+
+	return result;
+}
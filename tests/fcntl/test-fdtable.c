@@ -0,0 +1,175 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <internal/fcntl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <Windows.h>
+
+#define FDTABLE_THREADS    16
+#define FDTABLE_ITERATIONS (100000 / FDTABLE_THREADS)
+
+int test_lowest_fd()
+{
+	int fd[4];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		fd[i] = open("/dev/null", O_RDONLY);
+		ASSERT_EQ(fd[i], 3 + i);
+	}
+
+	ASSERT_SUCCESS(close(fd[2]));
+	ASSERT_SUCCESS(close(fd[0]));
+
+	// The lowest free fd should be given.
+	fd[0] = open("/dev/null", O_RDONLY);
+	ASSERT_EQ(fd[0], 3);
+
+	fd[2] = open("/dev/null", O_RDONLY);
+	ASSERT_EQ(fd[2], 5);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		ASSERT_SUCCESS(close(fd[i]));
+	}
+
+	return 0;
+}
+
+int test_grow()
+{
+	int fd[300];
+	HANDLE handle;
+
+	// This should grow the table a few times.
+	for (int i = 0; i < 300; ++i)
+	{
+		fd[i] = open("/dev/null", O_RDONLY);
+		ASSERT_EQ(fd[i], 3 + i);
+	}
+
+	for (int i = 0; i < 300; ++i)
+	{
+		handle = get_fd_handle(fd[i]);
+		ASSERT_EQ(get_fd(handle), fd[i]);
+	}
+
+	for (int i = 0; i < 300; i += 2)
+	{
+		ASSERT_SUCCESS(close(fd[i]));
+	}
+
+	for (int i = 0; i < 300; i += 2)
+	{
+		fd[i] = open("/dev/null", O_RDONLY);
+		ASSERT_EQ(fd[i], 3 + i);
+	}
+
+	for (int i = 0; i < 300; ++i)
+	{
+		ASSERT_SUCCESS(close(fd[i]));
+	}
+
+	return 0;
+}
+
+int test_dup2_high()
+{
+	int fd, fd2;
+	HANDLE handle;
+
+	fd = open("/dev/null", O_RDONLY);
+	ASSERT_EQ(fd, 3);
+
+	fd2 = dup2(fd, 5000);
+	ASSERT_EQ(fd2, 5000);
+
+	handle = get_fd_handle(fd2);
+	ASSERT_EQ(get_fd(handle), 5000);
+	ASSERT_EQ(get_fd_type(fd2), NULL_HANDLE);
+
+	ASSERT_SUCCESS(close(fd2));
+	ASSERT_EQ(get_fd_type(fd2), INVALID_HANDLE);
+	ASSERT_EQ(get_fd(handle), -1);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+static volatile LONG failures = 0;
+
+DWORD WINAPI open_close_thread(LPVOID arg)
+{
+	int fd;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	for (int i = 0; i < FDTABLE_ITERATIONS; ++i)
+	{
+		fd = open("/dev/null", O_RDONLY);
+		if (fd == -1)
+		{
+			InterlockedIncrement(&failures);
+			continue;
+		}
+
+		if (get_fd_type(fd) != NULL_HANDLE || get_fd(get_fd_handle(fd)) != fd)
+		{
+			InterlockedIncrement(&failures);
+		}
+
+		if (close(fd) != 0)
+		{
+			InterlockedIncrement(&failures);
+		}
+	}
+
+	return 0;
+}
+
+int test_concurrent()
+{
+	int fd;
+	HANDLE threads[FDTABLE_THREADS];
+
+	for (int i = 0; i < FDTABLE_THREADS; ++i)
+	{
+		threads[i] = CreateThread(NULL, 0, open_close_thread, NULL, 0, NULL);
+		ASSERT_NOTNULL(threads[i]);
+	}
+
+	WaitForMultipleObjects(FDTABLE_THREADS, threads, TRUE, INFINITE);
+
+	for (int i = 0; i < FDTABLE_THREADS; ++i)
+	{
+		CloseHandle(threads[i]);
+	}
+
+	ASSERT_EQ(failures, 0);
+
+	// Every fd should have been released.
+	fd = open("/dev/null", O_RDONLY);
+	ASSERT_EQ(fd, 3);
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_lowest_fd());
+	TEST(test_grow());
+	TEST(test_dup2_high());
+	TEST(test_concurrent());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -8,6 +8,8 @@
 #include <tests/test.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <unistd.h>
 
 int test_poll_err()
@@ -246,6 +248,81 @@ int test_poll_wait()
 	return 0;
 }
 
+void *delayed_write(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+
+	usleep(50000); // 50 ms
+	write(fd, "hello", 5);
+
+	return NULL;
+}
+
+int test_poll_wakeup()
+{
+	int result;
+	int fd[2];
+	pthread_t thread;
+	struct pollfd fds[1];
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	fds[0].fd = fd[0];
+	fds[0].events = POLLIN;
+
+	// The write from the other thread should end the wait well before the timeout.
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_write, (void *)(intptr_t)fd[1]));
+
+	result = poll(fds, 1, 60000);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(fds[0].revents, POLLIN);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	// Infinite wait with data already present.
+	result = poll(fds, 1, -1);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(fds[0].revents, POLLIN);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+
+	return 0;
+}
+
+int test_poll_nonblocking_wakeup()
+{
+	int result;
+	int fd1[2], fd2[2];
+	pthread_t thread;
+	struct pollfd fds[2];
+
+	// Non blocking pipes are waited on the same way.
+	ASSERT_SUCCESS(pipe2(fd1, O_NONBLOCK));
+	ASSERT_SUCCESS(pipe2(fd2, O_NONBLOCK));
+
+	fds[0].fd = fd1[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = fd2[0];
+	fds[1].events = POLLIN;
+
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_write, (void *)(intptr_t)fd2[1]));
+
+	result = poll(fds, 2, 60000);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(fds[0].revents, 0);
+	ASSERT_EQ(fds[1].revents, POLLIN);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	ASSERT_SUCCESS(close(fd1[0]));
+	ASSERT_SUCCESS(close(fd1[1]));
+	ASSERT_SUCCESS(close(fd2[0]));
+	ASSERT_SUCCESS(close(fd2[1]));
+
+	return 0;
+}
+
 void cleanup()
 {
 	remove("t-poll-rw");
@@ -264,6 +341,8 @@ int main()
 	TEST(test_poll_pipe());
 	TEST(test_poll_pipe_err());
 	TEST(test_poll_wait());
+	TEST(test_poll_wakeup());
+	TEST(test_poll_nonblocking_wakeup());
 
 	VERIFY_RESULT_AND_EXIT();
 }
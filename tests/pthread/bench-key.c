@@ -0,0 +1,130 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of pthread_getspecific for an inline key and a paged key, compared to the previous path of TlsGetValue
+ followed by an index into the thread's slots.
+
+ Usage: bench-key [iterations]
+*/
+
+#include <Windows.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PAGED_KEY_INDEX 1000
+
+typedef struct _old_slots
+{
+	void *slots[64];
+} old_slots;
+
+static DWORD old_index;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Kept out of line, like the library call it is compared against.
+static __declspec(noinline) void *old_getspecific(pthread_key_t key)
+{
+	old_slots *slots = (old_slots *)TlsGetValue(old_index);
+	return slots->slots[key];
+}
+
+static void report(const char *name, size_t iterations, double time)
+{
+	printf("%20s%12.2f%12.3f\n", name, time * 1e9 / iterations, time * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	size_t iterations = 100000000;
+	pthread_key_t inline_key, paged_key;
+	pthread_key_t *keys;
+	old_slots slots = {0};
+	uintptr_t sum = 0;
+	double start;
+
+	if (argc > 1)
+	{
+		iterations = (size_t)atoll(argv[1]);
+	}
+
+	// Create enough keys to get one in a page.
+	keys = (pthread_key_t *)malloc(sizeof(pthread_key_t) * (PAGED_KEY_INDEX + 1));
+	if (keys == NULL)
+	{
+		return 1;
+	}
+
+	for (int i = 0; i <= PAGED_KEY_INDEX; ++i)
+	{
+		if (pthread_key_create(&keys[i], NULL) != 0)
+		{
+			perror("pthread_key_create");
+			return 1;
+		}
+	}
+
+	inline_key = keys[0];
+	paged_key = keys[PAGED_KEY_INDEX];
+
+	pthread_setspecific(inline_key, (void *)1);
+	pthread_setspecific(paged_key, (void *)2);
+
+	old_index = TlsAlloc();
+	slots.slots[0] = (void *)1;
+	TlsSetValue(old_index, &slots);
+
+	printf("%zu iterations\n", iterations);
+	printf("%20s%12s%12s\n", "", "ns/get", "ms");
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += (uintptr_t)old_getspecific(0);
+	}
+	report("TlsGetValue + index", iterations, now() - start);
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += (uintptr_t)pthread_getspecific(inline_key);
+	}
+	report("inline key", iterations, now() - start);
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += (uintptr_t)pthread_getspecific(paged_key);
+	}
+	report("paged key", iterations, now() - start);
+
+	// Keep the loops from being optimized away.
+	if (sum != iterations * 4)
+	{
+		printf("Unexpected sum %zu\n", (size_t)sum);
+		return 1;
+	}
+
+	TlsFree(old_index);
+
+	for (int i = 0; i <= PAGED_KEY_INDEX; ++i)
+	{
+		pthread_key_delete(keys[i]);
+	}
+
+	free(keys);
+
+	return 0;
+}
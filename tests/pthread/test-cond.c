@@ -88,8 +88,9 @@ void *timed(void *arg)
 	if (pthread_cond_timedwait(locks->cond, locks->mutex, &abstime) == 0)
 	{
 		signal_variable = 1;
-		pthread_mutex_unlock(locks->mutex);
 	}
+	// The mutex is reacquired even if the wait times out.
+	pthread_mutex_unlock(locks->mutex);
 
 	return NULL;
 }
@@ -240,6 +241,82 @@ int test_cond_timed()
 	return 0;
 }
 
+#define BROADCAST_THREADS 64
+
+static int broadcast_ready = 0;
+static int broadcast_go = 0;
+static int broadcast_woken = 0;
+
+void *many(void *arg)
+{
+	locking *locks = (locking *)arg;
+
+	pthread_mutex_lock(locks->mutex);
+	++broadcast_ready;
+	while (broadcast_go == 0)
+	{
+		pthread_cond_wait(locks->cond, locks->mutex);
+	}
+	++broadcast_woken;
+	pthread_mutex_unlock(locks->mutex);
+
+	return NULL;
+}
+
+int test_cond_broadcast_many()
+{
+	int status;
+	int ready = 0;
+	pthread_t threads[BROADCAST_THREADS];
+	pthread_cond_t cond;
+	pthread_mutex_t mutex;
+
+	status = pthread_mutex_init(&mutex, NULL);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_cond_init(&cond, NULL);
+	ASSERT_EQ(status, 0);
+
+	locking args = {&cond, &mutex};
+
+	for (int i = 0; i < BROADCAST_THREADS; ++i)
+	{
+		status = pthread_create(&threads[i], NULL, many, &args);
+		ASSERT_EQ(status, 0);
+	}
+
+	// Wait for all the threads to start waiting.
+	while (ready != BROADCAST_THREADS)
+	{
+		usleep(1000);
+		pthread_mutex_lock(&mutex);
+		ready = broadcast_ready;
+		pthread_mutex_unlock(&mutex);
+	}
+
+	pthread_mutex_lock(&mutex);
+	broadcast_go = 1;
+	status = pthread_cond_broadcast(&cond);
+	ASSERT_EQ(status, 0);
+	pthread_mutex_unlock(&mutex);
+
+	for (int i = 0; i < BROADCAST_THREADS; ++i)
+	{
+		status = pthread_join(threads[i], NULL);
+		ASSERT_EQ(status, 0);
+	}
+
+	ASSERT_EQ(broadcast_woken, BROADCAST_THREADS);
+
+	status = pthread_cond_destroy(&cond);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_mutex_destroy(&mutex);
+	ASSERT_EQ(status, 0);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -251,6 +328,7 @@ int main()
 	if (!(asan_build && concurrency <= 2))
 	{
 		TEST(test_cond_broadcast());
+		TEST(test_cond_broadcast_many());
 	}
 
 	signal_variable = 0;
@@ -6,6 +6,7 @@
 */
 
 #include <tests/test.h>
+#include <internal/thread.h>
 #include <pthread.h>
 
 typedef struct _key_args
@@ -158,23 +159,91 @@ int test_key_destructor2()
 	return 0;
 }
 
-int test_too_many_keys()
+int test_key_generation()
 {
 	int status;
+	key_t key, new_key;
+
+	status = pthread_key_create(&key, NULL);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_setspecific(key, (void *)(intptr_t)1);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_key_delete(key);
+	ASSERT_EQ(status, 0);
+
+	// The deleted key can't be used.
+	ASSERT_NULL(pthread_getspecific(key));
+	status = pthread_setspecific(key, (void *)(intptr_t)1);
+	ASSERT_EQ(status, -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// The new key reuses the index, but not the value.
+	status = pthread_key_create(&new_key, NULL);
+	ASSERT_EQ(status, 0);
+	ASSERT_NOTEQ(new_key, key);
+	ASSERT_NULL(pthread_getspecific(new_key));
+
+	status = pthread_key_delete(new_key);
+	ASSERT_EQ(status, 0);
+
+	return 0;
+}
+
+int test_many_keys()
+{
+	int status;
+	pthread_t thread;
+	key_t keys[TLS_MAX_KEYS];
 	key_t key;
+	key_args args;
 
-	// The current implementation only supports 64 slots.
-	for (int i = 0; i < 64; ++i)
+	test_variable = 0;
+
+	for (int i = 0; i < TLS_MAX_KEYS; ++i)
 	{
-		status = pthread_key_create(&key, destructor);
+		status = pthread_key_create(&keys[i], destructor);
 		ASSERT_EQ(status, 0);
 	}
 
-	// Trying to create a new slot should fail.
+	// Trying to create a new key should fail.
 	status = pthread_key_create(&key, destructor);
 	ASSERT_EQ(status, -1);
 
-	// Don't delete the keys here.
+	// Keys beyond the inline ones.
+	for (int i = 0; i < TLS_MAX_KEYS; i += 97)
+	{
+		status = pthread_setspecific(keys[i], (void *)(intptr_t)(i + 1));
+		ASSERT_EQ(status, 0);
+	}
+
+	for (int i = 0; i < TLS_MAX_KEYS; ++i)
+	{
+		ASSERT_EQ(pthread_getspecific(keys[i]), ((i % 97 == 0) ? i + 1 : 0));
+	}
+
+	// Destructors of keys in pages are run as well.
+	args.key = keys[TLS_MAX_KEYS - 1];
+	args.value = (void *)(intptr_t)1;
+
+	status = pthread_create(&thread, NULL, simple, &args);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_join(thread, NULL);
+	ASSERT_EQ(status, 0);
+
+	ASSERT_EQ(test_variable, 1);
+
+	// The value of this thread is untouched.
+	ASSERT_NULL(pthread_getspecific(keys[TLS_MAX_KEYS - 1]));
+
+	for (int i = 0; i < TLS_MAX_KEYS; ++i)
+	{
+		status = pthread_key_delete(keys[i]);
+		ASSERT_EQ(status, 0);
+	}
+
 	return 0;
 }
 
@@ -187,7 +256,8 @@ int main()
 	test_variable = 0;
 	// Same as above, but ensure destructors are called with pthread_exit as well.
 	TEST(test_key_destructor2());
-	TEST(test_too_many_keys());
+	TEST(test_key_generation());
+	TEST(test_many_keys());
 
 	VERIFY_RESULT_AND_EXIT();
 }
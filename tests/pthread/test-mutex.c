@@ -229,6 +229,66 @@ int test_mutex_try()
 	return 0;
 }
 
+#define CONTENDED_THREADS    8
+#define CONTENDED_ITERATIONS 100000
+
+static int contended_variable = 0;
+
+void *contended_lock(void *arg)
+{
+	pthread_mutex_t *mutex = (pthread_mutex_t *)arg;
+
+	for (int i = 0; i < CONTENDED_ITERATIONS; ++i)
+	{
+		pthread_mutex_lock(mutex);
+		++contended_variable;
+		pthread_mutex_unlock(mutex);
+	}
+
+	return NULL;
+}
+
+int test_mutex_contended()
+{
+	int status;
+	pthread_t threads[CONTENDED_THREADS];
+	pthread_mutex_t mutex;
+
+	status = pthread_mutex_init(&mutex, NULL);
+	ASSERT_EQ(status, 0);
+
+	for (int i = 0; i < CONTENDED_THREADS; ++i)
+	{
+		status = pthread_create(&threads[i], NULL, contended_lock, (void *)&mutex);
+		ASSERT_EQ(status, 0);
+	}
+
+	for (int i = 0; i < CONTENDED_THREADS; ++i)
+	{
+		status = pthread_join(threads[i], NULL);
+		ASSERT_EQ(status, 0);
+	}
+
+	ASSERT_EQ(contended_variable, CONTENDED_THREADS * CONTENDED_ITERATIONS);
+
+	// Destroying a locked mutex should fail.
+	status = pthread_mutex_lock(&mutex);
+	ASSERT_EQ(status, 0);
+
+	errno = 0;
+	status = pthread_mutex_destroy(&mutex);
+	ASSERT_EQ(status, -1);
+	ASSERT_ERRNO(EBUSY);
+
+	status = pthread_mutex_unlock(&mutex);
+	ASSERT_EQ(status, 0);
+
+	status = pthread_mutex_destroy(&mutex);
+	ASSERT_EQ(status, 0);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -237,5 +297,6 @@ int main()
 	variable = 0;
 	TEST(test_mutex_timed());
 	TEST(test_mutex_try());
+	TEST(test_mutex_contended());
 	VERIFY_RESULT_AND_EXIT();
 }
@@ -6,6 +6,7 @@
 */
 
 #include <tests/test.h>
+#include <pthread.h>
 #include <signal.h>
 
 static int global_variable = 0;
@@ -36,12 +37,82 @@ int test_SA_RESETHAND()
 	return 0;
 }
 
+void other_sighandler(int sig)
+{
+	global_variable -= sig;
+}
+
+static volatile int stop_writer = 0;
+
+void *sigaction_writer(void *arg)
+{
+	struct sigaction first, second;
+
+	first.sa_handler = my_sighandler;
+	first.sa_flags = SA_NODEFER;
+	first.sa_mask = 1u << SIGUSR2;
+
+	second.sa_handler = other_sighandler;
+	second.sa_flags = SA_RESETHAND;
+	second.sa_mask = 1u << SIGHUP;
+
+	while (!stop_writer)
+	{
+		sigaction(SIGUSR1, &first, NULL);
+		sigaction(SIGUSR1, &second, NULL);
+	}
+
+	return arg;
+}
+
+int test_concurrent_sigaction()
+{
+	pthread_t thread;
+	struct sigaction S;
+	int status;
+
+	S.sa_handler = my_sighandler;
+	S.sa_flags = SA_NODEFER;
+	S.sa_mask = 1u << SIGUSR2;
+	status = sigaction(SIGUSR1, &S, NULL);
+	ASSERT_EQ(status, 0);
+
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, sigaction_writer, NULL));
+
+	// The readers should never see a mix of the two actions.
+	for (int i = 0; i < 100000; ++i)
+	{
+		status = sigaction(SIGUSR1, NULL, &S);
+		ASSERT_EQ(status, 0);
+
+		if (S.sa_handler == my_sighandler)
+		{
+			ASSERT_EQ(S.sa_flags, SA_NODEFER);
+			ASSERT_EQ(S.sa_mask, 1u << SIGUSR2);
+		}
+		else
+		{
+			ASSERT_EQ(S.sa_handler, other_sighandler);
+			ASSERT_EQ(S.sa_flags, SA_RESETHAND);
+			ASSERT_EQ(S.sa_mask, 1u << SIGHUP);
+		}
+	}
+
+	stop_writer = 1;
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	signal(SIGUSR1, SIG_DFL);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
 
 	global_variable = 0;
 	TEST(test_SA_RESETHAND());
+	TEST(test_concurrent_sigaction());
 
 	VERIFY_RESULT_AND_EXIT();
 }
@@ -0,0 +1,88 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Throughput of fopen, fputs, fclose cycles on /dev/null with an increasing number of threads.
+
+ Usage: bench-fopen [iterations per thread]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <Windows.h>
+
+#define MAX_THREADS 16
+
+static int iterations = 100000;
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+DWORD WINAPI churn(LPVOID arg)
+{
+	FILE *stream;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		stream = fopen("/dev/null", "w");
+		if (stream == NULL)
+		{
+			return 1;
+		}
+
+		fputs("hello\n", stream);
+		fclose(stream);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	HANDLE threads[MAX_THREADS];
+	double start, time;
+
+	if (argc > 1)
+	{
+		iterations = atoi(argv[1]);
+	}
+
+	printf("%8s%16s\n", "threads", "opens/s");
+
+	for (int count = 1; count <= MAX_THREADS; count *= 2)
+	{
+		start = now();
+
+		for (int i = 0; i < count; ++i)
+		{
+			threads[i] = CreateThread(NULL, 0, churn, NULL, 0, NULL);
+			if (threads[i] == NULL)
+			{
+				return 1;
+			}
+		}
+
+		WaitForMultipleObjects(count, threads, TRUE, INFINITE);
+		time = now() - start;
+
+		for (int i = 0; i < count; ++i)
+		{
+			CloseHandle(threads[i]);
+		}
+
+		printf("%8d%16.0f\n", count, (double)count * iterations / time);
+	}
+
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of tokenizing a file of numbers by copying it out of the stream with fread, compared to parsing it in place
+ with fpeek and fconsume.
+
+ Usage: bench-fpeek [numbers]
+*/
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Longest token in the file, including the separator.
+#define MAX_TOKEN 32
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Parse the complete tokens in 'buffer', returns the number of bytes consumed.
+static size_t parse(const char *buffer, size_t size, unsigned long long *sum)
+{
+	size_t consumed = 0;
+	unsigned long long value = 0;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (buffer[i] == '\n')
+		{
+			*sum += value;
+			value = 0;
+			consumed = i + 1;
+		}
+		else
+		{
+			value = value * 10 + (buffer[i] - '0');
+		}
+	}
+
+	return consumed;
+}
+
+static unsigned long long parse_fread(FILE *stream)
+{
+	char buffer[65536];
+	size_t pending = 0;
+	size_t result;
+	unsigned long long sum = 0;
+
+	while ((result = fread(buffer + pending, 1, sizeof(buffer) - pending, stream)) != 0)
+	{
+		size_t size = pending + result;
+		size_t consumed = parse(buffer, size, &sum);
+
+		// Carry the partial token over to the next chunk.
+		pending = size - consumed;
+		memmove(buffer, buffer + consumed, pending);
+	}
+
+	return sum;
+}
+
+static unsigned long long parse_fpeek(FILE *stream)
+{
+	const char *buffer;
+	size_t size;
+	unsigned long long sum = 0;
+
+	while (fpeek(stream, MAX_TOKEN, &buffer, &size) == 0 && size != 0)
+	{
+		size_t consumed = parse(buffer, size, &sum);
+
+		// Only a partial token is left at the end of the file.
+		if (consumed == 0)
+		{
+			break;
+		}
+
+		fconsume(stream, consumed);
+	}
+
+	return sum;
+}
+
+static void report(const char *name, size_t bytes, double time)
+{
+	printf("%20s%14.1f%12.3f\n", name, (double)bytes / (1024 * 1024) / time, time * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	size_t numbers = 10000000;
+	unsigned long long expected = 0, sum;
+	size_t bytes;
+	FILE *stream;
+	double start;
+
+	if (argc > 1)
+	{
+		numbers = (size_t)atoi(argv[1]);
+	}
+
+	stream = tmpfile();
+	if (stream == NULL)
+	{
+		perror("tmpfile");
+		return 1;
+	}
+
+	for (size_t i = 0; i < numbers; ++i)
+	{
+		unsigned long long value = (i * 2654435761u) % 1000000007;
+
+		fprintf(stream, "%llu\n", value);
+		expected += value;
+	}
+	fflush(stream);
+	bytes = (size_t)ftell(stream);
+
+	printf("%zu numbers, %zu bytes\n", numbers, bytes);
+	printf("%20s%14s%12s\n", "", "MB/s", "ms");
+
+	rewind(stream);
+	start = now();
+	sum = parse_fread(stream);
+	report("fread + memcpy", bytes, now() - start);
+
+	if (sum != expected)
+	{
+		printf("fread: wrong sum\n");
+		fclose(stream);
+		return 1;
+	}
+
+	rewind(stream);
+	start = now();
+	sum = parse_fpeek(stream);
+	report("fpeek + fconsume", bytes, now() - start);
+
+	fclose(stream);
+
+	if (sum != expected)
+	{
+		printf("fpeek: wrong sum\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Throughput of getline over a file of fixed length lines, compared to reading the lines a character at a time with
+ getc, which is what getdelim used to do.
+
+ Usage: bench-getline [size in MB] [line length]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// The previous loop of getdelim.
+static ssize_t getline_per_char(char **line, size_t *size, FILE *stream)
+{
+	size_t count = 0;
+	int ch;
+
+	while ((ch = getc(stream)) != EOF)
+	{
+		if (count + 2 > *size)
+		{
+			size_t new_size = *size == 0 ? 128 : *size * 2;
+			char *new_line = (char *)realloc(*line, new_size);
+
+			if (new_line == NULL)
+			{
+				return -1;
+			}
+
+			*line = new_line;
+			*size = new_size;
+		}
+
+		(*line)[count++] = (char)ch;
+
+		if (ch == '\n')
+		{
+			break;
+		}
+	}
+
+	if (count == 0)
+	{
+		return -1;
+	}
+
+	(*line)[count] = '\0';
+	return (ssize_t)count;
+}
+
+// Both paths go through a call, getline itself is inline.
+static ssize_t getline_block(char **line, size_t *size, FILE *stream)
+{
+	return getline(line, size, stream);
+}
+
+static int run(const char *name, const char *filename, ssize_t (*read_line)(char **, size_t *, FILE *), size_t total, size_t lines)
+{
+	FILE *stream;
+	char *line = NULL;
+	size_t size = 0;
+	size_t count = 0, bytes = 0;
+	ssize_t result;
+	double start, time;
+
+	stream = fopen(filename, "rb");
+	if (stream == NULL)
+	{
+		perror("fopen");
+		return 1;
+	}
+
+	start = now();
+	while ((result = read_line(&line, &size, stream)) != -1)
+	{
+		bytes += result;
+		++count;
+	}
+	time = now() - start;
+
+	fclose(stream);
+	free(line);
+
+	if (count != lines || bytes != total)
+	{
+		printf("%12s read %zu lines, %zu bytes\n", name, count, bytes);
+		return 1;
+	}
+
+	printf("%12s%14.1f%14.2f\n", name, (double)total / (1024 * 1024) / time, (double)count / 1e6 / time);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filename = "t-bench-getline";
+	size_t total = 256;
+	size_t length = 80;
+	size_t lines;
+	FILE *stream;
+	char *data;
+	int result = 0;
+
+	if (argc > 1)
+	{
+		total = (size_t)atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		length = (size_t)atoi(argv[2]);
+	}
+
+	if (length == 0)
+	{
+		printf("Usage: bench-getline [size in MB] [line length]\n");
+		return 1;
+	}
+
+	total *= 1024 * 1024;
+	total -= total % length;
+	lines = total / length;
+
+	data = (char *)malloc(length);
+	if (data == NULL)
+	{
+		return 1;
+	}
+	memset(data, 'x', length - 1);
+	data[length - 1] = '\n';
+
+	stream = fopen(filename, "wb");
+	if (stream == NULL)
+	{
+		perror("fopen");
+		free(data);
+		return 1;
+	}
+
+	for (size_t i = 0; i < lines; ++i)
+	{
+		if (fwrite(data, 1, length, stream) != length)
+		{
+			perror("fwrite");
+			fclose(stream);
+			free(data);
+			return 1;
+		}
+	}
+	fclose(stream);
+
+	printf("%zu MB in %zu byte lines\n", total / (1024 * 1024), length);
+	printf("%12s%14s%14s\n", "", "MB/s", "Mlines/s");
+
+	result |= run("getc", filename, getline_per_char, total, lines);
+	result |= run("getline", filename, getline_block, total, lines);
+
+	remove(filename);
+	free(data);
+
+	return result;
+}
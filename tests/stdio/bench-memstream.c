@@ -0,0 +1,120 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of building a report in memory with open_memstream compared to a temporary file, and of parsing it back
+ with fmemopen compared to the temporary file.
+
+ Usage: bench-memstream [lines]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void write_report(FILE *stream, size_t lines)
+{
+	for (size_t i = 0; i < lines; ++i)
+	{
+		fprintf(stream, "%zu,item-%zu,%.3f\n", i, i * 7, (double)i / 3);
+	}
+}
+
+static size_t read_report(FILE *stream)
+{
+	char *line = NULL;
+	size_t size = 0;
+	size_t total = 0;
+	ssize_t result;
+
+	while ((result = getline(&line, &size, stream)) != -1)
+	{
+		total += result;
+	}
+
+	free(line);
+
+	return total;
+}
+
+static void report(const char *name, size_t bytes, double time)
+{
+	printf("%20s%14.1f%12.3f\n", name, (double)bytes / (1024 * 1024) / time, time * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	size_t lines = 1000000;
+	FILE *stream;
+	char *buffer = NULL;
+	size_t size = 0;
+	size_t read_size;
+	double start;
+
+	if (argc > 1)
+	{
+		lines = (size_t)atoi(argv[1]);
+	}
+
+	printf("%zu lines\n", lines);
+	printf("%20s%14s%12s\n", "", "MB/s", "ms");
+
+	// Write
+	start = now();
+	stream = open_memstream(&buffer, &size);
+	if (stream == NULL)
+	{
+		perror("open_memstream");
+		return 1;
+	}
+	write_report(stream, lines);
+	fclose(stream);
+	report("open_memstream", size, now() - start);
+
+	start = now();
+	stream = tmpfile();
+	if (stream == NULL)
+	{
+		perror("tmpfile");
+		free(buffer);
+		return 1;
+	}
+	write_report(stream, lines);
+	fflush(stream);
+	report("tmpfile write", size, now() - start);
+
+	// Read
+	start = now();
+	rewind(stream);
+	read_size = read_report(stream);
+	fclose(stream);
+	report("tmpfile read", read_size, now() - start);
+
+	start = now();
+	stream = fmemopen(buffer, size, "r");
+	if (stream == NULL)
+	{
+		perror("fmemopen");
+		free(buffer);
+		return 1;
+	}
+	read_size = read_report(stream);
+	fclose(stream);
+	report("fmemopen read", read_size, now() - start);
+
+	free(buffer);
+
+	return read_size == size ? 0 : 1;
+}
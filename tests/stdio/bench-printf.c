@@ -0,0 +1,137 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Cost of fprintf for a short log line and for a line longer than the stack buffer of printf, compared to the previous
+ path of sizing the output with vsnprintf, formatting it into a heap buffer and writing that out.
+
+ Usage: bench-printf [iterations]
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LONG_LENGTH 2000 // Larger than the stack buffer.
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// The previous path, formatting twice.
+static int old_fprintf(FILE *stream, const char *format, ...)
+{
+	va_list args, copy;
+	char *buffer;
+	int size;
+
+	va_start(args, format);
+	va_copy(copy, args);
+
+	size = vsnprintf(NULL, 0, format, args);
+	buffer = (char *)malloc(size + 1);
+	if (buffer == NULL)
+	{
+		va_end(copy);
+		va_end(args);
+		return -1;
+	}
+
+	vsnprintf(buffer, size + 1, format, copy);
+	fwrite(buffer, 1, size, stream);
+	free(buffer);
+
+	va_end(copy);
+	va_end(args);
+
+	return size;
+}
+
+static void report(const char *name, size_t iterations, double time)
+{
+	printf("%20s%12.2f%12.3f\n", name, time * 1e9 / iterations, time * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	size_t iterations = 1000000;
+	const char *short_format = "[%s] request %d took %.3f ms\n";
+	const char *long_format = "[%s] request %d took %.3f ms, payload %s\n";
+	char *payload;
+	FILE *stream;
+	size_t sum = 0;
+	double start;
+
+	if (argc > 1)
+	{
+		iterations = (size_t)atoll(argv[1]);
+	}
+
+	payload = (char *)malloc(LONG_LENGTH + 1);
+	if (payload == NULL)
+	{
+		return 1;
+	}
+	memset(payload, 'x', LONG_LENGTH);
+	payload[LONG_LENGTH] = '\0';
+
+	stream = fopen("/dev/null", "w");
+	if (stream == NULL)
+	{
+		perror("fopen");
+		free(payload);
+		return 1;
+	}
+
+	printf("%zu iterations\n", iterations);
+	printf("%20s%12s%12s\n", "", "ns/call", "ms");
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += old_fprintf(stream, short_format, "info", (int)i, 1.5);
+	}
+	report("short, two pass", iterations, now() - start);
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += fprintf(stream, short_format, "info", (int)i, 1.5);
+	}
+	report("short, fprintf", iterations, now() - start);
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += old_fprintf(stream, long_format, "info", (int)i, 1.5, payload);
+	}
+	report("long, two pass", iterations, now() - start);
+
+	start = now();
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		sum += fprintf(stream, long_format, "info", (int)i, 1.5, payload);
+	}
+	report("long, fprintf", iterations, now() - start);
+
+	fclose(stream);
+	free(payload);
+
+	// Keep the loops from being optimized away.
+	if (sum == 0)
+	{
+		printf("Nothing was written\n");
+		return 1;
+	}
+
+	return 0;
+}
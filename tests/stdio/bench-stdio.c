@@ -0,0 +1,152 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ Throughput of buffered stdio over different buffer sizes.
+ A file is written and then read back sequentially with small fwrite/fread calls, for each buffer size.
+ 'default' is the buffer picked by fopen.
+
+ Usage: bench-stdio [size in MB] [chunk size in bytes]
+*/
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const size_t buffer_sizes[] = {0 /* default */, 512, 4096, 16384, 65536, 262144};
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run(const char *filename, size_t buffer_size, size_t total, size_t chunk, char *data)
+{
+	FILE *stream;
+	char *buffer = NULL;
+	double start, write_time, read_time;
+	size_t done;
+	size_t actual_size;
+
+	if (buffer_size != 0)
+	{
+		buffer = (char *)malloc(buffer_size);
+		if (buffer == NULL)
+		{
+			return 1;
+		}
+	}
+
+	// Write
+	stream = fopen(filename, "wb");
+	if (stream == NULL)
+	{
+		perror("fopen");
+		free(buffer);
+		return 1;
+	}
+
+	if (buffer_size != 0)
+	{
+		setvbuf(stream, buffer, _IOFBF, buffer_size);
+	}
+
+	start = now();
+	for (done = 0; done < total; done += chunk)
+	{
+		if (fwrite(data, 1, chunk, stream) != chunk)
+		{
+			perror("fwrite");
+			fclose(stream);
+			free(buffer);
+			return 1;
+		}
+	}
+	actual_size = __fbufsize(stream);
+	fclose(stream);
+	write_time = now() - start;
+
+	// Read
+	stream = fopen(filename, "rb");
+	if (stream == NULL)
+	{
+		perror("fopen");
+		free(buffer);
+		return 1;
+	}
+
+	if (buffer_size != 0)
+	{
+		setvbuf(stream, buffer, _IOFBF, buffer_size);
+	}
+
+	start = now();
+	for (done = 0; done < total; done += chunk)
+	{
+		if (fread(data, 1, chunk, stream) != chunk)
+		{
+			perror("fread");
+			fclose(stream);
+			free(buffer);
+			return 1;
+		}
+	}
+	fclose(stream);
+	read_time = now() - start;
+
+	free(buffer);
+
+	printf("%10s%10zu%14.1f%14.1f%12zu\n", buffer_size == 0 ? "default" : "setvbuf", actual_size,
+		   (double)total / (1024 * 1024) / write_time, (double)total / (1024 * 1024) / read_time, total / actual_size);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filename = "t-bench-stdio";
+	size_t total = 256;
+	size_t chunk = 100;
+	char *data;
+	int result = 0;
+
+	if (argc > 1)
+	{
+		total = (size_t)atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		chunk = (size_t)atoi(argv[2]);
+	}
+
+	total *= 1024 * 1024;
+	total -= total % chunk;
+
+	data = (char *)malloc(chunk);
+	if (data == NULL)
+	{
+		return 1;
+	}
+	memset(data, 'x', chunk);
+
+	printf("%zu MB in %zu byte chunks\n", total / (1024 * 1024), chunk);
+	printf("%10s%10s%14s%14s%12s\n", "mode", "buffer", "write (MB/s)", "read (MB/s)", "io calls");
+
+	for (size_t i = 0; i < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); ++i)
+	{
+		result |= run(filename, buffer_sizes[i], total, chunk, data);
+	}
+
+	remove(filename);
+	free(data);
+
+	return result;
+}
@@ -8,6 +8,7 @@
 #include <tests/test.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -440,6 +441,51 @@ int test_write_buffer_change()
 	return 0;
 }
 
+int test_write_large()
+{
+	FILE *f = NULL;
+	char *write_buffer, *read_buffer;
+	const size_t size = 1024 * 1024;
+	const char *filename = "t-fileio-write-large";
+
+	write_buffer = malloc(size);
+	read_buffer = malloc(size + 16);
+	ASSERT_NOTNULL(write_buffer);
+	ASSERT_NOTNULL(read_buffer);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		write_buffer[i] = (char)(i % 251);
+	}
+
+	f = fopen(filename, "w");
+	ASSERT_NOTNULL(f);
+
+	// Buffered data followed by a write larger than the buffer, both go out together.
+	ASSERT_EQ(fwrite("abcdefgh", 1, 8, f), 8);
+	ASSERT_EQ(fwrite(write_buffer, 1, size, f), size);
+	ASSERT_EQ(ftell(f), size + 8);
+	ASSERT_EQ(fwrite("ijklmnop", 1, 8, f), 8);
+	ASSERT_EQ(ftell(f), size + 16);
+
+	ASSERT_SUCCESS(fclose(f));
+
+	f = fopen(filename, "r");
+	ASSERT_NOTNULL(f);
+	ASSERT_EQ(fread(read_buffer, 1, size + 16, f), size + 16);
+	ASSERT_MEMEQ(read_buffer, "abcdefgh", 8);
+	ASSERT_MEMEQ(read_buffer + 8, write_buffer, size);
+	ASSERT_MEMEQ(read_buffer + 8 + size, "ijklmnop", 8);
+	ASSERT_SUCCESS(fclose(f));
+
+	ASSERT_SUCCESS(unlink(filename));
+
+	free(write_buffer);
+	free(read_buffer);
+
+	return 0;
+}
+
 int test_read_write()
 {
 	int fd, result;
@@ -650,6 +696,48 @@ int test_read_append()
 #pragma warning(push)
 #pragma warning(disable: 4244) // Truncation loss of data
 
+int test_append_position()
+{
+	int fd;
+	ssize_t read_result;
+	FILE *f1, *f2;
+	char check_buffer[64];
+	const char *filename = "t-fileio-append-position";
+
+	ASSERT_SUCCESS(prepare(filename));
+
+	f1 = fopen(filename, "a");
+	ASSERT_NOTNULL(f1);
+	f2 = fopen(filename, "a");
+	ASSERT_NOTNULL(f2);
+
+	ASSERT_EQ(fwrite("1111", 1, 4, f1), 4);
+	ASSERT_EQ(ftell(f1), 40);
+	ASSERT_SUCCESS(fflush(f1));
+
+	// The other stream appends after the data written by the first one.
+	ASSERT_EQ(fwrite("2222", 1, 4, f2), 4);
+	ASSERT_SUCCESS(fflush(f2));
+	ASSERT_EQ(ftell(f2), 44);
+
+	ASSERT_EQ(fwrite("11", 1, 2, f1), 2);
+	ASSERT_SUCCESS(fflush(f1));
+
+	ASSERT_SUCCESS(fclose(f1));
+	ASSERT_SUCCESS(fclose(f2));
+
+	fd = open(filename, O_RDONLY);
+	ASSERT_NOTEQ(fd, -1);
+	read_result = read(fd, check_buffer, 64);
+	ASSERT_EQ(read_result, 46);
+	ASSERT_MEMEQ(check_buffer, "abcdefghijklmnopqrstuvwxyz01234567891111222211", 46);
+	ASSERT_SUCCESS(close(fd));
+
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
 int test_getc()
 {
 	FILE *f;
@@ -860,10 +948,12 @@ void cleanup()
 	remove("t-fileio-write-internal-buffer");
 	remove("t-fileio-write-external-buffer");
 	remove("t-fileio-write-varying-buffer");
+	remove("t-fileio-write-large");
 
 	remove("t-fileio-read-write");
 	remove("t-fileio-read-write-seek");
 	remove("t-fileio-read-append");
+	remove("t-fileio-append-position");
 
 	remove("t-fileio-getc");
 	remove("t-fileio-putc");
@@ -887,11 +977,13 @@ int main()
 	TEST(test_write_small_buffer_internal());
 	TEST(test_write_small_buffer_external());
 	TEST(test_write_buffer_change());
+	TEST(test_write_large());
 
 	// read and write tests
 	TEST(test_read_write());
 	TEST(test_read_write_seek());
 	TEST(test_read_append());
+	TEST(test_append_position());
 
 	TEST(test_getc());
 	TEST(test_putc());
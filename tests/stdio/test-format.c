@@ -0,0 +1,443 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+/*
+ * The formatting engine has no Windows dependencies. On a POSIX host this test can be built on its own
+ * and it will also compare the engine against the host's printf.
+ *
+ * cc -O2 -idirafter include tests/stdio/test-format.c src/stdio/format.c -lm -o test-format
+ * ./test-format        (run the tests)
+ * ./test-format bench  (time the engine against the host's snprintf)
+ */
+
+#include <internal/format.h>
+#include <tests/test.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int format(char *buffer, size_t size, const char *format, ...)
+{
+	int result;
+	va_list args;
+
+	va_start(args, format);
+	result = format_string(buffer, size, format, args);
+	va_end(args);
+
+	return result;
+}
+
+#define CHECK(expected, ...)                                           \
+	{                                                                  \
+		char buffer[512];                                              \
+		int result = format(buffer, sizeof(buffer), __VA_ARGS__);      \
+		ASSERT_STREQ(buffer, expected);                                \
+		ASSERT_EQ(result, strlen(expected));                           \
+	}
+
+int test_integers()
+{
+	CHECK("0", "%d", 0);
+	CHECK("-1", "%d", -1);
+	CHECK("2147483647 -2147483648", "%d %d", INT_MAX, INT_MIN);
+	CHECK("4294967295", "%u", UINT_MAX);
+	CHECK("9223372036854775807", "%lld", LLONG_MAX);
+	CHECK("-9223372036854775808", "%lld", LLONG_MIN);
+	CHECK("18446744073709551615", "%llu", ULLONG_MAX);
+	CHECK("12345678901234", "%jd", (intmax_t)12345678901234);
+	CHECK("42", "%zu", (size_t)42);
+	CHECK("-42", "%I64d", (long long)-42);
+
+	CHECK("ff FF 0xff 0XFF", "%x %X %#x %#X", 255, 255, 255, 255);
+	CHECK("0", "%#x", 0);
+	CHECK("17 017 0", "%o %#o %#o", 15, 15, 0);
+	CHECK("-1 255", "%hhd %hhu", 255, 255);
+	CHECK("-1 65535", "%hd %hu", 65535, 65535);
+
+	CHECK("   42|42   |00042", "%5d|%-5d|%05d", 42, 42, 42);
+	CHECK("+42 +42  42", "%+d %+i % d", 42, 42, 42);
+	CHECK("-0042", "%05d", -42);
+	CHECK("  00042", "%7.5d", 42);
+	CHECK("  042", "%05.3d", 42);
+	CHECK("", "%.0d", 0);
+	CHECK("    ", "%4.0d", 0);
+	CHECK("0x002a", "%#06x", 42);
+	CHECK("   42", "%*d", 5, 42);
+	CHECK("42   ", "%*d", -5, 42);
+	CHECK("00042", "%.*d", 5, 42);
+	CHECK("42", "%.*d", -5, 42);
+
+	return 0;
+}
+
+int test_strings()
+{
+	CHECK("hello", "%s", "hello");
+	CHECK("(null)", "%s", (char *)NULL);
+	CHECK("  abc|abc  |ab", "%5s|%-5s|%.2s", "abc", "abc", "abc");
+	CHECK("a|  b|c  ", "%c|%3c|%-3c", 'a', 'b', 'c');
+	CHECK("100%", "%d%%", 100);
+	CHECK("caf\xc3\xa9 \xe2\x82\xac", "%ls %lc", L"caf\xe9", (wint_t)0x20ac);
+	CHECK("caf", "%.4ls", L"caf\xe9"); // Do not split a character
+	CHECK("(nil)", "%p", NULL);
+
+	return 0;
+}
+
+int test_floats()
+{
+	CHECK("0.000000 -0.000000", "%f %f", 0.0, -0.0);
+	CHECK("3.141593 3.14 3", "%f %.2f %.0f", 3.14159265, 3.14159265, 3.14159265);
+	CHECK("0 2 2 4", "%.0f %.0f %.0f %.0f", 0.5, 1.5, 2.5, 3.5); // Ties go to even
+	CHECK("1.000000e+00 1.5E-10 1e+100", "%e %.1E %.0e", 1.0, 1.5e-10, 1e100);
+	CHECK("0.1 1e-05 100000 1e+06", "%g %g %g %g", 0.1, 0.00001, 100000.0, 1000000.0);
+	CHECK("0.0001 1.23457e-05 1.00000", "%g %g %#g", 0.0001, 0.0000123456789, 1.0);
+	CHECK("0.30000000000000004", "%.17g", 0.1 + 0.2);
+	CHECK("179769313486231570814527423731704356798070567525844996598917476803157260780028538760589558632766878171540458953514382464234321326889464182768467546703537516986049910576551282076245490090389328944075868508455133942304583236903222948165808559332123348274797826204144723168738177180919299881250404026184124858368",
+		  "%.0f", DBL_MAX);
+	CHECK("4.9406564584124654e-324", "%.16e", 4.9406564584124654e-324);
+	CHECK("2.2250738585072014e-308", "%.17g", DBL_MIN);
+	CHECK("0.000000000000000000001000", "%.24f", 1e-21);
+	CHECK("9.9e+09 1e+10", "%.2g %.2g", 9.94e9, 9.96e9);
+	CHECK("  +1.50|1.50   |001.50|1.", "%+7.2f|%-7.2f|%06.2f|%#.0f", 1.5, 1.5, 1.5, 1.0);
+	CHECK("inf -INF nan   inf", "%f %F %e %5g", INFINITY, -INFINITY, NAN, INFINITY);
+
+	CHECK("0x1p+0 0x1.8p+1 -0x1.999999999999ap-4", "%a %a %a", 1.0, 3.0, -0.1);
+	CHECK("0x0p+0 0X1.00P+1 0x2p+0 0x1p+1", "%a %.2A %.0a %.0a", 0.0, 2.0, 1.5, 2.5);
+	CHECK("0x0.0000000000001p-1022", "%a", 4.9406564584124654e-324);
+
+	return 0;
+}
+
+int test_positional()
+{
+	CHECK("b a", "%2$s %1$s", "a", "b");
+	CHECK("1.5 7 1.5", "%2$g %1$d %2$g", 7, 1.5);
+	CHECK("  x", "%2$*1$s", 3, "x");
+	CHECK("3.14", "%1$.*2$f", 3.14159, 2);
+
+	return 0;
+}
+
+int test_truncation()
+{
+	char buffer[8];
+	int result;
+	int count = 0;
+
+	memset(buffer, 'x', sizeof(buffer));
+	result = format(buffer, 4, "%s", "abcdef");
+	ASSERT_EQ(result, 6);
+	ASSERT_STREQ(buffer, "abc");
+	ASSERT_EQ(buffer[4], 'x');
+
+	result = format(NULL, 0, "%d-%d", 12, 345);
+	ASSERT_EQ(result, 6);
+
+	result = format(buffer, 1, "%d", 12345);
+	ASSERT_EQ(result, 5);
+	ASSERT_EQ(buffer[0], '\0');
+
+	result = format(buffer, sizeof(buffer), "abc%nde", &count);
+	ASSERT_EQ(result, 5);
+	ASSERT_EQ(count, 3);
+
+	return 0;
+}
+
+typedef struct _collector
+{
+	char data[512];
+	size_t length;
+	size_t window_size;
+	int spills;
+	int fail_after;
+} collector;
+
+// Small window, collect everything that gets spilled.
+static int spill_collector(format_sink *sink)
+{
+	collector *c = (collector *)sink->context;
+
+	if (c->fail_after >= 0 && c->spills == c->fail_after)
+	{
+		errno = EIO;
+		return -1;
+	}
+
+	memcpy(c->data + c->length, sink->buffer, sink->used);
+	c->length += sink->used;
+	c->spills++;
+	sink->size = c->window_size;
+	sink->used = 0;
+
+	return 0;
+}
+
+static int format_collect(collector *c, char *window, size_t size, const char *format, ...)
+{
+	format_sink sink;
+	va_list args;
+	int result;
+
+	sink.buffer = window;
+	sink.size = size;
+	sink.used = 0;
+	sink.spill = spill_collector;
+	sink.context = c;
+
+	va_start(args, format);
+	result = format_to_sink(&sink, format, args);
+	va_end(args);
+
+	memcpy(c->data + c->length, sink.buffer, sink.used);
+	c->length += sink.used;
+	c->data[c->length] = '\0';
+
+	return result;
+}
+
+int test_sink()
+{
+	collector c;
+	char window[5];
+	int result;
+
+	memset(&c, 0, sizeof(collector));
+	c.window_size = sizeof(window);
+	c.fail_after = -1;
+
+	result = format_collect(&c, window, sizeof(window), "%s|%10d|%-6.2f|%c", "spill", 12345, 2.5, '!');
+	ASSERT_EQ(result, 25);
+	ASSERT_STREQ(c.data, "spill|     12345|2.50  |!");
+	ASSERT_EQ(c.length, 25);
+	ASSERT_EQ(c.spills, 4);
+
+	// Start with a full window.
+	memset(&c, 0, sizeof(collector));
+	c.window_size = sizeof(window);
+	c.fail_after = -1;
+
+	result = format_collect(&c, window, 0, "%d", 7);
+	ASSERT_EQ(result, 1);
+	ASSERT_STREQ(c.data, "7");
+
+	// Failure to spill stops the formatting.
+	memset(&c, 0, sizeof(collector));
+	c.window_size = sizeof(window);
+	c.fail_after = 1;
+
+	errno = 0;
+	result = format_collect(&c, window, sizeof(window), "%s", "abcdefghijklmnop");
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(EIO);
+	ASSERT_EQ(c.spills, 1);
+
+	return 0;
+}
+
+int test_errors()
+{
+	char buffer[64];
+
+	// Mixing positional and sequential arguments.
+	errno = 0;
+	ASSERT_EQ(format(buffer, sizeof(buffer), "%1$d %d", 1, 2), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// Gap in the positions.
+	errno = 0;
+	ASSERT_EQ(format(buffer, sizeof(buffer), "%1$d %3$d", 1, 2, 3), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// Bad conversion.
+	errno = 0;
+	ASSERT_EQ(format(buffer, sizeof(buffer), "%y", 1), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// Lone surrogate.
+	errno = 0;
+	ASSERT_EQ(format(buffer, sizeof(buffer), "%lc", (wint_t)0xd800), -1);
+	ASSERT_ERRNO(EILSEQ);
+
+	return 0;
+}
+
+#ifndef _WIN32
+
+#	include <time.h>
+
+// Compare against the host's printf. Only run where the host printf is known to be correct.
+static unsigned long long random_state = 0x9e3779b97f4a7c15ull;
+
+static unsigned long long next_random()
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+static double random_double()
+{
+	unsigned long long bits;
+	double value;
+
+	do
+	{
+		bits = next_random();
+		memcpy(&value, &bits, sizeof(double));
+	} while (isnan(value));
+
+	return value;
+}
+
+int test_host_floats()
+{
+	const char *conversions[] = {"%.*e", "%.*f", "%.*g", "%#.*g", "%.*a", "%+.*E", "%.*G"};
+	char expected[2048], actual[2048];
+
+	for (int i = 0; i < 200000; ++i)
+	{
+		const char *conversion = conversions[i % (sizeof(conversions) / sizeof(conversions[0]))];
+		double value = random_double();
+		int precision = (int)(next_random() % 20);
+
+		// Keep %f outputs of huge values short enough.
+		if (conversion[3] == 'f' && fabs(value) > 1e300)
+		{
+			value = value / 1e300;
+		}
+
+		int expected_result = snprintf(expected, sizeof(expected), conversion, precision, value);
+		int actual_result = format(actual, sizeof(actual), conversion, precision, value);
+
+		ASSERT_STREQ(actual, expected);
+		ASSERT_EQ(actual_result, expected_result);
+	}
+
+	// Shortest round trip values with %.17g.
+	for (int i = 0; i < 100000; ++i)
+	{
+		double value = random_double();
+
+		snprintf(expected, sizeof(expected), "%.17g", value);
+		format(actual, sizeof(actual), "%.17g", value);
+		ASSERT_STREQ(actual, expected);
+	}
+
+	return 0;
+}
+
+int test_host_integers()
+{
+	const char *conversions[] = {"%lld", "%llu", "%llx", "%#llo", "%+20lld", "%-20.15llX", "%020lld", "% lld"};
+	char expected[128], actual[128];
+
+	for (int i = 0; i < 200000; ++i)
+	{
+		const char *conversion = conversions[i % (sizeof(conversions) / sizeof(conversions[0]))];
+		long long value = (long long)(next_random() >> (next_random() % 64));
+
+		if (i & 1)
+		{
+			value = -value;
+		}
+
+		snprintf(expected, sizeof(expected), conversion, value);
+		format(actual, sizeof(actual), conversion, value);
+		ASSERT_STREQ(actual, expected);
+	}
+
+	return 0;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+#	define BENCHMARK(fmt, ...)                                                                                            \
+		{                                                                                                                      \
+			double host, engine;                                                                                               \
+                                                                                                                               \
+			clock_gettime(CLOCK_MONOTONIC, &start);                                                                            \
+			for (int j = 0; j < iterations; ++j)                                                                               \
+			{                                                                                                                  \
+				sink += snprintf(buffer, sizeof(buffer), fmt, __VA_ARGS__);                                                    \
+			}                                                                                                                  \
+			clock_gettime(CLOCK_MONOTONIC, &end);                                                                              \
+			host = elapsed(&start, &end);                                                                                      \
+                                                                                                                               \
+			clock_gettime(CLOCK_MONOTONIC, &start);                                                                            \
+			for (int j = 0; j < iterations; ++j)                                                                               \
+			{                                                                                                                  \
+				sink += format(buffer, sizeof(buffer), fmt, __VA_ARGS__);                                                      \
+			}                                                                                                                  \
+			clock_gettime(CLOCK_MONOTONIC, &end);                                                                              \
+			engine = elapsed(&start, &end);                                                                                    \
+                                                                                                                               \
+			printf("%-24s host %8.1f ns  engine %8.1f ns\n", fmt, host * 1e9 / iterations, engine * 1e9 / iterations);          \
+		}
+
+static void benchmark()
+{
+	const int iterations = 1000000;
+	struct timespec start, end;
+	char buffer[512];
+	volatile int sink = 0;
+
+	BENCHMARK("%d", j * 79);
+	BENCHMARK("%lld %llu", (long long)j * 1000003, (unsigned long long)j * 998244353);
+	BENCHMARK("%s=%d", "key", j);
+	BENCHMARK("%08.3f|%-10s|%x", j / 7.0, "v", j);
+	BENCHMARK("%g", 1.0 / (j + 1));
+	BENCHMARK("%.17g", 1.0 / (j + 1));
+	BENCHMARK("%e", j * 1e10);
+	BENCHMARK("%f", j * 1.5);
+	BENCHMARK("%2$s %1$d", j, "positional");
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+#ifndef _WIN32
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		benchmark();
+		return 0;
+	}
+#else
+	(void)argc;
+	(void)argv;
+#endif
+
+	INITIAILIZE_TESTS();
+
+	TEST(test_integers());
+	TEST(test_strings());
+	TEST(test_floats());
+	TEST(test_positional());
+	TEST(test_truncation());
+	TEST(test_sink());
+	TEST(test_errors());
+
+#ifndef _WIN32
+	TEST(test_host_floats());
+	TEST(test_host_integers());
+#endif
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -9,6 +9,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 int test_getdelim()
@@ -41,6 +42,11 @@ int test_getdelim()
 	ASSERT_EQ(result, 17);
 	ASSERT_STREQ(buffer, "mnopqrstuvwxyz012");
 
+	// Unterminated last line.
+	result = getdelim(&buffer, &size, 'a', f);
+	ASSERT_EQ(result, 7);
+	ASSERT_STREQ(buffer, "3456789");
+
 	result = getdelim(&buffer, &size, 'a', f);
 	ASSERT_EQ(result, -1);
 	ASSERT_EQ(feof(f), 1);
@@ -76,6 +82,12 @@ int test_getline()
 	ASSERT_EQ(size, 64);
 	ASSERT_STREQ(buffer, "klmnopqrstuvwxyz\n");
 
+	// Unterminated last line.
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, 10);
+	ASSERT_EQ(size, 64);
+	ASSERT_STREQ(buffer, "0123456789");
+
 	result = getline(&buffer, &size, f);
 	ASSERT_EQ(result, -1);
 	ASSERT_EQ(size, 64);
@@ -88,10 +100,132 @@ int test_getline()
 	return 0;
 }
 
+int test_getline_long()
+{
+	FILE *f;
+	ssize_t result;
+	size_t size = 0;
+	char *buffer = NULL;
+	char *line = NULL;
+	const char *filename = "t-getline-long";
+	int ch;
+	ssize_t length;
+	long offset;
+
+	// Lines of varying length, some of them much larger than the stream buffer.
+	f = fopen(filename, "w+");
+	ASSERT_NOTNULL(f);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		for (int j = 0; j < (i * 37) % 3000; ++j)
+		{
+			fputc('a' + (i + j) % 26, f);
+		}
+		fputc('\n', f);
+	}
+
+	fseek(f, 0, SEEK_SET);
+
+	line = (char *)malloc(4096);
+	ASSERT_NOTNULL(line);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		result = getline(&buffer, &size, f);
+		ASSERT_EQ(result, ((i * 37) % 3000) + 1);
+		ASSERT_EQ(strlen(buffer), result);
+		ASSERT_EQ(buffer[result - 1], '\n');
+	}
+
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, -1);
+	ASSERT_EQ(feof(f), 1);
+
+	// Compare with reading a character at a time.
+	fseek(f, 0, SEEK_SET);
+	ASSERT_EQ(feof(f), 0);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		offset = ftell(f);
+		length = 0;
+		while ((ch = fgetc(f)) != EOF)
+		{
+			line[length++] = (char)ch;
+			if (ch == '\n')
+			{
+				break;
+			}
+		}
+		line[length] = '\0';
+
+		ASSERT_EQ(length, ((i * 37) % 3000) + 1);
+		ASSERT_EQ(fseek(f, offset, SEEK_SET), 0);
+
+		result = getline(&buffer, &size, f);
+		ASSERT_EQ(result, length);
+		ASSERT_STREQ(buffer, line);
+	}
+
+	free(line);
+	free(buffer);
+	ASSERT_SUCCESS(fclose(f));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_getline_pipe()
+{
+	FILE *f;
+	ssize_t result;
+	size_t size = 0;
+	char *buffer = NULL;
+	int fds[2];
+	const char *content = "first\nsecond line\n\nlast";
+
+	ASSERT_SUCCESS(pipe(fds));
+
+	result = write(fds[1], content, strlen(content));
+	ASSERT_EQ(result, strlen(content));
+	ASSERT_SUCCESS(close(fds[1]));
+
+	f = fdopen(fds[0], "r");
+	ASSERT_NOTNULL(f);
+
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, 6);
+	ASSERT_STREQ(buffer, "first\n");
+
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, 12);
+	ASSERT_STREQ(buffer, "second line\n");
+
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, 1);
+	ASSERT_STREQ(buffer, "\n");
+
+	// Unterminated last line.
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, 4);
+	ASSERT_STREQ(buffer, "last");
+
+	result = getline(&buffer, &size, f);
+	ASSERT_EQ(result, -1);
+	ASSERT_EQ(feof(f), 1);
+
+	free(buffer);
+	ASSERT_SUCCESS(fclose(f));
+
+	return 0;
+}
+
 void cleanup()
 {
 	remove("t-getdelim");
 	remove("t-getline");
+	remove("t-getline-long");
 }
 
 int main()
@@ -101,6 +235,8 @@ int main()
 
 	TEST(test_getdelim());
 	TEST(test_getline());
+	TEST(test_getline_long());
+	TEST(test_getline_pipe());
 
 	VERIFY_RESULT_AND_EXIT();
 }
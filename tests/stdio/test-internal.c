@@ -9,6 +9,9 @@
 #include <tests/test.h>
 #include <stdio.h>
 
+// All the streams here are created by the main thread and are in its shard.
+#define STDIO_HEAD (_wlibc_stdio_shards[STDIO_CURRENT_SHARD()].head)
+
 // fclose is also tested here
 int test_list()
 {
@@ -18,7 +21,7 @@ int test_list()
 	const char *filename2 = "t-list2";
 
 	// Check std streams
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	// stderr
 	ASSERT_EQ(list->fd, 2);
 	ASSERT_NULL(list->next);
@@ -38,7 +41,7 @@ int test_list()
 	ASSERT_NOTNULL(f1);
 
 	// reset
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	ASSERT_EQ(list->fd, 3);
 	ASSERT_NULL(list->next);
 	ASSERT_EQ(list->prev->fd, 2);
@@ -53,7 +56,7 @@ int test_list()
 	ASSERT_NOTNULL(f2);
 
 	// reset
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	ASSERT_EQ(list->fd, 0); // stdin's fd should be used
 	ASSERT_NULL(list->next);
 	ASSERT_EQ(list->prev->fd, 3);
@@ -61,7 +64,7 @@ int test_list()
 	ASSERT_SUCCESS(fclose(f2)); // close last stream
 
 	// reset
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	ASSERT_EQ(list->fd, 3);
 	ASSERT_NULL(list->next);
 	ASSERT_EQ(list->prev->fd, 2);
@@ -69,7 +72,7 @@ int test_list()
 	ASSERT_SUCCESS(fclose(stderr)); // close something in the middle
 
 	// reset
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	ASSERT_EQ(list->fd, 3);
 	ASSERT_NULL(list->next);
 	ASSERT_EQ(list->prev->fd, 1); // should be stdout
@@ -84,9 +87,16 @@ int test_list()
 	result = fcloseall();
 	ASSERT_EQ(result, 0);
 
-	list = _wlibc_stdio_head;
+	list = STDIO_HEAD;
 	ASSERT_NULL(list);
 
+	// The cached streams are released as well.
+	for (int i = 0; i < STDIO_SHARDS; ++i)
+	{
+		ASSERT_NULL(_wlibc_stdio_shards[i].head);
+		ASSERT_NULL(_wlibc_stdio_shards[i].cache);
+	}
+
 	// Check whether 'D' works
 	ASSERT_FAIL(remove(filename1));
 	ASSERT_FAIL(remove(filename2));
@@ -0,0 +1,244 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Only standard interfaces are used here, these tests should pass against any conforming libc.
+
+int test_fmemopen_read()
+{
+	FILE *stream;
+	char buffer[16];
+	char data[] = "hello world\nbye";
+
+	stream = fmemopen(data, 15, "r");
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_EQ(fread(buffer, 1, 5, stream), 5);
+	ASSERT_MEMEQ(buffer, "hello", 5);
+	ASSERT_EQ(fgetc(stream), ' ');
+	ASSERT_EQ(ftell(stream), 6);
+
+	ASSERT_NOTNULL(fgets(buffer, 16, stream));
+	ASSERT_STREQ(buffer, "world\n");
+
+	ASSERT_EQ(ungetc('\n', stream), '\n');
+	ASSERT_EQ(fgetc(stream), '\n');
+
+	// Short read at the end.
+	ASSERT_EQ(fread(buffer, 1, 16, stream), 3);
+	ASSERT_MEMEQ(buffer, "bye", 3);
+	ASSERT_NOTEQ(feof(stream), 0);
+	ASSERT_EQ(fgetc(stream), EOF);
+
+	ASSERT_SUCCESS(fseek(stream, -5, SEEK_END));
+	ASSERT_EQ(feof(stream), 0);
+	ASSERT_EQ(fread(buffer, 1, 5, stream), 5);
+	ASSERT_MEMEQ(buffer, "d\nbye", 5);
+
+	// Can't seek outside the buffer.
+	errno = 0;
+	ASSERT_EQ(fseek(stream, 16, SEEK_SET), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(fseek(stream, -1, SEEK_SET), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// Read only.
+	ASSERT_EQ(fputc('a', stream), EOF);
+	ASSERT_NOTEQ(ferror(stream), 0);
+
+	ASSERT_SUCCESS(fclose(stream));
+
+	// The buffer is untouched.
+	ASSERT_STREQ(data, "hello world\nbye");
+
+	return 0;
+}
+
+int test_fmemopen_write()
+{
+	FILE *stream;
+	char data[16];
+
+	memset(data, 'x', 16);
+
+	stream = fmemopen(data, 16, "w");
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_EQ(fprintf(stream, "%d-%s", 42, "abc"), 6);
+	ASSERT_EQ(fputc('!', stream), '!');
+	ASSERT_EQ(ftell(stream), 7);
+
+	// The contents are NULL terminated on a flush.
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_STREQ(data, "42-abc!");
+
+	// Overwrite in the middle.
+	ASSERT_SUCCESS(fseek(stream, 3, SEEK_SET));
+	ASSERT_EQ(fwrite("xyz", 1, 3, stream), 3);
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_STREQ(data, "42-xyz!");
+
+	ASSERT_SUCCESS(fseek(stream, 0, SEEK_END));
+	ASSERT_EQ(ftell(stream), 7);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_STREQ(data, "42-xyz!");
+
+	return 0;
+}
+
+int test_fmemopen_update()
+{
+	FILE *stream;
+	char *line = NULL;
+	size_t size = 0;
+
+	// The buffer is allocated by fmemopen.
+	stream = fmemopen(NULL, 64, "w+");
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_GTEQ(fputs("line1\nline2\n", stream), 0);
+	rewind(stream);
+
+	ASSERT_EQ(getline(&line, &size, stream), 6);
+	ASSERT_STREQ(line, "line1\n");
+	ASSERT_EQ(getline(&line, &size, stream), 6);
+	ASSERT_STREQ(line, "line2\n");
+	ASSERT_EQ(getline(&line, &size, stream), -1);
+	ASSERT_NOTEQ(feof(stream), 0);
+
+	// Switch back to writing.
+	ASSERT_SUCCESS(fseek(stream, 0, SEEK_CUR));
+	ASSERT_GTEQ(fputs("line3\n", stream), 0);
+	ASSERT_SUCCESS(fseek(stream, 12, SEEK_SET));
+	ASSERT_EQ(getline(&line, &size, stream), 6);
+	ASSERT_STREQ(line, "line3\n");
+
+	ASSERT_SUCCESS(fclose(stream));
+	free(line);
+
+	return 0;
+}
+
+int test_fmemopen_append()
+{
+	FILE *stream;
+	char data[16] = "abc";
+
+	stream = fmemopen(data, 16, "a");
+	ASSERT_NOTNULL(stream);
+
+	// Starts at the first NULL byte.
+	ASSERT_EQ(ftell(stream), 3);
+	ASSERT_GTEQ(fputs("def", stream), 0);
+	ASSERT_EQ(ftell(stream), 6);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_STREQ(data, "abcdef");
+
+	return 0;
+}
+
+int test_open_memstream()
+{
+	FILE *stream;
+	char *buffer = NULL;
+	size_t size = 1;
+	char expected[16];
+	size_t expected_size = 0;
+
+	stream = open_memstream(&buffer, &size);
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_NOTNULL(buffer);
+	ASSERT_EQ(size, 0);
+	ASSERT_STREQ(buffer, "");
+
+	// Grows as needed.
+	for (int i = 0; i < 100000; ++i)
+	{
+		ASSERT_GTEQ(fprintf(stream, "%d\n", i), 2);
+		expected_size += snprintf(expected, 16, "%d\n", i);
+	}
+	for (int i = 0; i < 1000; ++i)
+	{
+		ASSERT_EQ(fputc('a' + (i % 26), stream), 'a' + (i % 26));
+	}
+	expected_size += 1000;
+	ASSERT_EQ(fwrite("end", 1, 3, stream), 3);
+	expected_size += 3;
+
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_EQ(size, expected_size);
+	ASSERT_EQ(strlen(buffer), expected_size);
+	ASSERT_MEMEQ(buffer, "0\n1\n2\n", 6);
+	ASSERT_MEMEQ(buffer + expected_size - 6, "jklend", 6);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_EQ(size, expected_size);
+
+	// The buffer belongs to us now.
+	free(buffer);
+
+	return 0;
+}
+
+int test_open_memstream_seek()
+{
+	FILE *stream;
+	char *buffer = NULL;
+	size_t size = 0;
+
+	stream = open_memstream(&buffer, &size);
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_GTEQ(fputs("hello", stream), 0);
+
+	// The size is the smaller of the current position and the length.
+	ASSERT_SUCCESS(fseek(stream, 1, SEEK_SET));
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_EQ(size, 1);
+	ASSERT_STREQ(buffer, "hello");
+
+	ASSERT_EQ(fputc('E', stream), 'E');
+	ASSERT_SUCCESS(fflush(stream));
+	ASSERT_EQ(size, 2);
+	ASSERT_STREQ(buffer, "hEllo");
+
+	// Seeking past the end and writing, the gap is zero filled.
+	ASSERT_SUCCESS(fseek(stream, 8, SEEK_SET));
+	ASSERT_EQ(fputc('!', stream), '!');
+	ASSERT_SUCCESS(fclose(stream));
+
+	ASSERT_EQ(size, 9);
+	ASSERT_MEMEQ(buffer, "hEllo\0\0\0!\0", 10);
+
+	free(buffer);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_fmemopen_read());
+	TEST(test_fmemopen_write());
+	TEST(test_fmemopen_update());
+	TEST(test_fmemopen_append());
+	TEST(test_open_memstream());
+	TEST(test_open_memstream_seek());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -0,0 +1,220 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Larger than the stack buffer used by the printf family.
+#define LONG_STRING_SIZE 4096
+
+static char long_string[LONG_STRING_SIZE + 1];
+
+static void prepare_long_string()
+{
+	for (int i = 0; i < LONG_STRING_SIZE; ++i)
+	{
+		long_string[i] = 'a' + (i % 26);
+	}
+	long_string[LONG_STRING_SIZE] = '\0';
+}
+
+static int read_back(const char *filename, char *buffer, size_t size)
+{
+	int fd = open(filename, O_RDONLY);
+	ssize_t result = read(fd, buffer, size);
+	ASSERT_NOTEQ(result, -1);
+	buffer[result] = '\0';
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_fprintf()
+{
+	FILE *f;
+	int result;
+	char *buffer;
+	const char *filename = "t-fprintf";
+
+	buffer = (char *)malloc(2 * LONG_STRING_SIZE);
+	ASSERT_NOTNULL(buffer);
+
+	f = fopen(filename, "w");
+	ASSERT_NOTNULL(f);
+
+	result = fprintf(f, "%d %s %c\n", 42, "short", 'x');
+	ASSERT_EQ(result, 11);
+
+	result = fprintf(f, "%s|%d\n", long_string, 7);
+	ASSERT_EQ(result, LONG_STRING_SIZE + 3);
+
+	ASSERT_SUCCESS(fclose(f));
+
+	ASSERT_SUCCESS(read_back(filename, buffer, 2 * LONG_STRING_SIZE));
+	ASSERT_EQ(strncmp(buffer, "42 short x\n", 11), 0);
+	ASSERT_EQ(strncmp(buffer + 11, long_string, LONG_STRING_SIZE), 0);
+	ASSERT_STREQ(buffer + 11 + LONG_STRING_SIZE, "|7\n");
+
+	free(buffer);
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_fprintf_buffering()
+{
+	FILE *f;
+	int result;
+	char buffer[256];
+	char stream_buffer[16];
+	const char *filename = "t-fprintf-buffering";
+
+	f = fopen(filename, "w+");
+	ASSERT_NOTNULL(f);
+
+	// Output spanning the stream buffer many times over.
+	ASSERT_SUCCESS(setvbuf(f, stream_buffer, _IOFBF, 16));
+
+	result = fprintf(f, "%5d|%s|%08.3f|", 42, "abcdefghijklmnopqrstuvwxyz", 3.14159);
+	ASSERT_EQ(result, 42);
+	ASSERT_EQ(ftell(f), 42);
+
+	// Mix with fwrite.
+	ASSERT_EQ(fwrite("0123456789", 1, 10, f), 10);
+	result = fprintf(f, "%x", 0xabcdef);
+	ASSERT_EQ(result, 6);
+	ASSERT_EQ(ftell(f), 58);
+
+	// Read back through the same stream.
+	ASSERT_SUCCESS(fseek(f, 0, SEEK_SET));
+	ASSERT_EQ(fread(buffer, 1, sizeof(buffer), f), 58);
+	buffer[58] = '\0';
+	ASSERT_STREQ(buffer, "   42|abcdefghijklmnopqrstuvwxyz|0003.142|0123456789abcdef");
+
+	// Unbuffered streams get the same output.
+	ASSERT_SUCCESS(setvbuf(f, NULL, _IONBF, 0));
+	ASSERT_SUCCESS(fseek(f, 0, SEEK_END));
+	result = fprintf(f, "%s-%d", "end", 1);
+	ASSERT_EQ(result, 5);
+
+	ASSERT_SUCCESS(fclose(f));
+
+	ASSERT_SUCCESS(read_back(filename, buffer, sizeof(buffer) - 1));
+	ASSERT_STREQ(buffer, "   42|abcdefghijklmnopqrstuvwxyz|0003.142|0123456789abcdefend-1");
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_dprintf()
+{
+	int fd;
+	int result;
+	char *buffer;
+	const char *filename = "t-dprintf";
+
+	buffer = (char *)malloc(2 * LONG_STRING_SIZE);
+	ASSERT_NOTNULL(buffer);
+
+	fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	result = dprintf(fd, "%u-%x", 10u, 255u);
+	ASSERT_EQ(result, 5);
+
+	result = dprintf(fd, "%s", long_string);
+	ASSERT_EQ(result, LONG_STRING_SIZE);
+
+	ASSERT_SUCCESS(close(fd));
+
+	ASSERT_SUCCESS(read_back(filename, buffer, 2 * LONG_STRING_SIZE));
+	ASSERT_EQ(strncmp(buffer, "10-ff", 5), 0);
+	ASSERT_STREQ(buffer + 5, long_string);
+
+	free(buffer);
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_asprintf()
+{
+	int result;
+	char *buffer = NULL;
+
+	result = asprintf(&buffer, "%s %d", "value", -5);
+	ASSERT_EQ(result, 8);
+	ASSERT_STREQ(buffer, "value -5");
+	free(buffer);
+
+	result = asprintf(&buffer, "%s%s", long_string, long_string);
+	ASSERT_EQ(result, 2 * LONG_STRING_SIZE);
+	ASSERT_EQ(strncmp(buffer, long_string, LONG_STRING_SIZE), 0);
+	ASSERT_STREQ(buffer + LONG_STRING_SIZE, long_string);
+	free(buffer);
+
+	return 0;
+}
+
+int test_asnprintf()
+{
+	char *result;
+	char buffer[16];
+	size_t size;
+
+	// Fits in the given buffer.
+	size = 16;
+	result = asnprintf(buffer, &size, "%d%d", 12, 34);
+	ASSERT_EQ(result, buffer);
+	ASSERT_EQ(size, 4);
+	ASSERT_STREQ(result, "1234");
+
+	// Does not fit.
+	size = 16;
+	result = asnprintf(buffer, &size, "%s", long_string);
+	ASSERT_NOTEQ(result, buffer);
+	ASSERT_EQ(size, LONG_STRING_SIZE);
+	ASSERT_STREQ(result, long_string);
+	free(result);
+
+	// No buffer.
+	size = 0;
+	result = asnprintf(NULL, &size, "%s", "abc");
+	ASSERT_NOTNULL(result);
+	ASSERT_EQ(size, 3);
+	ASSERT_STREQ(result, "abc");
+	free(result);
+
+	return 0;
+}
+
+void cleanup()
+{
+	remove("t-fprintf");
+	remove("t-fprintf-buffering");
+	remove("t-dprintf");
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+	CLEANUP(cleanup);
+
+	prepare_long_string();
+
+	TEST(test_fprintf());
+	TEST(test_fprintf_buffering());
+	TEST(test_dprintf());
+	TEST(test_asprintf());
+	TEST(test_asnprintf());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -0,0 +1,245 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <internal/stdio.h>
+#include <tests/test.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <Windows.h>
+
+#define REGISTRY_THREADS    8
+#define REGISTRY_ITERATIONS 2000
+
+static const char *content = "hello world\n";
+
+int test_reuse()
+{
+	FILE *f1, *f2;
+	char *buffer;
+	char line[32];
+	const char *filename = "t-registry";
+
+	f1 = fopen(filename, "w");
+	ASSERT_NOTNULL(f1);
+	ASSERT_GTEQ(fputs(content, f1), 0);
+
+	buffer = f1->buffer;
+	ASSERT_NOTNULL(buffer);
+
+	ASSERT_SUCCESS(fclose(f1));
+
+	// Closed streams fail validation while they are cached.
+	errno = 0;
+	ASSERT_EQ(fflush(f1), EOF);
+	ASSERT_ERRNO(EINVAL);
+
+	// The stream and its buffer are given back on the next open by this thread.
+	f2 = fopen(filename, "r");
+	ASSERT_NOTNULL(f2);
+	ASSERT_EQ(f2, f1);
+	ASSERT_EQ(f2->buffer, buffer);
+	ASSERT_EQ(f2->pos, 0);
+	ASSERT_EQ(f2->error, 0);
+
+	ASSERT_NOTNULL(fgets(line, 32, f2));
+	ASSERT_STREQ(line, content);
+	ASSERT_NULL(fgets(line, 32, f2));
+	ASSERT_NOTEQ(feof(f2), 0);
+
+	ASSERT_SUCCESS(fclose(f2));
+
+	// Memory streams bring their own buffer.
+	f2 = fmemopen(line, 32, "w");
+	ASSERT_NOTNULL(f2);
+	ASSERT_EQ(f2, f1);
+	ASSERT_EQ(f2->buffer, line);
+	ASSERT_GTEQ(fputs("abc", f2), 0);
+	ASSERT_SUCCESS(fclose(f2));
+	ASSERT_STREQ(line, "abc");
+
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+static volatile LONG failures = 0;
+static HANDLE opened[REGISTRY_THREADS];
+static HANDLE flushed;
+
+static void make_filename(char *filename, int index)
+{
+	snprintf(filename, 32, "t-registry-%d", index);
+}
+
+DWORD WINAPI write_wait_thread(LPVOID arg)
+{
+	FILE *stream;
+	int index = (int)(INT_PTR)arg;
+	char filename[32];
+
+	make_filename(filename, index);
+
+	stream = fopen(filename, "w");
+	if (stream == NULL)
+	{
+		InterlockedIncrement(&failures);
+		SetEvent(opened[index]);
+		return 0;
+	}
+
+	if (fputs(content, stream) == EOF)
+	{
+		InterlockedIncrement(&failures);
+	}
+
+	// The data is in the stream buffer, wait for fflush(NULL).
+	SetEvent(opened[index]);
+	WaitForSingleObject(flushed, INFINITE);
+
+	if (fclose(stream) != 0)
+	{
+		InterlockedIncrement(&failures);
+	}
+
+	return 0;
+}
+
+int test_flushall()
+{
+	HANDLE threads[REGISTRY_THREADS];
+	struct stat statbuf;
+	char filename[32];
+
+	failures = 0;
+	flushed = CreateEvent(NULL, TRUE, FALSE, NULL);
+	ASSERT_NOTNULL(flushed);
+
+	for (int i = 0; i < REGISTRY_THREADS; ++i)
+	{
+		opened[i] = CreateEvent(NULL, TRUE, FALSE, NULL);
+		ASSERT_NOTNULL(opened[i]);
+		threads[i] = CreateThread(NULL, 0, write_wait_thread, (LPVOID)(INT_PTR)i, 0, NULL);
+		ASSERT_NOTNULL(threads[i]);
+	}
+
+	WaitForMultipleObjects(REGISTRY_THREADS, opened, TRUE, INFINITE);
+
+	// The streams are spread over the shards of their threads, all of them should be flushed.
+	ASSERT_SUCCESS(fflush(NULL));
+
+	for (int i = 0; i < REGISTRY_THREADS; ++i)
+	{
+		make_filename(filename, i);
+		ASSERT_SUCCESS(stat(filename, &statbuf));
+		ASSERT_EQ(statbuf.st_size, strlen(content));
+	}
+
+	SetEvent(flushed);
+	WaitForMultipleObjects(REGISTRY_THREADS, threads, TRUE, INFINITE);
+
+	for (int i = 0; i < REGISTRY_THREADS; ++i)
+	{
+		CloseHandle(threads[i]);
+		CloseHandle(opened[i]);
+
+		make_filename(filename, i);
+		ASSERT_SUCCESS(unlink(filename));
+	}
+
+	CloseHandle(flushed);
+
+	ASSERT_EQ(failures, 0);
+
+	return 0;
+}
+
+DWORD WINAPI open_close_thread(LPVOID arg)
+{
+	FILE *stream;
+	int index = (int)(INT_PTR)arg;
+	char filename[32];
+	char line[32];
+
+	make_filename(filename, index);
+
+	for (int i = 0; i < REGISTRY_ITERATIONS; ++i)
+	{
+		stream = fopen(filename, (i % 2) ? "r" : "w");
+		if (stream == NULL)
+		{
+			InterlockedIncrement(&failures);
+			continue;
+		}
+
+		if (i % 2)
+		{
+			if (fgets(line, 32, stream) == NULL || strcmp(line, content) != 0)
+			{
+				InterlockedIncrement(&failures);
+			}
+		}
+		else
+		{
+			if (fputs(content, stream) == EOF)
+			{
+				InterlockedIncrement(&failures);
+			}
+		}
+
+		if (fclose(stream) != 0)
+		{
+			InterlockedIncrement(&failures);
+		}
+	}
+
+	return 0;
+}
+
+int test_churn()
+{
+	HANDLE threads[REGISTRY_THREADS];
+	char filename[32];
+
+	failures = 0;
+
+	for (int i = 0; i < REGISTRY_THREADS; ++i)
+	{
+		threads[i] = CreateThread(NULL, 0, open_close_thread, (LPVOID)(INT_PTR)i, 0, NULL);
+		ASSERT_NOTNULL(threads[i]);
+	}
+
+	// Walk the registry while it is changing.
+	while (WaitForMultipleObjects(REGISTRY_THREADS, threads, TRUE, 0) == WAIT_TIMEOUT)
+	{
+		fflush(NULL);
+	}
+
+	for (int i = 0; i < REGISTRY_THREADS; ++i)
+	{
+		CloseHandle(threads[i]);
+
+		make_filename(filename, i);
+		ASSERT_SUCCESS(unlink(filename));
+	}
+
+	ASSERT_EQ(failures, 0);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_reuse());
+	TEST(test_flushall());
+	TEST(test_churn());
+
+	VERIFY_RESULT_AND_EXIT();
+}
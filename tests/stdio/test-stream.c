@@ -9,6 +9,8 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdio_ext.h>
+#include <string.h>
+#include <unistd.h>
 
 int test_buffer()
 {
@@ -48,6 +50,73 @@ int test_buffer()
 	return 0;
 }
 
+int test_buffer_default()
+{
+	int fd[2];
+	FILE *stream;
+	const char *filename = "t-buffer-default";
+
+	// Files get a large buffer.
+	stream = fopen(filename, "w");
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_EQ(__fbufmode(stream), _IOFBF);
+	ASSERT_GTEQ(__fbufsize(stream), 65536);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_SUCCESS(remove(filename));
+
+	// Pipes get a buffer the size of the pipe.
+	ASSERT_SUCCESS(pipe(fd));
+
+	stream = fdopen(fd[1], "w");
+	ASSERT_NOTNULL(stream);
+
+	ASSERT_EQ(__fbufmode(stream), _IOFBF);
+	ASSERT_EQ(__fbufsize(stream), 16384);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_SUCCESS(close(fd[0]));
+
+	return 0;
+}
+
+int test_line_buffering()
+{
+	int fd;
+	char buffer[16];
+	FILE *stream;
+	const char *filename = "t-line-buffering";
+
+	stream = fopen(filename, "w");
+	ASSERT_NOTNULL(stream);
+	ASSERT_SUCCESS(setvbuf(stream, NULL, _IOLBF, 1024));
+
+	fd = open(filename, O_RDONLY);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Nothing is written till a newline.
+	ASSERT_EQ(fputs("abc", stream), 3);
+	ASSERT_EQ(read(fd, buffer, 16), 0);
+
+	ASSERT_EQ(fputc('\n', stream), '\n');
+	ASSERT_EQ(read(fd, buffer, 16), 4);
+
+	ASSERT_EQ(fprintf(stream, "%d\n%d", 1, 2), 3);
+	ASSERT_EQ(read(fd, buffer, 16), 3);
+	ASSERT_MEMEQ(buffer, "1\n2", 3);
+
+	ASSERT_EQ(fwrite("3\n", 1, 2, stream), 2);
+	ASSERT_EQ(read(fd, buffer, 16), 2);
+	ASSERT_MEMEQ(buffer, "3\n", 2);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_SUCCESS(remove(filename));
+
+	return 0;
+}
+
 int test_mode()
 {
 	FILE *stream;
@@ -143,11 +212,114 @@ int test_pending()
 	return 0;
 }
 
+int test_peek()
+{
+	int fd;
+	FILE *stream;
+	const char *buffer;
+	size_t size;
+	const char *filename = "t-peek";
+
+	fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+	ASSERT_EQ(write(fd, "hello world\nsecond line\n", 24), 24);
+	ASSERT_SUCCESS(close(fd));
+
+	stream = fopen(filename, "r");
+	ASSERT_NOTNULL(stream);
+	ASSERT_SUCCESS(setvbuf(stream, NULL, _IOFBF, 8));
+
+	// The buffer is filled.
+	ASSERT_SUCCESS(fpeek(stream, 1, &buffer, &size));
+	ASSERT_EQ(size, 8);
+	ASSERT_MEMEQ(buffer, "hello wo", 8);
+
+	ASSERT_SUCCESS(fconsume(stream, 6));
+	ASSERT_EQ(ftell(stream), 6);
+
+	// Straddles the end of the buffer, it should grow.
+	ASSERT_SUCCESS(fpeek(stream, 10, &buffer, &size));
+	ASSERT_GTEQ(size, 10);
+	ASSERT_MEMEQ(buffer, "world\nseco", 10);
+	ASSERT_GTEQ(__fbufsize(stream), 10);
+
+	ASSERT_SUCCESS(fconsume(stream, 10));
+	ASSERT_EQ(ftell(stream), 16);
+
+	// Mixing with the other functions.
+	ASSERT_EQ(fgetc(stream), 'n');
+	ASSERT_EQ(ungetc('n', stream), 'n');
+	ASSERT_EQ(fgetc(stream), 'n');
+
+	// Less than asked for at the end.
+	ASSERT_SUCCESS(fpeek(stream, 100, &buffer, &size));
+	ASSERT_EQ(size, 7);
+	ASSERT_MEMEQ(buffer, "d line\n", 7);
+	ASSERT_NOTEQ(feof(stream), 0);
+
+	// Can't consume more than what is available.
+	errno = 0;
+	ASSERT_EQ(fconsume(stream, 8), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(fconsume(stream, 7));
+	ASSERT_EQ(ftell(stream), 24);
+
+	ASSERT_SUCCESS(fpeek(stream, 1, &buffer, &size));
+	ASSERT_EQ(size, 0);
+
+	ASSERT_SUCCESS(fclose(stream));
+
+	// Unbuffered streams have nothing to lend.
+	stream = fopen(filename, "r");
+	ASSERT_NOTNULL(stream);
+	ASSERT_SUCCESS(setvbuf(stream, NULL, _IONBF, 0));
+
+	errno = 0;
+	ASSERT_EQ(fpeek(stream, 1, &buffer, &size), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(fclose(stream));
+	ASSERT_SUCCESS(remove(filename));
+
+	return 0;
+}
+
+int test_peek_memstream()
+{
+	FILE *stream;
+	const char *buffer;
+	size_t size;
+	char data[] = "abc def";
+
+	stream = fmemopen(data, 7, "r");
+	ASSERT_NOTNULL(stream);
+
+	// The whole memory is the window.
+	ASSERT_SUCCESS(fpeek(stream, 1, &buffer, &size));
+	ASSERT_EQ(size, 7);
+	ASSERT_EQ(buffer, data);
+
+	ASSERT_SUCCESS(fconsume(stream, 4));
+	ASSERT_EQ(fgetc(stream), 'd');
+
+	ASSERT_SUCCESS(fpeek(stream, 16, &buffer, &size));
+	ASSERT_EQ(size, 2);
+	ASSERT_MEMEQ(buffer, "ef", 2);
+
+	ASSERT_SUCCESS(fclose(stream));
+
+	return 0;
+}
+
 void cleanup()
 {
 	remove("t-buffer");
+	remove("t-buffer-default");
+	remove("t-line-buffering");
 	remove("t-mode");
 	remove("t-pending");
+	remove("t-peek");
 }
 
 int main()
@@ -156,8 +328,12 @@ int main()
 	CLEANUP(cleanup);
 
 	TEST(test_buffer());
+	TEST(test_buffer_default());
+	TEST(test_line_buffering());
 	TEST(test_mode());
 	TEST(test_pending());
+	TEST(test_peek());
+	TEST(test_peek_memstream());
 
 	VERIFY_RESULT_AND_EXIT();
 }
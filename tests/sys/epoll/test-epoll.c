@@ -0,0 +1,405 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define PIPE_COUNT 64
+
+int test_epoll_errors()
+{
+	int epfd, fd;
+	struct epoll_event event;
+	const char *filename = "t-epoll";
+
+	epfd = epoll_create1(0);
+	ASSERT_NOTEQ(epfd, -1);
+
+	fd = open(filename, O_RDWR | O_CREAT, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+
+	// Bad arguments.
+	errno = 0;
+	ASSERT_EQ(epoll_create(0), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(epoll_create1(-1), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, 0, fd, &event), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(-1, EPOLL_CTL_ADD, fd, &event), -1);
+	ASSERT_ERRNO(EBADF);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(fd, EPOLL_CTL_ADD, fd, &event), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, epfd, &event), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(epoll_wait(epfd, &event, 0, 0), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	// Regular files are not supported.
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event), -1);
+	ASSERT_ERRNO(EPERM);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event), -1);
+	ASSERT_ERRNO(EBADF);
+
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+int test_epoll_ctl()
+{
+	int epfd;
+	int fd[2];
+	struct epoll_event event, events[4];
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	ASSERT_NOTEQ(epfd, -1);
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	event.events = EPOLLIN;
+	event.data.u64 = 1;
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_MOD, fd[0], &event), -1);
+	ASSERT_ERRNO(ENOENT);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_DEL, fd[0], NULL), -1);
+	ASSERT_ERRNO(ENOENT);
+
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[0], &event));
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[0], &event), -1);
+	ASSERT_ERRNO(EEXIST);
+
+	ASSERT_EQ(epoll_wait(epfd, events, 4, 0), 0);
+
+	// Data in the pipe.
+	ASSERT_EQ(write(fd[1], "hello", 5), 5);
+
+	ASSERT_EQ(epoll_wait(epfd, events, 4, 1000), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.u64, 1);
+
+	// Write end.
+	event.events = EPOLLOUT;
+	event.data.u64 = 2;
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[1], &event));
+
+	// Level triggered, the read end is reported again.
+	ASSERT_EQ(epoll_wait(epfd, events, 4, 0), 2);
+	ASSERT_EQ(events[0].events + events[1].events, EPOLLIN + EPOLLOUT);
+	ASSERT_EQ(events[0].data.u64 + events[1].data.u64, 3);
+
+	// Respect maxevents.
+	ASSERT_EQ(epoll_wait(epfd, events, 1, 0), 1);
+
+	// Modify.
+	event.events = EPOLLIN;
+	event.data.u64 = 3;
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_MOD, fd[1], &event));
+
+	ASSERT_EQ(epoll_wait(epfd, events, 4, 0), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.u64, 1);
+
+	// Delete.
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_DEL, fd[0], NULL));
+	ASSERT_EQ(epoll_wait(epfd, events, 4, 0), 0);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+int test_epoll_ready_only()
+{
+	int epfd;
+	char buffer[8];
+	int fds[PIPE_COUNT][2];
+	struct epoll_event event, events[PIPE_COUNT];
+
+	epfd = epoll_create1(0);
+	ASSERT_NOTEQ(epfd, -1);
+
+	for (int i = 0; i < PIPE_COUNT; ++i)
+	{
+		ASSERT_SUCCESS(pipe(fds[i]));
+
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i][0], &event));
+	}
+
+	ASSERT_EQ(epoll_wait(epfd, events, PIPE_COUNT, 0), 0);
+
+	// Only the pipes with data should be reported.
+	ASSERT_EQ(write(fds[7][1], "a", 1), 1);
+	ASSERT_EQ(write(fds[42][1], "b", 1), 1);
+
+	// Give the watchers time to notice both.
+	usleep(100000); // 100 ms
+
+	ASSERT_EQ(epoll_wait(epfd, events, PIPE_COUNT, 1000), 2);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[1].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.u32 + events[1].data.u32, 49);
+
+	// Drain them, nothing should be reported after that.
+	ASSERT_EQ(read(fds[7][0], buffer, 8), 1);
+	ASSERT_EQ(read(fds[42][0], buffer, 8), 1);
+
+	ASSERT_EQ(epoll_wait(epfd, events, PIPE_COUNT, 20), 0);
+
+	// Closing the write end hangs up the read end.
+	ASSERT_SUCCESS(close(fds[3][1]));
+	fds[3][1] = -1;
+
+	ASSERT_EQ(epoll_wait(epfd, events, PIPE_COUNT, 1000), 1);
+	ASSERT_EQ(events[0].events, EPOLLHUP);
+	ASSERT_EQ(events[0].data.u32, 3);
+
+	// Closing the read end removes it from the interest list.
+	ASSERT_SUCCESS(close(fds[3][0]));
+	ASSERT_EQ(epoll_wait(epfd, events, PIPE_COUNT, 0), 0);
+
+	errno = 0;
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_DEL, fds[3][0], NULL), -1);
+	ASSERT_ERRNO(EBADF);
+
+	for (int i = 0; i < PIPE_COUNT; ++i)
+	{
+		if (i != 3)
+		{
+			ASSERT_SUCCESS(close(fds[i][0]));
+			ASSERT_SUCCESS(close(fds[i][1]));
+		}
+	}
+
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+int test_epoll_oneshot()
+{
+	int epfd;
+	int fd[2];
+	struct epoll_event event, events[2];
+
+	epfd = epoll_create1(0);
+	ASSERT_NOTEQ(epfd, -1);
+
+	ASSERT_SUCCESS(pipe(fd));
+	ASSERT_EQ(write(fd[1], "hello", 5), 5);
+
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.fd = fd[0];
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[0], &event));
+
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 0), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.fd, fd[0]);
+
+	// Disabled till it is modified.
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 0), 0);
+
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_MOD, fd[0], &event));
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 0), 1);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+void *delayed_write(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+
+	usleep(50000); // 50 ms
+	write(fd, "hello", 5);
+
+	return NULL;
+}
+
+int test_epoll_wakeup()
+{
+	int epfd;
+	int fd[2];
+	pthread_t thread;
+	struct pollfd pfd;
+	struct epoll_event event, events[2];
+
+	epfd = epoll_create1(0);
+	ASSERT_NOTEQ(epfd, -1);
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	event.events = EPOLLIN;
+	event.data.fd = fd[0];
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[0], &event));
+
+	// Arm the watcher.
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 0), 0);
+
+	// The write from the other thread should end the wait well before the timeout.
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_write, (void *)(intptr_t)fd[1]));
+
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 60000), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.fd, fd[0]);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	// The epoll fd itself can be polled.
+	pfd.fd = epfd;
+	pfd.events = POLLIN;
+	ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+	ASSERT_EQ(pfd.revents, POLLIN);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+int test_epoll_nonblocking_wakeup()
+{
+	int epfd;
+	int fd[2];
+	pthread_t thread;
+	struct epoll_event event, events[2];
+
+	epfd = epoll_create1(0);
+	ASSERT_NOTEQ(epfd, -1);
+
+	// Non blocking pipes are watched the same way.
+	ASSERT_SUCCESS(pipe2(fd, O_NONBLOCK));
+
+	event.events = EPOLLIN;
+	event.data.fd = fd[0];
+	ASSERT_SUCCESS(epoll_ctl(epfd, EPOLL_CTL_ADD, fd[0], &event));
+
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 0), 0);
+
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_write, (void *)(intptr_t)fd[1]));
+
+	ASSERT_EQ(epoll_wait(epfd, events, 2, 60000), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.fd, fd[0]);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+	ASSERT_SUCCESS(close(epfd));
+
+	return 0;
+}
+
+int test_epoll_nested()
+{
+	int outer, inner;
+	int fd[2];
+	pthread_t thread;
+	struct epoll_event event, events[2];
+
+	outer = epoll_create1(0);
+	ASSERT_NOTEQ(outer, -1);
+
+	inner = epoll_create1(0);
+	ASSERT_NOTEQ(inner, -1);
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	event.events = EPOLLIN;
+	event.data.fd = fd[0];
+	ASSERT_SUCCESS(epoll_ctl(inner, EPOLL_CTL_ADD, fd[0], &event));
+	ASSERT_EQ(epoll_wait(inner, events, 2, 0), 0);
+
+	event.events = EPOLLIN;
+	event.data.fd = inner;
+	ASSERT_SUCCESS(epoll_ctl(outer, EPOLL_CTL_ADD, inner, &event));
+	ASSERT_EQ(epoll_wait(outer, events, 2, 0), 0);
+
+	// The outer instance is woken up once the inner one has an event.
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_write, (void *)(intptr_t)fd[1]));
+
+	ASSERT_EQ(epoll_wait(outer, events, 2, 60000), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.fd, inner);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	ASSERT_EQ(epoll_wait(inner, events, 2, 0), 1);
+	ASSERT_EQ(events[0].events, EPOLLIN);
+	ASSERT_EQ(events[0].data.fd, fd[0]);
+
+	// Closing the inner instance removes it from the outer one.
+	ASSERT_SUCCESS(close(inner));
+	ASSERT_EQ(epoll_wait(outer, events, 2, 0), 0);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+	ASSERT_SUCCESS(close(outer));
+
+	return 0;
+}
+
+void cleanup()
+{
+	remove("t-epoll");
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+	CLEANUP(cleanup);
+
+	TEST(test_epoll_errors());
+	TEST(test_epoll_ctl());
+	TEST(test_epoll_ready_only());
+	TEST(test_epoll_oneshot());
+	TEST(test_epoll_wakeup());
+	TEST(test_epoll_nonblocking_wakeup());
+	TEST(test_epoll_nested());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -0,0 +1,262 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int test_eventfd_counter()
+{
+	int fd;
+	uint64_t value;
+	char small[4];
+
+	fd = eventfd(5, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	// The counter is returned and reset.
+	ASSERT_EQ(read(fd, &value, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(value, 5);
+
+	value = 3;
+	ASSERT_EQ(write(fd, &value, sizeof(uint64_t)), sizeof(uint64_t));
+	value = 4;
+	ASSERT_EQ(write(fd, &value, sizeof(uint64_t)), sizeof(uint64_t));
+
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 7);
+
+	// Buffers smaller than 8 bytes and the maximum value are invalid.
+	errno = 0;
+	ASSERT_EQ(read(fd, small, 4), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_write(fd, UINT64_MAX));
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_eventfd_semaphore()
+{
+	int fd;
+	eventfd_t value;
+
+	fd = eventfd(2, EFD_SEMAPHORE | EFD_NONBLOCK);
+	ASSERT_NOTEQ(fd, -1);
+
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 1);
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 1);
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_read(fd, &value));
+	ASSERT_ERRNO(EAGAIN);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_eventfd_nonblock()
+{
+	int fd;
+	eventfd_t value;
+
+	fd = eventfd(0, EFD_NONBLOCK);
+	ASSERT_NOTEQ(fd, -1);
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_read(fd, &value));
+	ASSERT_ERRNO(EAGAIN);
+
+	// The counter can't go past 0xfffffffffffffffe.
+	ASSERT_SUCCESS(eventfd_write(fd, 0xfffffffffffffffe));
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_write(fd, 1));
+	ASSERT_ERRNO(EAGAIN);
+
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 0xfffffffffffffffe);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_eventfd_dup()
+{
+	int fd, fd2;
+	eventfd_t value;
+
+	fd = eventfd(0, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	fd2 = dup(fd);
+	ASSERT_NOTEQ(fd2, -1);
+
+	// Both fds share the counter, even after the original is closed.
+	ASSERT_SUCCESS(eventfd_write(fd, 10));
+	ASSERT_SUCCESS(close(fd));
+
+	ASSERT_SUCCESS(eventfd_read(fd2, &value));
+	ASSERT_EQ(value, 10);
+
+	ASSERT_SUCCESS(close(fd2));
+
+	return 0;
+}
+
+void *delayed_signal(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+
+	usleep(50000); // 50 ms
+	eventfd_write(fd, 1);
+
+	return NULL;
+}
+
+int test_eventfd_poll()
+{
+	int fd, result;
+	eventfd_t value;
+	pthread_t thread;
+	struct pollfd pfd;
+
+	fd = eventfd(0, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN | POLLOUT;
+
+	// Always writable.
+	result = poll(&pfd, 1, 0);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(pfd.revents, POLLOUT);
+
+	pfd.events = POLLIN;
+
+	result = poll(&pfd, 1, 20);
+	ASSERT_EQ(result, 0);
+
+	// The write from the other thread should end the wait well before the timeout.
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_signal, (void *)(intptr_t)fd));
+
+	result = poll(&pfd, 1, 60000);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(pfd.revents, POLLIN);
+
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 1);
+
+	result = poll(&pfd, 1, 0);
+	ASSERT_EQ(result, 0);
+
+	// A blocking read is woken up by the write.
+	ASSERT_SUCCESS(pthread_create(&thread, NULL, delayed_signal, (void *)(intptr_t)fd));
+	ASSERT_SUCCESS(eventfd_read(fd, &value));
+	ASSERT_EQ(value, 1);
+	ASSERT_SUCCESS(pthread_join(thread, NULL));
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_eventfd_uio()
+{
+	int fd;
+	uint64_t value;
+	struct iovec iov;
+
+	fd = eventfd(0, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	iov.iov_base = &value;
+	iov.iov_len = sizeof(uint64_t);
+
+	value = 6;
+	ASSERT_EQ(writev(fd, &iov, 1), sizeof(uint64_t));
+
+	value = 0;
+	ASSERT_EQ(readv(fd, &iov, 1), sizeof(uint64_t));
+	ASSERT_EQ(value, 6);
+
+	// No file position.
+	errno = 0;
+	ASSERT_EQ(preadv(fd, &iov, 1, 0), -1);
+	ASSERT_ERRNO(ESPIPE);
+
+	errno = 0;
+	ASSERT_EQ(pwritev(fd, &iov, 1, 0), -1);
+	ASSERT_ERRNO(ESPIPE);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_eventfd_errors()
+{
+	int fd;
+	int pipefd[2];
+	eventfd_t value;
+
+	errno = 0;
+	ASSERT_FAIL(eventfd(0, 0x10));
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_read(-1, &value));
+	ASSERT_ERRNO(EBADF);
+
+	// Not an eventfd.
+	errno = 0;
+	ASSERT_SUCCESS(pipe(pipefd));
+	ASSERT_FAIL(eventfd_write(pipefd[1], 1));
+	ASSERT_ERRNO(EINVAL);
+	ASSERT_SUCCESS(close(pipefd[0]));
+	ASSERT_SUCCESS(close(pipefd[1]));
+
+	fd = eventfd(0, 0);
+	ASSERT_NOTEQ(fd, -1);
+	ASSERT_SUCCESS(close(fd));
+
+	errno = 0;
+	ASSERT_FAIL(eventfd_write(fd, 1));
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_eventfd_counter());
+	TEST(test_eventfd_semaphore());
+	TEST(test_eventfd_nonblock());
+	TEST(test_eventfd_dup());
+	TEST(test_eventfd_poll());
+	TEST(test_eventfd_uio());
+	TEST(test_eventfd_errors());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -149,11 +149,38 @@ int test_shared_lock()
 	return 0;
 }
 
+int test_append_lock()
+{
+	int status;
+	int fd;
+	ssize_t result;
+	const char *filename = "t-flock-append";
+
+	// Write only append descriptors can be locked as well.
+	fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	status = flock(fd, LOCK_EX);
+	ASSERT_EQ(status, 0);
+
+	result = write(fd, "hello", 5);
+	ASSERT_EQ(result, 5);
+
+	status = flock(fd, LOCK_UN);
+	ASSERT_EQ(status, 0);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
 void cleanup()
 {
 	remove("t-flock-recursive");
 	remove("t-flock-exclusive");
 	remove("t-flock-shared");
+	remove("t-flock-append");
 }
 
 int main()
@@ -164,6 +191,7 @@ int main()
 	TEST(test_recursive_lock());
 	TEST(test_exclusive_lock());
 	TEST(test_shared_lock());
+	TEST(test_append_lock());
 
 	VERIFY_RESULT_AND_EXIT();
 }
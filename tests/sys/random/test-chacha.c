@@ -0,0 +1,153 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <internal/random.h>
+#include <string.h>
+
+// Test vectors from RFC 8439.
+
+// Section 2.3.2
+static const uint8_t rfc_key[32] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+									0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+static const uint8_t rfc_nonce[12] = {0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00};
+static const uint8_t rfc_block[64] = {0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+									  0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+									  0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+									  0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e};
+
+// Appendix A.1, test vector #1
+static const uint8_t zero_block[64] = {0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+									   0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+									   0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+									   0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86};
+
+static void load_rfc_state(uint32_t key[CHACHA20_KEY_WORDS], uint32_t nonce[CHACHA20_NONCE_WORDS])
+{
+	// The words are little endian.
+	memcpy(key, rfc_key, sizeof(rfc_key));
+	memcpy(nonce, rfc_nonce, sizeof(rfc_nonce));
+}
+
+int test_generic()
+{
+	uint32_t key[CHACHA20_KEY_WORDS] = {0};
+	uint32_t nonce[CHACHA20_NONCE_WORDS] = {0};
+	uint8_t output[CHACHA20_BLOCK_SIZE];
+
+	chacha20_block_generic(key, 0, nonce, output);
+	ASSERT_MEMEQ(output, zero_block, CHACHA20_BLOCK_SIZE);
+
+	load_rfc_state(key, nonce);
+	chacha20_block_generic(key, 1, nonce, output);
+	ASSERT_MEMEQ(output, rfc_block, CHACHA20_BLOCK_SIZE);
+
+	return 0;
+}
+
+int test_sse2()
+{
+	uint32_t key[CHACHA20_KEY_WORDS];
+	uint32_t nonce[CHACHA20_NONCE_WORDS];
+	uint8_t expected[4 * CHACHA20_BLOCK_SIZE];
+	uint8_t output[4 * CHACHA20_BLOCK_SIZE];
+
+	load_rfc_state(key, nonce);
+
+	chacha20_blocks_sse2(key, 1, nonce, output);
+	ASSERT_MEMEQ(output, rfc_block, CHACHA20_BLOCK_SIZE);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		chacha20_block_generic(key, 1 + i, nonce, expected + i * CHACHA20_BLOCK_SIZE);
+	}
+
+	ASSERT_MEMEQ(output, expected, 4 * CHACHA20_BLOCK_SIZE);
+
+	// The counter wraps around.
+	chacha20_blocks_sse2(key, 0xfffffffe, nonce, output);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		chacha20_block_generic(key, 0xfffffffe + i, nonce, expected + i * CHACHA20_BLOCK_SIZE);
+	}
+
+	ASSERT_MEMEQ(output, expected, 4 * CHACHA20_BLOCK_SIZE);
+
+	return 0;
+}
+
+int test_avx2()
+{
+	uint32_t key[CHACHA20_KEY_WORDS];
+	uint32_t nonce[CHACHA20_NONCE_WORDS];
+	uint8_t expected[8 * CHACHA20_BLOCK_SIZE];
+	uint8_t output[8 * CHACHA20_BLOCK_SIZE];
+
+	if (!chacha20_avx2_supported())
+	{
+		printf("AVX2 not supported skipping test\n");
+		return 0;
+	}
+
+	load_rfc_state(key, nonce);
+
+	chacha20_blocks_avx2(key, 1, nonce, output);
+	ASSERT_MEMEQ(output, rfc_block, CHACHA20_BLOCK_SIZE);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		chacha20_block_generic(key, 1 + i, nonce, expected + i * CHACHA20_BLOCK_SIZE);
+	}
+
+	ASSERT_MEMEQ(output, expected, 8 * CHACHA20_BLOCK_SIZE);
+
+	chacha20_blocks_avx2(key, 0xfffffffc, nonce, output);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		chacha20_block_generic(key, 0xfffffffc + i, nonce, expected + i * CHACHA20_BLOCK_SIZE);
+	}
+
+	ASSERT_MEMEQ(output, expected, 8 * CHACHA20_BLOCK_SIZE);
+
+	return 0;
+}
+
+int test_blocks()
+{
+	uint32_t key[CHACHA20_KEY_WORDS];
+	uint32_t nonce[CHACHA20_NONCE_WORDS];
+	uint8_t expected[19 * CHACHA20_BLOCK_SIZE];
+	uint8_t output[19 * CHACHA20_BLOCK_SIZE];
+
+	load_rfc_state(key, nonce);
+
+	// All the implementations are used for 19 blocks (8 + 8 + 3 or 4 + 4 + 4 + 4 + 3).
+	chacha20_blocks(key, 1, nonce, output, 19);
+
+	for (int i = 0; i < 19; ++i)
+	{
+		chacha20_block_generic(key, 1 + i, nonce, expected + i * CHACHA20_BLOCK_SIZE);
+	}
+
+	ASSERT_MEMEQ(output, expected, 19 * CHACHA20_BLOCK_SIZE);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_generic());
+	TEST(test_sse2());
+	TEST(test_avx2());
+	TEST(test_blocks());
+
+	VERIFY_RESULT_AND_EXIT();
+}
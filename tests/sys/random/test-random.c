@@ -8,37 +8,42 @@
 #include <tests/test.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/random.h>
 
 int test_getrandom()
 {
 	ssize_t result;
 	char buffer[512];
+	char zero[512] = {0};
+	char *large = NULL;
 
-	result = getrandom(buffer, 512, 0);
-	ASSERT_EQ(result, 512);
-
-	// if length is odd last byte is not written
-	result = getrandom(buffer, 511, 0);
-	ASSERT_EQ(result, 510);
+	// The whole length is written.
+	for (int i = 505; i <= 512; ++i)
+	{
+		memset(buffer, 0, 512);
+		result = getrandom(buffer, i, 0);
+		ASSERT_EQ(result, i);
+		ASSERT_NOTEQ(memcmp(buffer + i - 32, zero, 32), 0);
+	}
 
-	result = getrandom(buffer, 510, 0);
-	ASSERT_EQ(result, 510);
+	result = getrandom(buffer, 0, 0);
+	ASSERT_EQ(result, 0);
 
-	result = getrandom(buffer, 509, 0);
-	ASSERT_EQ(result, 508);
+	// Large requests.
+	large = malloc(1048576);
+	ASSERT_NOTNULL(large);
 
-	result = getrandom(buffer, 508, 0);
-	ASSERT_EQ(result, 508);
+	memset(large, 0, 1048576);
+	result = getrandom(large, 1048576, 0);
+	ASSERT_EQ(result, 1048576);
+	ASSERT_NOTEQ(memcmp(large + 1048576 - 512, zero, 512), 0);
 
-	result = getrandom(buffer, 507, 0);
-	ASSERT_EQ(result, 506);
+	result = getrandom(large, 1048577, 0);
+	ASSERT_EQ(result, -1);
+	ASSERT_ERRNO(EINVAL);
 
-	result = getrandom(buffer, 506, 0);
-	ASSERT_EQ(result, 506);
-
-	result = getrandom(buffer, 505, 0);
-	ASSERT_EQ(result, 504);
+	free(large);
 
 	return 0;
 }
@@ -51,9 +56,41 @@ int test_getentropy()
 	result = getentropy(buffer, 512);
 	ASSERT_EQ(result, 512);
 
-	// if length is odd last byte is not written
 	result = getentropy(buffer, 511);
-	ASSERT_EQ(result, 510);
+	ASSERT_EQ(result, 511);
+
+	return 0;
+}
+
+int test_arc4random()
+{
+	uint32_t value;
+	char buffer[512];
+	char zero[64] = {0};
+	int count[6] = {0};
+
+	memset(buffer, 0, 512);
+	arc4random_buf(buffer, 511);
+	ASSERT_NOTEQ(memcmp(buffer + 511 - 64, zero, 64), 0);
+
+	ASSERT_EQ(arc4random_uniform(0), 0);
+	ASSERT_EQ(arc4random_uniform(1), 0);
+
+	for (int i = 0; i < 6000; ++i)
+	{
+		value = arc4random_uniform(6);
+		ASSERT_LTEQ(value, 5);
+		++count[value];
+	}
+
+	// Every value should turn up.
+	for (int i = 0; i < 6; ++i)
+	{
+		ASSERT_NOTEQ(count[i], 0);
+	}
+
+	// Two consecutive values being the same is unlikely.
+	ASSERT_NOTEQ(arc4random(), arc4random());
 
 	return 0;
 }
@@ -74,6 +111,7 @@ int main()
 
 	TEST(test_getrandom());
 	TEST(test_getentropy());
+	TEST(test_arc4random());
 
 	VERIFY_RESULT_AND_EXIT();
 }
@@ -0,0 +1,204 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+
+int test_signalfd_read()
+{
+	int fd;
+	sigset_t mask, oldmask, pending;
+	struct signalfd_siginfo info[4];
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	sigaddset(&mask, SIGUSR2);
+	ASSERT_SUCCESS(sigprocmask(SIG_BLOCK, &mask, &oldmask));
+
+	// Pending signals of the mask are taken by the signalfd.
+	ASSERT_SUCCESS(raise(SIGUSR2));
+
+	fd = signalfd(-1, &mask, SFD_NONBLOCK);
+	ASSERT_NOTEQ(fd, -1);
+
+	ASSERT_SUCCESS(raise(SIGUSR1));
+	// Not queued twice.
+	ASSERT_SUCCESS(raise(SIGUSR1));
+
+	ASSERT_SUCCESS(sigpending(&pending));
+	ASSERT_EQ(pending, 0);
+
+	ASSERT_EQ(read(fd, info, sizeof(info)), 2 * sizeof(struct signalfd_siginfo));
+	ASSERT_EQ(info[0].ssi_signo, SIGUSR1);
+	ASSERT_EQ(info[1].ssi_signo, SIGUSR2);
+	ASSERT_EQ(info[0].ssi_pid, getpid());
+
+	errno = 0;
+	ASSERT_EQ(read(fd, info, sizeof(info)), -1);
+	ASSERT_ERRNO(EAGAIN);
+
+	// One at a time.
+	ASSERT_SUCCESS(raise(SIGUSR1));
+	ASSERT_SUCCESS(raise(SIGUSR2));
+	ASSERT_EQ(read(fd, info, sizeof(struct signalfd_siginfo)), sizeof(struct signalfd_siginfo));
+	ASSERT_EQ(info[0].ssi_signo, SIGUSR1);
+	ASSERT_EQ(read(fd, info, sizeof(struct signalfd_siginfo)), sizeof(struct signalfd_siginfo));
+	ASSERT_EQ(info[0].ssi_signo, SIGUSR2);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(sigprocmask(SIG_SETMASK, &oldmask, NULL));
+
+	return 0;
+}
+
+int test_signalfd_mask()
+{
+	int fd, result;
+	sigset_t mask, oldmask, pending;
+	struct signalfd_siginfo info;
+	struct pollfd pfd;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	sigaddset(&mask, SIGUSR2);
+	ASSERT_SUCCESS(sigprocmask(SIG_BLOCK, &mask, &oldmask));
+
+	sigdelset(&mask, SIGUSR2);
+	fd = signalfd(-1, &mask, SFD_NONBLOCK);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Signals outside the mask stay pending in the thread.
+	ASSERT_SUCCESS(raise(SIGUSR2));
+	ASSERT_SUCCESS(sigpending(&pending));
+	ASSERT_EQ(pending, 1u << SIGUSR2);
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR2);
+	ASSERT_EQ(signalfd(fd, &mask, 0), fd);
+
+	ASSERT_SUCCESS(raise(SIGUSR2));
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	result = poll(&pfd, 1, 60000);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(pfd.revents, POLLIN);
+
+	ASSERT_EQ(read(fd, &info, sizeof(struct signalfd_siginfo)), sizeof(struct signalfd_siginfo));
+	ASSERT_EQ(info.ssi_signo, SIGUSR2);
+
+	result = poll(&pfd, 1, 0);
+	ASSERT_EQ(result, 0);
+
+	ASSERT_SUCCESS(close(fd));
+
+	// Drop the signal pending from before, SIGUSR2 terminates the process by default.
+	signal(SIGUSR2, SIG_IGN);
+	ASSERT_SUCCESS(sigprocmask(SIG_SETMASK, &oldmask, NULL));
+	signal(SIGUSR2, SIG_DFL);
+
+	return 0;
+}
+
+int test_signalfd_errors()
+{
+	int fd;
+	int pipefd[2];
+	sigset_t mask;
+	struct signalfd_siginfo info;
+
+	sigemptyset(&mask);
+	ASSERT_SUCCESS(pipe(pipefd));
+
+	errno = 0;
+	ASSERT_FAIL(signalfd(-1, NULL, 0));
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_FAIL(signalfd(-1, &mask, 0x10));
+	ASSERT_ERRNO(EINVAL);
+
+	// Not a signalfd.
+	errno = 0;
+	ASSERT_FAIL(signalfd(pipefd[0], &mask, 0));
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(close(pipefd[0]));
+	ASSERT_SUCCESS(close(pipefd[1]));
+
+	fd = signalfd(-1, &mask, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Too small a buffer.
+	errno = 0;
+	ASSERT_EQ(read(fd, &info, 8), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(close(fd));
+
+	errno = 0;
+	ASSERT_FAIL(signalfd(fd, &mask, 0));
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
+int test_signalfd_timer()
+{
+	int fd;
+	timer_t timer;
+	sigset_t mask, oldmask;
+	struct sigevent event;
+	struct itimerspec value;
+	struct signalfd_siginfo info;
+
+	// Timer signals are raised by an internal thread, the signalfd should take them all the same.
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGALRM);
+	ASSERT_SUCCESS(sigprocmask(SIG_BLOCK, &mask, &oldmask));
+
+	fd = signalfd(-1, &mask, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	event.sigev_notify = SIGEV_SIGNAL;
+	event.sigev_signo = SIGALRM;
+	ASSERT_SUCCESS(timer_create(CLOCK_MONOTONIC, &event, &timer));
+
+	value.it_interval.tv_sec = 0;
+	value.it_interval.tv_nsec = 0;
+	value.it_value.tv_sec = 0;
+	value.it_value.tv_nsec = 10000000; // 10ms
+	ASSERT_SUCCESS(timer_settime(timer, 0, &value, NULL));
+
+	// The default action of SIGALRM would terminate the process.
+	ASSERT_EQ(read(fd, &info, sizeof(struct signalfd_siginfo)), sizeof(struct signalfd_siginfo));
+	ASSERT_EQ(info.ssi_signo, SIGALRM);
+
+	ASSERT_SUCCESS(timer_delete(timer));
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(sigprocmask(SIG_SETMASK, &oldmask, NULL));
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_signalfd_read());
+	TEST(test_signalfd_mask());
+	TEST(test_signalfd_errors());
+	TEST(test_signalfd_timer());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -8,7 +8,9 @@
 #include <tests/test.h>
 #include <sys/time.h>
 #include <signal.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <Windows.h>
 
 int signal_count = 0;
 int notification_count = 0;
@@ -171,6 +173,152 @@ int test_timer_absolute()
 	return 0;
 }
 
+volatile LONG many_count = 0;
+
+void many_handler(union sigval arg)
+{
+	UNREFERENCED_PARAMETER(arg);
+	InterlockedIncrement(&many_count);
+}
+
+int test_timer_many()
+{
+	int status;
+	const int count = 100000;
+	timer_t *timers;
+	struct sigevent event;
+	struct itimerspec new_value, zero_value = {0};
+
+	timers = (timer_t *)malloc(sizeof(timer_t) * count);
+	ASSERT_NOTNULL(timers);
+
+	event.sigev_notify = SIGEV_THREAD;
+	event.sigev_value.sival_int = 0;
+	event.sigev_notify_function = many_handler;
+	event.sigev_notify_attributes = NULL;
+
+	for (int i = 0; i < count; ++i)
+	{
+		status = timer_create(CLOCK_MONOTONIC, &event, &timers[i]);
+		ASSERT_EQ(status, 0);
+	}
+
+	// Spread the timers over 1s - 1.1s, disarming every other one right after it is armed. The deadlines are far
+	// enough away that none of them can fire before being disarmed, even on a loaded machine.
+	new_value.it_interval.tv_sec = 0;
+	new_value.it_interval.tv_nsec = 0;
+
+	for (int i = 0; i < count; ++i)
+	{
+		new_value.it_value.tv_sec = 1;
+		new_value.it_value.tv_nsec = (i % 1000) * 100000;
+
+		status = timer_settime(timers[i], 0, &new_value, NULL);
+		ASSERT_EQ(status, 0);
+
+		if (i % 2 == 1)
+		{
+			status = timer_settime(timers[i], 0, &zero_value, NULL);
+			ASSERT_EQ(status, 0);
+		}
+	}
+
+	for (int i = 0; i < 500 && many_count < count / 2; ++i)
+	{
+		usleep(10000); // 10ms
+	}
+
+	// Nothing more should fire.
+	usleep(50000); // 50ms
+	ASSERT_EQ(many_count, count / 2);
+
+	for (int i = 0; i < count; ++i)
+	{
+		status = timer_delete(timers[i]);
+		ASSERT_EQ(status, 0);
+	}
+
+	free(timers);
+
+	return 0;
+}
+
+HANDLE overrun_gate;
+timer_t overrun_timer;
+volatile LONG overrun_seen = 0;
+
+void overrun_handler(union sigval arg)
+{
+	int overrun;
+
+	UNREFERENCED_PARAMETER(arg);
+
+	// Block till the gate is opened. Once all the callback threads are blocked here the expirations are missed.
+	WaitForSingleObject(overrun_gate, INFINITE);
+
+	overrun = timer_getoverrun(overrun_timer);
+	if (overrun > 0)
+	{
+		InterlockedExchange(&overrun_seen, overrun);
+	}
+}
+
+int test_timer_overrun()
+{
+	int status;
+	struct sigevent event;
+	struct itimerspec new_value, current_value, zero_value = {0};
+
+	overrun_gate = CreateEventA(NULL, TRUE, FALSE, NULL);
+	ASSERT_NOTNULL(overrun_gate);
+
+	event.sigev_notify = SIGEV_THREAD;
+	event.sigev_value.sival_int = 0;
+	event.sigev_notify_function = overrun_handler;
+	event.sigev_notify_attributes = NULL;
+
+	status = timer_create(CLOCK_MONOTONIC, &event, &overrun_timer);
+	ASSERT_EQ(status, 0);
+
+	ASSERT_EQ(timer_getoverrun(overrun_timer), 0);
+
+	new_value.it_interval.tv_sec = 0;
+	new_value.it_interval.tv_nsec = 1000000; // 1ms
+	new_value.it_value.tv_sec = 0;
+	new_value.it_value.tv_nsec = 1000000; // 1ms
+
+	status = timer_settime(overrun_timer, 0, &new_value, NULL);
+	ASSERT_EQ(status, 0);
+
+	usleep(50000); // 50ms
+
+	status = timer_gettime(overrun_timer, &current_value);
+	ASSERT_EQ(status, 0);
+	ASSERT_EQ(current_value.it_interval.tv_sec, 0);
+	ASSERT_EQ(current_value.it_interval.tv_nsec, 1000000);
+
+	// Let the callbacks run, the pending one reports the expirations missed while they were blocked.
+	SetEvent(overrun_gate);
+
+	for (int i = 0; i < 100 && overrun_seen == 0; ++i)
+	{
+		usleep(10000); // 10ms
+	}
+
+	status = timer_settime(overrun_timer, 0, &zero_value, NULL);
+	ASSERT_EQ(status, 0);
+
+	ASSERT_GTEQ(overrun_seen, 1);
+
+	status = timer_delete(overrun_timer);
+	ASSERT_EQ(status, 0);
+
+	usleep(10000); // 10ms, for the callbacks still running.
+	CloseHandle(overrun_gate);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -179,6 +327,8 @@ int main()
 	TEST(test_timer_signal());
 	TEST(test_timer_thread());
 	TEST(test_timer_absolute());
+	TEST(test_timer_many());
+	TEST(test_timer_overrun());
 
 	VERIFY_RESULT_AND_EXIT()
 }
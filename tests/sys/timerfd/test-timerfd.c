@@ -0,0 +1,258 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+int test_timerfd_oneshot()
+{
+	int fd;
+	uint64_t expirations;
+	struct itimerspec value, old;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Not armed.
+	ASSERT_SUCCESS(timerfd_gettime(fd, &value));
+	ASSERT_EQ(value.it_value.tv_sec, 0);
+	ASSERT_EQ(value.it_value.tv_nsec, 0);
+
+	value.it_value.tv_sec = 0;
+	value.it_value.tv_nsec = 20000000; // 20ms
+	value.it_interval.tv_sec = 0;
+	value.it_interval.tv_nsec = 0;
+
+	ASSERT_SUCCESS(timerfd_settime(fd, 0, &value, &old));
+	ASSERT_EQ(old.it_value.tv_sec, 0);
+	ASSERT_EQ(old.it_value.tv_nsec, 0);
+
+	ASSERT_SUCCESS(timerfd_gettime(fd, &value));
+	ASSERT_EQ(value.it_value.tv_sec, 0);
+	ASSERT_LTEQ(value.it_value.tv_nsec, 20000000);
+
+	// Blocks till the timer expires.
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(expirations, 1);
+
+	// Disarmed after the expiration is read.
+	ASSERT_SUCCESS(timerfd_gettime(fd, &value));
+	ASSERT_EQ(value.it_value.tv_sec, 0);
+	ASSERT_EQ(value.it_value.tv_nsec, 0);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_timerfd_periodic()
+{
+	int fd;
+	uint64_t expirations;
+	struct itimerspec value;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	ASSERT_NOTEQ(fd, -1);
+
+	value.it_value.tv_sec = 0;
+	value.it_value.tv_nsec = 10000000; // 10ms
+	value.it_interval.tv_sec = 0;
+	value.it_interval.tv_nsec = 10000000; // 10ms
+
+	ASSERT_SUCCESS(timerfd_settime(fd, 0, &value, NULL));
+
+	errno = 0;
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), -1);
+	ASSERT_ERRNO(EAGAIN);
+
+	// Missed expirations are counted.
+	usleep(105000);
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_GTEQ(expirations, 10);
+
+	ASSERT_SUCCESS(timerfd_gettime(fd, &value));
+	ASSERT_EQ(value.it_interval.tv_sec, 0);
+	ASSERT_EQ(value.it_interval.tv_nsec, 10000000);
+
+	// Disarm.
+	value.it_value.tv_nsec = 0;
+	ASSERT_SUCCESS(timerfd_settime(fd, 0, &value, NULL));
+	usleep(20000);
+
+	errno = 0;
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), -1);
+	ASSERT_ERRNO(EAGAIN);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_timerfd_abstime()
+{
+	int fd;
+	uint64_t expirations;
+	struct itimerspec value;
+	struct timespec now;
+
+	fd = timerfd_create(CLOCK_REALTIME, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	ASSERT_SUCCESS(clock_gettime(CLOCK_REALTIME, &value.it_value));
+	value.it_value.tv_nsec += 20000000; // 20ms
+	if (value.it_value.tv_nsec >= 1000000000)
+	{
+		value.it_value.tv_nsec -= 1000000000;
+		value.it_value.tv_sec += 1;
+	}
+	value.it_interval.tv_sec = 0;
+	value.it_interval.tv_nsec = 0;
+
+	ASSERT_SUCCESS(timerfd_settime(fd, TFD_TIMER_ABSTIME, &value, NULL));
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(expirations, 1);
+
+	// A time in the past expires immediately.
+	value.it_value.tv_sec -= 10;
+	ASSERT_SUCCESS(timerfd_settime(fd, TFD_TIMER_ABSTIME, &value, NULL));
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(expirations, 1);
+
+	ASSERT_SUCCESS(close(fd));
+
+	// Absolute monotonic times are on the clock of clock_gettime.
+	fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	ASSERT_SUCCESS(clock_gettime(CLOCK_MONOTONIC, &value.it_value));
+	value.it_value.tv_nsec += 20000000; // 20ms
+	if (value.it_value.tv_nsec >= 1000000000)
+	{
+		value.it_value.tv_nsec -= 1000000000;
+		value.it_value.tv_sec += 1;
+	}
+
+	ASSERT_SUCCESS(timerfd_settime(fd, TFD_TIMER_ABSTIME, &value, NULL));
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(expirations, 1);
+
+	ASSERT_SUCCESS(clock_gettime(CLOCK_MONOTONIC, &now));
+	ASSERT_GTEQ((now.tv_sec - value.it_value.tv_sec) * 1000000000 + (now.tv_nsec - value.it_value.tv_nsec), 0);
+	ASSERT_LTEQ(now.tv_sec - value.it_value.tv_sec, 10);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_timerfd_poll()
+{
+	int fd, result;
+	uint64_t expirations;
+	struct itimerspec value;
+	struct pollfd pfd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	// Never readable while disarmed.
+	result = poll(&pfd, 1, 20);
+	ASSERT_EQ(result, 0);
+
+	value.it_value.tv_sec = 0;
+	value.it_value.tv_nsec = 50000000; // 50ms
+	value.it_interval.tv_sec = 0;
+	value.it_interval.tv_nsec = 0;
+
+	ASSERT_SUCCESS(timerfd_settime(fd, 0, &value, NULL));
+
+	// The timer should end the wait well before the timeout.
+	result = poll(&pfd, 1, 60000);
+	ASSERT_EQ(result, 1);
+	ASSERT_EQ(pfd.revents, POLLIN);
+
+	ASSERT_EQ(read(fd, &expirations, sizeof(uint64_t)), sizeof(uint64_t));
+	ASSERT_EQ(expirations, 1);
+
+	result = poll(&pfd, 1, 0);
+	ASSERT_EQ(result, 0);
+
+	ASSERT_SUCCESS(close(fd));
+
+	return 0;
+}
+
+int test_timerfd_errors()
+{
+	int fd;
+	int pipefd[2];
+	struct itimerspec value = {0};
+
+	errno = 0;
+	ASSERT_FAIL(timerfd_create(5, 0));
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_FAIL(timerfd_create(CLOCK_MONOTONIC, 0x10));
+	ASSERT_ERRNO(EINVAL);
+
+	fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	ASSERT_NOTEQ(fd, -1);
+
+	errno = 0;
+	value.it_value.tv_nsec = 1000000000;
+	ASSERT_FAIL(timerfd_settime(fd, 0, &value, NULL));
+	ASSERT_ERRNO(EINVAL);
+
+	// Unsupported.
+	errno = 0;
+	value.it_value.tv_nsec = 0;
+	ASSERT_FAIL(timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &value, NULL));
+	ASSERT_ERRNO(EINVAL);
+
+	// Not a timerfd.
+	errno = 0;
+	value.it_value.tv_nsec = 0;
+	ASSERT_SUCCESS(pipe(pipefd));
+	ASSERT_FAIL(timerfd_settime(pipefd[0], 0, &value, NULL));
+	ASSERT_ERRNO(EINVAL);
+	ASSERT_SUCCESS(close(pipefd[0]));
+	ASSERT_SUCCESS(close(pipefd[1]));
+
+	// Writes are not supported.
+	errno = 0;
+	ASSERT_EQ(write(fd, &value, 8), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(close(fd));
+
+	errno = 0;
+	ASSERT_FAIL(timerfd_gettime(fd, &value));
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+
+	TEST(test_timerfd_oneshot());
+	TEST(test_timerfd_periodic());
+	TEST(test_timerfd_abstime());
+	TEST(test_timerfd_poll());
+	TEST(test_timerfd_errors());
+
+	VERIFY_RESULT_AND_EXIT();
+}
@@ -0,0 +1,375 @@
+/*
+   Copyright (c) 2020-2023 Sibi Siddharthan
+
+   Distributed under the MIT license.
+   Refer to the LICENSE file at the root directory for details.
+*/
+
+#include <tests/test.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+int test_pvio()
+{
+	int fd;
+	char buf1[4], buf2[8], buf3[16];
+	struct iovec iov[3];
+	const char *filename = "t-pvio";
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	iov[0].iov_base = "hello";
+	iov[0].iov_len = 5;
+	iov[1].iov_base = NULL;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = " world\n";
+	iov[2].iov_len = 7;
+
+	ASSERT_EQ(pwritev(fd, iov, 3, 4), 12);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+	iov[0].iov_base = buf1;
+	iov[0].iov_len = 4;
+	iov[1].iov_base = buf2;
+	iov[1].iov_len = 8;
+	iov[2].iov_base = buf3;
+	iov[2].iov_len = 16;
+
+	// Short read, the last buffer is partially filled.
+	memset(buf3, 0, 16);
+	ASSERT_EQ(preadv(fd, iov, 3, 0), 16);
+	ASSERT_MEMEQ(buf1, "\0\0\0\0", 4);
+	ASSERT_MEMEQ(buf2, "hello wo", 8);
+	ASSERT_MEMEQ(buf3, "rld\n", 4);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+	// Past the end.
+	ASSERT_EQ(preadv(fd, iov, 3, 100), 0);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_pvio_large()
+{
+	int fd;
+	const size_t size = 1024 * 1024;
+	char *wbuf1, *wbuf2, *rbuf1, *rbuf2;
+	struct iovec iov[2];
+	const char *filename = "t-pvio-large";
+
+	wbuf1 = malloc(size);
+	wbuf2 = malloc(size);
+	rbuf1 = malloc(size);
+	rbuf2 = malloc(size);
+
+	ASSERT_NOTNULL(wbuf1);
+	ASSERT_NOTNULL(wbuf2);
+	ASSERT_NOTNULL(rbuf1);
+	ASSERT_NOTNULL(rbuf2);
+
+	memset(wbuf1, 'a', size);
+	memset(wbuf2, 'b', size);
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Too large to be gathered into a single buffer.
+	iov[0].iov_base = wbuf1;
+	iov[0].iov_len = size;
+	iov[1].iov_base = wbuf2;
+	iov[1].iov_len = size;
+
+	ASSERT_EQ(pwritev(fd, iov, 2, 0), 2 * size);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+	iov[0].iov_base = rbuf1;
+	iov[0].iov_len = size;
+	iov[1].iov_base = rbuf2;
+	iov[1].iov_len = size;
+
+	ASSERT_EQ(preadv(fd, iov, 2, 0), 2 * size);
+	ASSERT_MEMEQ(rbuf1, wbuf1, size);
+	ASSERT_MEMEQ(rbuf2, wbuf2, size);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	free(wbuf1);
+	free(wbuf2);
+	free(rbuf1);
+	free(rbuf2);
+
+	return 0;
+}
+
+int test_pvio_bad()
+{
+	int fd;
+	char buf[4];
+	struct iovec iov[1];
+	const char *filename = "t-pvio-bad";
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 4;
+
+	errno = 0;
+	ASSERT_EQ(preadv(fd, iov, -1, 0), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(preadv(fd, iov, UIO_MAXIOV + 1, 0), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	errno = 0;
+	ASSERT_EQ(pwritev(fd, iov, 1, -1), -1);
+	ASSERT_ERRNO(EINVAL);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	errno = 0;
+	ASSERT_EQ(preadv(fd, iov, 1, 0), -1);
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
+int test_vio()
+{
+	int fd;
+	char buf1[4], buf2[8];
+	char header[] = "HEADER\n", body[] = "body\n", trailer[] = "TRAILER\n";
+	struct iovec iov[3];
+	const char *filename = "t-vio";
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = 7;
+	iov[1].iov_base = body;
+	iov[1].iov_len = 5;
+	iov[2].iov_base = trailer;
+	iov[2].iov_len = 8;
+
+	// The file position is advanced.
+	ASSERT_EQ(writev(fd, iov, 3), 20);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 20);
+	ASSERT_EQ(writev(fd, iov, 1), 7);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 27);
+
+	ASSERT_EQ(lseek(fd, 4, SEEK_SET), 4);
+
+	iov[0].iov_base = buf1;
+	iov[0].iov_len = 4;
+	iov[1].iov_base = buf2;
+	iov[1].iov_len = 8;
+
+	ASSERT_EQ(readv(fd, iov, 2), 12);
+	ASSERT_MEMEQ(buf1, "ER\nb", 4);
+	ASSERT_MEMEQ(buf2, "ody\nTRAI", 8);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 16);
+
+	// Short read at the end.
+	ASSERT_EQ(lseek(fd, 24, SEEK_SET), 24);
+	ASSERT_EQ(readv(fd, iov, 2), 3);
+	ASSERT_MEMEQ(buf1, "ER\n", 3);
+	ASSERT_EQ(readv(fd, iov, 2), 0);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_vio_many()
+{
+	int fd;
+	const size_t large_size = 256 * 1024;
+	char small[100][10];
+	char *large;
+	struct iovec iov[102];
+	char *rbuf;
+	const char *filename = "t-vio-many";
+
+	large = malloc(large_size);
+	rbuf = malloc(large_size + 1000);
+	ASSERT_NOTNULL(large);
+	ASSERT_NOTNULL(rbuf);
+
+	memset(large, 'L', large_size);
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	// Small buffers with a large one in the middle.
+	for (int i = 0; i < 100; ++i)
+	{
+		memset(small[i], '0' + (i % 10), 10);
+	}
+
+	for (int i = 0; i < 50; ++i)
+	{
+		iov[i].iov_base = small[i];
+		iov[i].iov_len = 10;
+	}
+
+	iov[50].iov_base = large;
+	iov[50].iov_len = large_size;
+	iov[51].iov_base = NULL;
+	iov[51].iov_len = 0;
+
+	for (int i = 50; i < 100; ++i)
+	{
+		iov[i + 2].iov_base = small[i];
+		iov[i + 2].iov_len = 10;
+	}
+
+	ASSERT_EQ(writev(fd, iov, 102), large_size + 1000);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), large_size + 1000);
+
+	ASSERT_EQ(pread(fd, rbuf, large_size + 1000, 0), large_size + 1000);
+	ASSERT_MEMEQ(rbuf + 490, "9999999999", 10);
+	ASSERT_MEMEQ(rbuf + 500, large, large_size);
+	ASSERT_MEMEQ(rbuf + 500 + large_size, "0000000000", 10);
+	ASSERT_MEMEQ(rbuf + 990 + large_size, "9999999999", 10);
+
+	// Read it back the same way.
+	memset(small, 0, sizeof(small));
+	memset(large, 0, large_size);
+
+	ASSERT_EQ(preadv(fd, iov, 102, 0), large_size + 1000);
+	ASSERT_MEMEQ(small[0], "0000000000", 10);
+	ASSERT_MEMEQ(small[49], "9999999999", 10);
+	ASSERT_MEMEQ(large, rbuf + 500, large_size);
+	ASSERT_MEMEQ(small[99], "9999999999", 10);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	free(large);
+	free(rbuf);
+
+	return 0;
+}
+
+int test_vio_pipe()
+{
+	int fd[2];
+	char buf[16];
+	struct iovec iov[3];
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	iov[0].iov_base = "abc";
+	iov[0].iov_len = 3;
+	iov[1].iov_base = "def";
+	iov[1].iov_len = 3;
+	iov[2].iov_base = "ghi";
+	iov[2].iov_len = 3;
+
+	ASSERT_EQ(writev(fd[1], iov, 3), 9);
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 4;
+	iov[1].iov_base = buf + 4;
+	iov[1].iov_len = 12;
+
+	ASSERT_EQ(readv(fd[0], iov, 2), 9);
+	ASSERT_MEMEQ(buf, "abcdefghi", 9);
+
+	// Pipes can't be seeked.
+	errno = 0;
+	ASSERT_EQ(preadv(fd[0], iov, 2, 0), -1);
+	ASSERT_ERRNO(ESPIPE);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+
+	return 0;
+}
+
+int test_pvio2()
+{
+	int fd;
+	char buf[16];
+	struct iovec iov[2];
+	const char *filename = "t-pvio2";
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	iov[0].iov_base = "hello";
+	iov[0].iov_len = 5;
+	iov[1].iov_base = "world";
+	iov[1].iov_len = 5;
+
+	// An offset of -1 uses the file position.
+	ASSERT_EQ(pwritev2(fd, iov, 2, -1, 0), 10);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 10);
+
+	ASSERT_EQ(pwritev2(fd, iov, 1, 2, RWF_DSYNC), 5);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 10);
+
+	ASSERT_EQ(pwritev2(fd, iov + 1, 1, 0, RWF_APPEND | RWF_SYNC), 5);
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 8;
+	iov[1].iov_base = buf + 8;
+	iov[1].iov_len = 8;
+
+	ASSERT_EQ(preadv2(fd, iov, 2, 0, 0), 15);
+	ASSERT_MEMEQ(buf, "hehellorldworld", 15);
+
+	ASSERT_EQ(lseek(fd, 5, SEEK_SET), 5);
+	ASSERT_EQ(preadv2(fd, iov, 1, -1, RWF_HIPRI), 8);
+	ASSERT_MEMEQ(buf, "lorldwor", 8);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 13);
+
+	errno = 0;
+	ASSERT_EQ(preadv2(fd, iov, 2, 0, 0x10000), -1);
+	ASSERT_ERRNO(EOPNOTSUPP);
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+void cleanup()
+{
+	remove("t-pvio");
+	remove("t-pvio2");
+	remove("t-vio");
+	remove("t-vio-many");
+	remove("t-pvio-large");
+	remove("t-pvio-bad");
+}
+
+int main()
+{
+	INITIAILIZE_TESTS();
+	CLEANUP(cleanup);
+
+	TEST(test_pvio());
+	TEST(test_pvio_large());
+	TEST(test_pvio_bad());
+	TEST(test_vio());
+	TEST(test_vio_many());
+	TEST(test_vio_pipe());
+	TEST(test_pvio2());
+
+	VERIFY_RESULT_AND_EXIT();
+}
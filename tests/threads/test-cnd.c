@@ -88,8 +88,9 @@ int timed(void *arg)
 	if (cnd_timedwait(locks->cond, locks->mutex, &abstime) == 0)
 	{
 		signal_variable = 1;
-		mtx_unlock(locks->mutex);
 	}
+	// The mutex is reacquired even if the wait times out.
+	mtx_unlock(locks->mutex);
 
 	return 0;
 }
@@ -211,6 +211,41 @@ int test_mutex_try()
 	return 0;
 }
 
+int trylock_busy(void *arg)
+{
+	mtx_t *mutex = (mtx_t *)arg;
+	return mtx_trylock(mutex) == -1 && errno == EBUSY;
+}
+
+int test_mutex_try_plain()
+{
+	int status;
+	int result = 0;
+	thrd_t thread;
+	mtx_t mutex;
+
+	status = mtx_init(&mutex, mtx_plain);
+	ASSERT_EQ(status, 0);
+
+	status = mtx_lock(&mutex);
+	ASSERT_EQ(status, 0);
+
+	// Try lock should not block even if the mutex does not support timed waits.
+	status = thrd_create(&thread, trylock_busy, (void *)&mutex);
+	ASSERT_EQ(status, 0);
+
+	status = thrd_join(thread, &result);
+	ASSERT_EQ(status, 0);
+	ASSERT_EQ(result, 1);
+
+	status = mtx_unlock(&mutex);
+	ASSERT_EQ(status, 0);
+
+	mtx_destroy(&mutex);
+
+	return 0;
+}
+
 int main()
 {
 	INITIAILIZE_TESTS();
@@ -219,5 +254,6 @@ int main()
 	variable = 0;
 	TEST(test_mutex_timed());
 	TEST(test_mutex_try());
+	TEST(test_mutex_try_plain());
 	VERIFY_RESULT_AND_EXIT();
 }
@@ -81,6 +81,30 @@ int test_O_APPEND()
 	rbuf[length] = '\0';
 	ASSERT_STREQ(rbuf, content);
 
+	// Positional writes append as well.
+	length = pwrite(fd, "!!", 2, 0);
+	ASSERT_EQ(length, 2);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 14);
+
+	length = pread(fd, rbuf, 16, 0);
+	ASSERT_EQ(length, 16);
+	ASSERT_MEMEQ(rbuf, content, 14);
+	ASSERT_MEMEQ(rbuf + 14, "!!", 2);
+
+	// Clearing O_APPEND makes the writes follow the file position again.
+	ASSERT_SUCCESS(fcntl(fd, F_SETFL, 0));
+	ASSERT_EQ(fcntl(fd, F_GETFL) & O_APPEND, 0);
+	lseek(fd, 0, SEEK_SET);
+
+	length = write(fd, "??", 2);
+	ASSERT_EQ(length, 2);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 2);
+
+	length = pread(fd, rbuf, 16, 0);
+	ASSERT_EQ(length, 16);
+	ASSERT_MEMEQ(rbuf, "??", 2);
+	ASSERT_MEMEQ(rbuf + 2, content + 2, 12);
+
 	ASSERT_SUCCESS(close(fd));
 	ASSERT_SUCCESS(unlink(filename));
 
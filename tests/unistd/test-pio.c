@@ -7,6 +7,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/file.h>
 #include <tests/test.h>
 #include <errno.h>
 
@@ -83,9 +84,104 @@ int test_pio_null()
 	return 0;
 }
 
+int test_pio_lock()
+{
+	errno = 0;
+	int fd;
+	ssize_t length;
+	char rbuf[16];
+	const char *filename = "t-pio-lock";
+
+	fd = open(filename, O_RDWR | O_CREAT, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	length = write(fd, (void *)content, 14);
+	ASSERT_EQ(length, 14);
+
+	// The lock holder should still be able to do positional io.
+	ASSERT_SUCCESS(flock(fd, LOCK_EX));
+
+	length = pwrite(fd, "world", 5, 0);
+	ASSERT_EQ(length, 5);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 14);
+
+	length = pread(fd, rbuf, 7, 0);
+	ASSERT_EQ(length, 7);
+	ASSERT_MEMEQ(rbuf, "world1\n", 7);
+	ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 14);
+
+	ASSERT_SUCCESS(flock(fd, LOCK_UN));
+
+	ASSERT_SUCCESS(close(fd));
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
+int test_pio_reuse()
+{
+	errno = 0;
+	int fd1, fd2;
+	ssize_t length;
+	char rbuf[16];
+	const char *filename1 = "t-pio-reuse1";
+	const char *filename2 = "t-pio-reuse2";
+
+	fd1 = open(filename1, O_RDWR | O_CREAT, 0700);
+	ASSERT_NOTEQ(fd1, -1);
+	fd2 = open(filename2, O_RDWR | O_CREAT, 0700);
+	ASSERT_NOTEQ(fd2, -1);
+
+	ASSERT_EQ(write(fd1, "aaaa", 4), 4);
+	ASSERT_EQ(write(fd2, "bbbb", 4), 4);
+
+	length = pread(fd1, rbuf, 4, 0);
+	ASSERT_EQ(length, 4);
+	ASSERT_MEMEQ(rbuf, "aaaa", 4);
+
+	// The descriptor now refers to another file, positional io should follow it.
+	ASSERT_EQ(dup2(fd2, fd1), fd1);
+
+	length = pread(fd1, rbuf, 4, 0);
+	ASSERT_EQ(length, 4);
+	ASSERT_MEMEQ(rbuf, "bbbb", 4);
+
+	ASSERT_SUCCESS(close(fd1));
+	ASSERT_SUCCESS(close(fd2));
+	ASSERT_SUCCESS(unlink(filename1));
+	ASSERT_SUCCESS(unlink(filename2));
+
+	return 0;
+}
+
+int test_pio_bad()
+{
+	errno = 0;
+	int fd[2];
+	char rbuf[16];
+
+	ASSERT_SUCCESS(pipe(fd));
+
+	ASSERT_EQ(pread(fd[0], rbuf, 16, 0), -1);
+	ASSERT_ERRNO(ESPIPE);
+	ASSERT_EQ(pwrite(fd[1], "a", 1, 0), -1);
+	ASSERT_ERRNO(ESPIPE);
+
+	ASSERT_SUCCESS(close(fd[0]));
+	ASSERT_SUCCESS(close(fd[1]));
+
+	ASSERT_EQ(pread(fd[0], rbuf, 16, 0), -1);
+	ASSERT_ERRNO(EBADF);
+
+	return 0;
+}
+
 void cleanup()
 {
 	remove("t-pio");
+	remove("t-pio-lock");
+	remove("t-pio-reuse1");
+	remove("t-pio-reuse2");
 }
 
 int main()
@@ -95,6 +191,9 @@ int main()
 
 	TEST(test_pio());
 	TEST(test_pio_null());
+	TEST(test_pio_lock());
+	TEST(test_pio_reuse());
+	TEST(test_pio_bad());
 
 	VERIFY_RESULT_AND_EXIT();
 }
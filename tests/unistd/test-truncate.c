@@ -97,6 +97,39 @@ int test_ftruncate()
 	return 0;
 }
 
+int test_ftruncate_append()
+{
+	int fd;
+	ssize_t length;
+	char read_buffer[16];
+	const char *filename = "t-ftruncate-append";
+
+	fd = open(filename, O_CREAT | O_WRONLY | O_APPEND, 0700);
+	ASSERT_NOTEQ(fd, -1);
+
+	length = write(fd, "hello world", 11);
+	ASSERT_EQ(length, 11);
+
+	ASSERT_SUCCESS(ftruncate(fd, 5));
+
+	// Writes still go to the end.
+	length = write(fd, "!", 1);
+	ASSERT_EQ(length, 1);
+
+	ASSERT_SUCCESS(close(fd));
+
+	fd = open(filename, O_RDONLY);
+	ASSERT_NOTEQ(fd, -1);
+	length = read(fd, read_buffer, 16);
+	ASSERT_EQ(length, 6);
+	ASSERT_MEMEQ(read_buffer, "hello!", 6);
+	ASSERT_SUCCESS(close(fd));
+
+	ASSERT_SUCCESS(unlink(filename));
+
+	return 0;
+}
+
 int test_readonly()
 {
 	int status;
@@ -120,6 +153,7 @@ void cleanup()
 	remove("t-truncate-lesser");
 	remove("t-truncate-greater");
 	remove("t-ftruncate");
+	remove("t-ftruncate-append");
 	remove("t-truncate-readonly");
 }
 
@@ -131,6 +165,7 @@ int main()
 	TEST(test_lesser_length());
 	TEST(test_greater_length());
 	TEST(test_ftruncate());
+	TEST(test_ftruncate_append());
 	TEST(test_readonly());
 
 	VERIFY_RESULT_AND_EXIT();